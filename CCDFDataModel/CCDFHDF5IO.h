@@ -29,6 +29,8 @@
 #include "CCDFDataModel.h"
 #include <stdio.h>
 #include <vector>
+#include <map>
+#include <string>
 #include <iostream>
 #include <hdf5.h>
 #include "CDebugger.h"
@@ -107,6 +109,86 @@ class CDFHDF5Reader :public CDFReader{
     hid_t error_stack;
     bool b_EnableKNMIHDF5toCFConversion;
     bool b_KNMIHDF5UseEndTime;
+
+    /* True when the variables and the CF conversion of fileName are already in cdfObject */
+    bool headerIsRead;
+
+    /* Datasets opened for reading data, by variable name. They stay open until close() */
+    std::map<std::string,hid_t> openDatasets;
+
+    /* Dataset access properties with the raw data chunk cache, H5P_DEFAULT when not configured */
+    hid_t datasetAccessProperties;
+
+    /**
+     * Returns the dataset of the variable with the given HDF5 name, opens it when it is not yet open
+     * @return The dataset id, or a negative value when it does not exist
+     */
+    hid_t getDataset(const char *variableGroupName){
+      std::map<std::string,hid_t>::iterator it = openDatasets.find(variableGroupName);
+      if(it!=openDatasets.end())return it->second;
+      char varName[1024];
+      hid_t datasetID = -1;
+      hid_t HDF5_group=openH5GroupByName(varName,1023,variableGroupName);
+      if(HDF5_group>0){
+        datasetID = H5Dopen2(HDF5_group,varName,datasetAccessProperties);
+        if(datasetID>0)openDatasets[variableGroupName]=datasetID;
+      }
+      closeH5GroupByName(variableGroupName);
+      return datasetID;
+    }
+
+    /**
+     * Reads a hyperslab of a dataset into var->data. Dimensions of var in front of the dimensions of the dataset
+     * are skipped, like the time dimension which is added by the KNMI HDF5 to CF conversion.
+     * @param start,count,stride Per dimension of var, or NULL to read the whole dataset
+     */
+    int readHyperslab(CDF::Variable *var,CDFType type,hid_t datasetID,size_t *start,size_t *count,ptrdiff_t *stride){
+      hid_t   HDF5_dataspace = H5Dget_space(datasetID);
+      int     ndims          = H5Sget_simple_extent_ndims(HDF5_dataspace);
+      if(ndims<=0){
+        H5Sclose(HDF5_dataspace);
+        CDBError("Dataset for variable %s has no dimensions",var->name.c_str());
+        return 1;
+      }
+      hsize_t dims_out[ndims];
+      H5Sget_simple_extent_dims(HDF5_dataspace, dims_out, NULL);
+      hsize_t data_start[ndims],data_count[ndims],data_stride[ndims];
+      size_t totalVariableSize=1;
+      int dimDiff=var->dimensionlinks.size()-ndims;
+      if(dimDiff<0)dimDiff=0;
+      for(int d=0;d<ndims;d++){
+        if(start!=NULL&&count!=NULL){
+          data_start[d]=start[d+dimDiff];
+          data_count[d]=count[d+dimDiff];
+          data_stride[d]=(stride!=NULL&&stride[d+dimDiff]>0)?stride[d+dimDiff]:1;
+        }else{
+          data_start[d]=0;
+          data_count[d]=dims_out[d];
+          data_stride[d]=1;
+        }
+#ifdef CCDFHDF5IO_DEBUG
+        CDBDebug("%d start %d count %d stride %d",d,(int)data_start[d],(int)data_count[d],(int)data_stride[d]);
+#endif
+        totalVariableSize*=data_count[d];
+      }
+
+      var->setSize(totalVariableSize);
+      if(CDF::allocateData(type,&var->data,var->getSize())){throw(__LINE__);}
+
+      /* Only the chunks which intersect the selection are read and decompressed */
+      hid_t HDF5_memspace = H5Screate_simple(ndims,data_count,NULL);
+      herr_t readStatus = H5Sselect_hyperslab(HDF5_dataspace,H5S_SELECT_SET,data_start,data_stride,data_count,NULL);
+      if(readStatus>=0){
+        readStatus = H5Dread(datasetID,cdfTypeToHDFType(type),HDF5_memspace,HDF5_dataspace,H5P_DEFAULT,var->data);
+      }
+      H5Sclose(HDF5_memspace);
+      H5Sclose(HDF5_dataspace);
+      if(readStatus<0){
+        CDBError("Unable to read data for variable %s",var->name.c_str());
+        return 1;
+      }
+      return 0;
+    }
    
   public:
     class CustomForecastReader:public CDF::Variable::CustomReader{
@@ -177,12 +259,16 @@ class CDFHDF5Reader :public CDFReader{
       b_KNMIHDF5UseEndTime=false;
       forecastReader = NULL;
       fileIsOpen = false;
+      headerIsRead = false;
+      datasetAccessProperties = H5P_DEFAULT;
     }
     ~CDFHDF5Reader(){
 #ifdef CCDFHDF5IO_DEBUG            
       CDBDebug("CCDFHDF5IO close");
 #endif     
       close();
+      if(forecastReader!=NULL){delete forecastReader;forecastReader=NULL;}
+      if(datasetAccessProperties!=H5P_DEFAULT)H5Pclose(datasetAccessProperties);
       /* Restore previous error handler */
       //H5Eset_auto2(error_stack, old_func, old_client_data);
     }
@@ -475,6 +561,28 @@ CDBDebug("Opened dataset %s with id %d from %d",name,datasetID,groupID);
     void enableKNMIHDF5UseEndTime() {
       b_KNMIHDF5UseEndTime=true;
     }
+
+    /**
+     * Sets the raw data chunk cache of the datasets, see H5Pset_chunk_cache. Must be called before reading data.
+     * @param numBytes Size of the cache per dataset in bytes
+     * @param numSlots Number of hash table slots, preferably a prime about 100 times the number of chunks in the cache
+     * @param preemption Preemption policy between 0 and 1, 1 evicts chunks which are fully read first
+     */
+    int setChunkCache(size_t numBytes,size_t numSlots,double preemption){
+      if(datasetAccessProperties==H5P_DEFAULT){
+        datasetAccessProperties = H5Pcreate(H5P_DATASET_ACCESS);
+        if(datasetAccessProperties<0){
+          datasetAccessProperties = H5P_DEFAULT;
+          CDBError("Unable to create dataset access properties");
+          return 1;
+        }
+      }
+      if(H5Pset_chunk_cache(datasetAccessProperties,numSlots,numBytes,preemption)<0){
+        CDBError("Unable to set chunk cache to %lu bytes, %lu slots, preemption %f",(unsigned long)numBytes,(unsigned long)numSlots,preemption);
+        return 1;
+      }
+      return 0;
+    }
     
     int convertNWCSAFtoCF();
     
@@ -971,6 +1079,12 @@ CDBDebug("Opened dataset %s with id %d from %d",name,datasetID,groupID);
       H5F_file = H5Fopen(this->fileName.c_str(),H5F_ACC_RDONLY, H5P_DEFAULT );
       
       if(H5F_file <0){CDBError("could not open HDF5 file [%s]",this->fileName.c_str());return 1;}
+
+      /* Reopened for reading data after close(): the variables and the CF conversion are still valid */
+      if(headerIsRead){
+        fileIsOpen=true;
+        return 0;
+      }
       
       //Read global attributes
 #ifdef CCDFHDF5IO_DEBUG      
@@ -1004,11 +1118,16 @@ CDBDebug("convertKNMIHDF5toCF()");
         if(status == 1)return 1;
       }
       fileIsOpen=true;
+      headerIsRead=true;
       return 0;
     }
     int close(){
+      for(std::map<std::string,hid_t>::iterator it=openDatasets.begin();it!=openDatasets.end();++it){
+        H5Dclose(it->second);
+      }
+      openDatasets.clear();
       if(H5F_file!=-1)H5Fclose(H5F_file);
-      if(forecastReader!=NULL){delete forecastReader;forecastReader=NULL;}
+      H5F_file=-1;
       fileIsOpen = false;
       return 0;
     }
@@ -1049,6 +1168,7 @@ CDBDebug("convertKNMIHDF5toCF()");
         #ifdef CCDFHDF5IO_DEBUG
         CDBDebug("closing with id %d",opengroups.back());
         #endif
+        H5Gclose(opengroups.back());
         opengroups.pop_back();
       }
     }
@@ -1058,105 +1178,34 @@ CDBDebug("convertKNMIHDF5toCF()");
         return 0;
       }
       if(fileIsOpen == false){
-        CDBError("openH5GroupByName: File is not open");
-        CDBDebug("Trying to open [%s]",fileName.c_str());
+        #ifdef CCDFHDF5IO_DEBUG
+        CDBDebug("Reopening [%s]",fileName.c_str());
+        #endif
         if(open(fileName.c_str())!=0)return -1;
       }
       
+      #ifdef CCDFHDF5IO_DEBUG
       char typeName[32];
       CDF::getCDFDataTypeName(typeName,31,type);
-      #ifdef CCDFHDF5IO_DEBUG
       CDBDebug("Reading %s --> %s with type %s",var->name.c_str(),var->orgName.c_str(),typeName);
       #endif
-      char varName[1024];
-      hid_t HDF5_group=openH5GroupByName(varName,1023,var->orgName.c_str());
-      if(HDF5_group>0){
-#ifdef CCDFHDF5IO_DEBUG        
-        CDBDebug("Group  %s Openend, got variable %s",var->orgName.c_str(),varName);
-#endif        
-        hid_t datasetID = H5Dopen2(HDF5_group,varName,H5P_DEFAULT);
-        if(datasetID>0){
-#ifdef CCDFHDF5IO_DEBUG          
-          CDBDebug("Dataset Openend");
-#endif          
-          hid_t   HDF5_dataspace = H5Dget_space(datasetID); 
-          int     ndims          = H5Sget_simple_extent_ndims(HDF5_dataspace);
-          hsize_t dims_out[ndims];
-          H5Sget_simple_extent_dims(HDF5_dataspace, dims_out, NULL);
-          hsize_t mem_count[ndims],mem_start[ndims];
-          hsize_t data_count[ndims],data_start[ndims];
-          int totalVariableSize=1;
-          int dimDiff=var->dimensionlinks.size()-ndims;
-          if(dimDiff<0)dimDiff=0;
-          for(int d=0;d<ndims;d++){
-            mem_start[d]=0;
-            mem_count[d]=count[d+dimDiff];
-            data_start[d]=start[d+dimDiff];//mem_start[d];
-            data_count[d]=mem_count[d];
-            #ifdef CCDFHDF5IO_DEBUG
-            CDBDebug("%d %d, %d",d,data_start[d],data_count[d]);
-#endif
-            totalVariableSize*=mem_count[d];;
-        
-          }
-          
-#ifdef CCDFHDF5IO_DEBUG          
-          CDBDebug("totalVariableSize= %d",totalVariableSize);
-#endif          
-          var->setSize(totalVariableSize);
-          if(CDF::allocateData(type,&var->data,var->getSize())){throw(__LINE__);}
-          hid_t HDF5_memspace = H5Screate_simple(2,mem_count,NULL);
-          H5Sselect_hyperslab(HDF5_memspace,H5S_SELECT_SET,mem_start, NULL,mem_count, NULL);
-          H5Sselect_hyperslab(HDF5_dataspace,H5S_SELECT_SET,data_start, NULL,data_count, NULL);
-          //hid_t datasetType=H5Dget_type(datasetID);
-          hid_t datasetType=cdfTypeToHDFType(type);
-          H5Dread(datasetID,datasetType,HDF5_memspace,HDF5_dataspace,H5P_DEFAULT,var->data);
-          
-          /*          
-          if(type==CDF_USHORT){
-          for(size_t j=0;j<var->getSize();j++){
-          unsigned short a=((unsigned short*)(var->data))[j];
-          unsigned char p1=a;
-          unsigned char p2=a/256;
-          a=p1*256+p2;
-          ((unsigned short*)(var->data))[j]=a;
-        }
-        }
-          if(type==CDF_SHORT){
-          for(size_t j=0;j<var->getSize();j++){
-          short a=((short*)(var->data))[j];
-          char p1=a;
-          char p2=a/256;
-          a=p1*256+p2;
-          ((short*)(var->data))[j]=a;
-        }
-        }*/
-          
-          //H5Tclose(datasetType);
-          H5Sclose(HDF5_memspace);
-          H5Sclose(HDF5_dataspace);
-          H5Dclose(datasetID);
-        }else {
-          CDBError("Unable to open variable %s with group ID %d",varName,HDF5_group);
-          closeH5GroupByName(var->name.c_str());
-          return 1;
-        }
-      }else {
-          closeH5GroupByName(var->name.c_str());
-          CDBError("Unable to open HDF5 group name %s",var->orgName.c_str());
-          return 1;
-        }
-      closeH5GroupByName(var->name.c_str());
-      return 0;
+      hid_t datasetID = getDataset(var->orgName.c_str());
+      if(datasetID<=0){
+        CDBError("Unable to open dataset for variable %s",var->orgName.c_str());
+        return 1;
+      }
+      return readHyperslab(var,type,datasetID,start,count,stride);
     }
     int _readVariableData(CDF::Variable *var, CDFType type){
       //All ready in memory
-      int status =0;
 //      CDBDebug(" ***** %s size=%d",var->name.c_str(),var->size());
       if(var->data!=NULL){
         //CDBWarning("Not reading any data because it is already in memory");
         return 0;
       }
+      if(fileIsOpen == false){
+        if(open(fileName.c_str())!=0)return -1;
+      }
       
       #ifdef CCDFHDF5IO_DEBUG
       char typeName[32];
@@ -1164,60 +1213,12 @@ CDBDebug("convertKNMIHDF5toCF()");
       CDBDebug("Reading %s == %s with type %s",var->name.c_str(),var->orgName.c_str(),typeName);
       #endif 
       
-      char varName[1024];
-      hid_t HDF5_group=openH5GroupByName(varName,1023,var->orgName.c_str());
-      if(HDF5_group>0){
-        hid_t datasetID = H5Dopen2(HDF5_group,varName,H5P_DEFAULT);
-        if(datasetID>0){
-          hid_t   HDF5_dataspace = H5Dget_space(datasetID); 
-          int     ndims          = H5Sget_simple_extent_ndims(HDF5_dataspace);
-          hsize_t dims_out[ndims];
-          H5Sget_simple_extent_dims(HDF5_dataspace, dims_out, NULL);
-          hsize_t mem_count[ndims],mem_start[ndims];
-          int totalVariableSize=1;
-          
-          for(int d=0;d<ndims;d++){
-            mem_start[d]=0;
-            mem_count[d]=dims_out[d];
-            totalVariableSize*=mem_count[d];;
-            //CDBDebug("dim size fpr %s = %d",varName,mem_count[d]);
-          }
-
-          var->setSize(totalVariableSize);
-          if(CDF::allocateData(type,&var->data,var->getSize())){throw(__LINE__);}
-          hid_t HDF5_memspace = H5Screate_simple(2,mem_count,NULL);
-          H5Sselect_hyperslab(HDF5_memspace,H5S_SELECT_SET,mem_start, NULL,mem_count, NULL);
-          H5Sselect_hyperslab(HDF5_dataspace,H5S_SELECT_SET,mem_start, NULL,mem_count, NULL);
-          //hid_t datasetType=H5Dget_type(datasetID);
-          hid_t datasetType=cdfTypeToHDFType(type);
-          //datasetType
-          H5Dread(datasetID,datasetType,HDF5_memspace,HDF5_dataspace,H5P_DEFAULT,var->data);
-          
-          
-        /* if(type==CDF_USHORT)
-          {
-            for(size_t j=0;j<var->getSize();j++){
-              unsigned short a=((unsigned short*)(var->data))[j];
-              unsigned char p1=a;
-              unsigned char p2=a/256;
-              a=p1*256+p2;
-              ((unsigned short*)(var->data))[j]=a;
-            }
-        }*/
-          
-          //H5Tclose(datasetType);
-          H5Sclose(HDF5_memspace);
-          H5Sclose(HDF5_dataspace);
-          H5Dclose(datasetID);
-        }else {
-          CDBError("Unable to find dataset id for variable %s",varName);
-          status=-1;
-        }
-      }else{
-        CDBError("Unable to find group id");
+      hid_t datasetID = getDataset(var->orgName.c_str());
+      if(datasetID<=0){
+        CDBError("Unable to find dataset id for variable %s",var->orgName.c_str());
+        return -1;
       }
-      closeH5GroupByName(var->name.c_str());
-      return status;
+      return readHyperslab(var,type,datasetID,NULL,NULL,NULL);
     }
 private:
   CustomForecastReader* forecastReader;
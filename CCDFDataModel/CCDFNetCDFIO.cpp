@@ -23,6 +23,8 @@
  * 
  ******************************************************************************/
 
+#include <fcntl.h>
+#include <unistd.h>
 #include "CCDFNetCDFIO.h"
 #include "CStopWatch.h"
 const char *CDFNetCDFReader::className="NetCDFReader";
@@ -41,7 +43,11 @@ CDFNetCDFReader::CDFNetCDFReader():CDFReader(){
   #endif
   root_id=-1;
   keepFileOpen=false;
-  
+  chunkCacheSize=0;
+  chunkCacheSlots=0;
+  chunkCachePreemption=-1;
+  accessMode=CDFNETCDFREADER_ACCESS_DEFAULT;
+  fileAccessAdvised=false;
 }
 CDFNetCDFReader::~CDFNetCDFReader(){
   close();
@@ -50,6 +56,121 @@ CDFNetCDFReader::~CDFNetCDFReader(){
 void CDFNetCDFReader::enableLonWarp(bool enableLonWarp){
   //warper.enableLonWarp=enableLonWarp;
 }
+
+void CDFNetCDFReader::setChunkCache(size_t size,size_t numSlots,float preemption){
+  chunkCacheSize=size;
+  chunkCacheSlots=numSlots;
+  chunkCachePreemption=preemption;
+}
+
+void CDFNetCDFReader::setAccessMode(int accessMode){
+  this->accessMode=accessMode;
+}
+
+static bool isOddPrime(size_t value){
+  for(size_t j=3;j*j<=value;j+=2)if(value%j==0)return false;
+  return true;
+}
+
+void CDFNetCDFReader::_setVariableChunkCache(int groupId,CDF::Variable *var){
+  if(chunkCacheSize==0&&accessMode==CDFNETCDFREADER_ACCESS_DEFAULT)return;
+  /* Setting the chunk cache reopens the dataset and empties the cache, so it is done once per variable */
+  std::pair<int,int> key(groupId,var->id);
+  if(chunkCacheVariables.find(key)!=chunkCacheVariables.end())return;
+  chunkCacheVariables.insert(key);
+  /* Coordinate variables are also read when only the header is needed */
+  if(var->dimensionlinks.size()>=2&&!fileAccessAdvised){
+    fileAccessAdvised=true;
+    _adviseFileAccess(var);
+  }
+
+  int ndims = 0;
+  if(nc_inq_varndims(groupId,var->id,&ndims)!=NC_NOERR||ndims<=0)return;
+  int storage = NC_CONTIGUOUS;
+  std::vector<size_t> chunkSizes(ndims);
+  /* NetCDF-3 files and contiguous variables have no chunk cache */
+  if(nc_inq_var_chunking(groupId,var->id,&storage,&chunkSizes[0])!=NC_NOERR||storage!=NC_CHUNKED)return;
+  nc_type xtype;
+  size_t typeSize = 0;
+  if(nc_inq_vartype(groupId,var->id,&xtype)!=NC_NOERR||nc_inq_type(groupId,xtype,NULL,&typeSize)!=NC_NOERR)return;
+  std::vector<int> dimIds(ndims);
+  if(nc_inq_vardimid(groupId,var->id,&dimIds[0])!=NC_NOERR)return;
+
+  /* The number of chunks the access pattern keeps using. The last two dimensions are y and x, the others are time, levels, ... */
+  int firstSpatialDim = ndims>=2?ndims-2:0;
+  size_t chunkBytes = typeSize;
+  size_t numChunks = 1;
+  for(int d=0;d<ndims;d++){
+    size_t dimLength = 0;
+    nc_inq_dimlen(groupId,dimIds[d],&dimLength);
+    if(chunkSizes[d]==0)chunkSizes[d]=1;
+    chunkBytes*=chunkSizes[d];
+    size_t dimChunks = (dimLength+chunkSizes[d]-1)/chunkSizes[d];
+    if(dimChunks==0)dimChunks=1;
+    bool spatial = d>=firstSpatialDim&&ndims>=2;
+    switch(accessMode){
+      case CDFNETCDFREADER_ACCESS_FULLFIELD:
+        /* Fields are read row by row, a row of chunks is enough */
+        if(d==ndims-1)numChunks*=dimChunks;
+        break;
+      case CDFNETCDFREADER_ACCESS_TIMESERIES:
+        /* A series reads all chunks along time at one point, the next series is usually in the same chunks */
+        if(!spatial)numChunks*=dimChunks;
+        break;
+      case CDFNETCDFREADER_ACCESS_SPATIALTILE:
+        /* A tile reads one step, the next tiles are next to it */
+        if(spatial)numChunks*=dimChunks<CDFNETCDFREADER_TILEWINDOW?dimChunks:CDFNETCDFREADER_TILEWINDOW;
+        break;
+      default:
+        numChunks*=dimChunks;
+        break;
+    }
+  }
+
+  size_t size = chunkCacheSize;
+  if(size==0){
+    size = numChunks*chunkBytes;
+    if(size>CDFNETCDFREADER_MAXCHUNKCACHESIZE)size=CDFNETCDFREADER_MAXCHUNKCACHESIZE;
+    if(size<chunkBytes)size=chunkBytes;
+  }
+  size_t numSlots = chunkCacheSlots;
+  if(numSlots==0){
+    /* A prime larger than the number of chunks which fit in the cache */
+    numSlots = (size/chunkBytes)*2+1;
+    while(!isOddPrime(numSlots))numSlots+=2;
+  }
+  float preemption = chunkCachePreemption;
+  if(preemption<0){
+    /* Chunks of a full field are read once. A time series reads a small part of each chunk, so all of them are read
+       again for the next point. A tile reads chunks at its edges partly, only those are read again by the next tiles. */
+    switch(accessMode){
+      case CDFNETCDFREADER_ACCESS_FULLFIELD:preemption = 1.0f;break;
+      case CDFNETCDFREADER_ACCESS_TIMESERIES:preemption = 0.25f;break;
+      default:preemption = 0.75f;break;
+    }
+  }
+  #ifdef CCDFNETCDFIO_DEBUG_OPEN
+  CDBDebug("Chunk cache for %s: %lu bytes, %lu slots, preemption %f (%lu chunks of %lu bytes)",var->name.c_str(),
+           (unsigned long)size,(unsigned long)numSlots,preemption,(unsigned long)numChunks,(unsigned long)chunkBytes);
+  #endif
+  status = nc_set_var_chunk_cache(groupId,var->id,size,numSlots,preemption);
+  if(status!=NC_NOERR){ncError(__LINE__,className,"nc_set_var_chunk_cache: ",status);}
+}
+
+void CDFNetCDFReader::_adviseFileAccess(CDF::Variable *var){
+  if(accessMode!=CDFNETCDFREADER_ACCESS_FULLFIELD)return;
+  /* The library does not expose the byte ranges of chunks. The whole file is only the needed range when the variable
+     has one field, with more time steps or levels reading it ahead would pull the other fields into the cache as well */
+  size_t numFields = 1;
+  for(size_t j=0;j+2<var->dimensionlinks.size();j++){
+    numFields*=var->dimensionlinks[j]->getSize();
+  }
+  if(numFields!=1)return;
+  int fd = ::open(fileName.c_str(),O_RDONLY);
+  if(fd<0)return;
+  posix_fadvise(fd,0,0,POSIX_FADV_WILLNEED);
+  ::close(fd);
+}
 void CDFNetCDFReader::ncError(int line, const char *className, const char * msg,int e){
   if(e==NC_NOERR)return;
   char szTemp[1024];
@@ -80,6 +201,8 @@ int CDFNetCDFReader::_readVariableData(CDF::Variable *var, CDFType type,size_t *
     
     status = nc_open(fileName.c_str(),NC_NOWRITE,&root_id);
     if(status!=NC_NOERR){ncError(__LINE__,className,"nc_open: ",status);return 1;}
+    chunkCacheVariables.clear();
+    fileAccessAdvised=false;
     status = nc_inq(root_id,&nDims,&nVars,&nRootAttributes,&unlimDimIdP);
     if(status!=NC_NOERR){ncError(__LINE__,className,"nc_inq: ",status);return 1;}
     #ifdef CCDFNETCDFIO_DEBUG_OPEN        
@@ -118,6 +241,7 @@ int CDFNetCDFReader::_readVariableData(CDF::Variable *var, CDFType type,size_t *
     CDBError("_findNCGroupIdForCDFVariable for %s = -1",var->name.c_str());
     return 1;
   }
+  _setVariableChunkCache(varGroupId,var);
   //CDBDebug("readVariableData");
   //It is essential that the variable nows which reader can be used to read the data
   //var->cdfReaderPointer=(void*)this;
@@ -681,6 +805,8 @@ int CDFNetCDFReader::open(const char *fileName){
   
   status = nc_open(fileName,NC_NOWRITE,&root_id);
   if(status!=NC_NOERR){ncError(__LINE__,className,"nc_open: ",status);return 1;}
+  chunkCacheVariables.clear();
+  fileAccessAdvised=false;
   
   #ifdef MEASURETIME
   StopWatch_Stop("CDFNetCDFReader open file\n");
@@ -791,9 +917,14 @@ CDFNetCDFWriter::CDFNetCDFWriter(CDFObject *cdfObject){
   shuffle=0;
   deflate=1;
   deflate_level=2;
+  incremental=false;
+  root_id=-1;
 };
 
 CDFNetCDFWriter::~CDFNetCDFWriter(){
+  if(incremental&&root_id!=-1){
+    close();
+  }
   for(size_t j=0;j<dimensions.size();j++){delete dimensions[j];}
 };
 
@@ -803,6 +934,38 @@ void CDFNetCDFWriter::setDeflateShuffle(int deflate, int deflate_level,int shuff
   this->deflate_level = deflate_level;
 }
 
+void CDFNetCDFWriter::setOutputProfile(const OutputProfile &profile){
+  outputProfile = profile;
+#ifndef NC_QUANTIZE_BITROUND
+  if(outputProfile.quantize!=CDFNETCDFWRITER_QUANTIZE_NONE){
+    CDBWarning("Quantization is not supported by this NetCDF library, writing full precision");
+    outputProfile.quantize=CDFNETCDFWRITER_QUANTIZE_NONE;
+  }
+#endif
+}
+
+bool CDFNetCDFWriter::_getProfileChunkSizes(CDF::Variable *variable,size_t *chunkSizes){
+  size_t numDims = variable->dimensionlinks.size();
+  if(outputProfile.chunking==CDFNETCDFWRITER_CHUNKING_DEFAULT||numDims<2)return false;
+  size_t tileSize = outputProfile.chunkSize;
+  if(tileSize==0){
+    /* Time series read a small area of many steps, spatial reads a large area of one step */
+    tileSize = outputProfile.chunking==CDFNETCDFWRITER_CHUNKING_TIME?32:256;
+  }
+  for(size_t m=0;m<numDims;m++){
+    size_t dimSize = variable->dimensionlinks[m]->getSize();
+    if(m+2>=numDims){
+      chunkSizes[m] = tileSize<dimSize?tileSize:dimSize;
+    }else if(outputProfile.chunking==CDFNETCDFWRITER_CHUNKING_TIME){
+      chunkSizes[m] = outputProfile.timeChunkSize>0&&outputProfile.timeChunkSize<dimSize?outputProfile.timeChunkSize:dimSize;
+    }else{
+      chunkSizes[m] = 1;
+    }
+    if(chunkSizes[m]==0)chunkSizes[m]=1;
+  }
+  return true;
+}
+
 void CDFNetCDFWriter::setNetCDFMode(int mode){
   if(mode!=3&&mode!=4){
     CDBError("Illegal netcdf mode %d: keeping mode ",mode,netcdfMode);
@@ -889,6 +1052,90 @@ int CDFNetCDFWriter::write(const char *fileName,void(*progress)(const char*messa
   return status;
 };
 
+int CDFNetCDFWriter::create(const char *fileName){
+  this->fileName=fileName;
+  incremental=true;
+  if(netcdfMode>3){
+    status = nc_create(fileName ,NC_NETCDF4|NC_CLOBBER , &root_id);
+  }else{
+    status = nc_create(fileName , NC_CLOBBER|NC_64BIT_OFFSET, &root_id);
+  }
+  if(status!=NC_NOERR){
+    CDBError("Unable to create %s",fileName);
+    ncError(__LINE__,className,"nc_create: ",status);
+    root_id=-1;
+    return 1;
+  }
+  status = _write(NULL);
+  if(status!=0){
+    nc_close(root_id);root_id=-1;
+    return status;
+  }
+  /* The last variable can have been defined without writing data, leaving the file in define mode */
+  status = nc_enddef(root_id);
+  if(status!=NC_NOERR&&status!=NC_ENOTINDEFINE){
+    ncError(__LINE__,className,"nc_enddef: ",status);
+    nc_close(root_id);root_id=-1;
+    return 1;
+  }
+  return 0;
+}
+
+int CDFNetCDFWriter::writeSlice(const char *variableName,size_t *start,size_t *count,void *data){
+  if(root_id==-1){
+    CDBError("File is not created");
+    return 1;
+  }
+  int nc_var_id;
+  status = nc_inq_varid(root_id,variableName,&nc_var_id);
+  if(status!=NC_NOERR){
+    CDBError("For variable %s:",variableName);
+    ncError(__LINE__,className,"nc_inq_varid: ",status);return 1;
+  }
+  status = nc_put_vara(root_id,nc_var_id,start,count,data);
+  if(status!=NC_NOERR){
+    CDBError("For variable %s:",variableName);
+    ncError(__LINE__,className,"nc_put_vara: ",status);return 1;
+  }
+  return 0;
+}
+
+int CDFNetCDFWriter::putAttribute(const char *variableName,CDF::Attribute *attribute){
+  if(root_id==-1){
+    CDBError("File is not created");
+    return 1;
+  }
+  int nc_var_id = NC_GLOBAL;
+  if(variableName!=NULL){
+    status = nc_inq_varid(root_id,variableName,&nc_var_id);
+    if(status!=NC_NOERR){
+      CDBError("For variable %s:",variableName);
+      ncError(__LINE__,className,"nc_inq_varid: ",status);return 1;
+    }
+  }
+  nc_redef(root_id);
+  status = nc_put_att(root_id,nc_var_id,attribute->name.c_str(),NCtypeConversion(attribute->getType()),attribute->length,attribute->data);
+  int enddefStatus = nc_enddef(root_id);
+  if(status!=NC_NOERR){
+    CDBError("For attribute %s:",attribute->name.c_str());
+    ncError(__LINE__,className,"nc_put_att: ",status);return 1;
+  }
+  if(enddefStatus!=NC_NOERR){
+    ncError(__LINE__,className,"nc_enddef: ",enddefStatus);return 1;
+  }
+  return 0;
+}
+
+int CDFNetCDFWriter::close(){
+  if(root_id==-1)return 0;
+  status = nc_close(root_id);root_id=-1;
+  incremental=false;
+  if(status!=NC_NOERR){
+    ncError(__LINE__,className,"nc_close: ",status);return 1;
+  }
+  return 0;
+}
+
 int CDFNetCDFWriter::_write(void(*progress)(const char*message,float percentage)){
   #ifdef CCDFNETCDFWRITER_DEBUG                        
   CDBDebug("Writing global attributes");
@@ -1066,7 +1313,26 @@ int CDFNetCDFWriter::_write(void(*progress)(const char*message,float percentage)
           if(netcdfMode>=4&&numDims>0&&1==1){
             
             size_t chunkSizes[variable->dimensionlinks.size()];
-            if(variable->dimensionlinks.size()>2){
+            if(_getProfileChunkSizes(variable,chunkSizes)){
+              if(incremental){
+                /* Slices are written one at a time, chunks spanning several slices would be recompressed on every write */
+                for(size_t m=0;m+2<variable->dimensionlinks.size();m++){
+                  if(chunkSizes[m]>1){
+                    CDBWarning("Chunk size %d along %s is not supported for incremental writes, using 1",(int)chunkSizes[m],variable->dimensionlinks[m]->name.c_str());
+                    chunkSizes[m]=1;
+                  }
+                }
+              }
+              status = nc_def_var_chunking(root_id,nc_var_id,0 ,chunkSizes);
+              if(status!=NC_NOERR){ncError(__LINE__,className,"nc_def_var_chunking: ",status);return 1;}
+            }else if(variable->dimensionlinks.size()>2&&incremental){
+              /* Slices are written one at a time, a chunk never needs to be written twice */
+              for(size_t m=0;m<variable->dimensionlinks.size();m++){
+                chunkSizes[m] = m+2<variable->dimensionlinks.size()?1:variable->dimensionlinks[m]->getSize();
+              }
+              status = nc_def_var_chunking(root_id,nc_var_id,0 ,chunkSizes);
+              if(status!=NC_NOERR){ncError(__LINE__,className,"nc_def_var_chunking: ",status);return 1;}
+            }else if(variable->dimensionlinks.size()>2){
               
               
               for(size_t m=0;m<variable->dimensionlinks.size();m++){
@@ -1092,13 +1358,34 @@ int CDFNetCDFWriter::_write(void(*progress)(const char*message,float percentage)
             }
           }
           
-          //CDBDebug("shuffle ,deflate, deflate_level %d,%d,%d",shuffle ,deflate, deflate_level);
-          status = nc_def_var_deflate(root_id,nc_var_id,shuffle ,deflate, deflate_level);
+          int varShuffle = outputProfile.shuffle>=0?outputProfile.shuffle:shuffle;
+          int varDeflate = deflate, varDeflateLevel = deflate_level;
+          if(outputProfile.deflateLevel>=0){
+            varDeflate = outputProfile.deflateLevel>0?1:0;
+            varDeflateLevel = outputProfile.deflateLevel;
+          }
+          //CDBDebug("shuffle ,deflate, deflate_level %d,%d,%d",varShuffle ,varDeflate, varDeflateLevel);
+          status = nc_def_var_deflate(root_id,nc_var_id,varShuffle ,varDeflate, varDeflateLevel);
           if(status!=NC_NOERR){ncError(__LINE__,className,"nc_def_var_deflate: ",status);return 1;}
           if(listNCCommands){
-            NCCommands.printconcat("nc_def_var_deflate(root_id,var_id_%d,shuffle ,deflate, deflate_level);\n",j);
+            NCCommands.printconcat("nc_def_var_deflate(root_id,var_id_%d,%d ,%d, %d);\n",j,varShuffle,varDeflate,varDeflateLevel);
           } 
           
+#ifdef NC_QUANTIZE_BITROUND
+          /* Quantization zeroes the insignificant bits of the data fields, which makes them compress much better */
+          if(netcdfMode>=4&&outputProfile.quantize!=CDFNETCDFWRITER_QUANTIZE_NONE&&numDims>=2&&
+            (variable->currentType==CDF_FLOAT||variable->currentType==CDF_DOUBLE)){
+            int quantizeMode = NC_QUANTIZE_BITROUND;
+            if(outputProfile.quantize==CDFNETCDFWRITER_QUANTIZE_BITGROOM)quantizeMode=NC_QUANTIZE_BITGROOM;
+            if(outputProfile.quantize==CDFNETCDFWRITER_QUANTIZE_GRANULARBR)quantizeMode=NC_QUANTIZE_GRANULARBR;
+            status = nc_def_var_quantize(root_id,nc_var_id,quantizeMode,outputProfile.quantizeDigits);
+            if(status!=NC_NOERR){CDBError("Unable to quantize variable %s",name);ncError(__LINE__,className,"nc_def_var_quantize: ",status);return 1;}
+            if(listNCCommands){
+              NCCommands.printconcat("nc_def_var_quantize(root_id,var_id_%d,%d,%d);\n",j,quantizeMode,outputProfile.quantizeDigits);
+            }
+          }
+#endif
+          
           //copy data
           #ifdef CCDFNETCDFWRITER_DEBUG     
           CT::string message;
@@ -1185,7 +1472,9 @@ int CDFNetCDFWriter::_write(void(*progress)(const char*message,float percentage)
               //CDBDebug("Skipping attribute %s:%s",variable->name.c_str(),variable->attributes[i]->name.c_str());
             }
           }
-          if((numDims>0&&writeData==true)){//||(variable->isDimension&&numDims==1)){
+          /* Variables without data are written later with writeSlice */
+          bool skipData = incremental&&variable->data==NULL;
+          if((numDims>0&&writeData==true&&skipData==false)){//||(variable->isDimension&&numDims==1)){
             bool needsDimIteration=false;
             int iterativeDimIndex=variable->getIterativeDimIndex();
             if(iterativeDimIndex!=-1)needsDimIteration=true;
@@ -28,6 +28,7 @@
 
 #include <stdio.h>
 #include <vector>
+#include <set>
 #include <iostream>
 #include <netcdf.h>
 #include <math.h>
@@ -40,6 +41,18 @@
 // #define CCDFNETCDFIO_DEBUG_OPEN
 // #define CCDFNETCDFWRITER_DEBUG
 
+/* Access patterns for CDFNetCDFReader::setAccessMode, used to size the chunk caches of variables */
+#define CDFNETCDFREADER_ACCESS_DEFAULT    0
+#define CDFNETCDFREADER_ACCESS_SPATIALTILE 1
+#define CDFNETCDFREADER_ACCESS_TIMESERIES  2
+#define CDFNETCDFREADER_ACCESS_FULLFIELD   3
+
+/* Upper limit of the chunk cache size of a variable, when it is sized by the access mode */
+#define CDFNETCDFREADER_MAXCHUNKCACHESIZE (256*1024*1024)
+
+/* Number of chunks in x and in y kept by the spatial tile access mode, so neighbouring tiles reuse them */
+#define CDFNETCDFREADER_TILEWINDOW 4
+
 class CDFNetCDFReader :public CDFReader{
   private:
   static void ncError(int line, const char *className, const char * msg,int e);  
@@ -61,16 +74,98 @@ class CDFNetCDFReader :public CDFReader{
   
   int _findNCGroupIdForCDFVariable(CT::string *varName);
 
+  size_t chunkCacheSize,chunkCacheSlots;
+  float chunkCachePreemption;
+  int accessMode;
+  bool fileAccessAdvised;
+
+  /* Variables (group id, variable id) of which the chunk cache is set since the file was opened */
+  std::set<std::pair<int,int> > chunkCacheVariables;
+
+  /**
+   * Sets the chunk cache of a NetCDF-4 variable before its first read, sized by the access mode from the chunk layout
+   */
+  void _setVariableChunkCache(int groupId,CDF::Variable *var);
+
+  /**
+   * Asks the kernel to read the file ahead, used for the full field access mode. Done once per open, at the
+   * first read of a variable with two or more dimensions, and only when that variable has a single field.
+   */
+  void _adviseFileAccess(CDF::Variable *var);
+
   public:
     CDFNetCDFReader();
     ~CDFNetCDFReader();
     void enableLonWarp(bool enableLonWarp);
+
+    /**
+     * Sets the chunk cache which is used for every variable, see nc_set_var_chunk_cache. Zero values are sized
+     * by the access mode.
+     * @param size Size in bytes per variable
+     * @param numSlots Number of chunk slots, preferably a prime
+     * @param preemption Between 0 and 1, negative for the default of the access mode
+     */
+    void setChunkCache(size_t size,size_t numSlots,float preemption);
+
+    /**
+     * Sets the access pattern: CDFNETCDFREADER_ACCESS_SPATIALTILE, _TIMESERIES or _FULLFIELD
+     */
+    void setAccessMode(int accessMode);
     int open(const char *fileName);
     int close();
 };
 
 
+/* Chunk layouts of CDFNetCDFWriter::OutputProfile */
+#define CDFNETCDFWRITER_CHUNKING_DEFAULT 0
+#define CDFNETCDFWRITER_CHUNKING_SPATIAL 1
+#define CDFNETCDFWRITER_CHUNKING_TIME    2
+
+/* Lossy quantization of float and double variables, see nc_def_var_quantize (NetCDF 4.9 and up) */
+#define CDFNETCDFWRITER_QUANTIZE_NONE       0
+#define CDFNETCDFWRITER_QUANTIZE_BITGROOM   1
+#define CDFNETCDFWRITER_QUANTIZE_GRANULARBR 2
+#define CDFNETCDFWRITER_QUANTIZE_BITROUND   3
+
 class CDFNetCDFWriter{
+  public:
+    /**
+     * Describes how the variables of a NetCDF-4 file are chunked, compressed and quantized
+     */
+    class OutputProfile{
+      public:
+        OutputProfile(){
+          chunking = CDFNETCDFWRITER_CHUNKING_DEFAULT;
+          chunkSize = 0;
+          timeChunkSize = 0;
+          deflateLevel = -1;
+          shuffle = -1;
+          quantize = CDFNETCDFWRITER_QUANTIZE_NONE;
+          quantizeDigits = 0;
+        }
+        
+        /**
+         * CDFNETCDFWRITER_CHUNKING_DEFAULT: One chunk per two dimensional field
+         * CDFNETCDFWRITER_CHUNKING_SPATIAL: Square tiles of chunkSize in the last two dimensions, one step in the others
+         * CDFNETCDFWRITER_CHUNKING_TIME: Small tiles of chunkSize in the last two dimensions, timeChunkSize steps in the others
+         */
+        int chunking;
+        
+        /* Chunk size of the last two dimensions, zero for the default of the chunking */
+        size_t chunkSize;
+        
+        /* Chunk size of the other dimensions for CDFNETCDFWRITER_CHUNKING_TIME, zero for the full length */
+        size_t timeChunkSize;
+        
+        /* Overrides the deflate level (0-9) and the shuffle filter (0 or 1) when not negative */
+        int deflateLevel;
+        int shuffle;
+        
+        /* Number of significant digits for BitGroom and GranularBR, number of mantissa bits for BitRound */
+        int quantize;
+        int quantizeDigits;
+    };
+    
   private:
     static void ncError(int line, const char *className, const char * msg,int e);  
     bool writeData;
@@ -86,7 +181,14 @@ class CDFNetCDFWriter{
     DEF_ERRORFUNCTION();
     int root_id,status;
     int netcdfMode;
+    bool incremental;
+    OutputProfile outputProfile;
     int _write(void(*progress)(const char*message,float percentage));
+    
+    /**
+     * Fills chunkSizes with the chunk layout of the output profile for a variable, returns false for the default layout
+     */
+    bool _getProfileChunkSizes(CDF::Variable *variable,size_t *chunkSizes);
     int copyVar(CDF::Variable *variable,int nc_var_id,size_t *start, size_t *count);
 
   public:
@@ -99,9 +201,46 @@ class CDFNetCDFWriter{
     void disableVariableWrite();
     void disableReadData();
     void setDeflateShuffle(int deflate, int deflate_level,int shuffle);
+    
+    /**
+     * Sets the chunk layout, compression and quantization of the variables. The deflate level and shuffle of
+     * the profile override setDeflateShuffle when they are set. Has effect for NetCDF-4 only.
+     */
+    void setOutputProfile(const OutputProfile &profile);
     void recordNCCommands(bool enable);
     int write(const char *fileName);
     int write(const char *fileName,void(*progress)(const char*message,float percentage));
+    
+    /**
+     * Creates the file and writes the definitions, the attributes and the data of the variables which have data.
+     * The file stays open, so that the data of the other variables can be written slice by slice with writeSlice.
+     * Variables with more than two dimensions are chunked per slice of the last two dimensions.
+     * @param fileName The file to create
+     * @return Zero on success
+     */
+    int create(const char *fileName);
+    
+    /**
+     * Writes a hyperslab of a variable to the file opened with create
+     * @param variableName The variable to write to
+     * @param start,count The hyperslab, one value for each dimension of the variable
+     * @param data The data, of the type of the variable
+     * @return Zero on success
+     */
+    int writeSlice(const char *variableName,size_t *start,size_t *count,void *data);
+    
+    /**
+     * Writes or replaces an attribute in the file opened with create
+     * @param variableName The variable, or NULL for a global attribute
+     * @return Zero on success
+     */
+    int putAttribute(const char *variableName,CDF::Attribute *attribute);
+    
+    /**
+     * Closes the file opened with create
+     * @return Zero on success
+     */
+    int close();
 };
 
 #endif
@@ -0,0 +1,113 @@
+/******************************************************************************
+ *
+ * Project:  ADAGUC Server
+ * Purpose:  Typed access to untyped CDF data arrays
+ * Date:     2026-10-18
+ *
+ ******************************************************************************
+ *
+ * Copyright 2026, Royal Netherlands Meteorological Institute (KNMI)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ******************************************************************************/
+
+#ifndef CCDFTYPEDVIEW_H
+#define CCDFTYPEDVIEW_H
+
+#include <math.h>
+#include "CCDFTypes.h"
+
+/*
+ * Data of CDF::Variable is stored as void* with a CDFType. Loops which switch on the type or cast for every
+ * element cannot be optimized by the compiler. Instead, the type is resolved once with CDF::dispatch, which
+ * calls a kernel with a TypedView of the actual C type, so the loop in the kernel is compiled for every type:
+ *
+ *   class Sum{
+ *   public:
+ *     double result;
+ *     template <class T> void run(CDF::TypedView<T> view){
+ *       for(size_t j=0;j<view.size;j++)result+=view[j];
+ *     }
+ *   };
+ *   Sum sum;sum.result=0;
+ *   if(CDF::dispatch(variable->getType(),variable->data,variable->getSize(),sum)!=0)... //CDF_STRING or unknown
+ */
+namespace CDF{
+
+  /**
+   * Properties of the C type of a CDFType
+   */
+  template <class T> class TypeTraits{};
+  template <> class TypeTraits<char>          {public: static const CDFType type = CDF_CHAR;  static const bool isFloatingPoint = false;};
+  template <> class TypeTraits<unsigned char> {public: static const CDFType type = CDF_UBYTE; static const bool isFloatingPoint = false;};
+  template <> class TypeTraits<short>         {public: static const CDFType type = CDF_SHORT; static const bool isFloatingPoint = false;};
+  template <> class TypeTraits<unsigned short>{public: static const CDFType type = CDF_USHORT;static const bool isFloatingPoint = false;};
+  template <> class TypeTraits<int>           {public: static const CDFType type = CDF_INT;   static const bool isFloatingPoint = false;};
+  template <> class TypeTraits<unsigned int>  {public: static const CDFType type = CDF_UINT;  static const bool isFloatingPoint = false;};
+  template <> class TypeTraits<float>         {public: static const CDFType type = CDF_FLOAT; static const bool isFloatingPoint = true;};
+  template <> class TypeTraits<double>        {public: static const CDFType type = CDF_DOUBLE;static const bool isFloatingPoint = true;};
+
+  /**
+   * Returns true for NaN and infinite values, always false for integer types
+   */
+  template <class T> inline bool isNotFinite(T){return false;}
+  inline bool isNotFinite(float value){return value!=value||value==INFINITY||value==-INFINITY;}
+  inline bool isNotFinite(double value){return value!=value||value==INFINITY||value==-INFINITY;}
+
+  /**
+   * Array of size elements of type T, does not own the data
+   */
+  template <class T>
+  class TypedView{
+    public:
+    T *data;
+    size_t size;
+    TypedView(void *data,size_t size){
+      this->data = (T*)data;
+      this->size = size;
+    }
+    T &operator[](size_t index){return data[index];}
+    const T &operator[](size_t index) const {return data[index];}
+
+    /**
+     * Returns true when value is not the nodata value, not NaN and not infinite
+     */
+    static bool isValid(T value,bool hasNodataValue,T nodataValue){
+      if(hasNodataValue&&value==nodataValue)return false;
+      return !isNotFinite(value);
+    }
+  };
+
+  /**
+   * Calls kernel.run(TypedView<T>(data,size)) with the C type T of type. CDF_BYTE and CDF_CHAR are both signed char.
+   * @return 0 when the kernel was called, 1 for CDF_STRING and unknown types
+   */
+  template <class Kernel>
+  int dispatch(CDFType type,void *data,size_t size,Kernel &kernel){
+    switch(type){
+      case CDF_CHAR  : kernel.run(TypedView<char>          (data,size));return 0;
+      case CDF_BYTE  : kernel.run(TypedView<char>          (data,size));return 0;
+      case CDF_UBYTE : kernel.run(TypedView<unsigned char> (data,size));return 0;
+      case CDF_SHORT : kernel.run(TypedView<short>         (data,size));return 0;
+      case CDF_USHORT: kernel.run(TypedView<unsigned short>(data,size));return 0;
+      case CDF_INT   : kernel.run(TypedView<int>           (data,size));return 0;
+      case CDF_UINT  : kernel.run(TypedView<unsigned int>  (data,size));return 0;
+      case CDF_FLOAT : kernel.run(TypedView<float>         (data,size));return 0;
+      case CDF_DOUBLE: kernel.run(TypedView<double>        (data,size));return 0;
+    }
+    return 1;
+  }
+};
+
+#endif
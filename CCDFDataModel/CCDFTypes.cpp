@@ -24,6 +24,7 @@
  ******************************************************************************/
 
 #include "CCDFTypes.h"
+#include "CBufferPool.h"
 
 //#include "CDebugger.h"
 //#ifdef MEMLEAKCHECK
@@ -49,7 +50,7 @@ int CDF::freeData(void **p){
   if (Tracer::Ready)
     NewTrace.Remove (*p);
   #endif
-  free(*p);
+  CBufferPool::release(*p);
   *p=NULL;
   return 0;
 }
@@ -65,7 +66,7 @@ int CDF::allocateData(CDFType type,void **p,size_t length){
     //CDBError("In CDF::allocateData: Unknown type");
     return 1;
   }
-  *p = malloc(length*typeSize);
+  *p = CBufferPool::allocate(length*typeSize);
   
   if(*p==NULL){
     //CDBError("In CDF::allocateData: Unable to allocate %d elements",length);
@@ -74,7 +74,7 @@ typedef int CDFError;
 
 namespace CDF{
   //Allocates data for an array, provide type, the empty array and length
-  // Data must be freed by using free()
+  // Data must be freed with CDF::freeData
   int allocateData(CDFType type,void **p,size_t length);
   int freeData(void **p);
   
@@ -27,6 +27,7 @@
 #include "CCDFObject.h"
 #include "CCDFReader.h"
 #include "CTime.h"
+#include "CFilePrefetcher.h"
 const char *CDF::Variable::className="Variable";
 
 extern CDF::Variable::CustomMemoryReader customMemoryReaderInstance;
@@ -215,19 +216,42 @@ int CDF::Variable::readData(CDFType type,size_t *_start,size_t *_count,ptrdiff_t
     }
     //Now make the iterative dim of length zero
     size_t iterDimStart=start[iterativeDimIndex];
-    //size_t iterDimCount=count[iterativeDimIndex];
+    size_t iterDimCount=count[iterativeDimIndex];
+    ptrdiff_t iterDimStride=stride[iterativeDimIndex];
+    if(iterDimStride<1)iterDimStride=1;
 #ifdef CCDFDATAMODEL_DEBUG        
     for(size_t i=0;i<dimensionlinks.size();i++){
       CDBDebug("%d\t%d",start[i],count[i]);
     }
 #endif
-   
-   
+    
+    /* 
+     * The sub-files are read one after another, because the NetCDF and HDF5 libraries are not thread safe. 
+     * When the whole field of each sub-file is requested, worker threads read the next sub-files completely, so
+     * the serial reads are served from the page cache. For smaller hyperslabs only their headers are read ahead.
+     */
+    CFilePrefetcher prefetcher;
+    if(!hasCustomReader&&iterDimCount>1){
+      bool readWholeFiles = true;
+      for(size_t d=0;d<dimensionlinks.size();d++){
+        if(int(d)!=iterativeDimIndex&&(start[d]!=0||count[d]!=dimensionlinks[d]->getSize()||stride[d]!=1))readWholeFiles = false;
+      }
+      try{
+        for(size_t j=0;j<iterDimCount;j++){
+          start[iterativeDimIndex]=iterDimStart+j*iterDimStride;count[iterativeDimIndex]=1;
+          CDFObject *tCDFObject=(CDFObject*)((CDFObjectClass *)getCDFObjectClassPointer(start,count))->cdfObjectPointer;
+          if(tCDFObject!=NULL&&tCDFObject->currentFile.empty()==false){
+            prefetcher.addFile(tCDFObject->currentFile.c_str(),readWholeFiles);
+          }
+        }
+      }catch(int e){
+      }
+      prefetcher.start(CCDFVARIABLE_AGGREGATION_READAHEAD);
+    }
+    
     size_t dataReadOffset=0;
-    //for(size_t j=iterDimStart;j<iterDimCount+iterDimStart;j++)
-      int j=iterDimStart;
-    {
-      
+    for(size_t iterIndex=0;iterIndex<iterDimCount;iterIndex++){
+      size_t j=iterDimStart+iterIndex*iterDimStride;
       try{
         
         //Get the right CDF reader for this dimension set
@@ -241,7 +265,7 @@ int CDF::Variable::readData(CDFType type,size_t *_start,size_t *_count,ptrdiff_t
         
         for(size_t d=0;d<dimensionlinks.size();d++){
           if(useStartCountStride){
-            start[d]=0;//TODO in case of multiple readers for the same variable, this offset will change!
+            start[d]=_start[d];
             count[d]=_count[d];
             stride[d]=_stride[d];
           }else{
@@ -252,22 +276,38 @@ int CDF::Variable::readData(CDFType type,size_t *_start,size_t *_count,ptrdiff_t
         }
         start[iterativeDimIndex]=tCDFObjectClass->dimIndex;
         count[iterativeDimIndex]=1;
+        stride[iterativeDimIndex]=1;
         //Read the data!
         
          if(!hasCustomReader){
           //TODO NEEDS BETTER CHECKS
           if(cdfReaderPointer==NULL){
             CDBError("No CDFReader defined for variable %s",name.c_str());
+            prefetcher.stop();
              delete[] start;delete[] count;delete[] stride;
             return 1;
           }
+          prefetcher.setCurrentFile(tCDFObject->currentFile.c_str());
           Variable *tVar=tCDFObject->getVariable(name.c_str());
+          tVar->freeData();
           if(tVar->readData(type,start,count,stride)!=0)throw(__LINE__);
           //Put the read data chunk in our destination variable
   #ifdef CCDFDATAMODEL_DEBUG                
           CDBDebug("Copying %d elements to variable %s",tVar->getSize(),name.c_str());
   #endif        
-          DataCopier::copy(data,type,tVar->data,type,dataReadOffset,0,tVar->getSize());dataReadOffset+=tVar->getSize();
+          if(iterDimCount==1&&tVar->getSize()==getSize()){
+            /* A single sub-file covers the whole request, its buffer is taken over instead of copied */
+            CDF::freeData(&data);
+            data=tVar->data;
+            tVar->data=NULL;
+          }else{
+            if(dataReadOffset+tVar->getSize()>getSize()){
+              CDBError("Sub-file data for variable %s does not fit in the destination",name.c_str());
+              throw(__LINE__);
+            }
+            DataCopier::copy(data,type,tVar->data,type,dataReadOffset,0,tVar->getSize());
+          }
+          dataReadOffset+=tVar->getSize();
           //Free the read data
   #ifdef CCDFDATAMODEL_DEBUG                
           CDBDebug("Free tVar %s",tVar->name.c_str());
@@ -279,7 +319,9 @@ int CDF::Variable::readData(CDFType type,size_t *_start,size_t *_count,ptrdiff_t
         
         
         if(hasCustomReader){
+          /* The custom reader fills the whole variable at once */
           status = customReader->readData(this,_start,count,stride);
+          break;
         }
          
         
@@ -289,10 +331,12 @@ int CDF::Variable::readData(CDFType type,size_t *_start,size_t *_count,ptrdiff_t
       }catch(int e){
         
         CDBError("Exception at line %d",e);
+        prefetcher.stop();
         delete[] start;delete[] count;delete[] stride;
         return 1;
       }
     }
+    prefetcher.stop();
     delete[] start;delete[] count;delete[] stride;
     
     if(status!=0)return 1;
@@ -31,6 +31,9 @@
 #include "CCDFDimension.h"
  //#define CCDFDATAMODEL_DEBUG
 #include "CDebugger_H2.h"
+
+/* Number of sub-files of an aggregated variable which are read ahead while reading, zero disables read ahead */
+#define CCDFVARIABLE_AGGREGATION_READAHEAD 4
 namespace CDF{
   class Variable{
     
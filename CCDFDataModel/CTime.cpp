@@ -30,6 +30,12 @@
 #include <math.h>
 
 const char *CTime::className="CTime";
+
+//Day number of 1582-10-15, the first day of the gregorian calendar. udunits uses the julian calendar before.
+#define CTIME_GREGORIANSTARTDAY -141427
+
+//Offsets further than about a million years from the epoch can not be converted
+#define CTIME_MAXFASTSECONDS 3.0e13
 //                                                    1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12
 int CTime::CTIME_CALENDARTYPE_360day_Months[]=     { 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30};
 int CTime::CTIME_CALENDARTYPE_360day_MonthsCumul[]={ 0, 30, 60, 90,120,150,180,210,240,270,300,330,360};
@@ -48,7 +54,10 @@ void CTime::safestrcpy(char *s1,const char*s2,size_t size_s1){
 
 CTime::CTime(){
   isInitialized = false;
+  udunitsInitialized = false;
   mode = CTIME_MODE_UTCALENDAR;
+  calendarType = CTIME_CALENDARTYPE_STANDARD;
+  timeUnits.fastPath = false;
 }
 CTime::~CTime(){
   reset();
@@ -61,12 +70,14 @@ CT::string CTime::getErrorMessage(int CTimeParserException){
 }
 
 void CTime::reset(){
-  if(isInitialized){
+  if(udunitsInitialized){
     utTerm();
   }
   currentUnit="";
   currentCalendar="";
   isInitialized=false;
+  udunitsInitialized=false;
+  timeUnits.fastPath=false;
 }
 
 int CTime::init(CDF::Variable *timeVariable){
@@ -138,15 +149,16 @@ int CTime::init(const char *units, const char *calendar){
     }
   }
   
-
-  bool parseTimeUnitsMySelf = false;
+  mode = CTIME_MODE_UTCALENDAR;
+  calendarType = CTIME_CALENDARTYPE_STANDARD;
+  timeUnits.fastPath = false;
   
   if(currentCalendar.length()>0){
     if(currentCalendar.equals("360days")||
       currentCalendar.equals("360_day")){
       //Mode is 360day
       mode = CTIME_MODE_360day;
-      parseTimeUnitsMySelf = true;
+      calendarType = CTIME_CALENDARTYPE_360DAY;
       CDBDebug("360day calendar with units %s",currentUnit.c_str());
     }
     if(currentCalendar.equals("365days")||
@@ -155,175 +167,22 @@ int CTime::init(const char *units, const char *calendar){
       currentCalendar.equals("no_leap")){
       //Mode is 365day  || noleap
       mode = CTIME_MODE_365day;
-      parseTimeUnitsMySelf = true;
+      calendarType = CTIME_CALENDARTYPE_365DAY;
       CDBDebug("365day calendar with units %s",currentUnit.c_str());
     }
-
+    if(currentCalendar.equals("proleptic_gregorian")){
+      calendarType = CTIME_CALENDARTYPE_PROLEPTICGREGORIAN;
+    }
   }
-  if(parseTimeUnitsMySelf){
-    //Eg parse "days since 1949-12-01 00:00:00"
-    CT::string YYYYMMDDPart;
-    CT::string HHMMSSPart;
   
-
-    CT::string* timeItems = currentUnit.splitToArray(" ");
-  
-    bool hasError = false;
-    try{
-      if(timeItems->count<3){
-        CDBError("timeItems length <3 for %s",currentUnit.c_str());
-        throw(__LINE__);
-      }
-      if(timeItems[1].equals("since")==false){
-        CDBError("timeItems is missing since for %s",currentUnit.c_str());
-        throw(__LINE__);
-      }
-    
-      int unitType = -1;
-      //Determine unit type (days since, hours since)
-      if(timeItems[0].equals("seconds")){unitType = CTIME_UNITTYPE_SECONDS;}
-      if(timeItems[0].equals("minutes")){unitType = CTIME_UNITTYPE_MINUTES;}
-      if(timeItems[0].equals("hours")){unitType = CTIME_UNITTYPE_HOURS;}
-      if(timeItems[0].equals("days")){unitType = CTIME_UNITTYPE_DAYS;}
-      if(timeItems[0].equals("months")){unitType = CTIME_UNITTYPE_MONTHS;}
-      if(timeItems[0].equals("years")){unitType = CTIME_UNITTYPE_YEARS;}
-      
-      if(unitType == -1){
-        CDBError("Unable to detect type of units for %s",timeItems[0].c_str());
-        throw(__LINE__);
-      }
-      timeUnits.unitType = unitType;
-    
-      timeUnits.date.year = 0;
-      timeUnits.date.month = 0;
-      timeUnits.date.day = 0;
-      timeUnits.date.hour = 0;
-      timeUnits.date.minute = 0;
-      timeUnits.date.second = 0;
-      
-      //Determince the since part, e.g. 1949-12-01 00:00:00
-      YYYYMMDDPart = timeItems[2].c_str();
-      
-      CT::string * YYYYMMDDPartSplitted = YYYYMMDDPart.splitToArray("-");
-      
-      if(YYYYMMDDPartSplitted->count != 3){
-        CDBError("YYYYMMDD part is incorrect [%s]",YYYYMMDDPart.c_str());
-        hasError = true;
-      }else{
-        timeUnits.date.year = YYYYMMDDPartSplitted[0].toInt();
-        timeUnits.date.month = YYYYMMDDPartSplitted[1].toInt();
-        timeUnits.date.day = YYYYMMDDPartSplitted[2].toInt();
-      }
-      
-      delete [] YYYYMMDDPartSplitted;
-      
-      if(timeItems->count>3){
-        HHMMSSPart=timeItems[3].c_str();
-        
-        CT::string *HHMMSSPartSplited = HHMMSSPart.splitToArray(":");
-        if(HHMMSSPartSplited->count!=3){
-          CDBError("HHMMSS part is incorrect [%s]",HHMMSSPart.c_str());
-          hasError = true;
-        }else{
-          timeUnits.date.hour = HHMMSSPartSplited[0].toInt();
-          timeUnits.date.minute = HHMMSSPartSplited[1].toInt();
-          timeUnits.date.second = (double)HHMMSSPartSplited[2].toInt();
-        }
-        delete [] HHMMSSPartSplited;
-      }
-    }catch(int e){
-      hasError = true;
-    }
-    delete[] timeItems;
-    
-    //Check limits
-    if(!(timeUnits.date.year>=0   && timeUnits.date.year<10000))  {CDBError("Year out of range");return 1;}
-    if(!(timeUnits.date.month>=1  && timeUnits.date.month<13)) {CDBError("Month out of range");return 1;}
-    if(!(timeUnits.date.day>=1    && timeUnits.date.day<32))   {CDBError("Day out of range");return 1;}
-    if(!(timeUnits.date.hour>=0   && timeUnits.date.hour<24))  {CDBError("Hour out of range");return 1;}
-    if(!(timeUnits.date.minute>=0 && timeUnits.date.minute<60)){CDBError("Minute out of range");return 1;}
-    if(!(timeUnits.date.second>=0 && timeUnits.date.second<60)){CDBError("Second out of range");return 1;}
-    
-    //Calculate date since offset for units
-    timeUnits.dateSinceOffset = 0;
-    
-    
-//       timeUnits.dateSinceOffset = dateToOffset(
-    if(timeUnits.unitType == CTIME_UNITTYPE_DAYS){
-      if(mode == CTIME_MODE_360day){
-        timeUnits.dateSinceOffset +=timeUnits.date.year*360;   
-        timeUnits.dateSinceOffset +=CTIME_CALENDARTYPE_360day_MonthsCumul[(timeUnits.date.month-1)];
-        timeUnits.dateSinceOffset +=(timeUnits.date.day-1);        
-  //         timeUnits.dateSinceOffset +=(((double)timeUnits.date.hour)/24.);  TODO
-  //         timeUnits.dateSinceOffset +=(((double)timeUnits.date.minute)/(24*60.)); TODO
-  //         timeUnits.dateSinceOffset +=(((double)timeUnits.date.second)/(24*60*60.));   TODO     
-      }
-      if(mode == CTIME_MODE_365day){
-        timeUnits.dateSinceOffset +=timeUnits.date.year*365;   
-        timeUnits.dateSinceOffset +=CTIME_CALENDARTYPE_365day_MonthsCumul[(timeUnits.date.month-1)];
-        timeUnits.dateSinceOffset +=(timeUnits.date.day-1);        
-        timeUnits.dateSinceOffset +=(((double)timeUnits.date.hour)/24.); 
-        timeUnits.dateSinceOffset +=(((double)timeUnits.date.minute)/(24*60.));
-        timeUnits.dateSinceOffset +=(((double)timeUnits.date.second)/(24*60*60.));  
-        
-//         CDBDebug("timeUnits.date.month = %f",float(timeUnits.date.month));
-//         
-//         
-//         
-//         CDBDebug("Y = %f",float(timeUnits.date.year*365));
-//         CDBDebug("m = %f",float(CTIME_CALENDARTYPE_365day_MonthsCumul[(timeUnits.date.month-1)]));
-//         CDBDebug("D = %f",float(timeUnits.date.day));
-//         CDBDebug("H = %f",(((double)timeUnits.date.hour)/24.));
-//         CDBDebug("M = %f",(((double)timeUnits.date.minute)/(24*60.)));
-//         CDBDebug("S = %f",(((double)timeUnits.date.second)/(24*60*60.)));
-//         
-//         
-//         CDBDebug("dateSinceOffset = %f",timeUnits.dateSinceOffset);
-      }
-
-    }else{
-      CDBError("timeUnits.unitType %d not yet supported!!!",timeUnits.unitType );
-      hasError= true;
-    }
-    
-    if(timeUnits.dateSinceOffset == 0){
-       CDBWarning("timeUnits.dateSinceOffset == 0, probably the unit parsing has failed!");
-    }
-    
-//       CDBDebug("timeUnits.date.year   = %d",timeUnits.date.year);
-//       CDBDebug("timeUnits.date.month  = %d",timeUnits.date.month);
-//       CDBDebug("timeUnits.date.day    = %d",timeUnits.date.day);
-//       CDBDebug("timeUnits.date.hour   = %d",timeUnits.date.hour);
-//       CDBDebug("timeUnits.date.minute = %d",timeUnits.date.minute);
-//       CDBDebug("timeUnits.date.second = %f",timeUnits.date.second);
-    /*
-    for(int d=1;d<366;d++){
-      CDBDebug("day %d = %d",d,getMonthByDayInYear(d,CTIME_CALENDARTYPE_365day_MonthsCumul));
-    }
-    
-    CDBDebug("dateSinceOffset = %f",timeUnits.dateSinceOffset);
-
-    double d = 20652;
-    
-    Date date =getDate(d);
-    double o = dateToOffset(date);
-    
-    CDBDebug("2006-07-01: In = %f, out = %s and %f",d,dateToISOString(date).c_str(),o);
-    
-    for(double d=20652;d<20652+366;d++){
-      Date date =getDate(d);
-      double o = dateToOffset(date);
-      
-      CDBDebug("In = %f, out = %s and %f",d,dateToISOString(date).c_str(),o);
-    }*/
-
-    if(hasError){
+  if(mode == CTIME_MODE_360day || mode == CTIME_MODE_365day){
+    //These calendars are not supported by udunits, eg parse "days since 1949-12-01 00:00:00"
+    if(parseTimeUnits(currentUnit.c_str())!=0){
+      CDBError("Unable to parse time units [%s] for calendar %s",currentUnit.c_str(),currentCalendar.c_str());
       return 1;
     }
-    
     isInitialized=true;
     return 0;
-  
   }
   
   //Mode is in YYYYMM format
@@ -340,16 +199,37 @@ int CTime::init(const char *units, const char *calendar){
     return 0;
   }
   
+  //Common units are converted without udunits. In the standard calendar udunits is still used for dates before 1582-10-15.
+  if(parseTimeUnits(currentUnit.c_str())==0){
+    if(calendarType == CTIME_CALENDARTYPE_PROLEPTICGREGORIAN || timeUnits.epochDay >= CTIME_GREGORIANSTARTDAY){
+      isInitialized=true;
+      return 0;
+    }
+    timeUnits.fastPath = false;
+  }
+  
   //Try udunits
+  if(initUdunits()!=0){
+    return 1;
+  }
+  isInitialized=true;
+  return 0;
+}
+
+int CTime::initUdunits(){
+  if(udunitsInitialized){
+    return 0;
+  }
   if (utInit("") != 0) {
     CDBError("Couldn't initialize Unidata units library, try setting UDUNITS_PATH to udunits.dat or try setting UDUNITS2_XML_PATH to udunits2.xml");
     return 1;
   }
+  udunitsInitialized = true;
   
-  size_t l=strlen(units);
+  size_t l=currentUnit.length();
   char szUnits[l+1];szUnits[l]='\0';
   for(size_t j=0;j<l;j++){
-    szUnits[j]=units[j];
+    szUnits[j]=currentUnit.c_str()[j];
     if(szUnits[j]=='U')szUnits[j]=32;
     if(szUnits[j]=='T')szUnits[j]=32;
     if(szUnits[j]=='C')szUnits[j]=32;
@@ -360,9 +240,163 @@ int CTime::init(const char *units, const char *calendar){
     CDBError("internal error: udu_fmt_time can't parse data unit string: %s",szUnits);
     return 1;
   }
-  mode = CTIME_MODE_UTCALENDAR;
+  return 0;
+}
+
+int CTime::parseTimeUnits(const char *units){
+  timeUnits.fastPath = false;
+  char unitName[32];
+  int n = 0;
+  if(sscanf(units," %31s since %n",unitName,&n)<1||n==0){
+    return 1;
+  }
   
-  isInitialized=true;
+  //Determine unit type (days since, hours since)
+  int unitType = -1;
+  double unitSeconds = 0;
+  if(strcmp(unitName,"seconds")==0||strcmp(unitName,"second")==0||strcmp(unitName,"secs")==0||strcmp(unitName,"sec")==0||strcmp(unitName,"s")==0){
+    unitType = CTIME_UNITTYPE_SECONDS;unitSeconds = 1;
+  }
+  if(strcmp(unitName,"minutes")==0||strcmp(unitName,"minute")==0||strcmp(unitName,"mins")==0||strcmp(unitName,"min")==0){
+    unitType = CTIME_UNITTYPE_MINUTES;unitSeconds = 60;
+  }
+  if(strcmp(unitName,"hours")==0||strcmp(unitName,"hour")==0||strcmp(unitName,"hrs")==0||strcmp(unitName,"hr")==0||strcmp(unitName,"h")==0){
+    unitType = CTIME_UNITTYPE_HOURS;unitSeconds = 3600;
+  }
+  if(strcmp(unitName,"days")==0||strcmp(unitName,"day")==0||strcmp(unitName,"d")==0){
+    unitType = CTIME_UNITTYPE_DAYS;unitSeconds = 86400;
+  }
+  if(unitType == -1){
+    //Months and years have no fixed length
+    return 1;
+  }
+  
+  //Determine the since part, e.g. 1949-12-01 00:00:00, 1970-01-01T00:00:00Z or 1970-1-1
+  const char *p = units+n;
+  Date date;
+  date.hour = 0;
+  date.minute = 0;
+  date.second = 0;
+  int c = 0;
+  if(sscanf(p,"%d-%d-%d%n",&date.year,&date.month,&date.day,&c)!=3){
+    return 1;
+  }
+  p+=c;
+  if(*p=='T'||*p==' '){
+    const char *q = p+1;
+    while(*q==' ')q++;
+    int hour,minute;
+    c = 0;
+    if(sscanf(q,"%2d:%2d%n",&hour,&minute,&c)==2){
+      date.hour = hour;
+      date.minute = minute;
+      q+=c;
+      if(*q==':'){
+        double second;
+        c = 0;
+        if(sscanf(q+1,"%lf%n",&second,&c)!=1){
+          return 1;
+        }
+        date.second = second;
+        q+=1+c;
+      }
+      p = q;
+    }
+  }
+  
+  //Only UTC is supported
+  while(*p==' ')p++;
+  if(!(*p==0||strcmp(p,"Z")==0||strcmp(p,"UTC")==0||strcmp(p,"GMT")==0||
+       strcmp(p,"+00:00")==0||strcmp(p,"+0:00")==0||strcmp(p,"+00")==0||strcmp(p,"00:00")==0)){
+    return 1;
+  }
+  
+  //Check limits
+  if(!(date.year>=0&&date.month>=1&&date.month<13&&date.day>=1&&date.day<32&&
+       date.hour>=0&&date.hour<24&&date.minute>=0&&date.minute<60&&date.second>=0&&date.second<60)){
+    return 1;
+  }
+  
+  timeUnits.unitType = unitType;
+  timeUnits.date = date;
+  timeUnits.unitSeconds = unitSeconds;
+  timeUnits.epochDay = dateToDayNumber(date.year,date.month,date.day);
+  timeUnits.epochSecondOfDay = date.hour*3600+date.minute*60+date.second;
+  timeUnits.fastPath = true;
+  return 0;
+}
+
+long long CTime::dateToDayNumber(int year,int month,int day){
+  long long y = year;
+  long long m = month-1;
+  //Carry months over to years
+  long long carry = m>=0?m/12:-((11-m)/12);
+  y+=carry;
+  m-=carry*12;
+  if(calendarType == CTIME_CALENDARTYPE_360DAY){
+    return y*360+CTIME_CALENDARTYPE_360day_MonthsCumul[m]+(day-1);
+  }
+  if(calendarType == CTIME_CALENDARTYPE_365DAY){
+    return y*365+CTIME_CALENDARTYPE_365day_MonthsCumul[m]+(day-1);
+  }
+  //Proleptic gregorian, days from civil date with years starting at March 1st
+  m+=1;
+  if(m<=2)y-=1;
+  long long era = (y>=0?y:y-399)/400;
+  long long yoe = y-era*400;
+  long long doy = (153*(m>2?m-3:m+9)+2)/5+(day-1);
+  long long doe = yoe*365+yoe/4-yoe/100+doy;
+  return era*146097+doe-719468;
+}
+
+void CTime::dayNumberToDate(long long dayNumber,int &year,int &month,int &day){
+  if(calendarType == CTIME_CALENDARTYPE_360DAY||calendarType == CTIME_CALENDARTYPE_365DAY){
+    int daysInYear = calendarType == CTIME_CALENDARTYPE_360DAY?360:365;
+    int *monthsCumul = calendarType == CTIME_CALENDARTYPE_360DAY?CTIME_CALENDARTYPE_360day_MonthsCumul:CTIME_CALENDARTYPE_365day_MonthsCumul;
+    long long y = dayNumber>=0?dayNumber/daysInYear:-((daysInYear-1-dayNumber)/daysInYear);
+    int doy = int(dayNumber-y*daysInYear);
+    int m = 1;
+    while(m<12&&monthsCumul[m]<=doy)m++;
+    year = int(y);
+    month = m;
+    day = doy-monthsCumul[m-1]+1;
+    return;
+  }
+  long long z = dayNumber+719468;
+  long long era = (z>=0?z:z-146096)/146097;
+  long long doe = z-era*146097;
+  long long yoe = (doe-doe/1460+doe/36524-doe/146096)/365;
+  long long doy = doe-(365*yoe+yoe/4-yoe/100);
+  long long mp = (5*doy+2)/153;
+  day = int(doy-(153*mp+2)/5+1);
+  month = int(mp<10?mp+3:mp-9);
+  year = int(yoe+era*400+(month<=2?1:0));
+}
+
+int CTime::offsetToDateFast(double offset,Date &date){
+  double total = timeUnits.epochSecondOfDay+offset*timeUnits.unitSeconds;
+  //Also rejects NaN and fill values
+  if(!(total>-CTIME_MAXFASTSECONDS&&total<CTIME_MAXFASTSECONDS)){
+    return 2;
+  }
+  double days = floor(total/86400.);
+  double secondOfDay = total-days*86400.;
+  //Rounding to microseconds removes the error of the unit conversion
+  secondOfDay = floor(secondOfDay*1000000.+0.5)/1000000.;
+  if(secondOfDay>=86400.){
+    secondOfDay-=86400.;
+    days+=1;
+  }
+  long long dayNumber = timeUnits.epochDay+(long long)days;
+  if(calendarType == CTIME_CALENDARTYPE_STANDARD && dayNumber < CTIME_GREGORIANSTARTDAY){
+    return 1;
+  }
+  dayNumberToDate(dayNumber,date.year,date.month,date.day);
+  int seconds = int(secondOfDay);
+  date.hour = seconds/3600;
+  date.minute = (seconds/60)%60;
+  date.second = secondOfDay-(date.hour*3600+date.minute*60);
+  date.offset = offset;
   return 0;
 }
 
@@ -382,86 +416,15 @@ CTime::Date CTime::getDate(double offset){
   Date date;
   date.offset=offset;
   
-    if(mode == CTIME_MODE_360day){
-    if(timeUnits.unitType == CTIME_UNITTYPE_DAYS){
-      double newOffset = timeUnits.dateSinceOffset+offset;
-      date.year = int(newOffset/360);
-      newOffset-=(date.year*360);
-
-      date.month = getMonthByDayInYear(newOffset,CTIME_CALENDARTYPE_360day_MonthsCumul);
-      if(date.month <= 0){CDBError("date.month <= 0");throw CTIME_CONVERSION_ERROR;}
-      newOffset-=(CTIME_CALENDARTYPE_360day_MonthsCumul[date.month-1]);
-
-      date.day = newOffset;
-      
-      newOffset -=date.day;;
-      if(newOffset>0){
-        date.hour   = int(newOffset*24)%24;      newOffset-=float(date.hour  )/24;
-        date.minute = int(newOffset*24*60)%60;   newOffset-=float(date.minute)/(60*24);
-        date.second = int(newOffset*24*60*60)%60;newOffset-=float(date.second)/(60*60*24);
-      }else{
-        date.hour = 0;
-        date.minute = 0;
-        date.second = 0;
-      }
-      date.day++;
-      int numDaysInMonth = CTIME_CALENDARTYPE_360day_Months[date.month-1];
-      if(date.day>numDaysInMonth){
-        date.month++;
-        date.day=1;
-        if(date.month>12){
-          date.month=1;
-          date.year++;
-        }
-      }
+  if(timeUnits.fastPath){
+    int status = offsetToDateFast(offset,date);
+    if(status == 0){
+      return date;
     }
-  }
-  
-  if(mode == CTIME_MODE_365day){
-    if(timeUnits.unitType == CTIME_UNITTYPE_DAYS){
-      double newOffset = timeUnits.dateSinceOffset+offset;
-//       CDBDebug("timeUnits.dateSinceOffset = %f",timeUnits.dateSinceOffset);
-//       CDBDebug("newOffset = %f",newOffset);
-//       CDBDebug("offset = %f",offset);
-      date.year = int(newOffset/365);
-      newOffset-=(date.year*365);
-
-      date.month = getMonthByDayInYear(newOffset,CTIME_CALENDARTYPE_365day_MonthsCumul);
-      if(date.month <= 0){CDBError("date.month <= 0");throw CTIME_CONVERSION_ERROR;}
-      newOffset-=(CTIME_CALENDARTYPE_365day_MonthsCumul[date.month-1]);
-
-      date.day = newOffset;
-      
-//       CDBDebug("YMD: %f %f %f",float(date.year),float(date.month),float(date.day));
-      
-      newOffset -=date.day;;
-      if(newOffset>0){
-        //CDBDebug("newOffset>0");
-        date.hour   = int(newOffset*24)%24;      newOffset-=float(date.hour  )/24;
-        date.minute = int(newOffset*24*60)%60;   newOffset-=float(date.minute)/(60*24);
-        date.second = int(newOffset*24*60*60)%60;newOffset-=float(date.second)/(60*60*24);
-//         CDBDebug("newOffset>0: %f %f %f",float(date.hour),float(date.minute),float(date.second));
-//         
-//         CDBDebug("Remaining offset: %f (should be zero)",newOffset);
-      }else{
-        date.hour = 0;
-        date.minute = 0;
-        date.second = 0;
-      }
-      date.day++;
-      int numDaysInMonth = CTIME_CALENDARTYPE_365day_Months[date.month-1];
-      if(date.day>numDaysInMonth){
-        date.month++;
-        date.day=1;
-        if(date.month>12){
-          date.month=1;
-          date.year++;
-        }
-      }
-    }else{
-      CDBError("Other unittype than CTIME_UNITTYPE_DAYS not supported");
-      throw CTIME_CONVERSION_ERROR;
+    if(status == 2){
+      CDBError("getDate: Unable to convert offset %f",offset);throw CTIME_CONVERSION_ERROR;
     }
+    //Before 1582-10-15 in the standard calendar, handled by udunits
   }
 
   if(mode == CTIME_MODE_YYYYMM){
@@ -487,6 +450,9 @@ CTime::Date CTime::getDate(double offset){
   }
   
   if(mode == CTIME_MODE_UTCALENDAR){
+    if(initUdunits()!=0){
+      CDBError("OffsetToAdaguc: Unable to initialize udunits");throw CTIME_CONVERSION_ERROR;
+    }
     float s;
     if(utCalendar(date.offset,&dataunits,&date.year,&date.month,&date.day,&date.hour,&date.minute,&s)!=0) {
       CDBError("OffsetToAdaguc: Internal error: utCalendar");throw CTIME_CONVERSION_ERROR;
@@ -500,31 +466,13 @@ CTime::Date CTime::getDate(double offset){
 double CTime::dateToOffset( Date date){
   double offset;
   
-  
-  if(mode == CTIME_MODE_360day){
-    if(timeUnits.unitType == CTIME_UNITTYPE_DAYS){
-      offset = date.year*360;
-      offset +=CTIME_CALENDARTYPE_360day_MonthsCumul[(date.month-1)];
-      offset +=(date.day-1);        
-      offset +=(((float)date.hour)/24.); 
-      offset +=(((float)date.minute)/(24*60.));
-      offset +=(((float)date.second)/(24*60*60.));       
-      offset-=timeUnits.dateSinceOffset;
-    }     
-    return offset;
-  }
-  
-  if(mode == CTIME_MODE_365day){
-    if(timeUnits.unitType == CTIME_UNITTYPE_DAYS){
-      offset = date.year*365;
-      offset +=CTIME_CALENDARTYPE_365day_MonthsCumul[(date.month-1)];
-      offset +=(date.day-1);        
-      offset +=(((float)date.hour)/24.); 
-      offset +=(((float)date.minute)/(24*60.));
-      offset +=(((float)date.second)/(24*60*60.));       
-      offset-=timeUnits.dateSinceOffset;
-    }     
-    return offset;
+  if(timeUnits.fastPath){
+    long long dayNumber = dateToDayNumber(date.year,date.month,date.day);
+    if(calendarType != CTIME_CALENDARTYPE_STANDARD || dayNumber >= CTIME_GREGORIANSTARTDAY){
+      double seconds = double(dayNumber-timeUnits.epochDay)*86400.;
+      seconds += date.hour*3600.+date.minute*60.+date.second-timeUnits.epochSecondOfDay;
+      return seconds/timeUnits.unitSeconds;
+    }
   }
   
   if(mode == CTIME_MODE_YYYYMM){
@@ -536,6 +484,9 @@ double CTime::dateToOffset( Date date){
   }
   
   if(mode == CTIME_MODE_UTCALENDAR){
+    if(initUdunits()!=0){
+      CDBError("dateToOffset: Unable to initialize udunits");throw CTIME_CONVERSION_ERROR;
+    }
     if(utInvCalendar(date.year,date.month,date.day,date.hour,date.minute,(int)date.second,&dataunits,&offset) != 0){
       CDBError("dateToOffset: Internal error: utInvCalendar with args %s",dateToString(date).c_str());throw CTIME_CONVERSION_ERROR;
     }
@@ -630,23 +581,96 @@ CT::string CTime::dateToString(Date date){
 
 
 CT::string CTime::dateToISOString(Date date){
+  char buffer[64];
+  int length = formatISOString(buffer,date);
   CT::string s;
+  s.copy(buffer,length);
+  return s;
+}
+
+static inline char *writeDigits(char *p,int value,int numDigits){
+  for(int j=numDigits-1;j>=0;j--){
+    p[j]='0'+(value%10);
+    value/=10;
+  }
+  return p+numDigits;
+}
+
+int CTime::formatISOString(char *buffer,const Date &date){
   float second=date.second;
-  //int minute = date.minute;
-//   if(date.second>=60.){
-//     second-=60;minute+=1;
-//   }
-  //s.print("%04d-%02d-%02dT%02d:%02d:%09f",date.year,date.month,date.day,date.hour,minute,second);
-  
   int seconds = int(second);
   int milliseconds = int((second-seconds)*1000)  ;
+  if(date.year<0||date.year>9999||date.month<0||date.month>99||date.day<0||date.day>99||
+     date.hour<0||date.hour>99||date.minute<0||date.minute>99||seconds<0||seconds>99||milliseconds<0){
+    if(milliseconds!=0){
+      return snprintf(buffer,32,"%04d-%02d-%02dT%02d:%02d:%02d.%03dZ",date.year,date.month,date.day,date.hour,date.minute,seconds,milliseconds);
+    }
+    return snprintf(buffer,32,"%04d-%02d-%02dT%02d:%02d:%02dZ",date.year,date.month,date.day,date.hour,date.minute,seconds);
+  }
+  //Written digit by digit, this is done for every value of a time dimension
+  char *p = buffer;
+  p = writeDigits(p,date.year,4);*p++='-';
+  p = writeDigits(p,date.month,2);*p++='-';
+  p = writeDigits(p,date.day,2);*p++='T';
+  p = writeDigits(p,date.hour,2);*p++=':';
+  p = writeDigits(p,date.minute,2);*p++=':';
+  p = writeDigits(p,seconds,2);
   if(milliseconds!=0){
-    s.print("%04d-%02d-%02dT%02d:%02d:%02d.%03dZ",date.year,date.month,date.day,date.hour,date.minute,seconds,milliseconds);
-  }else{
-    s.print("%04d-%02d-%02dT%02d:%02d:%02dZ",date.year,date.month,date.day,date.hour,date.minute,seconds);
+    *p++='.';
+    p = writeDigits(p,milliseconds,3);
   }
+  *p++='Z';
+  *p=0;
+  return int(p-buffer);
+}
 
-  return s;
+int CTime::offsetsToISOStrings(const double *offsets,size_t numOffsets,CT::string *isoStrings){
+  int numFailed = 0;
+  char buffer[64];
+  Date date;
+  for(size_t j=0;j<numOffsets;j++){
+    int status = 2;
+    if(timeUnits.fastPath){
+      status = offsetToDateFast(offsets[j],date);
+    }
+    if(status == 1||(status == 2&&timeUnits.fastPath == false)){
+      try{
+        date = getDate(offsets[j]);
+        status = 0;
+      }catch(int e){
+      }
+    }
+    if(status!=0){
+      isoStrings[j].copy("",0);
+      numFailed++;
+      continue;
+    }
+    int length = formatISOString(buffer,date);
+    isoStrings[j].copy(buffer,length);
+  }
+  return numFailed;
+}
+
+int CTime::ISOStringsToOffsets(CT::string *dateStrings,size_t numDates,double *offsets){
+  int numFailed = 0;
+  for(size_t j=0;j<numDates;j++){
+    const char *szTime = dateStrings[j].c_str();
+    Date date;
+    int c = 0;
+    try{
+      //YYYY-mm-ddThh:mm:ss[.SSS][Z] is parsed directly, other formats by freeDateStringToDate
+      if(sscanf(szTime,"%4d-%2d-%2dT%2d:%2d:%lf%n",&date.year,&date.month,&date.day,&date.hour,&date.minute,&date.second,&c)==6&&
+         c>=19&&(szTime[c]==0||(szTime[c]=='Z'&&szTime[c+1]==0))){
+        offsets[j] = dateToOffset(date);
+      }else{
+        offsets[j] = dateToOffset(freeDateStringToDate(szTime));
+      }
+    }catch(int e){
+      offsets[j] = NAN;
+      numFailed++;
+    }
+  }
+  return numFailed;
 }
 
 CTime::Date CTime::freeDateStringToDate(const char*szTime){
@@ -49,6 +49,11 @@
 
 //#define CTIME_CALENDARTYPE_365day  1
 
+#define CTIME_CALENDARTYPE_STANDARD           1
+#define CTIME_CALENDARTYPE_PROLEPTICGREGORIAN 2
+#define CTIME_CALENDARTYPE_365DAY             3
+#define CTIME_CALENDARTYPE_360DAY             4
+
 
 
 
@@ -97,11 +102,48 @@ class CTime{
 private:
   class TimeUnit{
   public:
-    //int calendarType;
     int unitType;
     Date date;
-    double dateSinceOffset;
+    /* Converts without udunits using the values below */
+    bool fastPath;
+    double unitSeconds;
+    long long epochDay;
+    double epochSecondOfDay;
   }timeUnits;
+  
+  int calendarType;
+  bool udunitsInitialized;
+  
+  /**
+   * Initializes udunits with currentUnit, done on first use
+   * @return 0 on success 1 on failure.
+   */
+  int initUdunits();
+  
+  /**
+   * Parses "<seconds|minutes|hours|days> since YYYY-MM-DD[ |T]hh:mm:ss[Z]" into timeUnits
+   * @return 0 when the units can be converted without udunits
+   */
+  int parseTimeUnits(const char *units);
+  
+  /**
+   * Day number in the calendar of this CTime, counted from 1970-01-01 for the gregorian calendars and from year 0 otherwise.
+   * Month and day may be out of range, they are carried over.
+   */
+  long long dateToDayNumber(int year,int month,int day);
+  void dayNumberToDate(long long dayNumber,int &year,int &month,int &day);
+  
+  /**
+   * Converts an offset without udunits
+   * @return 0 on success, 1 when the date is before the start of the gregorian calendar, 2 when the offset is invalid
+   */
+  int offsetToDateFast(double offset,Date &date);
+  
+  /**
+   * Writes the date as YYYY-mm-ddThh:mm:ss[.SSS]Z, buffer should hold at least 32 characters
+   * @return The length of the string
+   */
+  static int formatISOString(char *buffer,const Date &date);
 public:
   
   
@@ -203,6 +245,25 @@ public:
    */
   CT::string dateToISOString(Date date);
   
+  /**
+   * Converts an array of offsets to ISO strings in the format of dateToISOString.
+   * Faster than calling getDate and dateToISOString for each value, does not throw.
+   * @param offsets The values to convert
+   * @param numOffsets Number of values
+   * @param isoStrings Array of numOffsets strings, failed conversions are left empty
+   * @return The number of failed conversions
+   */
+  int offsetsToISOStrings(const double *offsets,size_t numOffsets,CT::string *isoStrings);
+  
+  /**
+   * Converts an array of date strings to offsets, the inverse of offsetsToISOStrings. Does not throw.
+   * @param dateStrings The date strings, in any format accepted by freeDateStringToDate
+   * @param numDates Number of strings
+   * @param offsets Array of numDates values, failed conversions are set to NaN
+   * @return The number of failed conversions
+   */
+  int ISOStringsToOffsets(CT::string *dateStrings,size_t numDates,double *offsets);
+  
   /**
    * Get current system time as ISO string
    * @return Current system time as ISO string
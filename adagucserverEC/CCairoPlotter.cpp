@@ -28,6 +28,7 @@
 //#define MEASURETIME
 
 #include "CStopWatch.h"
+#include <new>
 const char *CCairoPlotter::className="CCairoPlotter";
 
 cairo_status_t writerFunc(void *closure, const unsigned char *data, unsigned int length) {
@@ -104,8 +105,15 @@ void CCairoPlotter::_cairoPlotterInit(int width,int height,float fontSize, const
       
       unsigned char origAlphaC = ARGBByteBuffer[p+3];
       
-      //Background is transparent, combine Background with pixel
-      if(origAlphaC != 255){
+      //Background is fully transparent, the pixel replaces it. Computing this with floats can be one too low.
+      if(origAlphaC == 0){
+        ARGBByteBuffer[p]=b;
+        ARGBByteBuffer[p+1]=g;
+        ARGBByteBuffer[p+2]=r;
+        ARGBByteBuffer[p+3]=a;
+        if(a!=0){isAlphaUsed = true;}
+      }else if(origAlphaC != 255){
+        //Background is transparent, combine Background with pixel
         float origAlpha = float(origAlphaC);
         
         float origBlue = ARGBByteBuffer[p];
@@ -167,6 +175,49 @@ void CCairoPlotter::_cairoPlotterInit(int width,int height,float fontSize, const
 
   }
  
+  void CCairoPlotter::pixelsIndexed(const short *colorIndices,const unsigned char *red,const unsigned char *green,const unsigned char *blue,const short *alpha){
+    //ARGB32 pixels are native endian 32 bit words
+    unsigned int opaqueColors[256];
+    for(int c=0;c<256;c++){
+      opaqueColors[c]=(0xFFu<<24)|(((unsigned int)red[c])<<16)|(((unsigned int)green[c])<<8)|((unsigned int)blue[c]);
+    }
+    for(int y=0;y<height;y++){
+      const short *indexRow = colorIndices+size_t(y)*width;
+      unsigned int *pixelRow = (unsigned int*)(ARGBByteBuffer+size_t(y)*stride);
+      for(int x=0;x<width;x++){
+        int c = indexRow[x];
+        if(c<0||c>255)continue;
+        if(alpha[c]==255){
+          pixelRow[x]=opaqueColors[c];
+        }else if(alpha[c]>0){
+          pixel_blend(x,y,red[c],green[c],blue[c],alpha[c]);
+        }else if(alpha[c]<0){
+          pixel_overwrite(x,y,red[c],green[c],blue[c],-(alpha[c]+1));
+        }
+      }
+    }
+  }
+  
+  void CCairoPlotter::compositeLayers(CCairoPlotter **layers,size_t numLayers){
+    /* Row by row, so the row stays in the cache while all layers are blended on it */
+    for(int y=0;y<height;y++){
+      unsigned int *destRow = (unsigned int*)(ARGBByteBuffer+size_t(y)*stride);
+      for(size_t l=0;l<numLayers;l++){
+        const unsigned int *layerRow = (const unsigned int*)(layers[l]->ARGBByteBuffer+size_t(y)*stride);
+        for(int x=0;x<width;x++){
+          unsigned int c = layerRow[x];
+          unsigned int a = c>>24;
+          if(a==0)continue;
+          if(a==255){
+            destRow[x]=c;
+          }else{
+            pixel_blend(x,y,(c>>16)&255,(c>>8)&255,c&255,a);
+          }
+        }
+      }
+    }
+  }
+  
 //   void CCairoPlotter::pixel(int x,int y, unsigned char r,unsigned char g,unsigned char b,unsigned char a){
 //     pixel_blend(x,y,r,g,b,a);
 //   }
@@ -212,7 +263,11 @@ void CCairoPlotter::_cairoPlotterInit(int width,int height,float fontSize, const
     byteBufferPointerIsOwned = true;
     stride=cairo_format_stride_for_width(FORMAT, width);
     size_t bufferSize = size_t(height)*stride;
-    ARGBByteBuffer = new unsigned char[bufferSize];
+    ARGBByteBuffer = CBufferPool::allocate<unsigned char>(bufferSize);
+    if(ARGBByteBuffer==NULL){
+      CDBError("Unable to allocate %lu bytes for a %dx%d image",(unsigned long)bufferSize,width,height);
+      throw std::bad_alloc();
+    }
     if(a==0&&r==0&&g==0&&b==0){
       for(size_t j=0;j<bufferSize;j++){
         ARGBByteBuffer[j]=0;
@@ -253,7 +308,7 @@ void CCairoPlotter::_cairoPlotterInit(int width,int height,float fontSize, const
     cairo_destroy(cr);
     cairo_surface_destroy(surface);
     if(byteBufferPointerIsOwned){
-      delete[] ARGBByteBuffer;
+      CBufferPool::release(ARGBByteBuffer);
       ARGBByteBuffer= NULL;
     }
   }
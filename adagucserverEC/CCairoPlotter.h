@@ -38,6 +38,7 @@
 #include <cairo.h>
 #include "CDebugger.h"
 #include "CTypes.h"
+#include "CBufferPool.h"
 #include <ft2build.h>
 #include <freetype.h>
 #include <ftglyph.h>
@@ -101,6 +102,19 @@ public:
   void pixel_overwrite(int x,int y, unsigned char r,unsigned char g,unsigned char b,unsigned char a);
   void pixel_blend(int x,int y, unsigned char r,unsigned char g,unsigned char b,unsigned char a);
   
+  /**
+   * Draws a field of width*height color indices, negative indices are not drawn. Colors with alpha 255 are written
+   * directly into the buffer, alpha>0 is blended, alpha<0 overwrites with alpha -(alpha+1), like CDrawImage::setPixelIndexed.
+   */
+  void pixelsIndexed(const short *colorIndices,const unsigned char *red,const unsigned char *green,const unsigned char *blue,const short *alpha);
+  
+  /**
+   * Draws layers over this buffer, in the given order and in one pass over the rows. The layers must have the size of this
+   * buffer. Each layer pixel is blended with pixel_blend, so a layer which was drawn with pixel_blend on a transparent buffer
+   * gives the same pixels as drawing it here directly. Pixels which are transparent in all layers are left unchanged.
+   */
+  void compositeLayers(CCairoPlotter **layers,size_t numLayers);
+  
   unsigned char *getByteBuffer();
   void rectangle(int x1,int y1,int x2,int y2);
   void filledRectangle(int x1,int y1,int x2,int y2);
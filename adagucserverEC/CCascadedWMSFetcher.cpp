@@ -0,0 +1,420 @@
+/******************************************************************************
+ *
+ * Project:  ADAGUC Server
+ * Purpose:  Fetches the images of cascaded WMS layers in parallel with an HTTP cache
+ * Date:     2026-10-18
+ *
+ ******************************************************************************
+ *
+ * Copyright 2026, Royal Netherlands Meteorological Institute (KNMI)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ******************************************************************************/
+
+#ifdef ENABLE_CURL
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "CCascadedWMSFetcher.h"
+
+// #define CCASCADEDWMSFETCHER_DEBUG
+
+const char * CCascadedWMSFetcher::className = "CCascadedWMSFetcher";
+
+/* First line of a cache file, followed by the expiry time, ETag, Last-Modified and the body */
+#define CCASCADEDWMSFETCHER_CACHEMAGIC "ADAGUCHTTPCACHE1"
+
+static pthread_once_t curlInitOnce = PTHREAD_ONCE_INIT;
+static void curlInit(){
+  curl_global_init(CURL_GLOBAL_ALL);
+}
+
+CCascadedWMSFetcher::~CCascadedWMSFetcher(){
+  for(size_t j=0;j<requests.size();j++){
+    if(requests[j]->image!=NULL)gdImageDestroy(requests[j]->image);
+    if(requests[j]->headers!=NULL)curl_slist_free_all(requests[j]->headers);
+    if(requests[j]->curl!=NULL)curl_easy_cleanup(requests[j]->curl);
+    delete requests[j];
+  }
+  requests.clear();
+}
+
+int CCascadedWMSFetcher::add(const char *url){
+  Request *request = new Request();
+  request->url = url;
+  requests.push_back(request);
+  return requests.size()-1;
+}
+
+gdImagePtr CCascadedWMSFetcher::getImage(int index){
+  if(index<0||size_t(index)>=requests.size())return NULL;
+  return requests[index]->image;
+}
+
+size_t CCascadedWMSFetcher::writeCallback(void *ptr,size_t size,size_t nmemb,void *data){
+  size_t realsize = size*nmemb;
+  Request *request = (Request*)data;
+  request->body.insert(request->body.end(),(char*)ptr,(char*)ptr+realsize);
+  return realsize;
+}
+
+size_t CCascadedWMSFetcher::headerCallback(void *ptr,size_t size,size_t nmemb,void *data){
+  size_t realsize = size*nmemb;
+  Request *request = (Request*)data;
+  /* Header lines end with CRLF */
+  size_t length = realsize;
+  while(length>0&&(((char*)ptr)[length-1]=='\r'||((char*)ptr)[length-1]=='\n'))length--;
+  CT::string line((const char*)ptr,length);
+
+  /* A new response starts, for example after 100 Continue */
+  if(line.indexOf("HTTP/")==0){
+    request->etag = "";
+    request->lastModified = "";
+    request->maxAge = -1;
+    request->sharedMaxAge = -1;
+    request->age = 0;
+    request->expiresHeader = -1;
+    request->noCache = false;
+    request->noStore = false;
+    return realsize;
+  }
+
+  int colon = line.indexOf(":");
+  if(colon<=0)return realsize;
+  CT::string name = line.substring(0,colon);
+  CT::string value = line.substring(colon+1,line.length());
+  name.trimSelf();
+  value.trimSelf();
+  name.toLowerCaseSelf();
+
+  if(name.equals("etag")){
+    request->etag = value;
+  }else if(name.equals("last-modified")){
+    request->lastModified = value;
+  }else if(name.equals("cache-control")){
+    parseCacheControl(request,value.c_str());
+  }else if(name.equals("pragma")){
+    value.toLowerCaseSelf();
+    if(value.indexOf("no-cache")>=0)request->noCache = true;
+  }else if(name.equals("age")){
+    request->age = atol(value.c_str());
+  }else if(name.equals("expires")){
+    /* Invalid dates, like "0", mean already expired */
+    request->expiresHeader = curl_getdate(value.c_str(),NULL);
+    if(request->expiresHeader<0)request->expiresHeader = 0;
+  }
+  return realsize;
+}
+
+void CCascadedWMSFetcher::parseCacheControl(Request *request,const char *value){
+  CT::string cacheControl = value;
+  cacheControl.toLowerCaseSelf();
+  CT::string *directives = cacheControl.splitToArray(",");
+  for(size_t j=0;j<directives->count;j++){
+    directives[j].trimSelf();
+    if(directives[j].equals("no-store")||directives[j].equals("private")){
+      /* This is a shared cache, private responses are not stored */
+      request->noStore = true;
+    }else if(directives[j].equals("no-cache")){
+      request->noCache = true;
+    }else if(directives[j].indexOf("max-age=")==0){
+      request->maxAge = atol(directives[j].c_str()+8);
+    }else if(directives[j].indexOf("s-maxage=")==0){
+      request->sharedMaxAge = atol(directives[j].c_str()+9);
+    }
+  }
+  delete[] directives;
+}
+
+time_t CCascadedWMSFetcher::getExpires(Request *request){
+  time_t now = time(NULL);
+  if(request->noCache)return 0;
+  if(request->sharedMaxAge>=0)return now+request->sharedMaxAge-request->age;
+  if(request->maxAge>=0)return now+request->maxAge-request->age;
+  if(request->expiresHeader>=0)return request->expiresHeader;
+  return 0;
+}
+
+int CCascadedWMSFetcher::readCache(Request *request){
+  if(request->cacheFileName.empty())return 1;
+  FILE *fp = fopen(request->cacheFileName.c_str(),"rb");
+  if(fp==NULL)return 1;
+  int status = 0;
+  try{
+    char line[1024];
+    CT::string fields[4];
+    for(int j=0;j<4;j++){
+      if(fgets(line,sizeof(line),fp)==NULL)throw(__LINE__);
+      line[strcspn(line,"\r\n")]=0;
+      fields[j] = line;
+    }
+    if(!fields[0].equals(CCASCADEDWMSFETCHER_CACHEMAGIC))throw(__LINE__);
+    request->cacheExpires = atol(fields[1].c_str());
+    request->cacheEtag = fields[2];
+    request->cacheLastModified = fields[3];
+    long start = ftell(fp);
+    if(fseek(fp,0,SEEK_END)!=0)throw(__LINE__);
+    long end = ftell(fp);
+    if(start<0||end<=start)throw(__LINE__);
+    request->cacheBody.resize(end-start);
+    if(fseek(fp,start,SEEK_SET)!=0)throw(__LINE__);
+    if(fread(&request->cacheBody[0],1,end-start,fp)!=size_t(end-start))throw(__LINE__);
+    request->hasCache = true;
+  }catch(int linenr){
+    CDBWarning("Invalid cache file %s (%d)",request->cacheFileName.c_str(),linenr);
+    request->cacheBody.clear();
+    status = 1;
+  }
+  fclose(fp);
+  return status;
+}
+
+int CCascadedWMSFetcher::writeCache(Request *request){
+  if(request->cacheFileName.empty())return 1;
+  /* Other processes may read the cache file at the same time, it is replaced at once */
+  CT::string tempFileName;
+  tempFileName.print("%s.%d.%lx",request->cacheFileName.c_str(),getpid(),(unsigned long)pthread_self());
+  FILE *fp = fopen(tempFileName.c_str(),"wb");
+  if(fp==NULL){
+    CDBWarning("Unable to write cache file %s",tempFileName.c_str());
+    return 1;
+  }
+  fprintf(fp,"%s\n%ld\n%s\n%s\n",CCASCADEDWMSFETCHER_CACHEMAGIC,(long)getExpires(request),request->etag.c_str(),request->lastModified.c_str());
+  size_t written = fwrite(&request->body[0],1,request->body.size(),fp);
+  if(fclose(fp)!=0||written!=request->body.size()||rename(tempFileName.c_str(),request->cacheFileName.c_str())!=0){
+    CDBWarning("Unable to write cache file %s",request->cacheFileName.c_str());
+    unlink(tempFileName.c_str());
+    return 1;
+  }
+  return 0;
+}
+
+void CCascadedWMSFetcher::removeOldCacheFiles(const char *cacheDirectory){
+  time_t now = time(NULL);
+  /* The modification time of the marker file is the time of the last cleanup by any process */
+  CT::string markerFileName;
+  markerFileName.print("%s/cascadedwms_cleanup",cacheDirectory);
+  struct stat stFileInfo;
+  if(stat(markerFileName.c_str(),&stFileInfo)==0&&now-stFileInfo.st_mtime<CCASCADEDWMSFETCHER_CLEANUPINTERVAL)return;
+  FILE *fp = fopen(markerFileName.c_str(),"w");
+  if(fp==NULL){
+    CDBWarning("Unable to write %s",markerFileName.c_str());
+    return;
+  }
+  fclose(fp);
+
+  DIR *dir = opendir(cacheDirectory);
+  if(dir==NULL)return;
+  size_t numRemoved = 0;
+  struct dirent *entry;
+  while((entry = readdir(dir))!=NULL){
+    if(strncmp(entry->d_name,"cascadedwms_",12)!=0||strstr(entry->d_name,".cache")==NULL)continue;
+    CT::string path;
+    path.print("%s/%s",cacheDirectory,entry->d_name);
+    if(stat(path.c_str(),&stFileInfo)!=0||!S_ISREG(stFileInfo.st_mode))continue;
+    if(now-stFileInfo.st_mtime<CCASCADEDWMSFETCHER_MAXCACHEAGE)continue;
+    /* Another process may have removed or replaced it in the meantime, which is fine */
+    if(unlink(path.c_str())==0)numRemoved++;
+  }
+  closedir(dir);
+#ifdef CCASCADEDWMSFETCHER_DEBUG
+  CDBDebug("Removed %d old cache files from %s",(int)numRemoved,cacheDirectory);
+#endif
+}
+
+gdImagePtr CCascadedWMSFetcher::decode(const std::vector<char> &data){
+  if(data.size()<=4)return NULL;
+  void *ptr = (void*)&data[0];
+  if(data[0]=='G')return gdImageCreateFromGifPtr(data.size(),ptr);
+  if((unsigned char)data[0]==0xFF&&(unsigned char)data[1]==0xD8)return gdImageCreateFromJpegPtr(data.size(),ptr);
+  return gdImageCreateFromPngPtr(data.size(),ptr);
+}
+
+int CCascadedWMSFetcher::startTransfer(CURLM *multi,Request *request){
+  request->curl = curl_easy_init();
+  if(request->curl==NULL){
+    CDBError("curl_easy_init failed");
+    return 1;
+  }
+  CURL *curl = request->curl;
+  curl_easy_setopt(curl,CURLOPT_URL,request->url.c_str());
+  curl_easy_setopt(curl,CURLOPT_WRITEFUNCTION,writeCallback);
+  curl_easy_setopt(curl,CURLOPT_WRITEDATA,(void*)request);
+  curl_easy_setopt(curl,CURLOPT_HEADERFUNCTION,headerCallback);
+  curl_easy_setopt(curl,CURLOPT_HEADERDATA,(void*)request);
+  curl_easy_setopt(curl,CURLOPT_PRIVATE,(void*)request);
+  curl_easy_setopt(curl,CURLOPT_ERRORBUFFER,request->errorBuffer);
+  curl_easy_setopt(curl,CURLOPT_USERAGENT,"libcurl-agent/1.0");
+  curl_easy_setopt(curl,CURLOPT_TIMEOUT,(long)CCASCADEDWMSFETCHER_TIMEOUT);
+  curl_easy_setopt(curl,CURLOPT_NOSIGNAL,1L);
+
+  /* Stale cached responses are revalidated */
+  if(request->hasCache){
+    CT::string header;
+    if(!request->cacheEtag.empty()){
+      header.print("If-None-Match: %s",request->cacheEtag.c_str());
+      request->headers = curl_slist_append(request->headers,header.c_str());
+    }
+    if(!request->cacheLastModified.empty()){
+      header.print("If-Modified-Since: %s",request->cacheLastModified.c_str());
+      request->headers = curl_slist_append(request->headers,header.c_str());
+    }
+    if(request->headers!=NULL)curl_easy_setopt(curl,CURLOPT_HTTPHEADER,request->headers);
+  }
+
+  if(curl_multi_add_handle(multi,curl)!=CURLM_OK){
+    CDBError("curl_multi_add_handle failed");
+    return 1;
+  }
+  return 0;
+}
+
+void CCascadedWMSFetcher::finishTransfer(Request *request,CURLcode result){
+  long responseCode = 0;
+  curl_easy_getinfo(request->curl,CURLINFO_RESPONSE_CODE,&responseCode);
+  curl_easy_cleanup(request->curl);
+  request->curl = NULL;
+
+  if(result!=CURLE_OK){
+    CT::string u=request->url.c_str();u.encodeURLSelf();
+    CDBError("Unable to get image %s: %s",u.c_str(),request->errorBuffer);
+    return;
+  }
+
+  if(responseCode==304&&request->hasCache){
+    /* Not modified: the cached body is used and stored with the new expiry time */
+#ifdef CCASCADEDWMSFETCHER_DEBUG
+    CDBDebug("Revalidated %s",request->cacheFileName.c_str());
+#endif
+    if(request->etag.empty())request->etag = request->cacheEtag;
+    if(request->lastModified.empty())request->lastModified = request->cacheLastModified;
+    request->body.swap(request->cacheBody);
+  }else if(responseCode!=200&&responseCode!=0){
+    /* A response code of 0 is used for non HTTP urls, like file:// */
+    CT::string u=request->url.c_str();u.encodeURLSelf();
+    CDBError("Unable to get image %s: HTTP status %ld",u.c_str(),responseCode);
+    return;
+  }
+  request->cacheBody.clear();
+
+  request->image = decode(request->body);
+  if(request->image==NULL){
+    CT::string u=request->url.c_str();u.encodeURLSelf();
+    CDBError("Invalid image %s",u.c_str());
+    return;
+  }
+  request->status = 0;
+
+  /* Only responses which can be reused, now or after revalidation, are stored */
+  if(responseCode!=0&&!request->noStore&&(getExpires(request)>time(NULL)||!request->etag.empty()||!request->lastModified.empty())){
+    if(writeCache(request)==0)cacheWritten = true;
+  }
+  request->body.clear();
+}
+
+int CCascadedWMSFetcher::run(const char *cacheDirectory){
+  pthread_once(&curlInitOnce,curlInit);
+
+  CURLM *multi = curl_multi_init();
+  if(multi==NULL){
+    CDBError("curl_multi_init failed");
+    return 1;
+  }
+
+  time_t now = time(NULL);
+  size_t next = 0;
+  int numActive = 0;
+  while(true){
+    /* Start new transfers, responses which are fresh in the cache are decoded directly */
+    while(numActive<CCASCADEDWMSFETCHER_MAXPARALLEL&&next<requests.size()){
+      Request *request = requests[next++];
+      if(cacheDirectory!=NULL&&strlen(cacheDirectory)>0){
+        unsigned long long hash = 14695981039346656037ULL;
+        for(size_t j=0;j<request->url.length();j++){
+          hash ^= (unsigned char)request->url.c_str()[j];
+          hash *= 1099511628211ULL;
+        }
+        request->cacheFileName.print("%s/cascadedwms_%016llx.cache",cacheDirectory,hash);
+        readCache(request);
+      }
+      if(request->hasCache&&request->cacheExpires>now){
+#ifdef CCASCADEDWMSFETCHER_DEBUG
+        CDBDebug("Using cached %s",request->cacheFileName.c_str());
+#endif
+        request->image = decode(request->cacheBody);
+        request->cacheBody.clear();
+        if(request->image!=NULL){
+          request->status = 0;
+          continue;
+        }
+        request->hasCache = false;
+      }
+      if(startTransfer(multi,request)!=0){
+        if(request->curl!=NULL){curl_easy_cleanup(request->curl);request->curl = NULL;}
+        continue;
+      }
+      numActive++;
+    }
+    if(numActive==0)break;
+
+    int numRunning = 0;
+    if(curl_multi_perform(multi,&numRunning)!=CURLM_OK){
+      CDBError("curl_multi_perform failed");
+      break;
+    }
+
+    /* Decode every image as soon as it is complete */
+    CURLMsg *message;
+    int numMessages;
+    while((message = curl_multi_info_read(multi,&numMessages))!=NULL){
+      if(message->msg!=CURLMSG_DONE)continue;
+      Request *request = NULL;
+      curl_easy_getinfo(message->easy_handle,CURLINFO_PRIVATE,(char**)&request);
+      CURLcode result = message->data.result;
+      curl_multi_remove_handle(multi,message->easy_handle);
+      finishTransfer(request,result);
+      numActive--;
+    }
+
+    if(numRunning>0){
+      curl_multi_wait(multi,NULL,0,1000,NULL);
+    }
+  }
+
+  /* Transfers which are still active after a failure of curl_multi_perform */
+  for(size_t j=0;j<requests.size();j++){
+    if(requests[j]->curl!=NULL){
+      curl_multi_remove_handle(multi,requests[j]->curl);
+      curl_easy_cleanup(requests[j]->curl);
+      requests[j]->curl = NULL;
+    }
+  }
+  curl_multi_cleanup(multi);
+
+  if(cacheWritten)removeOldCacheFiles(cacheDirectory);
+
+  int status = 0;
+  for(size_t j=0;j<requests.size();j++){
+    if(requests[j]->status!=0)status = 1;
+  }
+  return status;
+}
+
+#endif
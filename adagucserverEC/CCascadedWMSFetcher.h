@@ -0,0 +1,164 @@
+/******************************************************************************
+ *
+ * Project:  ADAGUC Server
+ * Purpose:  Fetches the images of cascaded WMS layers in parallel with an HTTP cache
+ * Date:     2026-10-18
+ *
+ ******************************************************************************
+ *
+ * Copyright 2026, Royal Netherlands Meteorological Institute (KNMI)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ******************************************************************************/
+
+#ifdef ENABLE_CURL
+#ifndef CCascadedWMSFetcher_H
+#define CCascadedWMSFetcher_H
+
+#include <vector>
+#include <time.h>
+#include <curl/curl.h>
+#include <gd.h>
+#include "CTString.h"
+#include "CDebugger.h"
+
+/* Maximum number of simultaneous transfers */
+#define CCASCADEDWMSFETCHER_MAXPARALLEL 8
+
+/* Maximum duration of one transfer, in seconds */
+#define CCASCADEDWMSFETCHER_TIMEOUT     60
+
+/* Cache files which have not been written or revalidated for this number of seconds are removed */
+#define CCASCADEDWMSFETCHER_MAXCACHEAGE   86400
+
+/* Minimum number of seconds between two cleanups of the cache directory */
+#define CCASCADEDWMSFETCHER_CLEANUPINTERVAL 600
+
+/**
+ * Fetches the images of cascaded WMS layers. All requests are transferred at the same time with curl multi, so
+ * the total waiting time is that of the slowest upstream server instead of the sum. Each image is decoded as
+ * soon as its transfer is finished.
+ *
+ * Responses are cached in a directory, honoring Cache-Control (max-age, no-cache, no-store, private) and Expires.
+ * Fresh responses are used without contacting the upstream server. Stale responses with an ETag or Last-Modified
+ * are revalidated with If-None-Match / If-Modified-Since, a 304 answer reuses the cached image. When a response
+ * has been written to the cache, files older than CCASCADEDWMSFETCHER_MAXCACHEAGE are removed from the directory,
+ * at most once per CCASCADEDWMSFETCHER_CLEANUPINTERVAL.
+ *
+ *   CCascadedWMSFetcher fetcher;
+ *   int a = fetcher.add(urlA);
+ *   int b = fetcher.add(urlB);
+ *   fetcher.run(cacheDirectory);
+ *   gdImagePtr image = fetcher.getImage(a); //NULL when failed, owned by the fetcher
+ */
+class CCascadedWMSFetcher{
+private:
+  DEF_ERRORFUNCTION();
+
+  class Request{
+  public:
+    Request(){
+      curl = NULL;
+      headers = NULL;
+      image = NULL;
+      status = 1;
+      errorBuffer[0] = 0;
+      maxAge = -1;
+      sharedMaxAge = -1;
+      age = 0;
+      expiresHeader = -1;
+      noCache = false;
+      noStore = false;
+      hasCache = false;
+      cacheExpires = 0;
+    }
+    CT::string url;
+    CT::string cacheFileName;
+    CURL *curl;
+    struct curl_slist *headers;
+    char errorBuffer[CURL_ERROR_SIZE];
+    std::vector<char> body;
+    gdImagePtr image;
+    int status;
+
+    /* Caching information from the response headers, -1 when absent */
+    CT::string etag,lastModified;
+    long maxAge,sharedMaxAge,age;
+    time_t expiresHeader;
+    bool noCache,noStore;
+
+    /* The cached response, when available */
+    bool hasCache;
+    CT::string cacheEtag,cacheLastModified;
+    time_t cacheExpires;
+    std::vector<char> cacheBody;
+  };
+
+  std::vector<Request*> requests;
+  bool cacheWritten;
+  CCascadedWMSFetcher(const CCascadedWMSFetcher&);
+  CCascadedWMSFetcher &operator=(const CCascadedWMSFetcher&);
+
+  static size_t writeCallback(void *ptr,size_t size,size_t nmemb,void *data);
+  static size_t headerCallback(void *ptr,size_t size,size_t nmemb,void *data);
+  static void parseCacheControl(Request *request,const char *value);
+
+  /**
+   * Returns the time until which the response of request may be used without revalidation
+   */
+  static time_t getExpires(Request *request);
+
+  static int readCache(Request *request);
+  static int writeCache(Request *request);
+
+  /**
+   * Removes cache files which have not been written for CCASCADEDWMSFETCHER_MAXCACHEAGE seconds, including
+   * temporary files left by interrupted writes. Skipped when another process cleaned up the directory recently.
+   */
+  static void removeOldCacheFiles(const char *cacheDirectory);
+
+  int startTransfer(CURLM *multi,Request *request);
+
+  /**
+   * Handles the result of a finished transfer and decodes the image
+   */
+  void finishTransfer(Request *request,CURLcode result);
+  static gdImagePtr decode(const std::vector<char> &data);
+public:
+  CCascadedWMSFetcher(){
+    cacheWritten = false;
+  }
+  ~CCascadedWMSFetcher();
+
+  /**
+   * Adds a request
+   * @return The index of the request, used by getImage
+   */
+  int add(const char *url);
+
+  /**
+   * Fetches and decodes all added requests
+   * @param cacheDirectory Directory for cached responses, NULL or empty to disable the cache
+   * @return 0 when all images are available
+   */
+  int run(const char *cacheDirectory);
+
+  /**
+   * Returns the decoded image of a request, NULL when it is not available. The image is destroyed by the fetcher.
+   */
+  gdImagePtr getImage(int index);
+};
+
+#endif
+#endif
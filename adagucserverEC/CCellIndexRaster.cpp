@@ -0,0 +1,207 @@
+/******************************************************************************
+ *
+ * Project:  ADAGUC Server
+ * Purpose:  Cache of rasterized cell indices for unstructured and swath geometries
+ * Date:     2026-10-18
+ *
+ ******************************************************************************
+ *
+ * Copyright 2026, Royal Netherlands Meteorological Institute (KNMI)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "CCellIndexRaster.h"
+
+// #define CCELLINDEXRASTER_DEBUG
+
+/* Identifies the cache file format */
+#define CCELLINDEXRASTER_MAGIC 0x58444943
+
+const char *CCellIndexRaster::className="CCellIndexRaster";
+pthread_mutex_t CCellIndexRaster::mutex = PTHREAD_MUTEX_INITIALIZER;
+std::vector<std::pair<std::string,std::vector<int> > > CCellIndexRaster::memoryCache;
+
+/**
+ * Hashes coordinates 8 bytes at a time, which is fast enough to run on every request
+ */
+static unsigned long long hashCoordinates(unsigned long long hash,const float *data,size_t num){
+  const unsigned char *bytes = (const unsigned char*)data;
+  size_t numBytes = num*sizeof(float);
+  size_t numWords = numBytes/8;
+  for(size_t j=0;j<numWords;j++){
+    unsigned long long word;
+    memcpy(&word,bytes+j*8,8);
+    hash ^= word;
+    hash *= 1099511628211ULL;
+    hash ^= hash>>29;
+  }
+  for(size_t j=numWords*8;j<numBytes;j++){
+    hash ^= bytes[j];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+/**
+ * Hashes which cells have nodata, 64 cells per word
+ */
+static unsigned long long hashNodataMask(unsigned long long hash,const float *values,size_t numCells,float fill){
+  for(size_t j=0;j<numCells;j+=64){
+    unsigned long long word = 0;
+    size_t end = j+64<numCells?j+64:numCells;
+    for(size_t i=j;i<end;i++){
+      if(CCellIndexRaster::isNodata(values[i],fill))word |= 1ULL<<(i-j);
+    }
+    hash ^= word;
+    hash *= 1099511628211ULL;
+    hash ^= hash>>29;
+  }
+  return hash;
+}
+
+CCellIndexRaster::CCellIndexRaster(){
+  width = 0;
+  height = 0;
+}
+
+int CCellIndexRaster::get(CDataSource *dataSource,const float *lonData,const float *latData,size_t numCoordinates,const float *values,size_t numCells,float fill,const char *variant){
+  CServerParams *srvParams = dataSource->srvParams;
+  width = dataSource->dWidth;
+  height = dataSource->dHeight;
+
+  unsigned long long hash = 14695981039346656037ULL;
+  hash = hashCoordinates(hash,lonData,numCoordinates);
+  hash = hashCoordinates(hash,latData,numCoordinates);
+  hash = hashNodataMask(hash,values,numCells,fill);
+  CT::string keyString;
+  keyString.print("%016llx_%s_%s_%.17g_%.17g_%.17g_%.17g_%d_%d",hash,variant,srvParams->Geo->CRS.c_str(),
+                  srvParams->Geo->dfBBOX[0],srvParams->Geo->dfBBOX[1],srvParams->Geo->dfBBOX[2],srvParams->Geo->dfBBOX[3],width,height);
+  key = keyString.c_str();
+
+  pthread_mutex_lock(&mutex);
+  for(size_t j=0;j<memoryCache.size();j++){
+    if(memoryCache[j].first == key){
+      cellIndex = memoryCache[j].second;
+      pthread_mutex_unlock(&mutex);
+      #ifdef CCELLINDEXRASTER_DEBUG
+      CDBDebug("Found %s in memory",key.c_str());
+      #endif
+      return 0;
+    }
+  }
+  pthread_mutex_unlock(&mutex);
+
+  /* The key contains characters which are not suitable for file names, so it is hashed again */
+  cacheFileName = "";
+  if(srvParams->cfg->TempDir.size()>0&&srvParams->cfg->TempDir[0]->attr.value.empty()==false){
+    unsigned long long fileHash = 14695981039346656037ULL;
+    for(size_t j=0;j<key.length();j++){
+      fileHash ^= (unsigned char)key[j];
+      fileHash *= 1099511628211ULL;
+    }
+    cacheFileName.print("%s/cellindex_%016llx.bin",srvParams->cfg->TempDir[0]->attr.value.c_str(),fileHash);
+    if(loadFromFile() == 0){
+      pthread_mutex_lock(&mutex);
+      if(memoryCache.size()>=CCELLINDEXRASTER_MEMORYCACHESIZE)memoryCache.erase(memoryCache.begin());
+      memoryCache.push_back(std::pair<std::string,std::vector<int> >(key,cellIndex));
+      pthread_mutex_unlock(&mutex);
+      return 0;
+    }
+  }
+  return 1;
+}
+
+float *CCellIndexRaster::beginRasterize(){
+  rasterizeBuffer.assign(size_t(width)*size_t(height),-1.0f);
+  return &rasterizeBuffer[0];
+}
+
+void CCellIndexRaster::endRasterize(){
+  size_t size = rasterizeBuffer.size();
+  cellIndex.resize(size);
+  for(size_t j=0;j<size;j++){
+    float v = rasterizeBuffer[j];
+    /* Drawing routines can write fractions and NaN at the edges */
+    cellIndex[j] = v==v&&v>=0?int(v+0.5f):-1;
+  }
+  std::vector<float>().swap(rasterizeBuffer);
+
+  pthread_mutex_lock(&mutex);
+  if(memoryCache.size()>=CCELLINDEXRASTER_MEMORYCACHESIZE)memoryCache.erase(memoryCache.begin());
+  memoryCache.push_back(std::pair<std::string,std::vector<int> >(key,cellIndex));
+  pthread_mutex_unlock(&mutex);
+  saveToFile();
+}
+
+void CCellIndexRaster::gather(const float *values,size_t numCells,float fill,float *output){
+  size_t size = cellIndex.size();
+  const int *index = cellIndex.empty()?NULL:&cellIndex[0];
+  for(size_t j=0;j<size;j++){
+    int i = index[j];
+    if(i<0||size_t(i)>=numCells)continue;
+    float v = values[i];
+    if(isNodata(v,fill))continue;
+    output[j] = v;
+  }
+}
+
+int CCellIndexRaster::loadFromFile(){
+  FILE *fp = fopen(cacheFileName.c_str(),"rb");
+  if(fp == NULL)return 1;
+  int header[3] = {0,0,0};
+  int status = 0;
+  if(fread(header,sizeof(header),1,fp)!=1||header[0]!=CCELLINDEXRASTER_MAGIC||header[1]!=width||header[2]!=height)status = 1;
+  if(status == 0){
+    cellIndex.resize(size_t(width)*size_t(height));
+    if(cellIndex.size()>0&&fread(&cellIndex[0],sizeof(int),cellIndex.size(),fp)!=cellIndex.size())status = 1;
+  }
+  fclose(fp);
+  if(status!=0){
+    CDBWarning("Cell index raster %s is not valid",cacheFileName.c_str());
+    cellIndex.clear();
+    return 1;
+  }
+  #ifdef CCELLINDEXRASTER_DEBUG
+  CDBDebug("Loaded %s",cacheFileName.c_str());
+  #endif
+  return 0;
+}
+
+int CCellIndexRaster::saveToFile(){
+  if(cacheFileName.empty())return 1;
+  /* Written to a temporary file first, so concurrent requests never read a partial raster */
+  CT::string tempFileName;
+  tempFileName.print("%s.%d",cacheFileName.c_str(),getpid());
+  FILE *fp = fopen(tempFileName.c_str(),"wb");
+  if(fp == NULL){
+    CDBWarning("Unable to write cell index raster %s",tempFileName.c_str());
+    return 1;
+  }
+  int header[3] = {CCELLINDEXRASTER_MAGIC,width,height};
+  int status = 0;
+  if(fwrite(header,sizeof(header),1,fp)!=1)status = 1;
+  if(status == 0&&cellIndex.size()>0&&fwrite(&cellIndex[0],sizeof(int),cellIndex.size(),fp)!=cellIndex.size())status = 1;
+  if(fclose(fp)!=0)status = 1;
+  if(status == 0&&rename(tempFileName.c_str(),cacheFileName.c_str())!=0)status = 1;
+  if(status!=0){
+    CDBWarning("Unable to write cell index raster %s",cacheFileName.c_str());
+    unlink(tempFileName.c_str());
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,110 @@
+/******************************************************************************
+ *
+ * Project:  ADAGUC Server
+ * Purpose:  Cache of rasterized cell indices for unstructured and swath geometries
+ * Date:     2026-10-18
+ *
+ ******************************************************************************
+ *
+ * Copyright 2026, Royal Netherlands Meteorological Institute (KNMI)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ******************************************************************************/
+
+#ifndef CCELLINDEXRASTER_H
+#define CCELLINDEXRASTER_H
+#include <vector>
+#include <string>
+#include <pthread.h>
+#include <math.h>
+#include "CDataSource.h"
+#include "CDebugger.h"
+
+/* Cell indices are rasterized as float values, these are exact up to this number of cells */
+#define CCELLINDEXRASTER_MAXCELLS 4194304
+
+/* Number of rasters kept in memory, for animations and multiple variables on the same geometry */
+#define CCELLINDEXRASTER_MEMORYCACHESIZE 8
+
+/**
+ * For every pixel of the requested map, the index of the cell which covers it, or -1.
+ *
+ * The geometry of a mesh or swath is the same for every time step and variable. Once rasterized with the
+ * cell index as value, drawing a field is a gather: out[pixel] = values[cellIndex[pixel]].
+ * Cells with a nodata value are not drawn, so that overlapping cells with data show through as when drawing the
+ * values directly. Rasters are keyed on a hash of the cell coordinates, the nodata mask of the cells, the CRS,
+ * the BBOX and the size of the map, and are kept in memory and in the TempDir.
+ *
+ * Usage:
+ *   CCellIndexRaster raster;
+ *   if(raster.get(dataSource,lonData,latData,numCoordinates,values,numCells,fill,"variant")!=0){
+ *     float *indexData = raster.beginRasterize();
+ *     ...draw each cell with data into indexData with float(cellIndex) as value...
+ *     raster.endRasterize();
+ *   }
+ *   raster.gather(values,numCells,fill,outputData);
+ */
+class CCellIndexRaster{
+  private:
+    DEF_ERRORFUNCTION();
+    std::string key;
+    CT::string cacheFileName;
+    int width,height;
+    std::vector<int> cellIndex;
+    std::vector<float> rasterizeBuffer;
+    static pthread_mutex_t mutex;
+    static std::vector<std::pair<std::string,std::vector<int> > > memoryCache;
+    int loadFromFile();
+    int saveToFile();
+  public:
+    CCellIndexRaster();
+
+    /**
+     * Gets the raster for the geometry and the map of the request, from memory or from the TempDir
+     * @param dataSource The datasource, its srvParams give the CRS, BBOX, width and height
+     * @param lonData,latData The coordinates of the cells, these are hashed to identify the geometry
+     * @param numCoordinates Number of values in lonData and latData
+     * @param values,numCells,fill The values of the cells, cells with nodata are left out of the raster
+     * @param variant Distinguishes between the ways of drawing the same coordinates
+     * @return Zero when found, 1 when the raster needs to be made with beginRasterize and endRasterize
+     */
+    int get(CDataSource *dataSource,const float *lonData,const float *latData,size_t numCoordinates,const float *values,size_t numCells,float fill,const char *variant);
+
+    /**
+     * Returns true when the value of a cell is nodata, these cells must not be drawn into the raster
+     */
+    static bool isNodata(float value,float fill){
+      return value==fill||!(value==value)||value==INFINITY||value==-INFINITY;
+    }
+
+    /**
+     * Returns a width*height buffer filled with -1, in which the cells need to be drawn with their index as value
+     */
+    float *beginRasterize();
+
+    /**
+     * Converts the drawn buffer to cell indices and stores the raster in the caches
+     */
+    void endRasterize();
+
+    /**
+     * Draws values into the map, pixels without cell or with a nodata value are left as they are
+     * @param values The value for each cell
+     * @param numCells Number of values
+     * @param fill Nodata value of values
+     * @param output The width*height map
+     */
+    void gather(const float *values,size_t numCells,float fill,float *output);
+};
+#endif
@@ -0,0 +1,230 @@
+/******************************************************************************
+ *
+ * Project:  ADAGUC Server
+ * Purpose:  Maps data values to color indices of the legend
+ * Date:     2026-10-18
+ *
+ ******************************************************************************
+ *
+ * Copyright 2026, Royal Netherlands Meteorological Institute (KNMI)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ******************************************************************************/
+
+#ifndef CColorIndexTable_H
+#define CColorIndexTable_H
+
+#include <math.h>
+#include <limits>
+#include "CDataSource.h"
+#include "CStyleConfiguration.h"
+
+/* Color index of values which are not drawn, like nodata or values outside the legend value range */
+#define CCOLORINDEXTABLE_NODRAW   -1
+
+/* Highest color index used by the legend */
+#define CCOLORINDEXTABLE_MAXINDEX 239
+
+/* Number of bins of the table for float data, and the bin value for bins in which the color index changes */
+#define CCOLORINDEXTABLE_NUMBINS  4096
+#define CCOLORINDEXTABLE_BINMIXED -2
+
+/**
+ * Converts data values to color indices of the legend, using the nodata value of the data and the legend value
+ * range, log, scale and offset of the style.
+ *
+ * For 8 and 16 bit data the index of every possible value is calculated once by prepare<T>(), after that get()
+ * is a table lookup. For float and 32 bit data prepare<T>() divides the values which map to the legend into
+ * CCOLORINDEXTABLE_NUMBINS equal bins. A bin in which the color index does not change is a table lookup, only
+ * values in bins at an index boundary, or outside the bins, are calculated. This avoids the log10 of log legends.
+ * The bins are calculated with values of type T, so get<T>() gives the same index as calculate<T>().
+ */
+class CColorIndexTable{
+private:
+  double legendLowerRange,legendUpperRange;
+  bool legendValueRange;
+  bool hasNodataValue;
+  double dfNodataValue;
+  float legendLog,legendLogAsLog,legendScale,legendOffset;
+  short *table;
+  size_t tableMask;
+  short *binTable;
+  double binStart,binScale;
+  template <class T>
+  void prepareBins(){
+    if(legendScale==0||(legendLog!=0&&legendLogAsLog==0))return;
+    /* The values at which the color index reaches 0 and the maximum index */
+    double t0 = (0-legendOffset)/legendScale;
+    double t1 = (CCOLORINDEXTABLE_MAXINDEX+1-legendOffset)/legendScale;
+    if(legendLog!=0){
+      t0 = pow(10,t0*legendLogAsLog);
+      t1 = pow(10,t1*legendLogAsLog);
+    }
+    double binEnd = t0>t1?t0:t1;
+    binStart = t0<t1?t0:t1;
+    if(legendValueRange){
+      if(legendLowerRange>binStart)binStart = legendLowerRange;
+      if(legendUpperRange<binEnd)binEnd = legendUpperRange;
+    }
+    bool isIntegral = T(0.5)==T(0);
+    if(isIntegral){
+      if(binStart<double(std::numeric_limits<T>::min()))binStart = std::numeric_limits<T>::min();
+      if(binEnd>double(std::numeric_limits<T>::max()))binEnd = std::numeric_limits<T>::max();
+    }
+    if(!(binEnd>binStart)||isinf(binEnd-binStart))return;
+    binScale = CCOLORINDEXTABLE_NUMBINS/(binEnd-binStart);
+    double binWidth = (binEnd-binStart)/CCOLORINDEXTABLE_NUMBINS;
+    binTable = new short[CCOLORINDEXTABLE_NUMBINS];
+    for(int j=0;j<CCOLORINDEXTABLE_NUMBINS;j++){
+      /* The mapping is monotonic, so the index is the same in the whole bin when it is at both ends. The ends are widened
+         a little, a value rounded into a neighbouring bin still gets the right index. The ends are values of type T, like
+         the data: calculate<T> truncates the log of integers, and integer data only has the integers inside the bin. */
+      double lo = binStart+j*binWidth-binWidth*0.01;
+      double hi = binStart+(j+1)*binWidth+binWidth*0.01;
+      if(isIntegral){
+        lo = ceil(lo);
+        hi = floor(hi);
+        if(lo<double(std::numeric_limits<T>::min()))lo = std::numeric_limits<T>::min();
+        if(hi>double(std::numeric_limits<T>::max()))hi = std::numeric_limits<T>::max();
+        if(lo>hi){
+          binTable[j] = CCOLORINDEXTABLE_BINMIXED;
+          continue;
+        }
+      }
+      short indexLo = calculate<T>((T)lo);
+      binTable[j] = indexLo==calculate<T>((T)hi)?indexLo:CCOLORINDEXTABLE_BINMIXED;
+    }
+  }
+  CColorIndexTable(const CColorIndexTable&);
+  CColorIndexTable &operator=(const CColorIndexTable&);
+public:
+  CColorIndexTable(){
+    table = NULL;
+    tableMask = 0;
+    binTable = NULL;
+    binStart = 0;
+    binScale = 0;
+    legendLowerRange = 0;
+    legendUpperRange = 0;
+    legendValueRange = false;
+    hasNodataValue = false;
+    dfNodataValue = 0;
+    legendLog = 0;
+    legendLogAsLog = 0;
+    legendScale = 1;
+    legendOffset = 0;
+  }
+  ~CColorIndexTable(){
+    delete[] table;
+    delete[] binTable;
+  }
+
+  void init(CDataSource *dataSource){
+    init(dataSource->getStyle(),dataSource->getDataObject(0)->hasNodataValue,dataSource->getDataObject(0)->dfNodataValue);
+  }
+
+  /**
+   * Takes the legend value range, log, scale and offset of the style, for data with the given nodata value
+   */
+  void init(CStyleConfiguration *styleConfiguration,bool hasNodataValue,double dfNodataValue){
+    this->dfNodataValue  = dfNodataValue;
+    this->hasNodataValue = hasNodataValue;
+    legendValueRange = styleConfiguration->hasLegendValueRange;
+    legendLowerRange = styleConfiguration->legendLowerRange;
+    legendUpperRange = styleConfiguration->legendUpperRange;
+    legendLog = styleConfiguration->legendLog;
+    if(legendLog>0){
+      legendLogAsLog = log10(legendLog);
+    }else{
+      legendLogAsLog = 0;
+    }
+    legendScale = styleConfiguration->legendScale;
+    legendOffset = styleConfiguration->legendOffset;
+  }
+
+  /**
+   * Fills the table for data of type T, must be called after init
+   */
+  template <class T>
+  void prepare(){
+    delete[] table;
+    table = NULL;
+    tableMask = 0;
+    delete[] binTable;
+    binTable = NULL;
+    if(sizeof(T)>2||T(0.5)!=T(0)){
+      prepareBins<T>();
+      return;
+    }
+    size_t tableSize = sizeof(T)==1?256:65536;
+    table = new short[tableSize];
+    tableMask = tableSize-1;
+    for(size_t j=0;j<tableSize;j++){
+      T val = (T)j;
+      table[size_t((unsigned int)val)&tableMask]=calculate(val);
+    }
+  }
+
+  /**
+   * Calls prepare<T>() with the C type of the CDFType
+   */
+  void prepare(CDFType type){
+    switch(type){
+      case CDF_CHAR  : prepare<char>();break;
+      case CDF_BYTE  : prepare<char>();break;
+      case CDF_UBYTE : prepare<unsigned char>();break;
+      case CDF_SHORT : prepare<short>();break;
+      case CDF_USHORT: prepare<ushort>();break;
+      case CDF_INT   : prepare<int>();break;
+      case CDF_UINT  : prepare<unsigned int>();break;
+      case CDF_FLOAT : prepare<float>();break;
+      default: prepare<double>();break;
+    }
+  }
+
+  /**
+   * Returns the color index of val, or CCOLORINDEXTABLE_NODRAW when it should not be drawn
+   */
+  template <class T>
+  short get(T val) const {
+    if(sizeof(T)<=2&&table!=NULL)return table[size_t((unsigned int)val)&tableMask];
+    if(binTable!=NULL){
+      if(hasNodataValue&&val==(T)dfNodataValue)return CCOLORINDEXTABLE_NODRAW;
+      /* NaN fails the comparisons and is calculated */
+      double bin = (val-binStart)*binScale;
+      if(bin>=0&&bin<CCOLORINDEXTABLE_NUMBINS){
+        short pcolorind = binTable[int(bin)];
+        if(pcolorind!=CCOLORINDEXTABLE_BINMIXED)return pcolorind;
+      }
+    }
+    return calculate(val);
+  }
+
+  template <class T>
+  short calculate(T val) const {
+    if(hasNodataValue){if(val==(T)dfNodataValue)return CCOLORINDEXTABLE_NODRAW;}
+    if(!(val==val))return CCOLORINDEXTABLE_NODRAW;
+    if(legendValueRange)if(val<legendLowerRange||val>legendUpperRange)return CCOLORINDEXTABLE_NODRAW;
+    if(legendLog!=0){
+      if(val>0){
+        val=(T)(log10(val)/legendLogAsLog);
+      }else val=(T)(-legendOffset);
+    }
+    int pcolorind=(int)(val*legendScale+legendOffset);
+    if(pcolorind>=CCOLORINDEXTABLE_MAXINDEX)pcolorind=CCOLORINDEXTABLE_MAXINDEX;else if(pcolorind<=0)pcolorind=0;
+    return pcolorind;
+  }
+};
+
+#endif
@@ -26,6 +26,8 @@
 #include "CConvertCurvilinear.h"
 #include "CFillTriangle.h"
 #include "CImageWarper.h"
+#include "CSwathIndex.h"
+#include "CCellIndexRaster.h"
 //#define CCONVERTCURVILINEAR_DEBUG
 const char *CConvertCurvilinear::className="CConvertCurvilinear";
 
@@ -675,7 +677,21 @@ int CConvertCurvilinear::convertCurvilinearData(CDataSource *dataSource,int mode
       try{swathMiddleLon->getAttribute("_FillValue")->getData(&fillValueLon,1);}catch(int e){};
       try{swathMiddleLat->getAttribute("_FillValue")->getData(&fillValueLat,1);}catch(int e){};
       
+      //Rows in blocks outside the requested area are not reprojected and drawn
+      CSwathIndex swathIndex;
+      double latLonBBOX[4];
+      bool useSwathIndex = CSwathIndex::getRequestLatLonBBOX(dataSource->srvParams,&imageWarper,projectionRequired,latLonBBOX)==0;
+      if(useSwathIndex){
+        CT::string cacheFileName = CSwathIndex::getCacheFileName(dataSource->srvParams,cdfObject->currentFile.c_str(),"curvilinear_center");
+        useSwathIndex = swathIndex.loadOrBuild(cacheFileName.c_str(),lonData,latData,size_t(numRows)*numCols,1,size_t(numCols)*CSWATHINDEX_SCANLINESPERBLOCK)==0;
+        if(useSwathIndex&&projectionRequired)swathIndex.projectBlocks(dataSource->srvParams,&imageWarper);
+      }
+      
       for(int y=0;y<numRows-1;y++){ 
+        if(useSwathIndex){
+          //The quads of this row also use the next row, which can be in the next block
+          if(!swathIndex.blockIntersects(y/CSWATHINDEX_SCANLINESPERBLOCK,latLonBBOX)&&!swathIndex.blockIntersects((y+1)/CSWATHINDEX_SCANLINESPERBLOCK,latLonBBOX))continue;
+        }
         for(int x=0;x<numCols-1;x++){ 
           size_t pSwath = x+y*numCols;
           //CDBDebug("%d %d %d",x,y,pSwath);
@@ -784,7 +800,35 @@ int CConvertCurvilinear::convertCurvilinearData(CDataSource *dataSource,int mode
       try{swathLon->getAttribute("_FillValue")->getData(&fillValueLon,1);}catch(int e){};
       try{swathLat->getAttribute("_FillValue")->getData(&fillValueLat,1);}catch(int e){};
       
-      for(int pSwath=0;pSwath<numTiles;pSwath++){ 
+      //Blocks of tiles outside the requested area are not reprojected and drawn
+      CSwathIndex swathIndex;
+      double latLonBBOX[4];
+      int tilesPerBlock = numRows*CSWATHINDEX_SCANLINESPERBLOCK;
+      bool useSwathIndex = CSwathIndex::getRequestLatLonBBOX(dataSource->srvParams,&imageWarper,projectionRequired,latLonBBOX)==0;
+      if(useSwathIndex){
+        CT::string cacheFileName = CSwathIndex::getCacheFileName(dataSource->srvParams,cdfObject->currentFile.c_str(),"curvilinear_bounds");
+        useSwathIndex = swathIndex.loadOrBuild(cacheFileName.c_str(),lonData,latData,numTiles,4,tilesPerBlock)==0;
+        if(useSwathIndex&&projectionRequired)swathIndex.projectBlocks(dataSource->srvParams,&imageWarper);
+      }
+      
+      //The tiles are drawn once with their cell index as value, other time steps and variables only need a gather
+      CCellIndexRaster cellIndexRaster;
+      bool useCellIndexRaster = numTiles<=CCELLINDEXRASTER_MAXCELLS;
+      bool drawGeometry = true;
+      float *drawData = sdata;
+      if(useCellIndexRaster){
+        if(cellIndexRaster.get(dataSource,lonData,latData,size_t(numTiles)*4,swathData,numTiles,fill,"curvilinear")==0){
+          drawGeometry = false;
+        }else{
+          drawData = cellIndexRaster.beginRasterize();
+        }
+      }
+      
+      for(int pSwath=0;pSwath<numTiles&&drawGeometry;pSwath++){ 
+        if(useSwathIndex&&pSwath%tilesPerBlock==0&&!swathIndex.blockIntersects(pSwath/tilesPerBlock,latLonBBOX)){
+          pSwath+=tilesPerBlock-1;
+          continue;
+        }
 
         
         double lons[4],lats[4];
@@ -799,12 +843,13 @@ int CConvertCurvilinear::convertCurvilinearData(CDataSource *dataSource,int mode
         lats[2] = (double)latData[pSwath*4+3];
         lats[3] = (double)latData[pSwath*4+2];
         
-        vals[0] = swathData[pSwath];
+        vals[0] = useCellIndexRaster?float(pSwath):swathData[pSwath];
         vals[1]=  vals[0];
         vals[2] = vals[0];
         vals[3] = vals[0];
 
-        bool tileHasNoData = false;
+        //Cells without data are left out of the cell index raster as well, so overlapping cells with data show through
+        bool tileHasNoData = CCellIndexRaster::isNodata(swathData[pSwath],fill);
         
       
         float lonMin,lonMax,lonMiddle=0;
@@ -816,8 +861,6 @@ int CConvertCurvilinear::convertCurvilinearData(CDataSource *dataSource,int mode
           }
           lonMiddle+=lon;
           float lat = lats[j];
-          float val = vals[j];
-          if(val==fill||val==INFINITY||val==NAN||val==-INFINITY||!(val==val)){tileHasNoData=true;break;}
           if(lat==fillValueLat||lat==INFINITY||lat==-INFINITY||!(lat==lat)){tileHasNoData=true;break;}
           if(lon==fillValueLon||lon==INFINITY||lon==-INFINITY||!(lon==lon)){tileHasNoData=true;break;}
         
@@ -838,10 +881,14 @@ int CConvertCurvilinear::convertCurvilinearData(CDataSource *dataSource,int mode
             dlats[j]=int((lats[j]-offsetY)/cellSizeY);
           }
           if(tileHasNoData==false){
-            fillQuadGouraud(sdata, vals, dataSource->dWidth,dataSource->dHeight, dlons,dlats);
+            fillQuadGouraud(drawData, vals, dataSource->dWidth,dataSource->dHeight, dlons,dlats);
           }
         }
       }
+      if(useCellIndexRaster){
+        if(drawGeometry)cellIndexRaster.endRasterize();
+        cellIndexRaster.gather(swathData,numTiles,fill,sdata);
+      }
     }
     imageWarper.closereproj();
    
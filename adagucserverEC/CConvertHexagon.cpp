@@ -26,6 +26,7 @@
 #include "CConvertHexagon.h"
 #include "CFillTriangle.h"
 #include "CImageWarper.h"
+#include "CCellIndexRaster.h"
 
 
 //#define CCONVERTHEXAGON_DEBUG
@@ -815,15 +816,29 @@ int CConvertHexagon::convertHexagonData(CDataSource *dataSource,int mode){
       try{swathLon->getAttribute("_FillValue")->getData(&fillValueLon,1);}catch(int e){};
       try{swathLat->getAttribute("_FillValue")->getData(&fillValueLat,1);}catch(int e){};
       
-      for(int pSwath=0;pSwath<numTiles;pSwath++){ 
+      //The hexagons are drawn once with their cell index as value, other time steps and variables only need a gather
+      CCellIndexRaster cellIndexRaster;
+      bool useCellIndexRaster = numTiles<=CCELLINDEXRASTER_MAXCELLS;
+      bool drawGeometry = true;
+      float *drawData = sdata;
+      if(useCellIndexRaster){
+        if(cellIndexRaster.get(dataSource,lonData,latData,size_t(numTiles)*numVerts,hexagonData,numTiles,fill,"hexagon")==0){
+          drawGeometry = false;
+        }else{
+          drawData = cellIndexRaster.beginRasterize();
+        }
+      }
+      
+      for(int pSwath=0;pSwath<numTiles&&drawGeometry;pSwath++){ 
 
         
         
         float *lons = &lonData[pSwath*numVerts];
         float *lats = &latData[pSwath*numVerts];
-        float val = hexagonData[pSwath];
+        float val = useCellIndexRaster?float(pSwath):hexagonData[pSwath];
         
-        bool tileHasNoData = false;
+        //Cells without data are left out of the cell index raster as well, so overlapping cells with data show through
+        bool tileHasNoData = CCellIndexRaster::isNodata(hexagonData[pSwath],fill);
         
         bool tileIsOverDateBorder = false;
         
@@ -831,7 +846,6 @@ int CConvertHexagon::convertHexagonData(CDataSource *dataSource,int mode){
           float lon = lons[j];
           float lat = lats[j];
           
-          if(val==fill||val==INFINITY||val==NAN||val==-INFINITY||!(val==val)){tileHasNoData=true;break;}
           if(lat==fillValueLat||lat==INFINITY||lat==-INFINITY||!(lat==lat)){tileHasNoData=true;break;}
           if(lon==fillValueLon||lon==INFINITY||lon==-INFINITY||!(lon==lon)){tileHasNoData=true;break;}
           if(lon>178)tileIsOverDateBorder=true;//Needs further inspection
@@ -885,11 +899,15 @@ int CConvertHexagon::convertHexagonData(CDataSource *dataSource,int mode){
             //fillQuadGouraud(sdata, vals, dataSource->dWidth,dataSource->dHeight, dlons,dlats);
             
             //drawpoly2(sdata,dataSource->dWidth,dataSource->dHeight,numVerts,flons,flats,val);
-            drawNGon(sdata,dataSource->dWidth,dataSource->dHeight,numVerts,flons,flats,val);
+            drawNGon(drawData,dataSource->dWidth,dataSource->dHeight,numVerts,flons,flats,val);
             //drawlines2(sdata,dataSource->dWidth,dataSource->dHeight,numVerts,flons,flats,val);
           }
         }
       }
+      if(useCellIndexRaster){
+        if(drawGeometry)cellIndexRaster.endRasterize();
+        cellIndexRaster.gather(hexagonData,numTiles,fill,sdata);
+      }
     }
     imageWarper.closereproj();
    
@@ -71,24 +71,14 @@ int CConvertTROPOMI::convertTROPOMIHeader( CDFObject *cdfObject,CServerParams *s
   if(isThisTROPOMIData(cdfObject)!=0)return 1;
   CDBDebug("Using CConvertTROPOMI.h");
 
-  //Standard bounding box of adaguc data is worldwide
-  CDF::Variable *pointLon;
-  CDF::Variable *pointLat;
+  CDBDebug("start reading latlon coordinates");
   
-  try{
-    pointLon = cdfObject->getVariable("PRODUCT/SUPPORT_DATA/GEOLOCATIONS/longitude_bounds");
-    pointLat = cdfObject->getVariable("PRODUCT/SUPPORT_DATA/GEOLOCATIONS/latitude_bounds");
-  }catch(int e){
-    CDBError("lat or lon variables not found");
+  //The extent comes from the swath index, which only reads the coordinates when it is not cached yet
+  CSwathIndex swathIndex;
+  if(getSwathIndex(cdfObject,srvParams,swathIndex)!=0){
     return 1;
   }
   
-  
-  CDBDebug("start reading latlon coordinates");
-  
-  pointLon->readData(CDF_FLOAT,true);
-  pointLat->readData(CDF_FLOAT,true);
-  
   #ifdef CCONVERTTROPOMI_DEBUG
     StopWatch_Stop("DATA READ");
   #endif
@@ -98,9 +88,12 @@ int CConvertTROPOMI::convertTROPOMIHeader( CDFObject *cdfObject,CServerParams *s
   latMinMax.min = -90;
   lonMinMax.max = 180;
   latMinMax.max = 90;
-  if(pointLon->getSize() > 0){
-    lonMinMax = getMinMax(pointLon);
-    latMinMax = getMinMax(pointLat);
+  double extent[4];
+  if(swathIndex.getExtent(extent) == 0){
+    lonMinMax.min = extent[0];
+    latMinMax.min = extent[1];
+    lonMinMax.max = extent[2];
+    latMinMax.max = extent[3];
   }
   #ifdef CCONVERTTROPOMI_DEBUG
     StopWatch_Stop("MIN/MAX Calculated");
@@ -305,6 +298,68 @@ void CConvertTROPOMIDrawlines(float *imagedata,int w,int h,int polyCorners,int *
   CConvertTROPOMIline2(imagedata, w, h,polyX[polyCorners-1],polyY[polyCorners-1],polyX[0],polyY[0],value);
 }
 
+/**
+ * Loads the swath index of the file from the cache, or builds it from the coordinates and saves it
+ */
+int CConvertTROPOMI::getSwathIndex(CDFObject *cdfObject,CServerParams *srvParams,CSwathIndex &swathIndex){
+  CDF::Variable *pointLon;
+  CDF::Variable *pointLat;
+  try{
+    pointLon = cdfObject->getVariable("PRODUCT/SUPPORT_DATA/GEOLOCATIONS/longitude_bounds");
+    pointLat = cdfObject->getVariable("PRODUCT/SUPPORT_DATA/GEOLOCATIONS/latitude_bounds");
+  }catch(int e){
+    CDBError("lat or lon variables not found");
+    return 1;
+  }
+  if(pointLon->dimensionlinks.size()<3){
+    CDBError("Unexpected dimensions for %s",pointLon->name.c_str());
+    return 1;
+  }
+  
+  CT::string cacheFileName = CSwathIndex::getCacheFileName(srvParams,cdfObject->currentFile.c_str(),"tropomi");
+  if(swathIndex.load(cacheFileName.c_str()) == 0){
+    return 0;
+  }
+  
+  pointLon->readData(CDF_FLOAT,true);
+  pointLat->readData(CDF_FLOAT,true);
+  size_t swathWidth = pointLon->dimensionlinks[pointLon->dimensionlinks.size()-2]->getSize();
+  swathIndex.build((float*)pointLon->data,(float*)pointLat->data,pointLon->getSize()/4,4,swathWidth*CSWATHINDEX_SCANLINESPERBLOCK);
+  swathIndex.save(cacheFileName.c_str());
+  return 0;
+}
+
+/**
+ * Reads a range of scanlines of a swath variable, all other dimensions are read completely.
+ * Nothing is read when the whole variable is already in memory, dataOffset then gives the position of the first scanline in data.
+ */
+int CConvertTROPOMI::readScanlines(CDF::Variable *var,size_t scanlineDim,size_t firstScanline,size_t numScanlines,bool applyScaleOffset,size_t &dataOffset){
+  size_t numDims = var->dimensionlinks.size();
+  size_t start[numDims];
+  size_t count[numDims];
+  ptrdiff_t stride[numDims];
+  size_t fullSize = 1;
+  for(size_t d=0;d<numDims;d++){
+    start[d]=0;
+    count[d]=var->dimensionlinks[d]->getSize();
+    stride[d]=1;
+    fullSize*=count[d];
+  }
+  if(var->data!=NULL){
+    if(var->getSize()==fullSize){
+      dataOffset=count[scanlineDim]>0?firstScanline*(fullSize/count[scanlineDim]):0;
+      return 0;
+    }
+    //Scanlines read by an earlier call, these can be different ones
+    var->freeData();
+  }
+  start[scanlineDim]=firstScanline;
+  count[scanlineDim]=numScanlines;
+  dataOffset=0;
+  if(numScanlines==0)return 0;
+  return var->readData(CDF_FLOAT,start,count,stride,applyScaleOffset);
+}
+
 /**
  * This function draws the virtual 2D variable into a new 2D field
  */
@@ -322,9 +377,10 @@ int CConvertTROPOMI::convertTROPOMIData(CDataSource *dataSource,int mode){
     CDBError("lat or lon variables not found");
     return 1;
   }
-  
-  pointLon->readData(CDF_FLOAT,true);
-  pointLat->readData(CDF_FLOAT,true);
+  if(pointLon->dimensionlinks.size()<3||pointLat->dimensionlinks.size()<3){
+    CDBError("Unexpected dimensions for lat or lon variables");
+    return 1;
+  }
   
   size_t nrDataObjects = dataSource->getNumDataObjects();
   
@@ -390,9 +446,72 @@ int CConvertTROPOMI::convertTROPOMIData(CDataSource *dataSource,int mode){
     CDF::Variable *new2DVar[nrDataObjects];
     CDF::Variable *pointVar[nrDataObjects];
     
-    
     for(size_t d=0;d<nrDataObjects;d++){
       new2DVar[d] = dataSource->getDataObject(d)->cdfVariable;
+    }
+    
+    CImageWarper imageWarper;
+    bool projectionRequired=false;
+    if(dataSource->srvParams->Geo->CRS.length()>0){
+      projectionRequired=true;
+      for(size_t d=0;d<nrDataObjects;d++){
+        new2DVar[d]->setAttributeText("grid_mapping","customgridprojection");
+      }
+      if(cdfObject->getVariableNE("customgridprojection")==NULL){
+        CDF::Variable *projectionVar = new CDF::Variable();
+        projectionVar->name.copy("customgridprojection");
+        cdfObject->addVariable(projectionVar);
+        dataSource->nativeEPSG = dataSource->srvParams->Geo->CRS.c_str();
+        imageWarper.decodeCRS(&dataSource->nativeProj4,&dataSource->nativeEPSG,&dataSource->srvParams->cfg->Projection);
+        if(dataSource->nativeProj4.length()==0){
+          dataSource->nativeProj4=LATLONPROJECTION;
+          dataSource->nativeEPSG="EPSG:4326";
+          projectionRequired=false;
+        }
+        projectionVar->setAttributeText("proj4_params",dataSource->nativeProj4.c_str());
+      }
+    }
+    
+    
+    #ifdef CCONVERTTROPOMI_DEBUG
+    CDBDebug("Datasource CRS = %s nativeproj4 = %s",dataSource->nativeEPSG.c_str(),dataSource->nativeProj4.c_str());
+    CDBDebug("Datasource bbox:%f %f %f %f",dataSource->srvParams->Geo->dfBBOX[0],dataSource->srvParams->Geo->dfBBOX[1],dataSource->srvParams->Geo->dfBBOX[2],dataSource->srvParams->Geo->dfBBOX[3]);
+    CDBDebug("Datasource width height %d %d",dataSource->dWidth,dataSource->dHeight);
+    #endif
+    
+    
+    if(projectionRequired){
+      int status = imageWarper.initreproj(dataSource,dataSource->srvParams->Geo,&dataSource->srvParams->cfg->Projection);
+      if(status !=0 ){
+        CDBError("Unable to init projection");
+        return 1;
+      }
+    }
+    
+    int swathLonWidth = pointLon->dimensionlinks[pointLon->dimensionlinks.size()-2]->getSize();
+    int swathLonHeight = pointLon->dimensionlinks[pointLon->dimensionlinks.size()-3]->getSize();
+    
+    //Use the swath index to find the scanlines which intersect the requested area, only these are read and drawn
+    size_t firstScanline = 0;
+    size_t numScanlines = swathLonHeight;
+    CSwathIndex swathIndex;
+    double latLonBBOX[4];
+    if(getSwathIndex(cdfObject,dataSource->srvParams,swathIndex)==0&&CSwathIndex::getRequestLatLonBBOX(dataSource->srvParams,&imageWarper,projectionRequired,latLonBBOX)==0){
+      size_t firstCell,numCells;
+      if(projectionRequired)swathIndex.projectBlocks(dataSource->srvParams,&imageWarper);
+      if(swathIndex.getCellRange(latLonBBOX,firstCell,numCells)==0){
+        firstScanline = firstCell/swathLonWidth;
+        numScanlines = (firstCell+numCells+swathLonWidth-1)/swathLonWidth-firstScanline;
+      }else{
+        numScanlines = 0;
+      }
+    }
+    #ifdef CCONVERTTROPOMI_DEBUG
+    CDBDebug("Using %d scanlines from %d of %d",(int)numScanlines,(int)firstScanline,swathLonHeight);
+    #endif
+    
+    size_t pointVarOffset = 0;
+    for(size_t d=0;d<nrDataObjects;d++){
       CT::string origSwathName=new2DVar[d]->name.c_str();
       origSwathName.concat("_backup");
       pointVar[d]=dataSource->getDataObject(d)->cdfObject->getVariableNE(origSwathName.c_str());
@@ -400,7 +519,16 @@ int CConvertTROPOMI::convertTROPOMIData(CDataSource *dataSource,int mode){
         CDBError("Unable to find orignal swath variable with name %s",origSwathName.c_str());
         return 1;
       }
-      pointVar[d]->readData(CDF_FLOAT);
+      if(pointVar[d]->dimensionlinks.size()<2){
+        CDBError("Unexpected dimensions for swath variable %s",origSwathName.c_str());
+        return 1;
+      }
+      size_t dataOffset = 0;
+      if(readScanlines(pointVar[d],pointVar[d]->dimensionlinks.size()-2,firstScanline,numScanlines,false,dataOffset)!=0){
+        CDBError("Unable to read scanlines of swath variable %s",origSwathName.c_str());
+        return 1;
+      }
+      if(d==0)pointVarOffset = dataOffset;
     }
     
     
@@ -430,8 +558,10 @@ int CConvertTROPOMI::convertTROPOMIData(CDataSource *dataSource,int mode){
     if(dataSource->stretchMinMax){
       if(dataSource->statistics==NULL){
 
+        //Statistics of the scanlines in the requested area
+        size_t numValues = pointVar[0]->data==NULL?0:size_t(numScanlines)*swathLonWidth;
         dataSource->statistics = new CDataSource::Statistics();
-        dataSource->statistics->calculate(pointVar[0]->getSize(),(float*)pointVar[0]->data,CDF_FLOAT,dataSource->getDataObject(0)->dfNodataValue, dataSource->getDataObject(0)->hasNodataValue);
+        dataSource->statistics->calculate(numValues,((float*)pointVar[0]->data)+pointVarOffset,CDF_FLOAT,dataSource->getDataObject(0)->dfNodataValue, dataSource->getDataObject(0)->hasNodataValue);
 //         dataSource->statistics->setMaximum(max);
 //         dataSource->statistics->setMinimum(min);
       }
@@ -457,55 +587,21 @@ int CConvertTROPOMI::convertTROPOMIData(CDataSource *dataSource,int mode){
       }
     }
     
-    CImageWarper imageWarper;
-    bool projectionRequired=false;
-    if(dataSource->srvParams->Geo->CRS.length()>0){
-      projectionRequired=true;
-      for(size_t d=0;d<nrDataObjects;d++){
-        new2DVar[d]->setAttributeText("grid_mapping","customgridprojection");
-      }
-      if(cdfObject->getVariableNE("customgridprojection")==NULL){
-        CDF::Variable *projectionVar = new CDF::Variable();
-        projectionVar->name.copy("customgridprojection");
-        cdfObject->addVariable(projectionVar);
-        dataSource->nativeEPSG = dataSource->srvParams->Geo->CRS.c_str();
-        imageWarper.decodeCRS(&dataSource->nativeProj4,&dataSource->nativeEPSG,&dataSource->srvParams->cfg->Projection);
-        if(dataSource->nativeProj4.length()==0){
-          dataSource->nativeProj4=LATLONPROJECTION;
-          dataSource->nativeEPSG="EPSG:4326";
-          projectionRequired=false;
-        }
-        projectionVar->setAttributeText("proj4_params",dataSource->nativeProj4.c_str());
-      }
+    size_t lonOffset = 0,latOffset = 0;
+    if(readScanlines(pointLon,pointLon->dimensionlinks.size()-3,firstScanline,numScanlines,true,lonOffset)!=0||
+       readScanlines(pointLat,pointLat->dimensionlinks.size()-3,firstScanline,numScanlines,true,latOffset)!=0){
+      CDBError("Unable to read scanlines of lat or lon variables");
+      return 1;
     }
     
-    
-    #ifdef CCONVERTTROPOMI_DEBUG
-    CDBDebug("Datasource CRS = %s nativeproj4 = %s",dataSource->nativeEPSG.c_str(),dataSource->nativeProj4.c_str());
-    CDBDebug("Datasource bbox:%f %f %f %f",dataSource->srvParams->Geo->dfBBOX[0],dataSource->srvParams->Geo->dfBBOX[1],dataSource->srvParams->Geo->dfBBOX[2],dataSource->srvParams->Geo->dfBBOX[3]);
-    CDBDebug("Datasource width height %d %d",dataSource->dWidth,dataSource->dHeight);
-    #endif
-    
-    
-    if(projectionRequired){
-      int status = imageWarper.initreproj(dataSource,dataSource->srvParams->Geo,&dataSource->srvParams->cfg->Projection);
-      if(status !=0 ){
-        CDBError("Unable to init projection");
-        return 1;
-      }
-    }
-    
-      
     float *sdata = ((float*)dataSource->getDataObject(0)->cdfVariable->data);
 
-    float *lonData = (float*)pointLon->data;
-    float *latData = (float*)pointLat->data;
+    float *lonData = ((float*)pointLon->data)+lonOffset;
+    float *latData = ((float*)pointLat->data)+latOffset;
+    float *swathData = ((float*)pointVar[0]->data)+pointVarOffset;
     double lons[4],lats[4];
     float vals[4];
     
-    int swathLonWidth = pointLon->dimensionlinks[pointLon->dimensionlinks.size()-2]->getSize();
-    int swathLonHeight = pointLon->dimensionlinks[pointLon->dimensionlinks.size()-3]->getSize();
-    
 //     for(size_t j=0;j<pointLon->dimensionlinks.size();j++){
 //       CDBDebug("%d %s %d",j,pointLon->dimensionlinks[j]->name.c_str(),pointLon->dimensionlinks[j]->getSize());
 //     }
@@ -518,11 +614,12 @@ int CConvertTROPOMI::convertTROPOMIData(CDataSource *dataSource,int mode){
     int mode = 0;
     //for( mode=0;mode<2;mode++)
     {
-    for(int y=0;y<swathLonHeight;y++){
+    //Coordinates and values start at firstScanline
+    for(int y=0;y<int(numScanlines);y++){
       for(int x=0;x<swathLonWidth;x++){
         
         size_t pSwath = (x+y*swathLonWidth);
-        float val  = ((float*)pointVar[0]->data)[pSwath];
+        float val  = swathData[pSwath];
         lons[0] = (float)lonData[pSwath*4+0];
         lons[1] = (float)lonData[pSwath*4+1];
         lons[2] = (float)lonData[pSwath*4+3];
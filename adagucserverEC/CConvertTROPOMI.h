@@ -26,6 +26,7 @@
 #ifndef CCONVERTTROPOMI_H
 #define CCONVERTTROPOMI_H
 #include "CDataSource.h"
+#include "CSwathIndex.h"
 class CConvertTROPOMI{
   private:
   DEF_ERRORFUNCTION();
@@ -33,6 +34,8 @@ class CConvertTROPOMI{
    * returns 0 on success.
    */
   static int isThisTROPOMIData( CDFObject *cdfObject );
+  static int getSwathIndex(CDFObject *cdfObject,CServerParams *srvParams,CSwathIndex &swathIndex);
+  static int readScanlines(CDF::Variable *var,size_t scanlineDim,size_t firstScanline,size_t numScanlines,bool applyScaleOffset,size_t &dataOffset);
   public:
   static int convertTROPOMIHeader(CDFObject *cdfObject,CServerParams *srvParams);
   static int convertTROPOMIData(CDataSource *dataSource,int mode);
@@ -0,0 +1,480 @@
+/******************************************************************************
+ *
+ * Project:  ADAGUC Server
+ * Purpose:  Extracts contour lines from the native grid and writes them as GeoJSON
+ * Date:     2026-10-18
+ *
+ ******************************************************************************
+ *
+ * Copyright 2026, Royal Netherlands Meteorological Institute (KNMI)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <map>
+#include <algorithm>
+#include <math.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "CCreateContours.h"
+#include "CDataReader.h"
+#include "CReadFile.h"
+
+// #define CCREATECONTOURS_DEBUG
+
+const char * CCreateContours::className = "CCreateContours";
+
+/* Edges of a cell, as used in segmentTable */
+#define CCREATECONTOURS_EDGE_TOP    0
+#define CCREATECONTOURS_EDGE_RIGHT  1
+#define CCREATECONTOURS_EDGE_BOTTOM 2
+#define CCREATECONTOURS_EDGE_LEFT   3
+
+#define CCREATECONTOURS_NOEDGE      ((size_t)-1)
+
+/* Segments per marching squares case, as pairs of edges, -1 terminated. Bit 1 is the top left corner, then clockwise.
+ * The saddles 5 and 10 are listed for a low cell center, they are swapped when the center is high. */
+static const int segmentTable[16][5]={
+  {-1,-1,-1,-1,-1},
+  { 3, 0,-1,-1,-1},
+  { 0, 1,-1,-1,-1},
+  { 3, 1,-1,-1,-1},
+  { 1, 2,-1,-1,-1},
+  { 3, 0, 1, 2,-1},
+  { 0, 2,-1,-1,-1},
+  { 3, 2,-1,-1,-1},
+  { 2, 3,-1,-1,-1},
+  { 0, 2,-1,-1,-1},
+  { 0, 1, 2, 3,-1},
+  { 1, 2,-1,-1,-1},
+  { 1, 3,-1,-1,-1},
+  { 0, 1,-1,-1,-1},
+  { 3, 0,-1,-1,-1},
+  {-1,-1,-1,-1,-1}
+};
+
+CCreateContours::CCreateContours(){
+  srvParam = NULL;
+  baseDataSource = NULL;
+  numFeatures = 0;
+}
+
+int CCreateContours::init(CServerParams *srvParam,CDataSource *dataSource, int nrOfBands){
+  this->srvParam = srvParam;
+  baseDataSource = dataSource;
+  JSONdata = "";
+  numFeatures = 0;
+  return 0;
+}
+
+int CCreateContours::addData(std::vector <CDataSource*> &dataSources){
+  CDataSource *dataSource = dataSources[0];
+  if(dataSource->dLayerType!=CConfigReaderLayerTypeDataBase){
+    CDBError("Contours are only available for database layers");
+    return 1;
+  }
+  for(int k=0;k<dataSource->getNumTimeSteps();k++){
+    dataSource->setTimeStep(k);
+    CT::string features;
+    if(makeFeatures(dataSource,features)!=0){
+      return 1;
+    }
+    if(features.length()>0){
+      if(numFeatures>0)JSONdata.concat(",");
+      JSONdata.concat(&features);
+      numFeatures++;
+    }
+  }
+  return 0;
+}
+
+CT::string CCreateContours::getLevelDefinition(CDataSource *dataSource){
+  CT::string definition;
+  CStyleConfiguration *styleConfiguration = dataSource->getStyle();
+  if(styleConfiguration == NULL)return definition;
+  if(styleConfiguration->contourLines!=NULL){
+    for(size_t j=0;j<styleConfiguration->contourLines->size();j++){
+      CServerConfig::XMLE_ContourLine *contourLine = (*styleConfiguration->contourLines)[j];
+      if(!contourLine->attr.classes.empty()){
+        definition.printconcat("classes(%s)",contourLine->attr.classes.c_str());
+      }else if(!contourLine->attr.interval.empty()&&contourLine->attr.interval.toDouble()>0){
+        definition.printconcat("interval(%s)",contourLine->attr.interval.c_str());
+      }
+    }
+  }
+  if(styleConfiguration->contourIntervalL>0)definition.printconcat("interval(%g)",styleConfiguration->contourIntervalL);
+  if(styleConfiguration->contourIntervalH>0)definition.printconcat("interval(%g)",styleConfiguration->contourIntervalH);
+  return definition;
+}
+
+void CCreateContours::getLevels(CDataSource *dataSource,const float *data,size_t size,std::vector<double> &levels){
+  CStyleConfiguration *styleConfiguration = dataSource->getStyle();
+  std::vector<double> intervals;
+  if(styleConfiguration->contourLines!=NULL){
+    for(size_t j=0;j<styleConfiguration->contourLines->size();j++){
+      CServerConfig::XMLE_ContourLine *contourLine = (*styleConfiguration->contourLines)[j];
+      if(!contourLine->attr.classes.empty()){
+        CT::string *classes = contourLine->attr.classes.splitToArray(",");
+        for(size_t c=0;c<classes->count;c++)levels.push_back(classes[c].toDouble());
+        delete[] classes;
+      }else if(!contourLine->attr.interval.empty()&&contourLine->attr.interval.toDouble()>0){
+        intervals.push_back(contourLine->attr.interval.toDouble());
+      }
+    }
+  }
+  if(styleConfiguration->contourIntervalL>0)intervals.push_back(styleConfiguration->contourIntervalL);
+  if(styleConfiguration->contourIntervalH>0)intervals.push_back(styleConfiguration->contourIntervalH);
+
+  if(intervals.size()>0){
+    float min = 0,max = 0;
+    bool first = true;
+    for(size_t j=0;j<size;j++){
+      float v = data[j];
+      if(v!=v)continue;
+      if(first){min = v;max = v;first = false;}
+      if(v<min)min = v;
+      if(v>max)max = v;
+    }
+    if(!first){
+      for(size_t j=0;j<intervals.size();j++){
+        double interval = intervals[j];
+        double start = ceil(min/interval);
+        double stop = floor(max/interval);
+        if(stop-start>=CCREATECONTOURS_MAXLEVELS){
+          CDBWarning("Interval %g gives too many contour levels, limited to %d",interval,CCREATECONTOURS_MAXLEVELS);
+          stop = start+CCREATECONTOURS_MAXLEVELS-1;
+        }
+        for(double i=start;i<=stop;i++)levels.push_back(i*interval);
+      }
+    }
+  }
+
+  //Levels which are defined more than once are extracted only once
+  std::sort(levels.begin(),levels.end());
+  levels.erase(std::unique(levels.begin(),levels.end()),levels.end());
+}
+
+CT::string CCreateContours::getCacheFileName(CDataSource *dataSource,const char *levelDefinition){
+  CT::string cacheFileName;
+  if(srvParam->cfg->TempDir.size()==0||srvParam->cfg->TempDir[0]->attr.value.empty()){
+    return cacheFileName;
+  }
+  /* Files which are overwritten get a new key */
+  struct stat stFileInfo;
+  long long modificationTime = 0;
+  if(stat(dataSource->getFileName(),&stFileInfo)==0)modificationTime = stFileInfo.st_mtime;
+
+  CT::string key;
+  key.print("%s_%lld_%s_%s_%s_%g",dataSource->getFileName(),modificationTime,dataSource->getDataObject(0)->variableName.c_str(),
+            levelDefinition,srvParam->Geo->CRS.c_str(),CCREATECONTOURS_SIMPLIFYTOLERANCE);
+  /* The requested dimension value can be a range or a list, the key uses the value and index of the current step */
+  for(size_t d=0;d<dataSource->requiredDims.size();d++){
+    key.printconcat("_%s=%s@%d",dataSource->requiredDims[d]->name.c_str(),dataSource->getDimensionValue(d).c_str(),int(dataSource->getDimensionIndex(d)));
+  }
+  unsigned long long hash = 14695981039346656037ULL;
+  for(size_t j=0;j<key.length();j++){
+    hash ^= (unsigned char)key.c_str()[j];
+    hash *= 1099511628211ULL;
+  }
+  cacheFileName.print("%s/contours_%016llx.json",srvParam->cfg->TempDir[0]->attr.value.c_str(),hash);
+  return cacheFileName;
+}
+
+int CCreateContours::makeFeatures(CDataSource *dataSource,CT::string &features){
+  CT::string levelDefinition = getLevelDefinition(dataSource);
+  if(levelDefinition.empty()){
+    CDBError("No ContourLine or ContourInterval defined for style of layer %s",dataSource->getLayerName());
+    return 1;
+  }
+
+  CT::string cacheFileName = getCacheFileName(dataSource,levelDefinition.c_str());
+  if(!cacheFileName.empty()){
+    struct stat stFileInfo;
+    if(stat(cacheFileName.c_str(),&stFileInfo)==0){
+      try{
+        features = CReadFile::open(cacheFileName.c_str());
+        #ifdef CCREATECONTOURS_DEBUG
+        CDBDebug("Contours read from %s",cacheFileName.c_str());
+        #endif
+        return 0;
+      }catch(int e){
+        CDBWarning("Unable to read contour cache %s",cacheFileName.c_str());
+      }
+    }
+  }
+
+  CDataReader reader;
+  int status = reader.open(dataSource,CNETCDFREADER_MODE_OPEN_ALL);
+  if(status!=0){
+    CDBError("Could not open file: %s",dataSource->getFileName());
+    return 1;
+  }
+  int width = dataSource->dWidth;
+  int height = dataSource->dHeight;
+  size_t size = size_t(width)*size_t(height);
+  std::vector<float> field(size);
+  CDF::DataCopier::copy(&field[0],dataSource->getDataObject(0)->cdfVariable->data,dataSource->getDataObject(0)->cdfVariable->getType(),size);
+  if(dataSource->getDataObject(0)->hasNodataValue){
+    float fNodataValue = (float)dataSource->getDataObject(0)->dfNodataValue;
+    for(size_t j=0;j<size;j++){
+      if(field[j]==fNodataValue)field[j]=NAN;
+    }
+  }
+
+  std::vector<double> levels;
+  getLevels(dataSource,&field[0],size,levels);
+  std::vector<std::vector<Line> > lines(levels.size());
+
+  /* The levels are independent, each thread takes the next level which is not done yet */
+  Job job;
+  job.data = &field[0];
+  job.width = width;
+  job.height = height;
+  job.levels = &levels;
+  job.result = &lines;
+  job.nextLevel = 0;
+  pthread_mutex_init(&job.mutex,NULL);
+  int numThreads = sysconf(_SC_NPROCESSORS_ONLN);
+  if(numThreads>CCREATECONTOURS_MAXTHREADS)numThreads = CCREATECONTOURS_MAXTHREADS;
+  if(numThreads>int(levels.size()))numThreads = levels.size();
+  if(numThreads<1)numThreads = 1;
+  std::vector<pthread_t> threads(numThreads);
+  int numStarted = 0;
+  for(int t=1;t<numThreads;t++){
+    if(pthread_create(&threads[t],NULL,extractThread,&job)!=0)break;
+    numStarted++;
+  }
+  extractThread(&job);
+  for(int t=1;t<=numStarted;t++){
+    pthread_join(threads[t],NULL);
+  }
+  pthread_mutex_destroy(&job.mutex);
+  #ifdef CCREATECONTOURS_DEBUG
+  CDBDebug("Extracted %d levels with %d threads",levels.size(),numStarted+1);
+  #endif
+
+  CImageWarper warper;
+  status = warper.initreproj(dataSource,srvParam->Geo,&srvParam->cfg->Projection);
+  if(status != 0){
+    CDBError("Unable to initialize projection");
+    return 1;
+  }
+  bool reproject = warper.isProjectionRequired();
+  double cellSizeX = (dataSource->dfBBOX[2]-dataSource->dfBBOX[0])/double(width);
+  double cellSizeY = (dataSource->dfBBOX[1]-dataSource->dfBBOX[3])/double(height);
+
+  CT::string dims;
+  for(size_t d=0;d<dataSource->requiredDims.size();d++){
+    if(d>0)dims.concat(",");
+    dims.printconcat("\"%s\":\"%s\"",dataSource->requiredDims[d]->name.c_str(),dataSource->getDimensionValue(d).c_str());
+  }
+
+  features = "";
+  int numLevelFeatures = 0;
+  for(size_t l=0;l<levels.size();l++){
+    if(lines[l].size()==0)continue;
+    if(numLevelFeatures>0)features.concat(",");
+    numLevelFeatures++;
+    features.printconcat("{\"type\":\"Feature\",\"properties\":{\"layer\":\"%s\",\"value\":%g,\"dims\":{%s}},",dataSource->getLayerName(),levels[l],dims.c_str());
+    features.concat("\"geometry\":{\"type\":\"MultiLineString\",\"coordinates\":[");
+    for(size_t j=0;j<lines[l].size();j++){
+      if(j>0)features.concat(",");
+      features.concat("[");
+      Line &line = lines[l][j];
+      for(size_t p=0;p<line.size();p++){
+        double x = dataSource->dfBBOX[0]+(double(line[p].x)+0.5)*cellSizeX;
+        double y = dataSource->dfBBOX[3]+(double(line[p].y)+0.5)*cellSizeY;
+        if(reproject)warper.reprojpoint_inv(x,y);
+        if(p>0)features.concat(",");
+        features.printconcat("[%.8g,%.8g]",x,y);
+      }
+      features.concat("]");
+    }
+    features.concat("]}}");
+  }
+  warper.closereproj();
+  reader.close();
+
+  if(!cacheFileName.empty()){
+    /* Written to a temporary file first, so concurrent requests never read a partial result */
+    CT::string tempFileName;
+    tempFileName.print("%s.%d",cacheFileName.c_str(),getpid());
+    try{
+      CReadFile::write(tempFileName.c_str(),features.c_str(),features.length());
+      if(rename(tempFileName.c_str(),cacheFileName.c_str())!=0)throw(__LINE__);
+    }catch(int e){
+      CDBWarning("Unable to write contour cache %s",cacheFileName.c_str());
+      unlink(tempFileName.c_str());
+    }
+  }
+  return 0;
+}
+
+void *CCreateContours::extractThread(void *arg){
+  Job *job = (Job*)arg;
+  while(true){
+    pthread_mutex_lock(&job->mutex);
+    size_t level = job->nextLevel++;
+    pthread_mutex_unlock(&job->mutex);
+    if(level>=job->levels->size())break;
+    extractLevel(job->data,job->width,job->height,(*job->levels)[level],(*job->result)[level]);
+  }
+  return NULL;
+}
+
+void CCreateContours::extractLevel(const float *data,int width,int height,double level,std::vector<Line> &lines){
+  /* A point on a cell edge, with the (at most two) other edge points it is connected to. Horizontal edge (i,j)-(i+1,j)
+   * has id 2*(j*width+i), vertical edge (i,j)-(i,j+1) has id 2*(j*width+i)+1 */
+  class EdgePoint{
+  public:
+    float x,y;
+    size_t link[2];
+    int numLinks;
+    bool visited;
+  };
+  std::map<size_t,EdgePoint> edgePoints;
+  float fLevel = (float)level;
+
+  for(int j=0;j<height-1;j++){
+    for(int i=0;i<width-1;i++){
+      size_t p = size_t(j)*width+i;
+      float v[4] = {data[p],data[p+1],data[p+1+width],data[p+width]};
+      if(v[0]!=v[0]||v[1]!=v[1]||v[2]!=v[2]||v[3]!=v[3])continue;
+      int code = (v[0]>=fLevel?1:0)|(v[1]>=fLevel?2:0)|(v[2]>=fLevel?4:0)|(v[3]>=fLevel?8:0);
+      if(code==0||code==15)continue;
+      int segmentCode = code;
+      if(code==5||code==10){
+        float center = (v[0]+v[1]+v[2]+v[3])/4;
+        if(center>=fLevel)segmentCode = code==5?10:5;
+      }
+      const int *segments = segmentTable[segmentCode];
+      for(int s=0;segments[s]!=-1;s+=2){
+        size_t ids[2];
+        for(int e=0;e<2;e++){
+          int edge = segments[s+e];
+          size_t id;float x,y,a,b;
+          switch(edge){
+            case CCREATECONTOURS_EDGE_TOP:    id = 2*p;           a=v[0];b=v[1];break;
+            case CCREATECONTOURS_EDGE_RIGHT:  id = 2*(p+1)+1;     a=v[1];b=v[2];break;
+            case CCREATECONTOURS_EDGE_BOTTOM: id = 2*(p+width);   a=v[3];b=v[2];break;
+            default:                          id = 2*p+1;         a=v[0];b=v[3];break;
+          }
+          float t = b!=a?(fLevel-a)/(b-a):0.5f;
+          if(edge==CCREATECONTOURS_EDGE_TOP||edge==CCREATECONTOURS_EDGE_BOTTOM){
+            x = i+t;y = edge==CCREATECONTOURS_EDGE_TOP?j:j+1;
+          }else{
+            x = edge==CCREATECONTOURS_EDGE_LEFT?i:i+1;y = j+t;
+          }
+          std::map<size_t,EdgePoint>::iterator it = edgePoints.find(id);
+          if(it == edgePoints.end()){
+            EdgePoint edgePoint;
+            edgePoint.x = x;edgePoint.y = y;edgePoint.numLinks = 0;edgePoint.visited = false;
+            edgePoints[id] = edgePoint;
+          }
+          ids[e] = id;
+        }
+        EdgePoint &first = edgePoints[ids[0]];
+        if(first.numLinks<2)first.link[first.numLinks++] = ids[1];
+        EdgePoint &second = edgePoints[ids[1]];
+        if(second.numLinks<2)second.link[second.numLinks++] = ids[0];
+      }
+    }
+  }
+
+  /* Open lines start at points with one link, the remaining points form closed rings */
+  for(int pass=0;pass<2;pass++){
+    for(std::map<size_t,EdgePoint>::iterator it=edgePoints.begin();it!=edgePoints.end();++it){
+      if(it->second.visited)continue;
+      if(pass==0&&it->second.numLinks!=1)continue;
+      Line line;
+      size_t previous = CCREATECONTOURS_NOEDGE;
+      size_t current = it->first;
+      while(current!=CCREATECONTOURS_NOEDGE){
+        EdgePoint &edgePoint = edgePoints[current];
+        line.push_back(Point(edgePoint.x,edgePoint.y));
+        //Back at the start of a ring
+        if(edgePoint.visited)break;
+        edgePoint.visited = true;
+        size_t next = CCREATECONTOURS_NOEDGE;
+        for(int l=0;l<edgePoint.numLinks;l++){
+          if(edgePoint.link[l]!=previous){next = edgePoint.link[l];break;}
+        }
+        previous = current;
+        current = next;
+      }
+      //Rings around a single point are left out
+      if(line.size()<2||(line.size()==2&&line[0].x==line[1].x&&line[0].y==line[1].y))continue;
+      Line simplified;
+      simplify(line,CCREATECONTOURS_SIMPLIFYTOLERANCE,simplified);
+      lines.push_back(simplified);
+    }
+  }
+}
+
+void CCreateContours::simplify(const Line &line,double tolerance,Line &result){
+  if(line.size()<3){
+    result = line;
+    return;
+  }
+  std::vector<bool> keep(line.size(),false);
+  keep[0] = true;
+  keep[line.size()-1] = true;
+  simplifyRange(line,0,line.size()-1,tolerance,keep);
+  for(size_t j=0;j<line.size();j++){
+    if(keep[j])result.push_back(line[j]);
+  }
+}
+
+void CCreateContours::simplifyRange(const Line &line,size_t first,size_t last,double tolerance,std::vector<bool> &keep){
+  if(last<=first+1)return;
+  double dx = line[last].x-line[first].x;
+  double dy = line[last].y-line[first].y;
+  double length = sqrt(dx*dx+dy*dy);
+  double maxDistance = -1;
+  size_t farthest = first;
+  for(size_t j=first+1;j<last;j++){
+    double px = line[j].x-line[first].x;
+    double py = line[j].y-line[first].y;
+    /* Distance to the segment, or to the first point for closed rings */
+    double distance = length>0?fabs(px*dy-py*dx)/length:sqrt(px*px+py*py);
+    if(distance>maxDistance){
+      maxDistance = distance;
+      farthest = j;
+    }
+  }
+  if(maxDistance>tolerance){
+    keep[farthest] = true;
+    simplifyRange(line,first,farthest,tolerance,keep);
+    simplifyRange(line,farthest,last,tolerance,keep);
+  }
+}
+
+int CCreateContours::end(){
+  if (srvParam->JSONP.length()==0) {
+    CTracer::printServerTimingHeader();
+    printf("%s%c%c\n","Content-Type: application/json",13,10);
+  } else {
+    CTracer::printServerTimingHeader();
+    printf("%s%c%c\n%s(","Content-Type: application/javascript",13,10,srvParam->JSONP.c_str());
+  }
+  printf("{\"type\":\"FeatureCollection\",\"features\":[");
+  fwrite(JSONdata.c_str(),1,JSONdata.length(),stdout);
+  printf("]}");
+  if (srvParam->JSONP.length()!=0) {
+    printf(");");
+  }
+  resetErrors();
+  return 0;
+}
@@ -0,0 +1,108 @@
+/******************************************************************************
+ *
+ * Project:  ADAGUC Server
+ * Purpose:  Extracts contour lines from the native grid and writes them as GeoJSON
+ * Date:     2026-10-18
+ *
+ ******************************************************************************
+ *
+ * Copyright 2026, Royal Netherlands Meteorological Institute (KNMI)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ******************************************************************************/
+
+#ifndef CCreateContours_H
+#define CCreateContours_H
+
+#include <vector>
+#include "Definitions.h"
+#include "CDataSource.h"
+#include "CImageWarper.h"
+#include "CIBaseDataWriterInterface.h"
+#include "CDebugger.h"
+
+/* Maximum number of contour levels for a field, protects against very small intervals */
+#define CCREATECONTOURS_MAXLEVELS         1000
+
+/* Maximum number of threads, the levels are divided over the threads */
+#define CCREATECONTOURS_MAXTHREADS        8
+
+/* Douglas-Peucker tolerance, in grid cells */
+#define CCREATECONTOURS_SIMPLIFYTOLERANCE 0.2
+
+/**
+ * WMS GetContours request: returns the contour lines of a layer as a GeoJSON FeatureCollection, with one
+ * MultiLineString feature per contour level and time step, in the coordinates of the requested CRS.
+ *
+ * The levels are taken from the ContourLine elements (classes or interval) and ContourIntervalL/H of the style.
+ * The lines are extracted with marching squares from the native grid, so they do not depend on the requested
+ * BBOX or size and only need to be calculated once per field. The levels are divided over multiple threads. The
+ * result of each field is cached in the TempDir, keyed by file, modification time, dimensions, levels and CRS.
+ *
+ * Example: SERVICE=WMS&REQUEST=GetContours&LAYERS=temperature&STYLES=temperature/contour&CRS=EPSG:4326&TIME=...
+ */
+class CCreateContours: public CBaseDataWriterInterface{
+private:
+  DEF_ERRORFUNCTION();
+  class Point{
+  public:
+    Point(float x,float y){this->x=x;this->y=y;}
+    float x,y;
+  };
+  typedef std::vector<Point> Line;
+
+  class Job{
+  public:
+    const float *data;
+    int width,height;
+    const std::vector<double> *levels;
+    std::vector<std::vector<Line> > *result;
+    size_t nextLevel;
+    pthread_mutex_t mutex;
+  };
+
+  CServerParams *srvParam;
+  CDataSource *baseDataSource;
+  CT::string JSONdata;
+  int numFeatures;
+
+  static void *extractThread(void *arg);
+
+  /**
+   * Marching squares for one level, joins the segments of neighbouring cells into lines
+   * @param data The field, NaN for nodata
+   * @param lines The lines in grid coordinates, x and y are the column and row of the cell centers
+   */
+  static void extractLevel(const float *data,int width,int height,double level,std::vector<Line> &lines);
+  static void simplify(const Line &line,double tolerance,Line &result);
+  static void simplifyRange(const Line &line,size_t first,size_t last,double tolerance,std::vector<bool> &keep);
+
+  /**
+   * Returns the contour definitions of the style as string, empty when the style has no contours
+   */
+  static CT::string getLevelDefinition(CDataSource *dataSource);
+  static void getLevels(CDataSource *dataSource,const float *data,size_t size,std::vector<double> &levels);
+  int makeFeatures(CDataSource *dataSource,CT::string &features);
+  CT::string getCacheFileName(CDataSource *dataSource,const char *levelDefinition);
+public:
+  CCreateContours();
+  virtual ~CCreateContours(){};
+
+  // Virtual functions
+  int init(CServerParams *srvParam,CDataSource *dataSource, int nrOfBands);
+  int addData(std::vector <CDataSource*> &dataSources);
+  int end();
+};
+
+#endif
@@ -1,5 +1,7 @@
 #include "CCreateHistogram.h"
 #include "CGenericDataWarper.h"
+#include "CFieldStatistics.h"
+#include "CTracer.h"
 const char * CCreateHistogram::className = "CCreateHistogram";
 
 int CCreateHistogram::createHistogram(CDataSource *dataSource,CDrawImage *legendImage){
@@ -10,9 +12,11 @@ int CCreateHistogram::createHistogram(CDataSource *dataSource,CDrawImage *legend
   CT::string resultJSON;
   if (dataSource->srvParams->JSONP.length()==0) {
     CDBDebug("CREATING JSON");
+    CTracer::printServerTimingHeader();
     printf("%s%c%c\n","Content-Type: application/json",13,10);
   } else {
     CDBDebug("CREATING JSONP %s",dataSource->srvParams->JSONP.c_str() );
+    CTracer::printServerTimingHeader();
     printf("%s%c%c\n%s(","Content-Type: application/javascript",13,10,dataSource->srvParams->JSONP.c_str());
   }
   
@@ -139,13 +143,16 @@ int CCreateHistogram::addData(std::vector <CDataSource*> &dataSources){
       reader.close();
       CDBDebug("Addata finished, data warped");
       
+      //The statistics of the whole field are taken from the scanner when available
+      CFieldStatistics fieldStatistics;
+      bool hasFieldStatistics = fieldStatistics.load(dataSource)==0;
+      
       if(dataSource->statistics==NULL){
         dataSource->statistics = new CDataSource::Statistics();
-        dataSource->statistics->calculate(dataSource);
         dataSource->statistics->calculate(dataSource->srvParams->Geo->dWidth*dataSource->srvParams->Geo->dHeight,(float*)warpedData,CDF_FLOAT,dataSource->getDataObject(0)->dfNodataValue,dataSource->getDataObject(0)->hasNodataValue);
       }
-      float fieldMin=(float)dataSource->statistics->getMinimum();
-      float fieldMax=(float)dataSource->statistics->getMaximum();
+      float fieldMin=hasFieldStatistics?(float)fieldStatistics.min:(float)dataSource->statistics->getMinimum();
+      float fieldMax=hasFieldStatistics?(float)fieldStatistics.max:(float)dataSource->statistics->getMaximum();
       
       
       
@@ -218,6 +225,20 @@ int CCreateHistogram::addData(std::vector <CDataSource*> &dataSources){
       JSONdata.printconcat("\"fieldmin\":%f,", fieldMin);
       JSONdata.printconcat("\"fieldmax\":%f,", fieldMax);
       
+      if(hasFieldStatistics){
+        JSONdata.printconcat("\"fieldaverage\":%f,",fieldStatistics.avg);
+        JSONdata.printconcat("\"fieldstddev\":%f,",fieldStatistics.stddev);
+        JSONdata.printconcat("\"fieldpercentiles\":{");
+        for(size_t j=0;j<fieldStatistics.percentiles.size();j++){
+          if(j>0){
+            JSONdata.concat(",");
+          }
+          JSONdata.printconcat("\"%g\":%f",CFieldStatistics::percentileLevels[j],fieldStatistics.percentiles[j]);
+        }
+        JSONdata.concat("},");
+        JSONdata.printconcat("\"fieldhistogram\":[%s],",fieldStatistics.getHistogramAsString().c_str());
+      }
+      
       //Print interval
       JSONdata.printconcat("\"interval\":[");
       for(int j=0;j<numBins;j++){
@@ -261,9 +282,11 @@ int CCreateHistogram::end(){
   CT::string resultJSON;
   if (baseDataSource->srvParams->JSONP.length()==0) {
     CDBDebug("CREATING JSON");
+    CTracer::printServerTimingHeader();
     printf("%s%c%c\n","Content-Type: application/json",13,10);
   } else {
     CDBDebug("CREATING JSONP %s",baseDataSource->srvParams->JSONP.c_str() );
+    CTracer::printServerTimingHeader();
     printf("%s%c%c\n%s(","Content-Type: application/javascript",13,10,baseDataSource->srvParams->JSONP.c_str());
   }
   
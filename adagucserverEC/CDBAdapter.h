@@ -72,6 +72,11 @@ public:
   virtual int              storeDimensionInfoForLayerTableAndLayerName(const char *layertable,const char *layername,const char *netcdfname,const char *ogcname,const char *units) = 0;
   virtual int              removeDimensionInfoForLayerTableAndLayerName(const char *layertable,const char *layername) = 0;
   
+  /*Field statistics, calculated by the scanner per file, variable and index of the non spatial dimensions*/
+  virtual CDBStore::Store *getFieldStatistics(const char *file,const char *variable,const char *fieldindex) = 0;
+  virtual int              storeFieldStatistics(const char *file,const char *variable,const char *fieldindex,double min,double max,double avg,double stddev,const char *percentiles,const char *histogram) = 0;
+  virtual int              removeFieldStatistics(const char *file) = 0;
+  
   virtual CDBStore::Store *getFilesAndIndicesForDimensions(CDataSource *dataSource,int limit) = 0;
   virtual CDBStore::Store *getFilesForIndices(CDataSource *dataSource,size_t *start,size_t *count,ptrdiff_t *stride,int limit) = 0;
   
@@ -981,6 +981,21 @@ int CDBAdapterMongoDB::removeDimensionInfoForLayerTableAndLayerName(const char *
   CDBError("CDBAdapterMongoDB::removeDimensionInfoForLayerTableAndLayerName is not YET implemented !!!!");
   throw(-1);
 }
+
+
+CDBStore::Store *CDBAdapterMongoDB::getFieldStatistics(const char *file,const char *variable,const char *fieldindex) {
+  /* Field statistics are not stored in MongoDB, they are calculated while reading instead. */
+  return NULL;
+}
+
+int CDBAdapterMongoDB::storeFieldStatistics(const char *file,const char *variable,const char *fieldindex,double min,double max,double avg,double stddev,const char *percentiles,const char *histogram) {
+  /* Nothing is stored, like getFieldStatistics finds nothing. Called for every field of every scanned file, so it does not log. */
+  return 0;
+}
+
+int CDBAdapterMongoDB::removeFieldStatistics(const char *file) {
+  return 0;
+}
     
 /* Not used anymore? */
 int CDBAdapterMongoDB::dropTable(const char *tablename) {
@@ -162,6 +162,9 @@ class CDBAdapterMongoDB:public CDBAdapter{
    
     //TODO IMPLEMENT THIS METHOD!!!
     int              removeDimensionInfoForLayerTableAndLayerName(const char *layertable,const char *layername);
+    CDBStore::Store *getFieldStatistics(const char *file,const char *variable,const char *fieldindex);
+    int              storeFieldStatistics(const char *file,const char *variable,const char *fieldindex,double min,double max,double avg,double stddev,const char *percentiles,const char *histogram);
+    int              removeFieldStatistics(const char *file);
     
     int              dropTable(const char *tablename);
     int              createDimTableInt(const char *dimname,const char *tablename);
@@ -819,6 +819,41 @@ int CDBAdapterPostgreSQL::removeDimensionInfoForLayerTableAndLayerName(const cha
 }
 
 
+CDBStore::Store *CDBAdapterPostgreSQL::getFieldStatistics(const char *file,const char *variable,const char *fieldindex){
+  CPGSQLDB * dataBaseConnection = getDataBaseConnection(); if(dataBaseConnection == NULL){return NULL;  }
+  CT::string query;
+  query.print("SELECT fieldmin,fieldmax,fieldavg,fieldstddev,percentiles,histogram FROM field_statistics where path=E'%s' and variable=E'%s' and fieldindex=E'%s'",file,variable,fieldindex);
+  return dataBaseConnection->queryToStore(query.c_str());
+}
+
+int CDBAdapterPostgreSQL::storeFieldStatistics(const char *file,const char *variable,const char *fieldindex,double min,double max,double avg,double stddev,const char *percentiles,const char *histogram){
+  CPGSQLDB * dataBaseConnection = getDataBaseConnection(); if(dataBaseConnection == NULL){return -1;  }
+  CT::string tableColumns("path varchar (511), variable varchar (255), fieldindex varchar (255)");
+  tableColumns.concat(", fieldmin double precision, fieldmax double precision, fieldavg double precision, fieldstddev double precision");
+  tableColumns.concat(", percentiles varchar (1023), histogram text, PRIMARY KEY (path, variable, fieldindex)");
+  int status = dataBaseConnection->checkTable("field_statistics",tableColumns.c_str());
+  if(status == 1){CDBError("\nFAIL: Table field_statistics could not be created: %s",tableColumns.c_str()); return 1;  }
+  
+  CT::string query;
+  query.print("DELETE FROM field_statistics where path=E'%s' and variable=E'%s' and fieldindex=E'%s'",file,variable,fieldindex);
+  dataBaseConnection->query(query.c_str());
+  query.print("INSERT INTO field_statistics values (E'%s',E'%s',E'%s',%.17g,%.17g,%.17g,%.17g,E'%s',E'%s')",file,variable,fieldindex,min,max,avg,stddev,percentiles,histogram);
+  status = dataBaseConnection->query(query.c_str()); 
+  if(status!=0){
+    CDBError("Unable to insert records: \"%s\"",query.c_str());
+    return 1;
+  }
+  return 0;
+}
+
+int CDBAdapterPostgreSQL::removeFieldStatistics(const char *file){
+  CPGSQLDB * dataBaseConnection = getDataBaseConnection(); if(dataBaseConnection == NULL){return -1;  }
+  CT::string query;
+  query.print("DELETE FROM field_statistics where path=E'%s'",file);
+  return dataBaseConnection->query(query.c_str()); 
+}
+
+
 int CDBAdapterPostgreSQL::dropTable(const char *tablename){
   #ifdef MEASURETIME
   StopWatch_Stop(">CDBAdapterPostgreSQL::dropTable");
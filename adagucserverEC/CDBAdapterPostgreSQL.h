@@ -56,6 +56,9 @@ class CDBAdapterPostgreSQL:public CDBAdapter{
     CDBStore::Store *getDimensionInfoForLayerTableAndLayerName(const char *layertable,const char *layername);
     int              storeDimensionInfoForLayerTableAndLayerName(const char *layertable,const char *layername,const char *netcdfname,const char *ogcname,const char *units);
     int              removeDimensionInfoForLayerTableAndLayerName(const char *layertable,const char *layername);
+    CDBStore::Store *getFieldStatistics(const char *file,const char *variable,const char *fieldindex);
+    int              storeFieldStatistics(const char *file,const char *variable,const char *fieldindex,double min,double max,double avg,double stddev,const char *percentiles,const char *histogram);
+    int              removeFieldStatistics(const char *file);
      
     int              dropTable(const char *tablename);
     int              createDimTableInt(const char *dimname,const char *tablename);
@@ -948,6 +948,41 @@ int CDBAdapterSQLLite::removeDimensionInfoForLayerTableAndLayerName(const char *
   return status;
 }
 
+
+CDBStore::Store *CDBAdapterSQLLite::getFieldStatistics(const char *file,const char *variable,const char *fieldindex){
+  CSQLLiteDB * dataBaseConnection = getDataBaseConnection(); if(dataBaseConnection == NULL){return NULL;  }
+  CT::string query;
+  query.print("SELECT fieldmin,fieldmax,fieldavg,fieldstddev,percentiles,histogram FROM field_statistics where path='%s' and variable='%s' and fieldindex='%s'",file,variable,fieldindex);
+  return dataBaseConnection->queryToStore(query.c_str());
+}
+
+int CDBAdapterSQLLite::storeFieldStatistics(const char *file,const char *variable,const char *fieldindex,double min,double max,double avg,double stddev,const char *percentiles,const char *histogram){
+  CSQLLiteDB * dataBaseConnection = getDataBaseConnection(); if(dataBaseConnection == NULL){return -1;  }
+  CT::string tableColumns("path varchar (511), variable varchar (255), fieldindex varchar (255)");
+  tableColumns.concat(", fieldmin real, fieldmax real, fieldavg real, fieldstddev real");
+  tableColumns.concat(", percentiles varchar (1023), histogram text, PRIMARY KEY (path, variable, fieldindex)");
+  int status = dataBaseConnection->checkTable("field_statistics",tableColumns.c_str());
+  if(status == 1){CDBError("\nFAIL: Table field_statistics could not be created: %s",tableColumns.c_str()); return 1;  }
+  
+  CT::string query;
+  query.print("DELETE FROM field_statistics where path='%s' and variable='%s' and fieldindex='%s'",file,variable,fieldindex);
+  dataBaseConnection->query(query.c_str());
+  query.print("INSERT INTO field_statistics values ('%s','%s','%s',%.17g,%.17g,%.17g,%.17g,'%s','%s')",file,variable,fieldindex,min,max,avg,stddev,percentiles,histogram);
+  status = dataBaseConnection->query(query.c_str()); 
+  if(status!=0){
+    CDBError("Unable to insert records: \"%s\"",query.c_str());
+    return 1;
+  }
+  return 0;
+}
+
+int CDBAdapterSQLLite::removeFieldStatistics(const char *file){
+  CSQLLiteDB * dataBaseConnection = getDataBaseConnection(); if(dataBaseConnection == NULL){return -1;  }
+  CT::string query;
+  query.print("DELETE FROM field_statistics where path='%s'",file);
+  return dataBaseConnection->query(query.c_str()); 
+}
+
 int CDBAdapterSQLLite::dropTable(const char *tablename){
   CSQLLiteDB * dataBaseConnection = getDataBaseConnection(); if(dataBaseConnection == NULL){return -1;  }
   
@@ -28,6 +28,9 @@
 #include "CDebugger.h"
 #include "adagucserver.h"
 #include "CNetCDFDataWriter.h"
+#include "CTimeSeriesStore.h"
+#include "CFieldStatistics.h"
+#include "CWarmUp.h"
 #include <set>
 const char *CDBFileScanner::className="CDBFileScanner";
 std::vector <CT::string> CDBFileScanner::tableNamesDone;
@@ -707,6 +710,13 @@ int CDBFileScanner::DBLoopFiles(CDataSource *dataSource,int removeNonExistingFil
                       
                       bool dimIsUnique = true;
                       
+                      //Time values are converted all at once
+                      std::vector<CT::string> isoTimeStrings;
+                      if(isTimeDim[d]&&dimVar->getType()!=CDF_STRING&&dimDim->length>0){
+                        isoTimeStrings.resize(dimDim->length);
+                        adagucTime.offsetsToISOStrings(dimValues,dimDim->length,&isoTimeStrings[0]);
+                      }
+                      
                       CT::string uniqueKey;
                       for(size_t i=0;i<dimDim->length;i++){
                         
@@ -752,15 +762,13 @@ int CDBFileScanner::DBLoopFiles(CDataSource *dataSource,int removeNonExistingFil
                               
                               //ADTime->PrintISOTime(ISOTime,ISO8601TIME_LEN,dimValues[i]);status = 0;//TODO make PrintISOTime return a 0 if succeeded
                               
-                              try{
-                                uniqueKey = adagucTime.dateToISOString(adagucTime.getDate(dimValues[i]));
+                              if(isoTimeStrings[i].length()>=19){
+                                uniqueKey = isoTimeStrings[i].c_str();
                                 uniqueKey.setSize(19);
                                 uniqueKey.concat("Z");
                                 dbAdapter->setFileTimeStamp(tableNames[d].c_str(),dirReader->fileList[j]->fullName.c_str(),uniqueKey.c_str(),int(i),fileDate.c_str(),&geoOptions) ;
-                                
-                          
-                              }catch(int e){
-                                CDBDebug("Exception occurred during time conversion: %d",e);
+                              }else{
+                                CDBDebug("Exception occurred during time conversion of value %f",dimValues[i]);
                               }
                               
                             }
@@ -802,6 +810,14 @@ int CDBFileScanner::DBLoopFiles(CDataSource *dataSource,int removeNonExistingFil
                     throw(exceptionAtLineNr);
                   }
                 }
+                
+                //Statistics are calculated once per file
+                if(d==0){
+                  if(CFieldStatistics::scanFile(dataSource,dirReader->fileList[j]->fullName.c_str())!=0){
+                    CDBWarning("Unable to calculate field statistics for %s",dirReader->fileList[j]->fullName.c_str());
+                  }
+                  CWarmUp::addFile(dataSource,dirReader->fileList[j]->fullName.c_str());
+                }
               
               //delete cdfObject;cdfObject=NULL;
               //cdfObject=CDFObjectStore::getCDFObjectStore()->deleteCDFObject(&cdfObject);
@@ -840,6 +856,7 @@ int CDBFileScanner::DBLoopFiles(CDataSource *dataSource,int removeNonExistingFil
             CDBError("No files found for %s ",dataSource->layerName.c_str());
           }else{
             CDBDebug("The database contains %d files",values->getSize());
+            std::vector<CT::string> removedFiles;
             for(size_t j=0;j<values->getSize();j++){
               bool found = false;
               for(size_t i=0;i<dirReader->fileList.size();i++){
@@ -852,8 +869,15 @@ int CDBFileScanner::DBLoopFiles(CDataSource *dataSource,int removeNonExistingFil
               if(found == false){
                 CDBDebug("Deleting file %s from db",values->getRecord(j)->get(0)->c_str());
                 CDBFactory::getDBAdapter(dataSource->srvParams->cfg)->removeFile(tableNames[d].c_str(),values->getRecord(j)->get(0)->c_str());
+                if(d==0){
+                  CFieldStatistics::removeFile(dataSource,values->getRecord(j)->get(0)->c_str());
+                  removedFiles.push_back(values->getRecord(j)->get(0)->c_str());
+                }
               }
             }
+            if(CTimeSeriesStore::removeFiles(dataSource,removedFiles)!=0){
+              CDBWarning("Unable to remove files from time series store for layer %s",dataSource->cfgLayer->Name[0]->value.c_str());
+            }
           }
           
           
@@ -986,6 +1010,14 @@ int CDBFileScanner::updatedb( CDataSource *dataSource,CT::string *_tailPath,CT::
       status = DBLoopFiles(dataSource,removeNonExistingFiles,&dirReader,scanFlags);
       if(status != 0 )throw(__LINE__);
     }
+    
+    //Append new files to the time series store of this layer, if configured
+    if(CTimeSeriesStore::update(dataSource,&dirReader)!=0){
+      CDBWarning("Unable to update time series store for layer %s",dataSource->cfgLayer->Name[0]->value.c_str());
+    }
+    
+    //Render the configured tiles with the new data
+    CWarmUp::enqueue(dataSource);
   }
   catch(int linenr){
     CDBError("Exception in updatedb at line %d",linenr);
@@ -1009,6 +1041,85 @@ int CDBFileScanner::updatedb( CDataSource *dataSource,CT::string *_tailPath,CT::
   return 0;
 }
 
+int CDBFileScanner::updateFiles(CDataSource *dataSource,std::vector<CT::string> &fileNames,int scanFlags){
+  if(dataSource->dLayerType!=CConfigReaderLayerTypeDataBase&&
+    dataSource->dLayerType!=CConfigReaderLayerTypeBaseLayer
+  )return 0;
+  if(fileNames.size()==0)return 0;
+  
+  CCache::Lock lock;
+  CT::string identifier = "updatedb";  identifier.concat(dataSource->cfgLayer->FilePath[0]->value.c_str());  identifier.concat("/");  identifier.concat(dataSource->cfgLayer->FilePath[0]->attr.filter.c_str());  
+  CT::string cacheDirectory = dataSource->srvParams->cfg->TempDir[0]->attr.value.c_str();
+  if(cacheDirectory.length()>0){
+    lock.claim(cacheDirectory.c_str(),identifier.c_str(),"updatedb",dataSource->srvParams->isAutoResourceEnabled());
+  }
+  
+  CDirReader dirReader;
+  std::vector<CT::string> removedFiles;
+  for(size_t j=0;j<fileNames.size();j++){
+    struct stat stFileInfo;
+    if(stat(fileNames[j].c_str(),&stFileInfo)==0&&S_ISREG(stFileInfo.st_mode)){
+      //The modification date is remembered by CDirReader, but the file has changed
+      CDirReader::forgetFileDate(fileNames[j].c_str());
+      CFileObject * fileObject = new CFileObject();
+      fileObject->fullName.copy(&fileNames[j]);
+      fileObject->baseName.copy(&fileNames[j]);
+      fileObject->isDir=false;
+      dirReader.fileList.push_back(fileObject);
+    }else{
+      removedFiles.push_back(fileNames[j]);
+    }
+  }
+  
+  CDBDebug("*** Updating layer '%s' with %d changed and %d removed file(s) ***",dataSource->cfgLayer->Name[0]->value.c_str(),int(dirReader.fileList.size()),int(removedFiles.size()));
+  
+  try{
+    if(dirReader.fileList.size()>0){
+      int removeNonExistingFiles = 0;
+      int status = createDBUpdateTables(dataSource,removeNonExistingFiles,&dirReader);
+      if(status > 0 )throw(__LINE__);
+      if(status == 0){
+        status = DBLoopFiles(dataSource,removeNonExistingFiles,&dirReader,scanFlags);
+        if(status != 0 )throw(__LINE__);
+      }
+      if(CTimeSeriesStore::update(dataSource,&dirReader)!=0){
+        CDBWarning("Unable to update time series store for layer %s",dataSource->cfgLayer->Name[0]->value.c_str());
+      }
+      CWarmUp::enqueue(dataSource);
+    }
+    
+    //Without configured dimensions there are no tables yet, so there is nothing to remove
+    if(removedFiles.size()>0){
+      CDBAdapter * dbAdapter = CDBFactory::getDBAdapter(dataSource->srvParams->cfg);
+      for(size_t d=0;d<dataSource->cfgLayer->Dimension.size();d++){
+        CT::string tableName;
+        try{
+          tableName = dbAdapter->getTableNameForPathFilterAndDimension(dataSource->cfgLayer->FilePath[0]->value.c_str(),dataSource->cfgLayer->FilePath[0]->attr.filter.c_str(), dataSource->cfgLayer->Dimension[d]->attr.name.c_str(),dataSource);
+        }catch(int e){
+          CDBError("Unable to create tableName from '%s' '%s' '%s'",dataSource->cfgLayer->FilePath[0]->value.c_str(),dataSource->cfgLayer->FilePath[0]->attr.filter.c_str(), dataSource->cfgLayer->Dimension[d]->attr.name.c_str());
+          throw(__LINE__);
+        }
+        for(size_t j=0;j<removedFiles.size();j++){
+          CDBDebug("Deleting file %s from db",removedFiles[j].c_str());
+          dbAdapter->removeFile(tableName.c_str(),removedFiles[j].c_str());
+        }
+      }
+      for(size_t j=0;j<removedFiles.size();j++){
+        CFieldStatistics::removeFile(dataSource,removedFiles[j].c_str());
+      }
+      if(CTimeSeriesStore::removeFiles(dataSource,removedFiles)!=0){
+        CDBWarning("Unable to remove files from time series store for layer %s",dataSource->cfgLayer->Name[0]->value.c_str());
+      }
+    }
+  }catch(int linenr){
+    CDBError("Exception in updateFiles at line %d",linenr);
+    return 1;
+  }
+  
+  lock.release();
+  return 0;
+}
+
 //TODO READ FILE FROM DB!
 int CDBFileScanner::searchFileNames(CDirReader *dirReader,const char * path,CT::string expr,const char *tailPath){
   #ifdef CDBFILESCANNER_DEBUG
@@ -1149,6 +1260,16 @@ int CDBFileScanner::createTiles( CDataSource *dataSource,int scanFlags){
   
   double tileBBOXWidth  = fabs(tilecellsizex*double(tilewidthpx));
   double tileBBOXHeight = fabs(tilecellsizey*double(tileheightpx));
+  
+  /* Tiles are read as a whole when rendering, so by default each field of a tile is one chunk */
+  CDFNetCDFWriter::OutputProfile tileOutputProfile;
+  tileOutputProfile.chunking = CDFNETCDFWRITER_CHUNKING_SPATIAL;
+  tileOutputProfile.chunkSize = tilewidthpx>tileheightpx?tilewidthpx:tileheightpx;
+  if(ts->attr.outputprofile.empty()==false){
+    if(CNetCDFDataWriter::getOutputProfile(dataSource->srvParams->cfg,ts->attr.outputprofile.c_str(),tileOutputProfile)!=0){
+      return 1;
+    }
+  }
 
 
   CDBDebug("tilecellsizexy     : [%f,%f]",tilecellsizex,tilecellsizey);
@@ -1419,6 +1540,7 @@ int CDBFileScanner::createTiles( CDataSource *dataSource,int scanFlags){
                       if(tilemode.equals("avg_rgba")){
                         wcsWriter->setInterpolationMode(CNetCDFDataWriter_AVG_RGB);
                       }
+                      wcsWriter->setOutputProfile(tileOutputProfile);
                       try{
                         newSrvParams.Geo->dWidth=(tilewidthpx);
                         newSrvParams.Geo->dHeight=(tileheightpx);
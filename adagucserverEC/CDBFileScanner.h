@@ -73,6 +73,15 @@ public:
    */
   static int updatedb(CDataSource *dataSource,CT::string *tailPath,CT::string *_layerPathToScan,int scanFlags);
   
+  /**
+   * Updates the database for a list of changed files of a datasource, without listing directories.
+   * Files which exist are added or updated, files which do not exist anymore are removed from the database.
+   * @param dataSource: The datasource to update
+   * @param fileNames: The full paths of the changed files, these should match the datasources FilePath and filter
+   * @param scanFlags Scan flags parameters, e.g. CDBFILESCANNER_RESCAN can be set as flag.
+   */
+  static int updateFiles(CDataSource *dataSource,std::vector<CT::string> &fileNames,int scanFlags);
+  
   static int createTiles(CDataSource *dataSource,int scanFlags);
   
 };
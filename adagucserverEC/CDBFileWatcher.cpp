@@ -0,0 +1,326 @@
+/******************************************************************************
+ *
+ * Project:  ADAGUC Server
+ * Purpose:  Watches the configured FilePath directories and updates the database for changed files
+ * Date:     2026-10-18
+ *
+ ******************************************************************************
+ *
+ * Copyright 2026, Royal Netherlands Meteorological Institute (KNMI)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <poll.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+#include "CDBFileWatcher.h"
+#include "CDBFileScanner.h"
+#include "CDFObjectStore.h"
+#include "CWarmUp.h"
+
+// #define CDBFILEWATCHER_DEBUG
+
+#define CDBFILEWATCHER_EVENTMASK (IN_CLOSE_WRITE|IN_MODIFY|IN_CREATE|IN_MOVED_TO|IN_MOVED_FROM|IN_DELETE)
+
+const char *CDBFileWatcher::className="CDBFileWatcher";
+
+static volatile sig_atomic_t watcherStopRequested = 0;
+
+static void watcherSignalHandler(int){
+  watcherStopRequested = 1;
+}
+
+CDBFileWatcher::CDBFileWatcher(){
+  inotifyFd = -1;
+  scanFlags = 0;
+  srvParam = NULL;
+  needsFullScan = false;
+}
+
+CDBFileWatcher::~CDBFileWatcher(){
+  if(inotifyFd!=-1){
+    close(inotifyFd);
+    inotifyFd = -1;
+  }
+  for(size_t j=0;j<dataSources.size();j++){
+    delete dataSources[j];
+  }
+  dataSources.clear();
+}
+
+double CDBFileWatcher::getTimeMs(){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return double(ts.tv_sec)*1000.0+double(ts.tv_nsec)/1000000.0;
+}
+
+int CDBFileWatcher::run(CServerParams *srvParam,CT::string *layerPathToScan,int scanFlags){
+  this->srvParam = srvParam;
+  this->scanFlags = scanFlags;
+  srvParam->requestType=REQUEST_UPDATEDB;
+
+  inotifyFd = inotify_init1(IN_NONBLOCK|IN_CLOEXEC);
+  if(inotifyFd<0){
+    CDBError("Unable to initialize inotify: %s",strerror(errno));
+    return 1;
+  }
+
+  for(size_t layerNo=0;layerNo<srvParam->cfg->Layer.size();layerNo++){
+    CDataSource *dataSource = new CDataSource ();
+    if(dataSource->setCFGLayer(srvParam,srvParam->configObj->Configuration[0],srvParam->cfg->Layer[layerNo],NULL,layerNo)!=0){
+      delete dataSource;
+      return 1;
+    }
+    if((dataSource->dLayerType!=CConfigReaderLayerTypeDataBase&&dataSource->dLayerType!=CConfigReaderLayerTypeBaseLayer)||
+      dataSource->cfgLayer->FilePath.size()==0){
+      delete dataSource;
+      continue;
+    }
+    CT::string layerPath = dataSource->cfgLayer->FilePath[0]->value.c_str();
+    CDirReader::makeCleanPath(&layerPath);
+    if(layerPathToScan!=NULL&&layerPathToScan->length()!=0){
+      CT::string pathToScan = layerPathToScan->c_str();
+      CDirReader::makeCleanPath(&pathToScan);
+      if(layerPath.equals(&pathToScan)==false){
+        delete dataSource;
+        continue;
+      }
+    }
+    //Single files and OpenDAP URL's are not watched
+    struct stat stFileInfo;
+    if(stat(layerPath.c_str(),&stFileInfo)!=0||!S_ISDIR(stFileInfo.st_mode)){
+      CDBDebug("Not watching layer %s, [%s] is not a directory",dataSource->getLayerName(),layerPath.c_str());
+      delete dataSource;
+      continue;
+    }
+    dataSources.push_back(dataSource);
+    layerDirectories.push_back(layerPath);
+    bool alreadyWatched = false;
+    for(std::map<int,std::string>::iterator it=watchedDirectories.begin();it!=watchedDirectories.end();++it){
+      if(it->second == layerPath.c_str()){alreadyWatched = true;break;}
+    }
+    if(!alreadyWatched){
+      addWatchRecursive(layerPath.c_str(),false);
+    }
+  }
+
+  if(dataSources.size()==0){
+    CDBWarning("No layers with a FilePath directory to watch");
+    return 0;
+  }
+  CDBDebug("***** Watching %d directories for %d layers *****",watchedDirectories.size(),dataSources.size());
+
+  watcherStopRequested = 0;
+  signal(SIGINT,watcherSignalHandler);
+  signal(SIGTERM,watcherSignalHandler);
+
+  int status = 0;
+  while(watcherStopRequested == 0){
+    struct pollfd pfd;
+    pfd.fd = inotifyFd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    /* Wake up regularly while files are waiting for their debounce period or warm up requests are running */
+    int timeout = pendingFiles.empty()&&CWarmUp::poll()==0?1000:CDBFILEWATCHER_DEBOUNCE_MS/4;
+    int ready = poll(&pfd,1,timeout);
+    if(ready<0&&errno!=EINTR){
+      CDBError("poll failed: %s",strerror(errno));
+      status = 1;
+      break;
+    }
+    if(ready>0&&readEvents()!=0){
+      status = 1;
+      break;
+    }
+    if(needsFullScan){
+      fullScan();
+    }
+    processPendingFiles(false);
+  }
+
+  /* Files which were still waiting are handled before stopping */
+  processPendingFiles(true);
+  CWarmUp::finish();
+  signal(SIGINT,SIG_DFL);
+  signal(SIGTERM,SIG_DFL);
+  CDBDebug("***** Stopped watching *****");
+  return status;
+}
+
+int CDBFileWatcher::addWatchRecursive(const char *directory,bool enqueueFiles){
+  int wd = inotify_add_watch(inotifyFd,directory,CDBFILEWATCHER_EVENTMASK);
+  if(wd<0){
+    if(errno == ENOSPC){
+      CDBError("Unable to watch %s: the maximum number of watches is reached, increase fs.inotify.max_user_watches",directory);
+    }else{
+      CDBWarning("Unable to watch %s: %s",directory,strerror(errno));
+    }
+    return 1;
+  }
+  watchedDirectories[wd] = directory;
+  #ifdef CDBFILEWATCHER_DEBUG
+  CDBDebug("Watching %s",directory);
+  #endif
+
+  DIR *dir = opendir(directory);
+  if(dir == NULL)return 0;
+  double now = getTimeMs();
+  struct dirent *entry;
+  while((entry = readdir(dir))!=NULL){
+    if(entry->d_name[0]=='.')continue;
+    CT::string path;
+    path.print("%s/%s",directory,entry->d_name);
+    bool isDir = entry->d_type == DT_DIR;
+    if(entry->d_type == DT_UNKNOWN){
+      struct stat stFileInfo;
+      isDir = stat(path.c_str(),&stFileInfo)==0&&S_ISDIR(stFileInfo.st_mode);
+    }
+    if(isDir){
+      addWatchRecursive(path.c_str(),enqueueFiles);
+    }else if(enqueueFiles){
+      pendingFiles[path.c_str()] = now;
+    }
+  }
+  closedir(dir);
+  return 0;
+}
+
+int CDBFileWatcher::readEvents(){
+  char buffer[65536] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+  while(true){
+    ssize_t length = read(inotifyFd,buffer,sizeof(buffer));
+    if(length<0){
+      if(errno == EAGAIN||errno == EINTR)return 0;
+      CDBError("Unable to read inotify events: %s",strerror(errno));
+      return 1;
+    }
+    if(length == 0)return 0;
+    double now = getTimeMs();
+    for(char *p=buffer;p<buffer+length;){
+      struct inotify_event *event = (struct inotify_event *)p;
+      p+=sizeof(struct inotify_event)+event->len;
+
+      if(event->mask&IN_Q_OVERFLOW){
+        CDBWarning("Event queue overflow, all layers will be rescanned");
+        needsFullScan = true;
+        continue;
+      }
+      std::map<int,std::string>::iterator it = watchedDirectories.find(event->wd);
+      if(it == watchedDirectories.end())continue;
+      if(event->mask&IN_IGNORED){
+        //The directory is removed, its files have been reported as deleted already
+        watchedDirectories.erase(it);
+        continue;
+      }
+      if(event->len == 0||event->name[0]=='.')continue;
+
+      CT::string path;
+      path.print("%s/%s",it->second.c_str(),event->name);
+      if(event->mask&IN_ISDIR){
+        if(event->mask&(IN_CREATE|IN_MOVED_TO)){
+          addWatchRecursive(path.c_str(),true);
+        }
+        continue;
+      }
+      #ifdef CDBFILEWATCHER_DEBUG
+      CDBDebug("Event %x for %s",event->mask,path.c_str());
+      #endif
+      /* Every event restarts the debounce period, so files which are still being written are not scanned */
+      pendingFiles[path.c_str()] = now;
+    }
+  }
+  return 0;
+}
+
+int CDBFileWatcher::processPendingFiles(bool all){
+  if(pendingFiles.empty())return 0;
+  double now = getTimeMs();
+  std::vector<CT::string> readyFiles;
+  for(std::map<std::string,double>::iterator it=pendingFiles.begin();it!=pendingFiles.end();){
+    if(all||now-it->second>=CDBFILEWATCHER_DEBOUNCE_MS){
+      readyFiles.push_back(it->first.c_str());
+      pendingFiles.erase(it++);
+    }else{
+      ++it;
+    }
+  }
+  if(readyFiles.empty())return 0;
+
+  int status = 0;
+  bool updated = false;
+  CDirReader dirReader;
+  for(size_t d=0;d<dataSources.size();d++){
+    CDataSource *dataSource = dataSources[d];
+    CT::string filter = dataSource->cfgLayer->FilePath[0]->attr.filter.c_str();
+    if(filter.empty())filter = ".*\\.nc$";
+    CT::string prefix = layerDirectories[d].c_str();
+    prefix.concat("/");
+    std::vector<CT::string> layerFiles;
+    for(size_t j=0;j<readyFiles.size();j++){
+      if(readyFiles[j].indexOf(prefix.c_str())!=0)continue;
+      CT::string baseName = readyFiles[j].substring(readyFiles[j].lastIndexOf("/")+1,-1);
+      if(dirReader.testRegEx(baseName.c_str(),filter.c_str())!=1)continue;
+      layerFiles.push_back(readyFiles[j]);
+    }
+    if(layerFiles.empty())continue;
+    if(CDBFileScanner::updateFiles(dataSource,layerFiles,scanFlags)!=0){
+      CDBError("Could not update db for: %s",dataSource->cfgLayer->Name[0]->value.c_str());
+      status = 1;
+    }
+    updated = true;
+  }
+  if(updated){
+    invalidateCaches();
+  }
+  return status;
+}
+
+int CDBFileWatcher::fullScan(){
+  needsFullScan = false;
+  pendingFiles.clear();
+  int status = 0;
+  CT::string tailPath = "";
+  for(size_t d=0;d<dataSources.size();d++){
+    if(CDBFileScanner::updatedb(dataSources[d],&tailPath,NULL,scanFlags)!=0){
+      CDBError("Could not update db for: %s",dataSources[d]->cfgLayer->Name[0]->value.c_str());
+      status = 1;
+    }
+  }
+  invalidateCaches();
+  return status;
+}
+
+void CDBFileWatcher::invalidateCaches(){
+  //The GetCapabilities cache needs to be regenerated
+  CT::string cacheFileName;
+  srvParam->getCacheFileName(&cacheFileName);
+  if(cacheFileName.length()>0){
+    struct stat stFileInfo;
+    if(stat(cacheFileName.c_str(),&stFileInfo) == 0){
+      if(remove(cacheFileName.c_str())!=0){
+        CDBError("Unable to remove cachefile %s, please do it manually.",cacheFileName.c_str());
+      }
+    }
+  }
+  //Changed files should be read again
+  CDFObjectStore::getCDFObjectStore()->clear();
+}
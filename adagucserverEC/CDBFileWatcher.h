@@ -0,0 +1,78 @@
+/******************************************************************************
+ *
+ * Project:  ADAGUC Server
+ * Purpose:  Watches the configured FilePath directories and updates the database for changed files
+ * Date:     2026-10-18
+ *
+ ******************************************************************************
+ *
+ * Copyright 2026, Royal Netherlands Meteorological Institute (KNMI)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ******************************************************************************/
+
+#ifndef CDBFILEWATCHER_H
+#define CDBFILEWATCHER_H
+#include <map>
+#include <string>
+#include <vector>
+#include "CDataSource.h"
+#include "CServerParams.h"
+#include "CDebugger.h"
+
+/* A file is scanned when no events have been received for it during this number of milliseconds */
+#define CDBFILEWATCHER_DEBOUNCE_MS 2000
+
+/**
+ * Event driven database updates, the alternative to periodically running --updatedb.
+ *
+ * The FilePath directories of all database layers are watched with inotify. Created, modified, moved and
+ * deleted files are collected, and once a file has been quiet for CDBFILEWATCHER_DEBOUNCE_MS it is added to,
+ * updated in or removed from the dimension tables with CDBFileScanner::updateFiles. Directories are never
+ * listed again, except for new subdirectories and after an event queue overflow.
+ *
+ * Usage: adagucserver --updatedb --config config.xml --watch
+ */
+class CDBFileWatcher{
+  private:
+    DEF_ERRORFUNCTION();
+    int inotifyFd;
+    int scanFlags;
+    CServerParams *srvParam;
+    std::vector<CDataSource*> dataSources;
+    std::vector<CT::string> layerDirectories;
+    std::map<int,std::string> watchedDirectories;
+    std::map<std::string,double> pendingFiles;
+    bool needsFullScan;
+
+    int addWatchRecursive(const char *directory,bool enqueueFiles);
+    int readEvents();
+    int processPendingFiles(bool all);
+    int fullScan();
+    void invalidateCaches();
+    static double getTimeMs();
+  public:
+    CDBFileWatcher();
+    ~CDBFileWatcher();
+
+    /**
+     * Watches the directories of the layers until the process receives SIGINT or SIGTERM
+     * @param srvParam The server parameters with the configuration
+     * @param layerPathToScan When not empty, only the layer with this FilePath is watched
+     * @param scanFlags Scan flags as used by CDBFileScanner::updatedb
+     * @return Zero on success
+     */
+    int run(CServerParams *srvParam,CT::string *layerPathToScan,int scanFlags);
+};
+#endif
@@ -64,6 +64,22 @@ CDFReader *CDFObjectStore::getCDFReader(CDataSource *dataSource,const char *file
             hdf5Reader->enableKNMIHDF5UseEndTime();
           }
         }
+        /* Raw data chunk cache, e.g. <DataReader chunkcachesize="33554432" chunkcacheslots="12421" chunkcachepreemption="0.75">HDF5</DataReader> */
+        CServerConfig::XMLE_DataReader *cfgDataReader = dataSource->cfgLayer->DataReader[0];
+        if(!cfgDataReader->attr.chunkcachesize.empty()){
+          size_t numSlots = 521;
+          double preemption = 0.75;
+          if(!cfgDataReader->attr.chunkcacheslots.empty()){
+            int configuredSlots = cfgDataReader->attr.chunkcacheslots.toInt();
+            if(configuredSlots>0){
+              numSlots = configuredSlots;
+            }else{
+              CDBWarning("DataReader chunkcacheslots must be larger than zero, ignoring %s",cfgDataReader->attr.chunkcacheslots.c_str());
+            }
+          }
+          if(!cfgDataReader->attr.chunkcachepreemption.empty())preemption = cfgDataReader->attr.chunkcachepreemption.toDouble();
+          hdf5Reader->setChunkCache(strtoull(cfgDataReader->attr.chunkcachesize.c_str(),NULL,10),numSlots,preemption);
+        }
       } else if(dataSource->cfgLayer->DataReader[0]->value.equals("GEOJSON")){
         #ifdef CDFOBJECTSTORE_DEBUG
         CDBDebug("Creating GEOJSON reader");
@@ -81,6 +97,33 @@ CDFReader *CDFObjectStore::getCDFReader(CDataSource *dataSource,const char *file
     CDBDebug("Creating NetCDF reader");
     #endif
     cdfReader = new CDFNetCDFReader();
+    /* Chunk cache and access pattern, e.g. <DataReader accessmode="timeseries" chunkcachesize="16777216"/> */
+    if(dataSource!=NULL&&dataSource->cfgLayer->DataReader.size()>0){
+      CServerConfig::XMLE_DataReader *cfgDataReader = dataSource->cfgLayer->DataReader[0];
+      CDFNetCDFReader *netCDFReader = (CDFNetCDFReader*)cdfReader;
+      size_t chunkCacheSize = 0,chunkCacheSlots = 0;
+      float chunkCachePreemption = -1;
+      if(!cfgDataReader->attr.chunkcachesize.empty())chunkCacheSize = strtoull(cfgDataReader->attr.chunkcachesize.c_str(),NULL,10);
+      if(!cfgDataReader->attr.chunkcacheslots.empty()){
+        int numSlots = cfgDataReader->attr.chunkcacheslots.toInt();
+        if(numSlots>0){
+          chunkCacheSlots = numSlots;
+        }else{
+          CDBWarning("DataReader chunkcacheslots must be larger than zero, ignoring %s",cfgDataReader->attr.chunkcacheslots.c_str());
+        }
+      }
+      if(!cfgDataReader->attr.chunkcachepreemption.empty())chunkCachePreemption = cfgDataReader->attr.chunkcachepreemption.toDouble();
+      netCDFReader->setChunkCache(chunkCacheSize,chunkCacheSlots,chunkCachePreemption);
+      if(cfgDataReader->attr.accessmode.equals("spatialtile")){
+        netCDFReader->setAccessMode(CDFNETCDFREADER_ACCESS_SPATIALTILE);
+      }else if(cfgDataReader->attr.accessmode.equals("timeseries")){
+        netCDFReader->setAccessMode(CDFNETCDFREADER_ACCESS_TIMESERIES);
+      }else if(cfgDataReader->attr.accessmode.equals("fullfield")){
+        netCDFReader->setAccessMode(CDFNETCDFREADER_ACCESS_FULLFIELD);
+      }else if(!cfgDataReader->attr.accessmode.empty()){
+        CDBWarning("Unknown DataReader accessmode %s, use spatialtile, timeseries or fullfield",cfgDataReader->attr.accessmode.c_str());
+      }
+    }
   }
   return cdfReader;
 }
@@ -729,6 +729,7 @@ CDPPExecutor::CDPPExecutor(){
   dataPostProcessorList->push_back(new CDPPMSGCPPHIWCMask());
   dataPostProcessorList->push_back(new CDPPBeaufort());
   dataPostProcessorList->push_back(new CDPDBZtoRR());
+  dataPostProcessorList->push_back(new CDPPExpression());
   dataPostProcessorList->push_back(new CDPPAddFeatures());
 }
 
@@ -1142,3 +1143,315 @@ int CDPPAddFeatures::execute(CServerConfig::XMLE_DataPostProc* proc, CDataSource
   }
   return 0;    
 }
+
+/************************/
+/*      CDPPExpression  */
+/************************/
+const char *CDPPExpression::className="CDPPExpression";
+
+//Maximum number of threads used to evaluate an expression
+#define CDPPExpression_MAXTHREADS 8
+
+//Minimum number of elements per thread
+#define CDPPExpression_MINELEMENTSPERTHREAD 65536
+
+const char *CDPPExpression::getId(){
+  return "expression";
+}
+
+int CDPPExpression::isApplicable(CServerConfig::XMLE_DataPostProc* proc, CDataSource* dataSource){
+  if(proc->attr.algorithm.equals("expression")){
+    if(proc->attr.expression.empty()){
+      CDBError("No expression attribute given");
+      return CDATAPOSTPROCESSOR_CONSTRAINTSNOTMET;
+    }
+    return CDATAPOSTPROCESSOR_RUNAFTERREADING|CDATAPOSTPROCESSOR_RUNBEFOREREADING;
+  }
+  return CDATAPOSTPROCESSOR_NOTAPPLICABLE;
+}
+
+template <class T>
+static void CDPPExpression_load(const T *data,size_t n,float *dest){
+  for(size_t i=0;i<n;i++)dest[i]=(float)data[i];
+}
+
+/* Returns a block of n values of the source as float, converted into buffer when needed */
+static const float *CDPPExpression_loadBlock(void *data,CDFType type,size_t offset,size_t n,float *buffer){
+  switch(type){
+    case CDF_FLOAT:return ((const float*)data)+offset;
+    case CDF_DOUBLE:CDPPExpression_load(((const double*)data)+offset,n,buffer);break;
+    case CDF_CHAR:
+    case CDF_BYTE:CDPPExpression_load(((const char*)data)+offset,n,buffer);break;
+    case CDF_UBYTE:CDPPExpression_load(((const unsigned char*)data)+offset,n,buffer);break;
+    case CDF_SHORT:CDPPExpression_load(((const short*)data)+offset,n,buffer);break;
+    case CDF_USHORT:CDPPExpression_load(((const unsigned short*)data)+offset,n,buffer);break;
+    case CDF_INT:CDPPExpression_load(((const int*)data)+offset,n,buffer);break;
+    case CDF_UINT:CDPPExpression_load(((const unsigned int*)data)+offset,n,buffer);break;
+    default:for(size_t i=0;i<n;i++)buffer[i]=NAN;
+  }
+  return buffer;
+}
+
+void CDPPExpression::evaluate(Job *job){
+  std::vector<CExpressionEvaluator> &evaluators=*job->evaluators;
+  std::vector<Source> &sources=*job->sources;
+  size_t numSources=sources.size();
+  float *current=&job->workspace[0];
+  float *valid=current+CEXPRESSIONEVALUATOR_BLOCKSIZE;
+  float *sourceBuffers=valid+CEXPRESSIONEVALUATOR_BLOCKSIZE;
+  float *evaluatorWorkspace=sourceBuffers+numSources*CEXPRESSIONEVALUATOR_BLOCKSIZE;
+  std::vector<const float*> sourceBlocks(numSources);
+  //The number of variables of an expression is not limited
+  size_t maxInputs=1;
+  for(size_t e=0;e<job->inputMap->size();e++){
+    if((*job->inputMap)[e].size()>maxInputs)maxInputs=(*job->inputMap)[e].size();
+  }
+  std::vector<const float*> inputs(maxInputs);
+  
+  for(size_t blockStart=job->start;blockStart<job->end;blockStart+=CEXPRESSIONEVALUATOR_BLOCKSIZE){
+    size_t n=job->end-blockStart;
+    if(n>CEXPRESSIONEVALUATOR_BLOCKSIZE)n=CEXPRESSIONEVALUATOR_BLOCKSIZE;
+    
+    //Load the inputs and find out which elements have data for all of them
+    for(size_t i=0;i<n;i++)valid[i]=1;
+    for(size_t k=0;k<numSources;k++){
+      const float *block=CDPPExpression_loadBlock(sources[k].data,sources[k].type,blockStart,n,sourceBuffers+k*CEXPRESSIONEVALUATOR_BLOCKSIZE);
+      sourceBlocks[k]=block;
+      float noDataValue=sources[k].noDataValue;
+      if(sources[k].hasNodataValue){
+        for(size_t i=0;i<n;i++)if(block[i]!=block[i]||block[i]==noDataValue)valid[i]=0;
+      }else{
+        for(size_t i=0;i<n;i++)if(block[i]!=block[i])valid[i]=0;
+      }
+    }
+    
+    //All expressions of the chain are applied on the block, each one on the result of the previous one
+    memcpy(current,sourceBlocks[0],n*sizeof(float));
+    for(size_t e=0;e<evaluators.size();e++){
+      std::vector<int> &inputMap=(*job->inputMap)[e];
+      for(size_t v=0;v<inputMap.size();v++){
+        inputs[v]=inputMap[v]==0?current:sourceBlocks[inputMap[v]];
+      }
+      evaluators[e].evaluateBlock(&inputs[0],current,n,evaluatorWorkspace);
+    }
+    
+    float noDataValue=job->outputNoDataValue;
+    if(job->outputType==CDF_FLOAT){
+      float *output=((float*)job->output)+blockStart;
+      for(size_t i=0;i<n;i++)output[i]=(valid[i]!=0&&current[i]==current[i])?current[i]:noDataValue;
+    }else if(job->outputType==CDF_DOUBLE){
+      double *output=((double*)job->output)+blockStart;
+      for(size_t i=0;i<n;i++)output[i]=(valid[i]!=0&&current[i]==current[i])?current[i]:noDataValue;
+    }
+  }
+}
+
+void *CDPPExpression::runJob(void *arg){
+  evaluate((Job*)arg);
+  return NULL;
+}
+
+int CDPPExpression::execute(CServerConfig::XMLE_DataPostProc* proc, CDataSource* dataSource,int mode){
+  if((isApplicable(proc,dataSource)&mode)==false){
+    return -1;
+  }
+  if(mode==CDATAPOSTPROCESSOR_RUNBEFOREREADING){
+    if(proc->attr.units.empty()==false){
+      dataSource->getDataObject(0)->setUnits(proc->attr.units.c_str());
+    }
+    return 0;
+  }
+  if(mode!=CDATAPOSTPROCESSOR_RUNAFTERREADING)return 0;
+  
+  //Consecutive expressions are evaluated together with the first one of the chain
+  std::vector<CServerConfig::XMLE_DataPostProc*> &procs=dataSource->cfgLayer->DataPostProc;
+  size_t procIndex=0;
+  while(procIndex<procs.size()&&procs[procIndex]!=proc)procIndex++;
+  if(procIndex>0&&procIndex<procs.size()&&procs[procIndex-1]->attr.algorithm.equals("expression")){
+    return 0;
+  }
+  
+  CDataSource::DataObject *dataObject=dataSource->getDataObject(0);
+  
+  //Compile the chain and find the variables of each expression, source 0 is the first variable or the result of the previous expression
+  std::vector<CExpressionEvaluator> evaluators;
+  std::vector<std::vector<int> > inputMap;
+  std::vector<CDataSource::DataObject*> sourceObjects;
+  sourceObjects.push_back(dataObject);
+  for(size_t j=procIndex;j<procs.size()&&(j==procIndex||procs[j]->attr.algorithm.equals("expression"));j++){
+    evaluators.push_back(CExpressionEvaluator());
+    CExpressionEvaluator &evaluator=evaluators.back();
+    if(evaluator.compile(procs[j]->attr.expression.c_str())!=0){
+      return 1;
+    }
+    inputMap.push_back(std::vector<int>());
+    for(size_t v=0;v<evaluator.getNumVariables();v++){
+      const char *variableName=evaluator.getVariableName(v);
+      int sourceIndex=-1;
+      for(size_t k=0;k<sourceObjects.size();k++){
+        if(sourceObjects[k]->variableName.equals(variableName)){sourceIndex=k;break;}
+      }
+      if(sourceIndex==-1){
+        for(size_t varNr=0;varNr<dataSource->getNumDataObjects();varNr++){
+          if(dataSource->getDataObject(varNr)->variableName.equals(variableName)){
+            sourceIndex=sourceObjects.size();
+            sourceObjects.push_back(dataSource->getDataObject(varNr));
+            break;
+          }
+        }
+      }
+      if(sourceIndex==-1){
+        CDBError("Variable %s in expression \"%s\" is not configured in this layer",variableName,procs[j]->attr.expression.c_str());
+        return 1;
+      }
+      inputMap.back().push_back(sourceIndex);
+    }
+  }
+  
+  size_t workspaceSize=CEXPRESSIONEVALUATOR_BLOCKSIZE*(2+sourceObjects.size());
+  size_t evaluatorWorkspaceSize=0;
+  for(size_t e=0;e<evaluators.size();e++){
+    if(evaluators[e].getWorkspaceSize()>evaluatorWorkspaceSize)evaluatorWorkspaceSize=evaluators[e].getWorkspaceSize();
+  }
+  workspaceSize+=evaluatorWorkspaceSize;
+  
+  CDF::Variable *variable=dataObject->cdfVariable;
+  size_t l=(size_t)dataSource->dHeight*(size_t)dataSource->dWidth;
+  for(size_t k=0;k<sourceObjects.size();k++){
+    if(sourceObjects[k]->cdfVariable->data==NULL||sourceObjects[k]->cdfVariable->getSize()<l){
+      CDBError("No data available for variable %s",sourceObjects[k]->variableName.c_str());
+      return 1;
+    }
+  }
+  
+  std::vector<Source> sources(sourceObjects.size());
+  for(size_t k=0;k<sourceObjects.size();k++){
+    sources[k].data=sourceObjects[k]->cdfVariable->data;
+    sources[k].type=sourceObjects[k]->cdfVariable->getType();
+    sources[k].hasNodataValue=sourceObjects[k]->hasNodataValue;
+    sources[k].noDataValue=(float)sourceObjects[k]->dfNodataValue;
+  }
+  //Elements where an input has no data, or where the expression is not defined, get the nodata value
+  if(!dataObject->hasNodataValue){
+    dataObject->hasNodataValue=true;
+    dataObject->dfNodataValue=NC_FILL_FLOAT;
+  }
+  float outputNoDataValue=(float)dataObject->dfNodataValue;
+  CDFType type=variable->getType();
+  
+  //Integer data of the first variable only: evaluate once for every possible value and use a lookup table
+  bool useLookupTable=sourceObjects.size()==1&&(type==CDF_CHAR||type==CDF_BYTE||type==CDF_UBYTE||type==CDF_SHORT||type==CDF_USHORT);
+  if(type!=CDF_FLOAT&&type!=CDF_DOUBLE){
+    void *floatData=NULL;
+    if(CDF::allocateData(CDF_FLOAT,&floatData,variable->getSize())!=0){
+      CDBError("Unable to allocate data");
+      return 1;
+    }
+    float *output=(float*)floatData;
+    if(useLookupTable){
+      int firstValue=0;
+      size_t numValues=256;
+      if(type==CDF_CHAR||type==CDF_BYTE)firstValue=-128;
+      if(type==CDF_SHORT){firstValue=-32768;numValues=65536;}
+      if(type==CDF_USHORT)numValues=65536;
+      std::vector<float> domain(numValues),table(numValues);
+      for(size_t j=0;j<numValues;j++)domain[j]=float(firstValue+int(j));
+      Job job;
+      Source source=sources[0];
+      source.data=&domain[0];
+      source.type=CDF_FLOAT;
+      std::vector<Source> tableSources(1,source);
+      job.evaluators=&evaluators;
+      job.inputMap=&inputMap;
+      job.sources=&tableSources;
+      job.output=&table[0];
+      job.outputType=CDF_FLOAT;
+      job.outputNoDataValue=outputNoDataValue;
+      job.start=0;
+      job.end=numValues;
+      job.workspace.resize(workspaceSize);
+      evaluate(&job);
+      size_t size=variable->getSize();
+      switch(type){
+        case CDF_UBYTE:{const unsigned char *raw=(const unsigned char*)variable->data;for(size_t j=0;j<size;j++)output[j]=table[raw[j]];break;}
+        case CDF_USHORT:{const unsigned short *raw=(const unsigned short*)variable->data;for(size_t j=0;j<size;j++)output[j]=table[raw[j]];break;}
+        case CDF_SHORT:{const short *raw=(const short*)variable->data;for(size_t j=0;j<size;j++)output[j]=table[raw[j]+32768];break;}
+        default:{const signed char *raw=(const signed char*)variable->data;for(size_t j=0;j<size;j++)output[j]=table[raw[j]+128];break;}
+      }
+    }else{
+      CDPPExpression_loadBlock(variable->data,type,0,variable->getSize(),output);
+    }
+    CDF::freeData(&variable->data);
+    variable->data=floatData;
+    variable->setType(CDF_FLOAT);
+    sources[0].data=floatData;
+    sources[0].type=CDF_FLOAT;
+    type=CDF_FLOAT;
+  }
+  
+  if(!useLookupTable){
+    //Split the grid over threads, each thread evaluates its part block by block
+    size_t numThreads=sysconf(_SC_NPROCESSORS_ONLN);
+    if(numThreads>CDPPExpression_MAXTHREADS)numThreads=CDPPExpression_MAXTHREADS;
+    if(numThreads>l/CDPPExpression_MINELEMENTSPERTHREAD)numThreads=l/CDPPExpression_MINELEMENTSPERTHREAD;
+    if(numThreads<1)numThreads=1;
+    size_t numBlocks=(l+CEXPRESSIONEVALUATOR_BLOCKSIZE-1)/CEXPRESSIONEVALUATOR_BLOCKSIZE;
+    std::vector<Job> jobs(numThreads);
+    for(size_t t=0;t<numThreads;t++){
+      Job &job=jobs[t];
+      job.evaluators=&evaluators;
+      job.inputMap=&inputMap;
+      job.sources=&sources;
+      job.output=variable->data;
+      job.outputType=type;
+      job.outputNoDataValue=outputNoDataValue;
+      job.start=std::min(l,(numBlocks*t/numThreads)*CEXPRESSIONEVALUATOR_BLOCKSIZE);
+      job.end=std::min(l,(numBlocks*(t+1)/numThreads)*CEXPRESSIONEVALUATOR_BLOCKSIZE);
+      job.workspace.resize(workspaceSize);
+    }
+    std::vector<pthread_t> threads(numThreads);
+    std::vector<bool> started(numThreads,false);
+    for(size_t t=1;t<numThreads;t++){
+      started[t]=pthread_create(&threads[t],NULL,runJob,&jobs[t])==0;
+      if(!started[t])evaluate(&jobs[t]);
+    }
+    evaluate(&jobs[0]);
+    for(size_t t=1;t<numThreads;t++){
+      if(started[t])pthread_join(threads[t],NULL);
+    }
+  }
+  
+  //Point data, when all inputs have the same points
+  size_t numPoints=dataObject->points.size();
+  bool pointsAvailable=numPoints>0;
+  for(size_t k=1;k<sourceObjects.size();k++){
+    if(sourceObjects[k]->points.size()!=numPoints)pointsAvailable=false;
+  }
+  if(pointsAvailable){
+    std::vector<std::vector<float> > pointValues(sourceObjects.size(),std::vector<float>(numPoints));
+    std::vector<Source> pointSources(sources);
+    for(size_t k=0;k<sourceObjects.size();k++){
+      for(size_t p=0;p<numPoints;p++)pointValues[k][p]=sourceObjects[k]->points[p].v;
+      pointSources[k].data=&pointValues[k][0];
+      pointSources[k].type=CDF_FLOAT;
+    }
+    std::vector<float> result(numPoints);
+    Job job;
+    job.evaluators=&evaluators;
+    job.inputMap=&inputMap;
+    job.sources=&pointSources;
+    job.output=&result[0];
+    job.outputType=CDF_FLOAT;
+    job.outputNoDataValue=outputNoDataValue;
+    job.start=0;
+    job.end=numPoints;
+    job.workspace.resize(workspaceSize);
+    evaluate(&job);
+    for(size_t p=0;p<numPoints;p++)dataObject->points[p].v=result[p];
+  }
+  
+  #ifdef CDATAPOSTPROCESSOR_DEBUG
+  CDBDebug("Evaluated %d expressions on %d elements%s",(int)evaluators.size(),(int)l,useLookupTable?" with lookup table":"");
+  #endif
+  return 0;
+}
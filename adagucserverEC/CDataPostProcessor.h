@@ -26,6 +26,7 @@
 #ifndef CDATAPOSTPROCESSOR_H
 #define CDATAPOSTPROCESSOR_H
 #include "CDataSource.h"
+#include "CExpressionEvaluator.h"
 
 
 #define CDATAPOSTPROCESSOR_NOTAPPLICABLE 1
@@ -220,6 +221,42 @@
     virtual int execute(CServerConfig::XMLE_DataPostProc* proc, CDataSource* dataSource,int mode);
   };
   
+  /**
+  * Derived products from an expression over the layer variables, e.g.
+  * <DataPostProc algorithm="expression" expression="pow(pow(10,dbz/10)/200,1/1.6)" units="mm/hr"/>
+  * See CExpressionEvaluator for the syntax. The result replaces the first variable, other variables are inputs only.
+  * Consecutive expression processors are evaluated in a single pass over the data, in a following expression
+  * the name of the first variable refers to the result of the previous expression.
+  */
+  class CDPPExpression : public CDPPInterface{
+  private:
+    DEF_ERRORFUNCTION();
+    class Source{
+    public:
+      void *data;
+      CDFType type;
+      bool hasNodataValue;
+      float noDataValue;
+    };
+    class Job{
+    public:
+      std::vector<CExpressionEvaluator> *evaluators;
+      std::vector<std::vector<int> > *inputMap;
+      std::vector<Source> *sources;
+      void *output;
+      CDFType outputType;
+      float outputNoDataValue;
+      size_t start,end;
+      std::vector<float> workspace;
+    };
+    static void *runJob(void *arg);
+    static void evaluate(Job *job);
+  public:
+    virtual const char *getId();
+    virtual int isApplicable(CServerConfig::XMLE_DataPostProc* proc, CDataSource* dataSource);
+    virtual int execute(CServerConfig::XMLE_DataPostProc* proc, CDataSource* dataSource,int mode);
+  };
+  
   /**
    * AddFeature from a GEOJSON shape provider
    */
@@ -36,10 +36,12 @@
 #include "CConvertEProfile.h"
 #include "CConvertTROPOMI.h"
 #include "CDBFactory.h"
+#include "CFieldStatistics.h"
+#include "CCDFTypedView.h"
+#include "CSharedFieldCache.h"
 const char *CDataReader::className="CDataReader";
 
 // #define CDATAREADER_DEBUG
-// #define MEASURETIME
 
 #define uchar unsigned char
 #define MAX_STR_LEN 8191
@@ -219,20 +221,26 @@ class Proc{
     DEF_ERRORFUNCTION();
     static int swapPixelsAtLocation(CDataSource *dataSource,CDF::Variable *variable,int mode){   
       if(dataSource->useLonTransformation == -1)return 0;
-      switch (variable->getType()){
-      case CDF_CHAR  : _swapPixelsAtLocation<char>        (dataSource,variable,mode);break;
-      case CDF_BYTE  : _swapPixelsAtLocation<char>        (dataSource,variable,mode);break;
-      case CDF_UBYTE : _swapPixelsAtLocation<uchar>       (dataSource,variable,mode);break;
-      case CDF_SHORT : _swapPixelsAtLocation<short>       (dataSource,variable,mode);break;
-      case CDF_USHORT: _swapPixelsAtLocation<ushort>      (dataSource,variable,mode);break;
-      case CDF_INT   : _swapPixelsAtLocation<int>         (dataSource,variable,mode);break;
-      case CDF_UINT  : _swapPixelsAtLocation<unsigned int>(dataSource,variable,mode);break;
-      case CDF_FLOAT : _swapPixelsAtLocation<float>       (dataSource,variable,mode);break;
-      case CDF_DOUBLE: _swapPixelsAtLocation<double>      (dataSource,variable,mode);break;
-      default: {CDBError("Unknown data type"); return 1;}
+      SwapPixelsKernel kernel;
+      kernel.dataSource = dataSource;
+      kernel.variable = variable;
+      kernel.mode = mode;
+      if(CDF::dispatch(variable->getType(),variable->data,variable->getSize(),kernel)!=0){
+        CDBError("Unknown data type");
+        return 1;
+      }
+      return 0;
     }
-    return 0;
-  }
+  class SwapPixelsKernel{
+    public:
+    CDataSource *dataSource;
+    CDF::Variable *variable;
+    int mode;
+    template <class T>
+    void run(CDF::TypedView<T>){
+      _swapPixelsAtLocation<T>(dataSource,variable,mode);
+    }
+  };
   private: 
   template <class T>
   static void _swapPixelsAtLocation(CDataSource *dataSource,CDF::Variable *variable,int mode){
@@ -292,21 +300,27 @@ class Proc{
     variable->allocateData(imageSize);
     
     data = (T*) variable->data;
+    T nodataValue = (T)dataSource->getDataObject(0)->dfNodataValue;
     for(size_t j=0;j<imageSize;j++){
-      data[j]=(T)dataSource->getDataObject(0)->dfNodataValue;
+      data[j]=nodataValue;
     }
     
+    //The new column of a pixel is the same for every row
+    std::vector<int> newXIndices(dataSource->dOrigWidth);
+    for(int x=0;x<dataSource->dOrigWidth;x=x+1){
+      double lonX=((double(x)/double(dataSource->dOrigWidth))*origBBOXWidth)+left;
+      while(lonX<-180)lonX+=360;
+      while(lonX>=180)lonX-=360;
+      int newXIndex = int(floor((((lonX-dataSource->dfBBOX[0])/360))*double(dataSource->dWidth)+0.5));
+      newXIndices[x] = newXIndex>=0&&newXIndex<dataSource->dWidth?newXIndex:-1;
+    }
     
     for(int y=0;y<dataSource->dHeight;y++){
+      const T *sourceRow = tempData+size_t(y)*dataSource->dOrigWidth;
+      T *destRow = data+size_t(y)*dataSource->dWidth;
       for(int x=0;x<dataSource->dOrigWidth;x=x+1){
-        double lonX=((double(x)/double(dataSource->dOrigWidth))*origBBOXWidth)+left;
-        while(lonX<-180)lonX+=360;
-        while(lonX>=180)lonX-=360;
-        
-        int newXIndex = int(floor((((lonX-dataSource->dfBBOX[0])/360))*double(dataSource->dWidth)+0.5));
-        T value = tempData[x+y*dataSource->dOrigWidth];
-        if(newXIndex>=0&&newXIndex<dataSource->dWidth){
-          data[newXIndex+y*dataSource->dWidth]=value;
+        if(newXIndices[x]>=0){
+          destRow[newXIndices[x]]=sourceRow[x];
         }
       }
     }
@@ -321,6 +335,35 @@ class Proc{
 
 const char *Proc::className="Proc";
 
+/* Number of rows and columns transposed at once, so both the source and destination block stay in the cache */
+#define CDATAREADER_TRANSPOSEBLOCKSIZE 64
+
+/**
+ * Transposes the source view of width columns and height rows, stored column by column, into destination
+ */
+class TransposeKernel{
+  public:
+  void *destination;
+  size_t width,height;
+  template <class T>
+  void run(CDF::TypedView<T> source){
+    T *d = (T*)destination;
+    const T *s = source.data;
+    size_t w = width,h = height;
+    for(size_t yb=0;yb<h;yb+=CDATAREADER_TRANSPOSEBLOCKSIZE){
+      size_t ye = yb+CDATAREADER_TRANSPOSEBLOCKSIZE<h?yb+CDATAREADER_TRANSPOSEBLOCKSIZE:h;
+      for(size_t xb=0;xb<w;xb+=CDATAREADER_TRANSPOSEBLOCKSIZE){
+        size_t xe = xb+CDATAREADER_TRANSPOSEBLOCKSIZE<w?xb+CDATAREADER_TRANSPOSEBLOCKSIZE:w;
+        for(size_t y=yb;y<ye;y++){
+          for(size_t x=xb;x<xe;x++){
+            d[x+y*w]=s[y+x*h];
+          }
+        }
+      }
+    }
+  }
+};
+
 int CDataReader::open(CDataSource *dataSource, int mode){
   return open(dataSource,mode,-1,-1);
 }
@@ -545,9 +588,6 @@ int CDataReader::parseDimensions(CDataSource *dataSource,int mode,int x, int y){
   dataSource->origBBOXLeft = dataSource->dfBBOX[0];
   dataSource->origBBOXRight = dataSource->dfBBOX[2];
   
-#ifdef MEASURETIME
-  StopWatch_Stop("XY dimensions read");
-#endif
 
   // Retrieve CRS
   
@@ -707,6 +747,7 @@ int CDataReader::open(CDataSource *dataSource,int mode,int x,int y){
   }
  
   CDFObject *cdfObject = NULL;
+  CTracer::Span openSpan("open");
     
 //#ifdef CDATAREADER_DEBUG
   CDBDebug("Working on [%s] with mode %d and (%d,%d)",dataSourceFilename.c_str(),mode,x,y);
@@ -727,6 +768,7 @@ int CDataReader::open(CDataSource *dataSource,int mode,int x,int y){
     cdfObject=CDFObjectStore::getCDFObjectStore()->getCDFObject(dataSource,dataSourceFilename.c_str());
     //pthread_mutex_unlock(&CDataReader_open_lock);
   }
+  openSpan.stop();
   //pthread_mutex_lock(&CDataReader_open_lock);
    // //pthread_mutex_lock(&CDataReader_open_lock);
 //return 0;//CHECK
@@ -942,9 +984,6 @@ int CDataReader::open(CDataSource *dataSource,int mode,int x,int y){
  
     for(size_t varNr=0;varNr<dataSource->getNumDataObjects();varNr++)    {
        // double dfNoData = 0;
-      #ifdef MEASURETIME
-      StopWatch_Stop("Reading _FillValue");
-      #endif
       CDF::Attribute *fillValue = dataSource->getDataObject(varNr)->cdfVariable->getAttributeNE("_FillValue");
       if(fillValue!=NULL){
         
@@ -962,26 +1001,36 @@ int CDataReader::open(CDataSource *dataSource,int mode,int x,int y){
     CDBDebug("CNETCDFREADER_MODE_OPEN_ALL");
   #endif
 
-  #ifdef MEASURETIME
-    StopWatch_Stop("start reading image data");
-  #endif
     //for(size_t varNr=0;varNr<dataSource->getNumDataObjects();varNr++)
           for(size_t varNr=0;varNr<dataSource->getNumDataObjects();varNr++)    {
 
     
       
+      /* Fields which are read, transposed and unpacked by another server process are taken from the shared cache */
+      CT::string sharedFieldCacheKey;
+      bool useSharedFieldCache = singleCellMode==false&&dataSource->level2CompatMode==false&&
+        getSharedFieldCacheKey(dataSource,varNr,start,count,stride,&sharedFieldCacheKey)==0;
+      if(useSharedFieldCache){
+        CDataSource::DataObject *dataObject = dataSource->getDataObject(varNr);
+        dataObject->cdfVariable->freeData();
+        double nodataValue;
+        bool hasNodataValue;
+        if(CSharedFieldCache::get(sharedFieldCacheKey.c_str(),dataObject->cdfVariable,&hasNodataValue,&nodataValue)==0){
+          /* swapPixelsAtLocation may have introduced a nodata value when the field was stored */
+          dataObject->appliedScaleOffset = true;
+          dataObject->hasNodataValue = hasNodataValue;
+          dataObject->dfNodataValue = nodataValue;
+          continue;
+        }
+      }
+      
       //if( dataSource->getDataObject(varNr)->cdfVariable->data==NULL){
       if( dataSource->level2CompatMode == false){
-        //#ifdef MEASURETIME
-        //StopWatch_Stop("Freeing data");
-        //#endif
         
         //Read variable data
         dataSource->getDataObject(varNr)->cdfVariable->freeData();
 
-        #ifdef MEASURETIME
-        StopWatch_Stop("start reading data");
-        #endif
+        CTracer::Span readSpan("read");
         
         #ifdef CDATAREADER_DEBUG   
         CDBDebug("READING DATA FOR varNR [%d], name=\"%s\"",varNr,dataSource->getDataObject(varNr)->cdfVariable->name.c_str());
@@ -1021,37 +1070,31 @@ int CDataReader::open(CDataSource *dataSource,int mode,int x,int y){
       }
       dataSource->getDataObject(varNr)->appliedScaleOffset = false;
       
-      #ifdef MEASURETIME
-      StopWatch_Stop("data read");
-      #endif
       
       
       //Swap X, Y dimensions so that pointer x+y*w works correctly
     
 
       if(dataSource->swapXYDimensions){
+        CTracer::Span transposeSpan("transpose");
         size_t imgSize=dataSource->dHeight*dataSource->dWidth;
-        size_t w=dataSource->dWidth;size_t h=dataSource->dHeight;size_t x,y;
+        size_t w=dataSource->dWidth;size_t h=dataSource->dHeight;
         void *vd=NULL;                 //destination data
         void *vs=dataSource->getDataObject(varNr)->cdfVariable->data;     //source data
       
         //Allocate data for our new memory block
         CDF::allocateData(dataSource->getDataObject(varNr)->cdfVariable->getType(),&vd,imgSize);
-        //TODO This could also be solved using a template. But this works fine.
-        switch (dataSource->getDataObject(varNr)->cdfVariable->getType()){
-          case CDF_CHAR  : {char   *s=(char  *)vs;char   *d=(char  *)vd;for(y=0;y<h;y++)for(x=0;x<w;x++){d[x+y*w]=s[y+x*h];}}break;
-          case CDF_BYTE  : {char   *s=(char  *)vs;char   *d=(char  *)vd;for(y=0;y<h;y++)for(x=0;x<w;x++){d[x+y*w]=s[y+x*h];}}break;
-          case CDF_UBYTE : {uchar  *s=(uchar *)vs;uchar  *d=(uchar *)vd;for(y=0;y<h;y++)for(x=0;x<w;x++){d[x+y*w]=s[y+x*h];}}break;
-          case CDF_SHORT : {short  *s=(short *)vs;short  *d=(short *)vd;for(y=0;y<h;y++)for(x=0;x<w;x++){d[x+y*w]=s[y+x*h];}}break;
-          case CDF_USHORT: {ushort *s=(ushort*)vs;ushort *d=(ushort*)vd;for(y=0;y<h;y++)for(x=0;x<w;x++){d[x+y*w]=s[y+x*h];}}break;
-          case CDF_INT   : {int    *s=(int   *)vs;int    *d=(int   *)vd;for(y=0;y<h;y++)for(x=0;x<w;x++){d[x+y*w]=s[y+x*h];}}break;
-          case CDF_UINT  : {uint   *s=(uint  *)vs;uint   *d=(uint  *)vd;for(y=0;y<h;y++)for(x=0;x<w;x++){d[x+y*w]=s[y+x*h];}}break;
-          case CDF_FLOAT : {float  *s=(float *)vs;float  *d=(float *)vd;for(y=0;y<h;y++)for(x=0;x<w;x++){d[x+y*w]=s[y+x*h];}}break;
-          case CDF_DOUBLE: {double *s=(double*)vs;double *d=(double*)vd;for(y=0;y<h;y++)for(x=0;x<w;x++){d[x+y*w]=s[y+x*h];}}break;
-          default: {CDBError("Unknown data type"); return 1;}
+        TransposeKernel transposeKernel;
+        transposeKernel.destination = vd;
+        transposeKernel.width = w;
+        transposeKernel.height = h;
+        if(CDF::dispatch(dataSource->getDataObject(varNr)->cdfVariable->getType(),vs,imgSize,transposeKernel)!=0){
+          CDBError("Unknown data type");
+          CDF::freeData(&vd);
+          return 1;
         }
         //We will replace our old memory block with the new one, but we have to free our old one first.
-        free(dataSource->getDataObject(varNr)->cdfVariable->data);
+        CDF::freeData(&dataSource->getDataObject(varNr)->cdfVariable->data);
         //Replace the memory block.
         dataSource->getDataObject(varNr)->cdfVariable->data=vd;
       }
@@ -1060,6 +1103,7 @@ int CDataReader::open(CDataSource *dataSource,int mode,int x,int y){
       //Apply scale and offset factor on the data
       if(dataSource->getDataObject(varNr)->appliedScaleOffset == false && dataSource->getDataObject(varNr)->hasScaleOffset){
         dataSource->getDataObject(varNr)->appliedScaleOffset=true;
+        CTracer::Span scaleOffsetSpan("scaleoffset");
         
         double dfscale_factor = dataSource->getDataObject(varNr)->dfscale_factor;
         double dfadd_offset = dataSource->getDataObject(varNr)->dfadd_offset;
@@ -1110,9 +1154,10 @@ int CDataReader::open(CDataSource *dataSource,int mode,int x,int y){
         }
       }
       
-      #ifdef MEASURETIME
-      StopWatch_Stop("Scale and offset applied");
-      #endif
+      if(useSharedFieldCache){
+        CSharedFieldCache::put(sharedFieldCacheKey.c_str(),dataSource->getDataObject(varNr)->cdfVariable,dataSource->getDataObject(varNr)->hasNodataValue,dataSource->getDataObject(varNr)->dfNodataValue);
+      }
+      
       
 
    
@@ -1150,11 +1195,16 @@ int CDataReader::open(CDataSource *dataSource,int mode,int x,int y){
           #ifdef CDATAREADER_DEBUG
           CDBDebug("No statistics available");
           #endif    
+          CTracer::Span statisticsSpan("statistics");
           dataSource->statistics = new CDataSource::Statistics();
-          dataSource->statistics->calculate(dataSource);
-          #ifdef MEASURETIME
-          StopWatch_Stop("Calculated statistics");
-          #endif
+          //Use the statistics of the whole field calculated by the scanner, wind vectors need the calculated speed
+          CFieldStatistics fieldStatistics;
+          if(dataSource->getNumDataObjects()==1&&fieldStatistics.load(dataSource)==0){
+            dataSource->statistics->setMinimum(fieldStatistics.min);
+            dataSource->statistics->setMaximum(fieldStatistics.max);
+          }else{
+            dataSource->statistics->calculate(dataSource);
+          }
         }
         float min=(float)dataSource->statistics->getMinimum();
         float max=(float)dataSource->statistics->getMaximum();
@@ -1191,16 +1241,15 @@ int CDataReader::open(CDataSource *dataSource,int mode,int x,int y){
     CDBDebug("styleConfiguration->legendScale = %f, styleConfiguration->legendOffset = %f",styleConfiguration->legendScale,styleConfiguration->legendOffset);
     #endif    
     
-  #ifdef MEASURETIME
-    StopWatch_Stop("all read");
-  #endif
     
     /*
     * DataPostProc: Here our datapostprocessor comes into action!
     * This is stage2, running on data, not metadata
     */
     
+   CTracer::Span postProcSpan("postproc");
    CDataPostProcessor::getCDPPExecutor()->executeProcessors(dataSource,CDATAPOSTPROCESSOR_RUNAFTERREADING);
+   postProcSpan.stop();
 //    CT::string dumpString;
 //    CDF::dump(cdfObject,&dumpString);
 //   CDBDebug("\nSTART\n%s\nEND\n",dumpString.c_str());
@@ -1216,6 +1265,31 @@ int CDataReader::open(CDataSource *dataSource,int mode,int x,int y){
 
 
 
+int CDataReader::getSharedFieldCacheKey(CDataSource *dataSource,size_t varNr,size_t *start,size_t *count,ptrdiff_t *stride,CT::string *key){
+  CServerConfig::XMLE_Configuration *cfg = dataSource->srvParams->cfg;
+  if(cfg->SharedFieldCache.size()==0)return 1;
+  CT::string name = CSHAREDFIELDCACHE_DEFAULTNAME;
+  size_t sizeMB = CSHAREDFIELDCACHE_DEFAULTSIZE;
+  if(!cfg->SharedFieldCache[0]->attr.name.empty())name = cfg->SharedFieldCache[0]->attr.name.c_str();
+  if(!cfg->SharedFieldCache[0]->attr.size.empty())sizeMB = cfg->SharedFieldCache[0]->attr.size.toInt();
+  if(CSharedFieldCache::attach(name.c_str(),sizeMB*1024*1024)!=0)return 1;
+  
+  /* Remote files have no modification time to detect updates with */
+  struct stat fileInfo;
+  if(stat(dataSource->getFileName(),&fileInfo)!=0)return 1;
+  
+  CDataSource::DataObject *dataObject = dataSource->getDataObject(varNr);
+  key->print("%s|%lu|%ld|%ld|%s|%d|%d|%d|%d|%.17g|%.17g|%.17g",
+             dataSource->getFileName(),(unsigned long)fileInfo.st_ino,(long)fileInfo.st_mtime,(long)fileInfo.st_size,
+             dataObject->cdfVariable->name.c_str(),dataObject->cdfVariable->getType(),
+             dataSource->swapXYDimensions,dataSource->useLonTransformation,dataObject->hasScaleOffset,
+             dataObject->dfscale_factor,dataObject->dfadd_offset,dataObject->dfNodataValue);
+  for(int j=0;j<dataSource->dNetCDFNumDims;j++){
+    key->printconcat("|%lu:%lu:%ld",(unsigned long)start[j],(unsigned long)count[j],(long)stride[j]);
+  }
+  return 0;
+}
+
 CDF::Variable *CDataReader::getTimeDimension(CDataSource *dataSource){
   return getDimensionVariableByType(dataSource->getDataObject(0)->cdfVariable,dtype_time);
 }
@@ -37,6 +37,7 @@
 #include "CCDFHDF5IO.h"
 #include "CProj4ToCF.h"
 #include "CStopWatch.h"
+#include "CTracer.h"
 #include <sys/stat.h>
 #include "CDBFileScanner.h"
 #include "CDFObjectStore.h"
@@ -46,6 +47,13 @@
 class CDataReader{
   private:
     DEF_ERRORFUNCTION();
+    
+    /**
+     * Makes the key of a read field in the shared field cache, identifying the file version, the variable, the
+     * hyperslab and the processing which is applied after reading
+     * @return Zero when the field can be cached
+     */
+    static int getSharedFieldCacheKey(CDataSource *dataSource,size_t varNr,size_t *start,size_t *count,ptrdiff_t *stride,CT::string *key);
 
     
   public:
@@ -183,15 +183,10 @@ int CDataSource::Statistics::calculate(CDataSource *dataSource){
   if(dataObject->cdfVariable->data!=NULL){
     size_t size = dataObject->cdfVariable->getSize();//dataSource->dWidth*dataSource->dHeight;
     
-    if(dataObject->cdfVariable->getType()==CDF_CHAR)calcMinMax<char>(size,dataSource->getDataObjectsVector());
-    if(dataObject->cdfVariable->getType()==CDF_BYTE)calcMinMax<char>(size,dataSource->getDataObjectsVector());
-    if(dataObject->cdfVariable->getType()==CDF_UBYTE)calcMinMax<unsigned char>(size,dataSource->getDataObjectsVector());
-    if(dataObject->cdfVariable->getType()==CDF_SHORT)calcMinMax<short>(size,dataSource->getDataObjectsVector());
-    if(dataObject->cdfVariable->getType()==CDF_USHORT)calcMinMax<unsigned short>(size,dataSource->getDataObjectsVector());
-    if(dataObject->cdfVariable->getType()==CDF_INT)calcMinMax<int>(size,dataSource->getDataObjectsVector());
-    if(dataObject->cdfVariable->getType()==CDF_UINT)calcMinMax<unsigned int>(size,dataSource->getDataObjectsVector());
-    if(dataObject->cdfVariable->getType()==CDF_FLOAT)calcMinMax<float>(size,dataSource->getDataObjectsVector());
-    if(dataObject->cdfVariable->getType()==CDF_DOUBLE)calcMinMax<double>(size,dataSource->getDataObjectsVector()); 
+    CalcMinMaxKernel kernel;
+    kernel.statistics = this;
+    kernel.dataObjects = dataSource->getDataObjectsVector();
+    CDF::dispatch(dataObject->cdfVariable->getType(),dataObject->cdfVariable->data,size,kernel);
     
   }
   return 0;
@@ -33,6 +33,7 @@
 #include "Definitions.h"
 #include "CTypes.h"
 #include "CCDFDataModel.h"
+#include "CCDFTypedView.h"
 #include "COGCDims.h"
 #include "CStopWatch.h"
 
@@ -129,29 +130,22 @@ private:
     T _min=(T)0.0f,_max=(T)1.0f;
     double _sum=0,_sumsquared=0;
     size_t numSamples=0;
-    T maxInf=(T)INFINITY;
-    T minInf=(T)-INFINITY;
-    
-    bool checkInfinity = false;
-    if(type==CDF_FLOAT||type==CDF_DOUBLE)checkInfinity=true;
+    T nodataValue=(T)dfNodataValue;
     int firstDone=0;
 
     for(size_t p=0;p<size;p++){
       T v=data[p];
-      if((((T)v)!=(T)dfNodataValue||(!hasNodataValue))&&v==v){
-        if((checkInfinity&&v!=maxInf&&v!=minInf)||(!checkInfinity))
-        {
-          if(firstDone==0){
-            _min=v;_max=v;
-            firstDone=1;
-          }else{
-            if(v<_min)_min=v;
-            if(v>_max)_max=v;
-          }
-          _sum+=v;
-          _sumsquared+=(v*v);
-          numSamples++;
+      if(CDF::TypedView<T>::isValid(v,hasNodataValue,nodataValue)){
+        if(firstDone==0){
+          _min=v;_max=v;
+          firstDone=1;
+        }else{
+          if(v<_min)_min=v;
+          if(v>_max)_max=v;
         }
+        _sum+=v;
+        _sumsquared+=(v*v);
+        numSamples++;
       }
     }
   avg=_sum/double(numSamples);
@@ -162,6 +156,15 @@ private:
   private:
      template <class T>
       void calcMinMax(size_t size,std::vector <DataObject *> *dataObject);
+      class CalcMinMaxKernel{
+        public:
+        Statistics *statistics;
+        std::vector <DataObject *> *dataObjects;
+        template <class T>
+        void run(CDF::TypedView<T> view){
+          statistics->calcMinMax<T>(view.size,dataObjects);
+        }
+      };
       double min,max,avg,stddev;
     public:
       Statistics(){
@@ -92,10 +92,10 @@ void CDrawImage::destroyImage(){
  
   delete cairo; cairo=NULL;
   if(rField!=NULL){
-    delete[] rField; rField = NULL;
-    delete[] gField;gField=NULL;
-    delete[] bField;bField = NULL;
-    delete[] numField;numField = NULL;
+    CBufferPool::release(rField); rField = NULL;
+    CBufferPool::release(gField);gField=NULL;
+    CBufferPool::release(bField);bField = NULL;
+    CBufferPool::release(numField);numField = NULL;
   }
 }
 
@@ -704,6 +704,20 @@ void CDrawImage::setPixelIndexed(int x,int y,int color){
   }
 }
 
+void CDrawImage::setPixelsIndexed(const short *colorIndices){
+  if(currentGraphicsRenderer==CDRAWIMAGERENDERER_CAIRO){
+    if(currentLegend==NULL)return;
+    cairo->pixelsIndexed(colorIndices,currentLegend->CDIred,currentLegend->CDIgreen,currentLegend->CDIblue,currentLegend->CDIalpha);
+  }else{
+    for(int y=0;y<Geo->dHeight;y++){
+      for(int x=0;x<Geo->dWidth;x++){
+        int color = colorIndices[x+y*Geo->dWidth];
+        if(color>=0&&color<256)gdImageSetPixel(image,x,y,colors[color]);
+      }
+    }
+  }
+}
+
 void CDrawImage::getPixelTrueColor(int x,int y,unsigned char &r,unsigned char &g,unsigned char &b,unsigned char &a){
   if(currentGraphicsRenderer==CDRAWIMAGERENDERER_CAIRO){
     cairo->getPixel(x,y,r,g,b,a);
@@ -1573,6 +1587,14 @@ void CDrawImage:: getCanvasSize(int &x1,int &y1,int &w,int &h){
   if(h<0)h=0;
 }
 
+bool CDrawImage::hasOverwritingColors(){
+  if(currentLegend==NULL)return false;
+  for(int j=0;j<256;j++){
+    if(currentLegend->CDIalpha[j]<0)return true;
+  }
+  return false;
+}
+
 int CDrawImage::clonePalette(CDrawImage *drawImage){
   if(drawImage->currentLegend == NULL){
     currentLegend  = NULL;
@@ -1619,6 +1641,17 @@ int CDrawImage::createImage(CDrawImage *image,int width,int height){
   return 0;
 }
 
+int CDrawImage::createLayerImage(CDrawImage *image){
+  enableTransparency(true);
+  currentGraphicsRenderer = image->currentGraphicsRenderer;
+  _bEnableTrueColor = image->_bEnableTrueColor;
+  setTTFFontLocation(image->TTFFontLocation);
+  setTTFFontSize(image->TTFFontSize);
+  int status = createImage(image->Geo);
+  if(status!=0)return status;
+  return clonePalette(image);
+}
+
     
 int CDrawImage::setCanvasSize(int x,int y,int width,int height){
   CDrawImage temp;
@@ -1671,6 +1704,26 @@ int CDrawImage::draw(int destx, int desty,int sourcex,int sourcey,CDrawImage *si
   }
   return 0;
 }
+int CDrawImage::compositeLayers(std::vector<CDrawImage*> &layerImages){
+  if(currentGraphicsRenderer!=CDRAWIMAGERENDERER_CAIRO){
+    CDBError("compositeLayers is only possible with the cairo renderer");
+    return 1;
+  }
+  std::vector<CCairoPlotter*> layers;
+  for(size_t j=0;j<layerImages.size();j++){
+    CDrawImage *layerImage = layerImages[j];
+    if(layerImage->currentGraphicsRenderer!=CDRAWIMAGERENDERER_CAIRO||layerImage->Geo->dWidth!=Geo->dWidth||layerImage->Geo->dHeight!=Geo->dHeight){
+      CDBError("Layer image %d does not match the image",(int)j);
+      return 1;
+    }
+    layers.push_back(layerImage->cairo);
+  }
+  if(layers.size()>0){
+    cairo->compositeLayers(&layers[0],layers.size());
+  }
+  return 0;
+}
+
 int CDrawImage::drawrotated(int destx, int desty,int sourcex,int sourcey,CDrawImage *simage){
   unsigned char r,g,b,a;
   int dTranspColor;
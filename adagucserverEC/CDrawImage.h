@@ -27,9 +27,11 @@
 #define CDrawImage_H
 
 #include <map>
+#include <vector>
 #include <iostream>
 #include "CDebugger.h"
 #include "CTypes.h"
+#include "CBufferPool.h"
 
 #include "Definitions.h" 
 #include "CStopWatch.h"
@@ -174,6 +176,11 @@ public:
     int createImage(CGeoParams *_Geo);
     int createImage(const char *fn);
     int createImage(CDrawImage *image,int width,int height);
+    /**
+     * Creates a transparent image with the size, geo parameters, fonts and palette of image, to draw one layer in.
+     * The layer is drawn over image afterwards with compositeLayers.
+     */
+    int createLayerImage(CDrawImage *image);
     int printImagePng8(bool useBitAlpha);
     int printImagePng24();
     int printImagePng32();
@@ -182,6 +189,10 @@ public:
     int createGDPalette(CServerConfig::XMLE_Legend *palette);
     int create685Palette();
     int clonePalette(CDrawImage *drawImage);
+    /**
+     * Returns true when the current palette has colors with a negative alpha, which overwrite the pixels below them
+     */
+    bool hasOverwritingColors();
     
     void drawBarb(int x,int y,double direction, double strength,int color,bool toKnots,bool flip);
     void drawBarb(int x,int y,double direction, double strength,int color,float linewidth, bool toKnots,bool flip);
@@ -220,6 +231,11 @@ public:
     void circle(int x, int y, int r, int color,float lineWidth);
     void circle(int x, int y, int r, CColor color,float lineWidth);
     void setPixelIndexed(int x,int y,int color);
+    
+    /**
+     * Sets all pixels of the image from a field of width*height color indices, CCOLORINDEXTABLE_NODRAW (-1) leaves the pixel unchanged
+     */
+    void setPixelsIndexed(const short *colorIndices);
     void setPixelTrueColor(int x,int y,unsigned int color);
     void setPixelTrueColor(int x,int y,unsigned char r,unsigned char g,unsigned char b);
     void setPixelTrueColor(int x,int y,unsigned char r,unsigned char g,unsigned char b,unsigned char a);
@@ -271,6 +287,11 @@ public:
     
     int setCanvasSize(int x,int y,int width,int height);
     int draw(int destx, int desty,int sourcex,int sourcey,CDrawImage *simage);
+    /**
+     * Draws layer images of the same size over this image, in the order of the list and in one pass. Each pixel is
+     * blended like setPixelTrueColor does. Only for the cairo renderer.
+     */
+    int compositeLayers(std::vector<CDrawImage*> &layerImages);
     int drawrotated(int destx, int desty,int sourcex,int sourcey,CDrawImage *simage);    
     void crop(int paddingW,int paddingH);
     void crop(int padding);
@@ -0,0 +1,421 @@
+/******************************************************************************
+ *
+ * Project:  ADAGUC Server
+ * Purpose:  Compiles arithmetic expressions to bytecode and evaluates them on blocks of data
+ * Date:     2026-10-18
+ *
+ ******************************************************************************
+ *
+ * Copyright 2026, Royal Netherlands Meteorological Institute (KNMI)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <math.h>
+#include <string.h>
+#include <stdlib.h>
+#include "CExpressionEvaluator.h"
+
+const char *CExpressionEvaluator::className="CExpressionEvaluator";
+
+enum{
+  OP_CONST,OP_LOAD,
+  OP_NEG,OP_NOT,OP_FUNC1,
+  OP_ADD,OP_SUB,OP_MUL,OP_DIV,OP_MOD,OP_POW,
+  OP_LT,OP_LE,OP_GT,OP_GE,OP_EQ,OP_NE,OP_AND,OP_OR,OP_FUNC2,
+  OP_SELECT
+};
+
+enum{
+  FUNC_ABS,FUNC_SQRT,FUNC_EXP,FUNC_LOG,FUNC_LOG10,FUNC_SIN,FUNC_COS,FUNC_TAN,FUNC_ATAN,FUNC_FLOOR,FUNC_CEIL,FUNC_ROUND,FUNC_ISNAN,
+  FUNC_MIN,FUNC_MAX,FUNC_ATAN2,FUNC_HYPOT
+};
+
+static const char *CExpressionEvaluator_functions1[]={"abs","sqrt","exp","log","log10","sin","cos","tan","atan","floor","ceil","round","isnan",NULL};
+static const char *CExpressionEvaluator_functions2[]={"min","max","atan2","hypot",NULL};
+
+static int CExpressionEvaluator_getNumOperands(int op){
+  if(op==OP_CONST||op==OP_LOAD)return 0;
+  if(op<=OP_FUNC1)return 1;
+  if(op<=OP_FUNC2)return 2;
+  return 3;
+}
+
+static inline float CExpressionEvaluator_function1(int f,float a){
+  switch(f){
+    case FUNC_ABS:return fabsf(a);
+    case FUNC_SQRT:return sqrtf(a);
+    case FUNC_EXP:return expf(a);
+    case FUNC_LOG:return logf(a);
+    case FUNC_LOG10:return log10f(a);
+    case FUNC_SIN:return sinf(a);
+    case FUNC_COS:return cosf(a);
+    case FUNC_TAN:return tanf(a);
+    case FUNC_ATAN:return atanf(a);
+    case FUNC_FLOOR:return floorf(a);
+    case FUNC_CEIL:return ceilf(a);
+    case FUNC_ROUND:return roundf(a);
+    case FUNC_ISNAN:return a!=a;
+  }
+  return NAN;
+}
+
+static inline float CExpressionEvaluator_function2(int f,float a,float b){
+  switch(f){
+    case FUNC_MIN:return a<b?a:b;
+    case FUNC_MAX:return a>b?a:b;
+    case FUNC_ATAN2:return atan2f(a,b);
+    case FUNC_HYPOT:return hypotf(a,b);
+  }
+  return NAN;
+}
+
+float CExpressionEvaluator::apply(int op,int index,float a,float b,float c){
+  switch(op){
+    case OP_NEG:return -a;
+    case OP_NOT:return a==0;
+    case OP_FUNC1:return CExpressionEvaluator_function1(index,a);
+    case OP_ADD:return a+b;
+    case OP_SUB:return a-b;
+    case OP_MUL:return a*b;
+    case OP_DIV:return a/b;
+    case OP_MOD:return fmodf(a,b);
+    case OP_POW:return powf(a,b);
+    case OP_LT:return a<b;
+    case OP_LE:return a<=b;
+    case OP_GT:return a>b;
+    case OP_GE:return a>=b;
+    case OP_EQ:return a==b;
+    case OP_NE:return a!=b;
+    case OP_AND:return a!=0&&b!=0;
+    case OP_OR:return a!=0||b!=0;
+    case OP_FUNC2:return CExpressionEvaluator_function2(index,a,b);
+    case OP_SELECT:return a!=0?b:c;
+  }
+  return NAN;
+}
+
+/**
+ * Recursive descent parser, emits the instructions in postfix order
+ */
+class CExpressionEvaluator::Parser{
+  private:
+    DEF_ERRORFUNCTION();
+    CExpressionEvaluator *evaluator;
+    const char *expression;
+    size_t pos;
+    int depth;
+  public:
+    bool failed;
+    Parser(CExpressionEvaluator *evaluator,const char *expression){
+      this->evaluator=evaluator;
+      this->expression=expression;
+      pos=0;
+      depth=0;
+      failed=false;
+    }
+
+    void error(const char *message){
+      if(!failed){
+        CDBError("Expression \"%s\": %s at position %d",expression,message,(int)pos);
+      }
+      failed=true;
+    }
+
+    void skipSpaces(){
+      while(expression[pos]==' '||expression[pos]=='\t'||expression[pos]=='\n'||expression[pos]=='\r')pos++;
+    }
+
+    bool accept(const char *token){
+      skipSpaces();
+      size_t length=strlen(token);
+      if(strncmp(expression+pos,token,length)!=0)return false;
+      //Do not take the first character of <= or == as < or =
+      if(length==1&&(token[0]=='<'||token[0]=='>'||token[0]=='!')&&expression[pos+1]=='=')return false;
+      pos+=length;
+      return true;
+    }
+
+    void expect(const char *token){
+      if(!accept(token)){
+        CT::string message;
+        message.print("expected \"%s\"",token);
+        error(message.c_str());
+      }
+    }
+
+    /* Adds an instruction, operations on constants are folded into a single constant */
+    void emit(int op,int index,float value){
+      if(failed)return;
+      std::vector<Instruction> &program=evaluator->program;
+      int numOperands=CExpressionEvaluator_getNumOperands(op);
+      bool allConstant=numOperands>0&&int(program.size())>=numOperands;
+      for(int j=0;j<numOperands&&allConstant;j++){
+        if(program[program.size()-1-j].op!=OP_CONST)allConstant=false;
+      }
+      if(allConstant){
+        float operands[3]={0,0,0};
+        for(int j=0;j<numOperands;j++){
+          operands[j]=program[program.size()-numOperands+j].value;
+        }
+        program.resize(program.size()-numOperands);
+        depth-=numOperands;
+        value=apply(op,index,operands[0],operands[1],operands[2]);
+        op=OP_CONST;
+        index=0;
+        numOperands=0;
+      }
+      Instruction instruction;
+      instruction.op=op;
+      instruction.index=index;
+      instruction.value=value;
+      program.push_back(instruction);
+      depth+=1-numOperands;
+      if(depth>evaluator->maxDepth)evaluator->maxDepth=depth;
+      if(depth>CEXPRESSIONEVALUATOR_MAXDEPTH)error("expression is too deeply nested");
+    }
+
+    void parseExpression(){
+      parseOr();
+      if(accept("?")){
+        parseExpression();
+        expect(":");
+        parseExpression();
+        emit(OP_SELECT,0,0);
+      }
+    }
+
+    void parseOr(){
+      parseAnd();
+      while(!failed&&accept("||")){parseAnd();emit(OP_OR,0,0);}
+    }
+
+    void parseAnd(){
+      parseComparison();
+      while(!failed&&accept("&&")){parseComparison();emit(OP_AND,0,0);}
+    }
+
+    void parseComparison(){
+      parseSum();
+      while(!failed){
+        int op;
+        if(accept("<="))op=OP_LE;
+        else if(accept(">="))op=OP_GE;
+        else if(accept("=="))op=OP_EQ;
+        else if(accept("!="))op=OP_NE;
+        else if(accept("<"))op=OP_LT;
+        else if(accept(">"))op=OP_GT;
+        else break;
+        parseSum();
+        emit(op,0,0);
+      }
+    }
+
+    void parseSum(){
+      parseProduct();
+      while(!failed){
+        int op;
+        if(accept("+"))op=OP_ADD;
+        else if(accept("-"))op=OP_SUB;
+        else break;
+        parseProduct();
+        emit(op,0,0);
+      }
+    }
+
+    void parseProduct(){
+      parseUnary();
+      while(!failed){
+        int op;
+        if(accept("*"))op=OP_MUL;
+        else if(accept("/"))op=OP_DIV;
+        else if(accept("%"))op=OP_MOD;
+        else break;
+        parseUnary();
+        emit(op,0,0);
+      }
+    }
+
+    void parseUnary(){
+      if(accept("-")){parseUnary();emit(OP_NEG,0,0);return;}
+      if(accept("+")){parseUnary();return;}
+      if(accept("!")){parseUnary();emit(OP_NOT,0,0);return;}
+      parsePower();
+    }
+
+    void parsePower(){
+      parsePrimary();
+      if(!failed&&accept("^")){
+        parseUnary();
+        emit(OP_POW,0,0);
+      }
+    }
+
+    int findFunction(const char **functions,const char *name){
+      for(int j=0;functions[j]!=NULL;j++){
+        if(strcmp(functions[j],name)==0)return j;
+      }
+      return -1;
+    }
+
+    void parsePrimary(){
+      if(failed)return;
+      skipSpaces();
+      char c=expression[pos];
+      if(accept("(")){
+        parseExpression();
+        expect(")");
+        return;
+      }
+      if((c>='0'&&c<='9')||c=='.'){
+        char *end=NULL;
+        double value=strtod(expression+pos,&end);
+        if(end==expression+pos){error("invalid number");return;}
+        pos=end-expression;
+        emit(OP_CONST,0,(float)value);
+        return;
+      }
+      if(!((c>='a'&&c<='z')||(c>='A'&&c<='Z')||c=='_')){
+        error(c==0?"unexpected end":"unexpected character");
+        return;
+      }
+      size_t start=pos;
+      while((expression[pos]>='a'&&expression[pos]<='z')||(expression[pos]>='A'&&expression[pos]<='Z')||
+            (expression[pos]>='0'&&expression[pos]<='9')||expression[pos]=='_')pos++;
+      CT::string name;
+      name.copy(expression+start,pos-start);
+      if(accept("(")){
+        int function=findFunction(CExpressionEvaluator_functions1,name.c_str());
+        if(function!=-1){
+          parseExpression();
+          expect(")");
+          emit(OP_FUNC1,function,0);
+          return;
+        }
+        bool isPow=name.equals("pow");
+        function=findFunction(CExpressionEvaluator_functions2,name.c_str());
+        if(function!=-1||isPow){
+          parseExpression();
+          expect(",");
+          parseExpression();
+          expect(")");
+          if(isPow)emit(OP_POW,0,0);else emit(OP_FUNC2,FUNC_MIN+function,0);
+          return;
+        }
+        error("unknown function");
+        return;
+      }
+      if(name.equals("nodata")){emit(OP_CONST,0,NAN);return;}
+      if(name.equals("pi")){emit(OP_CONST,0,M_PI);return;}
+      std::vector<CT::string> &variableNames=evaluator->variableNames;
+      size_t index=0;
+      while(index<variableNames.size()&&!variableNames[index].equals(&name))index++;
+      if(index==variableNames.size())variableNames.push_back(name);
+      emit(OP_LOAD,index,0);
+    }
+
+    void parse(){
+      parseExpression();
+      skipSpaces();
+      if(!failed&&expression[pos]!=0)error("unexpected character");
+    }
+};
+
+const char *CExpressionEvaluator::Parser::className="CExpressionEvaluator::Parser";
+
+CExpressionEvaluator::CExpressionEvaluator(){
+  maxDepth=0;
+}
+
+int CExpressionEvaluator::compile(const char *expression){
+  program.clear();
+  variableNames.clear();
+  maxDepth=0;
+  if(expression==NULL){
+    CDBError("No expression given");
+    return 1;
+  }
+  Parser parser(this,expression);
+  parser.parse();
+  if(parser.failed){
+    program.clear();
+    return 1;
+  }
+  if(maxDepth<1)maxDepth=1;
+  return 0;
+}
+
+/* Loops over the block, written out per operation so that the compiler can vectorize them */
+#define CEXPRESSIONEVALUATOR_UNARY(EXPR) {const float *a=stack[sp-1];float *r=workspace+(sp-1)*CEXPRESSIONEVALUATOR_BLOCKSIZE;for(size_t i=0;i<n;i++){r[i]=(EXPR);}stack[sp-1]=r;}
+#define CEXPRESSIONEVALUATOR_BINARY(EXPR) {const float *a=stack[sp-2],*b=stack[sp-1];float *r=workspace+(sp-2)*CEXPRESSIONEVALUATOR_BLOCKSIZE;for(size_t i=0;i<n;i++){r[i]=(EXPR);}stack[sp-2]=r;sp--;}
+
+void CExpressionEvaluator::evaluateBlock(const float * const *inputs,float *output,size_t n,float *workspace){
+  const float *stack[CEXPRESSIONEVALUATOR_MAXDEPTH+1];
+  int sp=0;
+  size_t numInstructions=program.size();
+  for(size_t j=0;j<numInstructions;j++){
+    const Instruction &instruction=program[j];
+    switch(instruction.op){
+      case OP_CONST:{
+        float *r=workspace+sp*CEXPRESSIONEVALUATOR_BLOCKSIZE;
+        float value=instruction.value;
+        for(size_t i=0;i<n;i++)r[i]=value;
+        stack[sp++]=r;
+        break;
+      }
+      case OP_LOAD:stack[sp++]=inputs[instruction.index];break;
+      case OP_NEG:CEXPRESSIONEVALUATOR_UNARY(-a[i]);break;
+      case OP_NOT:CEXPRESSIONEVALUATOR_UNARY(a[i]==0?1.0f:0.0f);break;
+      case OP_FUNC1:{
+        int f=instruction.index;
+        if(f==FUNC_ABS)CEXPRESSIONEVALUATOR_UNARY(fabsf(a[i]))
+        else if(f==FUNC_SQRT)CEXPRESSIONEVALUATOR_UNARY(sqrtf(a[i]))
+        else CEXPRESSIONEVALUATOR_UNARY(CExpressionEvaluator_function1(f,a[i]));
+        break;
+      }
+      case OP_ADD:CEXPRESSIONEVALUATOR_BINARY(a[i]+b[i]);break;
+      case OP_SUB:CEXPRESSIONEVALUATOR_BINARY(a[i]-b[i]);break;
+      case OP_MUL:CEXPRESSIONEVALUATOR_BINARY(a[i]*b[i]);break;
+      case OP_DIV:CEXPRESSIONEVALUATOR_BINARY(a[i]/b[i]);break;
+      case OP_MOD:CEXPRESSIONEVALUATOR_BINARY(fmodf(a[i],b[i]));break;
+      case OP_POW:CEXPRESSIONEVALUATOR_BINARY(powf(a[i],b[i]));break;
+      case OP_LT:CEXPRESSIONEVALUATOR_BINARY(a[i]<b[i]?1.0f:0.0f);break;
+      case OP_LE:CEXPRESSIONEVALUATOR_BINARY(a[i]<=b[i]?1.0f:0.0f);break;
+      case OP_GT:CEXPRESSIONEVALUATOR_BINARY(a[i]>b[i]?1.0f:0.0f);break;
+      case OP_GE:CEXPRESSIONEVALUATOR_BINARY(a[i]>=b[i]?1.0f:0.0f);break;
+      case OP_EQ:CEXPRESSIONEVALUATOR_BINARY(a[i]==b[i]?1.0f:0.0f);break;
+      case OP_NE:CEXPRESSIONEVALUATOR_BINARY(a[i]!=b[i]?1.0f:0.0f);break;
+      case OP_AND:CEXPRESSIONEVALUATOR_BINARY((a[i]!=0&&b[i]!=0)?1.0f:0.0f);break;
+      case OP_OR:CEXPRESSIONEVALUATOR_BINARY((a[i]!=0||b[i]!=0)?1.0f:0.0f);break;
+      case OP_FUNC2:{
+        int f=instruction.index;
+        if(f==FUNC_MIN)CEXPRESSIONEVALUATOR_BINARY(a[i]<b[i]?a[i]:b[i])
+        else if(f==FUNC_MAX)CEXPRESSIONEVALUATOR_BINARY(a[i]>b[i]?a[i]:b[i])
+        else CEXPRESSIONEVALUATOR_BINARY(CExpressionEvaluator_function2(f,a[i],b[i]));
+        break;
+      }
+      case OP_SELECT:{
+        const float *c=stack[sp-3],*a=stack[sp-2],*b=stack[sp-1];
+        float *r=workspace+(sp-3)*CEXPRESSIONEVALUATOR_BLOCKSIZE;
+        for(size_t i=0;i<n;i++)r[i]=c[i]!=0?a[i]:b[i];
+        stack[sp-3]=r;
+        sp-=2;
+        break;
+      }
+    }
+  }
+  if(stack[0]!=output){
+    memcpy(output,stack[0],n*sizeof(float));
+  }
+}
@@ -0,0 +1,92 @@
+/******************************************************************************
+ *
+ * Project:  ADAGUC Server
+ * Purpose:  Compiles arithmetic expressions to bytecode and evaluates them on blocks of data
+ * Date:     2026-10-18
+ *
+ ******************************************************************************
+ *
+ * Copyright 2026, Royal Netherlands Meteorological Institute (KNMI)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ******************************************************************************/
+
+#ifndef CEXPRESSIONEVALUATOR_H
+#define CEXPRESSIONEVALUATOR_H
+#include <vector>
+#include "CTypes.h"
+#include "CDebugger.h"
+
+/* Number of elements evaluated per instruction, small enough to stay in cache, large enough for the compiler to vectorize the loops */
+#define CEXPRESSIONEVALUATOR_BLOCKSIZE 256
+#define CEXPRESSIONEVALUATOR_MAXDEPTH 64
+
+/**
+ * Expression engine for DataPostProc algorithm="expression".
+ *
+ * Supported syntax, evaluated in float:
+ *   numbers, variable names, nodata (gives NaN)
+ *   + - * / % ^ (power), unary - and !
+ *   < <= > >= == != && || and the conditional c ? a : b
+ *   abs sqrt exp log log10 sin cos tan atan floor ceil round isnan (one argument)
+ *   pow min max atan2 hypot (two arguments)
+ * For example "pow(pow(10,dbz/10)/200,1/1.6)" or "temperature > 273.15 ? temperature - 273.15 : nodata".
+ *
+ * The expression is compiled into bytecode for a stack machine, constant subexpressions are folded.
+ * Each instruction is executed on a whole block of elements at once.
+ */
+class CExpressionEvaluator{
+  private:
+    DEF_ERRORFUNCTION();
+    class Instruction{
+      public:
+        int op;
+        int index;
+        float value;
+    };
+    class Parser;
+    std::vector<Instruction> program;
+    std::vector<CT::string> variableNames;
+    int maxDepth;
+    static float apply(int op,int index,float a,float b,float c);
+  public:
+    CExpressionEvaluator();
+
+    /**
+     * Compiles the expression
+     * @return Zero on success, the error is logged otherwise
+     */
+    int compile(const char *expression);
+
+    /**
+     * The variables used in the expression, the inputs of evaluateBlock are in this order
+     */
+    size_t getNumVariables(){return variableNames.size();}
+    const char *getVariableName(size_t index){return variableNames[index].c_str();}
+
+    /**
+     * Number of floats needed as workspace for evaluateBlock
+     */
+    size_t getWorkspaceSize(){return size_t(maxDepth)*CEXPRESSIONEVALUATOR_BLOCKSIZE;}
+
+    /**
+     * Evaluates the expression for n elements. Thread safe, as long as each thread has its own workspace.
+     * @param inputs For each variable a pointer to n values
+     * @param output Gets the n results, may be one of the inputs
+     * @param n Number of elements, at most CEXPRESSIONEVALUATOR_BLOCKSIZE
+     * @param workspace Memory of getWorkspaceSize() floats
+     */
+    void evaluateBlock(const float * const *inputs,float *output,size_t n,float *workspace);
+};
+#endif
@@ -0,0 +1,285 @@
+/******************************************************************************
+ *
+ * Project:  ADAGUC Server
+ * Purpose:  Statistics of data fields, calculated by the scanner and stored in the database
+ * Date:     2026-10-18
+ *
+ ******************************************************************************
+ *
+ * Copyright 2026, Royal Netherlands Meteorological Institute (KNMI)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <cmath>
+#include <stdlib.h>
+#include "CFieldStatistics.h"
+#include "CDBFactory.h"
+#include "CDFObjectStore.h"
+
+// #define CFIELDSTATISTICS_DEBUG
+
+const char *CFieldStatistics::className="CFieldStatistics";
+
+const double CFieldStatistics::percentileLevels[CFIELDSTATISTICS_NUMPERCENTILES]={1,5,10,25,50,75,90,95,99};
+
+CFieldStatistics::CFieldStatistics(){
+  min = 0;
+  max = 0;
+  avg = 0;
+  stddev = 0;
+  numSamples = 0;
+}
+
+void CFieldStatistics::calculate(const float *data,size_t size,int numBins){
+  double sum = 0;
+  float fMin = 0,fMax = 0;
+  numSamples = 0;
+  for(size_t j=0;j<size;j++){
+    float v = data[j];
+    if(v!=v||v==INFINITY||v==-INFINITY)continue;
+    if(numSamples == 0){
+      fMin = v;fMax = v;
+    }else{
+      if(v<fMin)fMin = v;
+      if(v>fMax)fMax = v;
+    }
+    sum+=v;
+    numSamples++;
+  }
+  min = fMin;
+  max = fMax;
+  avg = numSamples>0?sum/double(numSamples):0;
+  stddev = 0;
+
+  if(numBins<1)numBins = 1;
+  histogram.assign(numBins,0);
+  percentiles.assign(CFIELDSTATISTICS_NUMPERCENTILES,min);
+  if(numSamples == 0)return;
+
+  //A fine histogram is made in the same pass, the percentiles are interpolated from it instead of sorting the field
+  std::vector<size_t> fineHistogram(CFIELDSTATISTICS_PERCENTILEBINS,0);
+  double range = max-min;
+  double fineScale = range>0?CFIELDSTATISTICS_PERCENTILEBINS/range:0;
+  double scale = range>0?numBins/range:0;
+  //The variance is summed from the differences with the average, the sum of squares minus the squared sum loses all precision for large values
+  double sumDeviation = 0,sumSquaredDeviation = 0;
+  for(size_t j=0;j<size;j++){
+    float v = data[j];
+    if(v!=v||v==INFINITY||v==-INFINITY)continue;
+    double deviation = v-avg;
+    sumDeviation+=deviation;
+    sumSquaredDeviation+=deviation*deviation;
+    int fineBin = int((v-min)*fineScale);
+    if(fineBin>=CFIELDSTATISTICS_PERCENTILEBINS)fineBin = CFIELDSTATISTICS_PERCENTILEBINS-1;
+    fineHistogram[fineBin]++;
+    int bin = int((v-min)*scale);
+    if(bin>=numBins)bin = numBins-1;
+    histogram[bin]++;
+  }
+  if(numSamples>1){
+    //The sum of the deviations corrects the rounding of the average
+    double variance = (sumSquaredDeviation-sumDeviation*sumDeviation/double(numSamples))/double(numSamples-1);
+    stddev = variance>0?sqrt(variance):0;
+  }
+
+  size_t cumulative = 0;
+  int p = 0;
+  double binWidth = range/CFIELDSTATISTICS_PERCENTILEBINS;
+  for(int bin=0;bin<CFIELDSTATISTICS_PERCENTILEBINS&&p<CFIELDSTATISTICS_NUMPERCENTILES;bin++){
+    size_t count = fineHistogram[bin];
+    while(p<CFIELDSTATISTICS_NUMPERCENTILES&&double(cumulative+count)>=percentileLevels[p]/100.*numSamples){
+      double fraction = count>0?(percentileLevels[p]/100.*numSamples-cumulative)/count:0;
+      percentiles[p] = min+(bin+fraction)*binWidth;
+      p++;
+    }
+    cumulative+=count;
+  }
+  for(;p<CFIELDSTATISTICS_NUMPERCENTILES;p++)percentiles[p] = max;
+}
+
+CT::string CFieldStatistics::getPercentilesAsString(){
+  CT::string result;
+  for(size_t j=0;j<percentiles.size();j++){
+    if(j>0)result.concat(",");
+    result.printconcat("%.8g",percentiles[j]);
+  }
+  return result;
+}
+
+CT::string CFieldStatistics::getHistogramAsString(){
+  CT::string result;
+  for(size_t j=0;j<histogram.size();j++){
+    if(j>0)result.concat(",");
+    result.printconcat("%lu",(unsigned long)histogram[j]);
+  }
+  return result;
+}
+
+int CFieldStatistics::scanFile(CDataSource *dataSource,const char *fileName){
+  if(dataSource->cfgLayer->FieldStatistics.size()==0)return 0;
+  int numBins = CFIELDSTATISTICS_DEFAULT_BINS;
+  if(!dataSource->cfgLayer->FieldStatistics[0]->attr.bins.empty()){
+    numBins = dataSource->cfgLayer->FieldStatistics[0]->attr.bins.toInt();
+    if(numBins<1)numBins = CFIELDSTATISTICS_DEFAULT_BINS;
+  }
+
+  CDFObject *cdfObject = NULL;
+  try{
+    cdfObject = CDFObjectStore::getCDFObjectStore()->getCDFObject(dataSource,fileName);
+  }catch(int e){
+  }
+  if(cdfObject == NULL){
+    CDBError("Unable to open file %s",fileName);
+    return 1;
+  }
+
+  CDBFactory::getDBAdapter(dataSource->srvParams->cfg)->removeFieldStatistics(fileName);
+  int status = 0;
+  for(size_t v=0;v<dataSource->cfgLayer->Variable.size();v++){
+    CDF::Variable *variable = cdfObject->getVariableNE(dataSource->cfgLayer->Variable[v]->value.c_str());
+    if(variable == NULL){
+      CDBError("Variable %s not found in %s",dataSource->cfgLayer->Variable[v]->value.c_str(),fileName);
+      status = 1;
+      continue;
+    }
+    if(scanVariable(dataSource,variable,fileName,numBins)!=0)status = 1;
+  }
+  return status;
+}
+
+int CFieldStatistics::scanVariable(CDataSource *dataSource,CDF::Variable *variable,const char *fileName,int numBins){
+  size_t numDims = variable->dimensionlinks.size();
+  if(numDims<2){
+    return 0;
+  }
+  size_t height = variable->dimensionlinks[numDims-2]->getSize();
+  size_t width = variable->dimensionlinks[numDims-1]->getSize();
+  size_t numFields = 1;
+  for(size_t d=0;d<numDims-2;d++)numFields*=variable->dimensionlinks[d]->getSize();
+
+  //Scale and offset are applied here, applyScaleOffset in readData would change the _FillValue of the cached file
+  double scaleFactor=1,addOffset=0,fillValue=0;
+  bool hasFillValue = false;
+  CDF::Attribute *attr = variable->getAttributeNE("scale_factor");
+  if(attr!=NULL)attr->getData(&scaleFactor,1);
+  attr = variable->getAttributeNE("add_offset");
+  if(attr!=NULL)attr->getData(&addOffset,1);
+  attr = variable->getAttributeNE("_FillValue");
+  if(attr!=NULL){attr->getData(&fillValue,1);hasFillValue=true;}
+  float fFillValue = (float)fillValue;
+
+  CDBAdapter *dbAdapter = CDBFactory::getDBAdapter(dataSource->srvParams->cfg);
+  size_t start[numDims],count[numDims];
+  ptrdiff_t stride[numDims];
+  int status = 0;
+  for(size_t field=0;field<numFields&&status==0;field++){
+    //Decompose the field number into the indices of the non spatial dimensions, the last one varies fastest
+    CT::string fieldIndex;
+    size_t rest = field;
+    for(int d=int(numDims)-3;d>=0;d--){
+      size_t size = variable->dimensionlinks[d]->getSize();
+      start[d] = rest%size;
+      rest/=size;
+    }
+    for(size_t d=0;d<numDims-2;d++){
+      count[d] = 1;
+      stride[d] = 1;
+      if(d>0)fieldIndex.concat(",");
+      fieldIndex.printconcat("%lu",(unsigned long)start[d]);
+    }
+    start[numDims-2] = 0;start[numDims-1] = 0;
+    count[numDims-2] = height;count[numDims-1] = width;
+    stride[numDims-2] = 1;stride[numDims-1] = 1;
+
+    variable->freeData();
+    if(variable->readData(CDF_FLOAT,start,count,stride)!=0){
+      CDBError("Unable to read variable %s from %s",variable->name.c_str(),fileName);
+      status = 1;
+      break;
+    }
+    float *data = (float*)variable->data;
+    size_t size = width*height;
+    for(size_t j=0;j<size;j++){
+      if(hasFillValue&&data[j]==fFillValue){
+        data[j]=NAN;
+      }else{
+        data[j]=data[j]*scaleFactor+addOffset;
+      }
+    }
+    CFieldStatistics statistics;
+    statistics.calculate(data,size,numBins);
+    if(statistics.numSamples == 0){
+      continue;
+    }
+    #ifdef CFIELDSTATISTICS_DEBUG
+    CDBDebug("%s %s [%s]: min %f max %f",fileName,variable->name.c_str(),fieldIndex.c_str(),statistics.min,statistics.max);
+    #endif
+    if(dbAdapter->storeFieldStatistics(fileName,variable->name.c_str(),fieldIndex.c_str(),statistics.min,statistics.max,statistics.avg,statistics.stddev,
+                                       statistics.getPercentilesAsString().c_str(),statistics.getHistogramAsString().c_str())!=0){
+      status = 1;
+    }
+  }
+  variable->freeData();
+  return status;
+}
+
+int CFieldStatistics::removeFile(CDataSource *dataSource,const char *fileName){
+  if(dataSource->cfgLayer->FieldStatistics.size()==0)return 0;
+  return CDBFactory::getDBAdapter(dataSource->srvParams->cfg)->removeFieldStatistics(fileName);
+}
+
+int CFieldStatistics::load(CDataSource *dataSource){
+  if(dataSource->cfgLayer->FieldStatistics.size()==0)return 1;
+  CDF::Variable *variable = dataSource->getDataObject(0)->cdfVariable;
+  if(variable == NULL)return 1;
+
+  //The same indices as used by CDataReader to read the field
+  CT::string fieldIndex;
+  size_t numDims = variable->dimensionlinks.size();
+  for(size_t d=0;d+2<numDims;d++){
+    if(d>0)fieldIndex.concat(",");
+    fieldIndex.printconcat("%lu",(unsigned long)dataSource->getDimensionIndex(variable->dimensionlinks[d]->name.c_str()));
+  }
+
+  CDBStore::Store *store = CDBFactory::getDBAdapter(dataSource->srvParams->cfg)->getFieldStatistics(dataSource->getFileName(),variable->name.c_str(),fieldIndex.c_str());
+  if(store == NULL||store->getSize()==0){
+    delete store;
+    return 1;
+  }
+  CDBStore::Record *record = store->getRecord(0);
+  min = record->get(0)->toDouble();
+  max = record->get(1)->toDouble();
+  avg = record->get(2)->toDouble();
+  stddev = record->get(3)->toDouble();
+
+  percentiles.clear();
+  CT::string *items = record->get(4)->splitToArray(",");
+  for(size_t j=0;j<items->count;j++)percentiles.push_back(items[j].toDouble());
+  delete[] items;
+
+  histogram.clear();
+  numSamples = 0;
+  items = record->get(5)->splitToArray(",");
+  for(size_t j=0;j<items->count;j++){
+    histogram.push_back(strtoul(items[j].c_str(),NULL,10));
+    numSamples+=histogram.back();
+  }
+  delete[] items;
+  delete store;
+  #ifdef CFIELDSTATISTICS_DEBUG
+  CDBDebug("Loaded statistics for %s %s [%s]: min %f max %f",dataSource->getFileName(),variable->name.c_str(),fieldIndex.c_str(),min,max);
+  #endif
+  return 0;
+}
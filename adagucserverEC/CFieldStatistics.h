@@ -0,0 +1,91 @@
+/******************************************************************************
+ *
+ * Project:  ADAGUC Server
+ * Purpose:  Statistics of data fields, calculated by the scanner and stored in the database
+ * Date:     2026-10-18
+ *
+ ******************************************************************************
+ *
+ * Copyright 2026, Royal Netherlands Meteorological Institute (KNMI)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ******************************************************************************/
+
+#ifndef CFIELDSTATISTICS_H
+#define CFIELDSTATISTICS_H
+#include <vector>
+#include "CDataSource.h"
+#include "CDebugger.h"
+
+#define CFIELDSTATISTICS_DEFAULT_BINS 100
+
+/* Number of bins of the histogram from which the percentiles are interpolated */
+#define CFIELDSTATISTICS_PERCENTILEBINS 4096
+
+/* Number of percentiles, see CFieldStatistics::percentileLevels */
+#define CFIELDSTATISTICS_NUMPERCENTILES 9
+
+/**
+ * Minimum, maximum, average, standard deviation, percentiles and histogram of one 2D field.
+ *
+ * Configured with <FieldStatistics bins="100"/> in a Layer. The scanner calculates the statistics of every field
+ * of the layer variables in new or changed files, and stores them with the CDBAdapter. A field is identified by
+ * the file, the variable and the indices of the non spatial dimensions, e.g. "3,0" for (time,height,y,x).
+ * CDataReader uses the stored minimum and maximum for stretchMinMax, so auto-stretched layers do not need an
+ * extra pass over the data and get the same range for every tile of a time step.
+ */
+class CFieldStatistics{
+  private:
+    DEF_ERRORFUNCTION();
+    static int scanVariable(CDataSource *dataSource,CDF::Variable *variable,const char *fileName,int numBins);
+  public:
+    double min,max,avg,stddev;
+    size_t numSamples;
+    std::vector<double> percentiles;  //Values at percentileLevels
+    std::vector<size_t> histogram;    //Number of values in equally sized bins between min and max
+    static const double percentileLevels[CFIELDSTATISTICS_NUMPERCENTILES];
+
+    CFieldStatistics();
+
+    /**
+     * Calculates the statistics
+     * @param data The values, NaN for nodata
+     * @param size Number of values
+     * @param numBins Number of histogram bins
+     */
+    void calculate(const float *data,size_t size,int numBins);
+
+    CT::string getPercentilesAsString();
+    CT::string getHistogramAsString();
+
+    /**
+     * Calculates and stores the statistics of all fields in a file. Does nothing when the layer has no FieldStatistics.
+     * @param dataSource The layer being scanned
+     * @param fileName The file
+     * @return Zero on success
+     */
+    static int scanFile(CDataSource *dataSource,const char *fileName);
+
+    /**
+     * Removes the statistics of a file which is removed from the database. Does nothing when the layer has no FieldStatistics.
+     */
+    static int removeFile(CDataSource *dataSource,const char *fileName);
+
+    /**
+     * Loads the statistics of the field read by CDataReader for the current time step of the first data object
+     * @return Zero on success, 1 when the layer has no FieldStatistics or the field has not been scanned
+     */
+    int load(CDataSource *dataSource);
+};
+#endif
@@ -26,6 +26,7 @@
 #include "Definitions.h"
 #ifdef ADAGUC_USE_GDAL
 #include "CGDALDataWriter.h"
+#include "CReadFile.h"
 
 #define CGDALDATAWRITER_DEBUG
 
@@ -633,9 +634,13 @@ int  CGDALDataWriter::end(){
     printf("Content-Description: File Transfer\r\n");
     printf("Content-Transfer-Encoding: binary\r\n");
     printf("Content-Length: %zu\r\n",endPos); 
+    CTracer::printServerTimingHeader();
     printf("%s\r\n\r\n",mimeType.c_str());
-    for(size_t j=0;j<endPos;j++)putchar(getc(fp));
     fclose(fp);
+    if(CReadFile::sendToStdout(tmpFileName.c_str())!=CREADFILE_OK){
+      CDBError("Unable to stream %s",tmpFileName.c_str());
+      returnCode = 1;
+    }
     fclose(stdout);
   }
   //Remove temporary files
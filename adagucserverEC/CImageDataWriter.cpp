@@ -34,6 +34,7 @@
 #include "CImageDataWriter.h"
 #include "CMakeJSONTimeSeries.h"
 #include "CMakeEProfile.h"
+#include "CCDFTypedView.h"
 #ifndef M_PI
 #define M_PI            3.14159265358979323846  // pi 
 #endif
@@ -49,7 +50,9 @@
 CT::string months[] = {"Jan","Feb","Mar","Apr","May","Jun","Jul","Aug","Sep","Oct","Nov","Dec"};
 
 //  #define CIMAGEDATAWRITER_DEBUG
-//  #define MEASURETIME
+
+/* Maximum number of data layers of one GetMap which are warped at the same time */
+#define CIMAGEDATAWRITER_MAXLAYERTHREADS 8
 
 
 
@@ -58,14 +61,12 @@ void rotateUvNorth(double &u, double &v, double rlo, double rla, float deltaX, f
 
 std::map<std::string,CImageDataWriter::ProjCacheInfo> CImageDataWriter::projCacheMap;
 std::map<std::string,CImageDataWriter::ProjCacheInfo>::iterator CImageDataWriter::projCacheIter;
+bool CImageDataWriter::warpLayersEnabled = true;
 
 CImageDataWriter::ProjCacheInfo CImageDataWriter::GetProjInfo(CT::string ckey, CDrawImage *drawImage, CDataSource *dataSource,CImageWarper *imageWarper,CServerParams *srvParam,int dX,int dY){
   std::string key=ckey.c_str();
   ProjCacheInfo projCacheInfo ;
-  
-  #ifdef MEASURETIME
-  StopWatch_Stop("projCacheInfo");
-  #endif
+  CTracer::Span projInfoSpan("projinfo");
   
   //bool projInvertedFirst = true;
   try{
@@ -76,10 +77,6 @@ CImageDataWriter::ProjCacheInfo CImageDataWriter::GetProjInfo(CT::string ckey, C
       throw 1;
     }
     projCacheInfo = (*projCacheIter).second;
-    
-    #ifdef MEASURETIME
-    StopWatch_Stop("found cache projCacheInfo");
-    #endif
   }catch(int e){
     projCacheInfo.isOutsideBBOX = false;
     #ifdef CIMAGEDATAWRITER_DEBUG  
@@ -255,6 +252,51 @@ class PlotObject{
 
 const char * CImageDataWriter::className = "CImageDataWriter";
 
+enum ConditionalOperator{ myand,myor,between,notbetween,lessthan,greaterthan};
+
+/**
+ * Evaluates the condition of one input of a boolean map for every pixel of the output grid, the input is sampled nearest neighbour
+ */
+class BooleanMapConditionKernel{
+  public:
+  int width,height;
+  int sourceWidth,sourceHeight;
+  bool flipY;
+  ConditionalOperator expression;
+  float low,high;
+  bool *result;
+  template <class T>
+  void run(CDF::TypedView<T> source){
+    std::vector<int> columns(width);
+    for(int x=0;x<width;x++)columns[x]=int((float(x)/float(width))*float(sourceWidth));
+    for(int y=0;y<height;y++){
+      int yj=int((float(y)/float(height))*float(sourceHeight));
+      if(flipY)yj=sourceHeight-yj-1;
+      const T *sourceRow = source.data+size_t(yj)*sourceWidth;
+      bool *resultRow = result+size_t(y)*width;
+      switch(expression){
+        case between   : for(int x=0;x<width;x++){double v=sourceRow[columns[x]];resultRow[x]=v>=low&&v<=high;}break;
+        case notbetween: for(int x=0;x<width;x++){double v=sourceRow[columns[x]];resultRow[x]=v<low||v>high;}break;
+        case lessthan  : for(int x=0;x<width;x++){double v=sourceRow[columns[x]];resultRow[x]=v<low;}break;
+        case greaterthan:for(int x=0;x<width;x++){double v=sourceRow[columns[x]];resultRow[x]=v>low;}break;
+        default        : for(int x=0;x<width;x++)resultRow[x]=false;break;
+      }
+    }
+  }
+};
+
+/**
+ * Writes the combined boolean map as 1 and 0 into the data of the first datasource
+ */
+class BooleanMapWriteKernel{
+  public:
+  const bool *map;
+  template <class T>
+  void run(CDF::TypedView<T> destination){
+    for(size_t j=0;j<destination.size;j++)destination[j]=map[j]?(T)1:(T)0;
+  }
+};
+
 CImageDataWriter::CImageDataWriter(){
   
   //Mode can be "uninitialized"0 "initialized"(1) and "finished" (2)
@@ -298,14 +340,7 @@ int CImageDataWriter::_setTransparencyAndBGColor(CServerParams *srvParam,CDrawIm
   return 0;
 }
 
-int CImageDataWriter::drawCascadedWMS(CDataSource * dataSource, const char *service,const char *layers, const char *styles,bool transparent, const char *bgcolor){
-
-#ifndef ENABLE_CURL
-  CDBError("CURL not enabled");
-  return 1;
-#endif
-
-#ifdef ENABLE_CURL
+CT::string CImageDataWriter::getCascadedWMSURL(const char *service,const char *layers, const char *styles,bool transparent, const char *bgcolor){
   bool trueColor=drawImage.getTrueColor();
  // transparent=true;
   CT::string url=service;
@@ -339,61 +374,45 @@ int CImageDataWriter::drawCascadedWMS(CDataSource * dataSource, const char *serv
     url.printconcat("&%s=%s",srvParam->requestDims[k]->name.c_str(),srvParam->requestDims[k]->value.c_str());
   }
   CDBDebug(url.c_str());
-  gdImagePtr gdImage;
-  
+  return url;
+}
+
+int CImageDataWriter::drawCascadedWMS(CDataSource * dataSource, gdImagePtr gdImage, bool transparent){
+  /* The error is already reported by the fetcher */
+  if(gdImage==NULL)return 1;
 
+  int w=gdImageSX(gdImage);
+  int h=gdImageSY(gdImage);
   
-  MyCURL myCURL;
-  int status  = myCURL.getGDImageField(url.c_str(),gdImage);
-  if(status==0){
-    if(gdImage){
-      int w=gdImageSX(gdImage);
-      int h=gdImageSY(gdImage);
-      
-      int offsetx=0;
-      int offsety=0;
-      if(dataSource->cfgLayer->Position.size()>0){
-        CServerConfig::XMLE_Position * pos=dataSource->cfgLayer->Position[0];
-        if(pos->attr.right.empty()==false)offsetx=(drawImage.Geo->dWidth-w)-parseInt(pos->attr.right.c_str());
-        if(pos->attr.bottom.empty()==false)offsety=(drawImage.Geo->dHeight-h)-parseInt(pos->attr.bottom.c_str());
-        if(pos->attr.left.empty()==false)offsetx=parseInt(pos->attr.left.c_str());
-        if(pos->attr.top.empty()==false)offsety=parseInt(pos->attr.top.c_str());
-        
-      }
-      
-      /*if(drawImage.Geo->dHeight!=h||drawImage.Geo->dWidth!=w){
-        gdImageDestroy(gdImage);
-        CDBError("Returned cascaded WMS image size is not the same as requested image size");
-        return 1;
-      }*/
-      
-      int transpColor=gdImageGetTransparent(gdImage);
-      for(int y=0;y<drawImage.Geo->dHeight&&y<h;y++){
-        for(int x=0;x<drawImage.Geo->dWidth&&x<w;x++){
-          int color = gdImageGetPixel(gdImage, x, y);
-          if(color!=transpColor&&127!=gdImageAlpha(gdImage,color)){
-            if(transparent){
-              drawImage.setPixelTrueColor(x+offsetx,y+offsety,gdImageRed(gdImage,color),gdImageGreen(gdImage,color),gdImageBlue(gdImage,color),255-gdImageAlpha(gdImage,color)*2);
-            }
-            else
-              drawImage.setPixelTrueColor(x+offsetx,y+offsety,gdImageRed(gdImage,color),gdImageGreen(gdImage,color),gdImageBlue(gdImage,color));
-          }
+  int offsetx=0;
+  int offsety=0;
+  if(dataSource->cfgLayer->Position.size()>0){
+    CServerConfig::XMLE_Position * pos=dataSource->cfgLayer->Position[0];
+    if(pos->attr.right.empty()==false)offsetx=(drawImage.Geo->dWidth-w)-parseInt(pos->attr.right.c_str());
+    if(pos->attr.bottom.empty()==false)offsety=(drawImage.Geo->dHeight-h)-parseInt(pos->attr.bottom.c_str());
+    if(pos->attr.left.empty()==false)offsetx=parseInt(pos->attr.left.c_str());
+    if(pos->attr.top.empty()==false)offsety=parseInt(pos->attr.top.c_str());
+    
+  }
+  
+  /*if(drawImage.Geo->dHeight!=h||drawImage.Geo->dWidth!=w){
+    CDBError("Returned cascaded WMS image size is not the same as requested image size");
+    return 1;
+  }*/
+  
+  int transpColor=gdImageGetTransparent(gdImage);
+  for(int y=0;y<drawImage.Geo->dHeight&&y<h;y++){
+    for(int x=0;x<drawImage.Geo->dWidth&&x<w;x++){
+      int color = gdImageGetPixel(gdImage, x, y);
+      if(color!=transpColor&&127!=gdImageAlpha(gdImage,color)){
+        if(transparent){
+          drawImage.setPixelTrueColor(x+offsetx,y+offsety,gdImageRed(gdImage,color),gdImageGreen(gdImage,color),gdImageBlue(gdImage,color),255-gdImageAlpha(gdImage,color)*2);
         }
+        else
+          drawImage.setPixelTrueColor(x+offsetx,y+offsety,gdImageRed(gdImage,color),gdImageGreen(gdImage,color),gdImageBlue(gdImage,color));
       }
-      gdImageDestroy(gdImage);
-    }else{
-      CT::string u=url.c_str();u.encodeURLSelf();
-      CDBError("Invalid image %s",u.c_str());
-      return 1;
     }
-  }else{
-    CT::string u=url.c_str();u.encodeURLSelf();
-    CDBError("Unable to get image %s",u.c_str());
-    return 1;
   }
-  return 0;
-#endif
-
   return 0;
 }
 
@@ -639,9 +658,7 @@ void CImageDataWriter::setValue(CDFType type,void *data,size_t ptr,double pixel)
 
 int CImageDataWriter::getFeatureInfo(std::vector<CDataSource *>dataSources,int dataSourceIndex,int dX,int dY){
   CImageWarper imageWarper;
-  #ifdef MEASURETIME
-  StopWatch_Stop("getFeatureInfo");
-  #endif
+  CTracer::Span featureInfoSpan("featureinfo");
   
   #ifdef CIMAGEDATAWRITER_DEBUG
   CDBDebug("[getFeatureInfo] %d, %d, [%d,%d]", dataSources.size(), dataSourceIndex, dX, dY);
@@ -723,6 +740,7 @@ int CImageDataWriter::getFeatureInfo(std::vector<CDataSource *>dataSources,int d
         }      
         CDBDebug("CMakeEProfile::MakeEProfile done");
       }else{
+        CTracer::printServerTimingHeader();
         printf("%s%c%c\n","Content-Type:text/plain",13,10);
         printf("Not supported yet");
         return 0;
@@ -739,10 +757,19 @@ int CImageDataWriter::getFeatureInfo(std::vector<CDataSource *>dataSources,int d
       
       std::map<std::string, bool>dimensionKeyValueMap;//A map for every dimensionvalue linked to a value
       
-      
+      //Read the files of the next steps ahead, the files are opened one by one. With openAll the data of each file is read as well.
+      CFilePrefetcher prefetcher;
+      if(openAll||sameHeaderForAll){
+        for(int step=0;step<dataSources[d]->getNumTimeSteps();step++){
+          dataSources[d]->setTimeStep(step);
+          prefetcher.addFile(dataSources[d]->getFileName(),openAll);
+        }
+        prefetcher.start(CMakeJSONTimeSeries::getReadAhead(dataSources[d]));
+      }
       
       for(int step=0;step<dataSources[d]->getNumTimeSteps();step++){
         dataSources[d]->setTimeStep(step);
+        prefetcher.setCurrentFile(dataSources[d]->getFileName());
         
         CCDFDims * cdfDims = dataSources[d]->getCDFDims();
         
@@ -802,9 +829,6 @@ int CImageDataWriter::getFeatureInfo(std::vector<CDataSource *>dataSources,int d
         ckey.print("%d:%d:%d:%d:%s:%f:%f:%f:%f",dX,dY,dataSource->dWidth,dataSource->dHeight,dataSource->nativeProj4.c_str(),dataSource->dfBBOX[0],dataSource->dfBBOX[1],dataSource->dfBBOX[2],dataSource->dfBBOX[3]);
         CImageDataWriter::ProjCacheInfo projCacheInfo = GetProjInfo(ckey,&drawImage,dataSource,&imageWarper,srvParam,dX,dY);
         //CDBDebug("key = %s",ckey.c_str());
-        #ifdef MEASURETIME
-        StopWatch_Stop("/projCacheInfo");
-        #endif
         //CDBDebug("ProjRes = (%d,%d)(%f,%f)(%f,%f)(%f,%f)",projCacheInfo.imx,projCacheInfo.imy,projCacheInfo.CoordX,projCacheInfo.CoordY,projCacheInfo.nativeCoordX,projCacheInfo.nativeCoordY,projCacheInfo.lonX,projCacheInfo.lonY);
         
         // Projections coordinates in latlon
@@ -1351,6 +1375,7 @@ int CImageDataWriter::createAnimation(){
   CDBDebug("[createAnimation]");
   #endif
   if(drawImage.getRenderer() == CDRAWIMAGERENDERER_GD){
+    CTracer::printServerTimingHeader();
     printf("%s%c%c\n","Content-Type:image/gif",13,10);
   }
   drawImage.beginAnimation();
@@ -1417,15 +1442,7 @@ int CImageDataWriter::warpImage(CDataSource *dataSource,CDrawImage *drawImage){
 
   CDataReader reader;
   pthread_mutex_lock(&CImageDataWriter_addData_lock);
-  #ifdef MEASURETIME
-  StopWatch_Stop("Thread[%d]: start Opening grid",dataSource->threadNr);
-#endif
-
   status = reader.open(dataSource,CNETCDFREADER_MODE_OPEN_ALL);
-  #ifdef MEASURETIME
-  StopWatch_Stop("Thread[%d]: Opened grid",dataSource->threadNr);
-#endif
-
   pthread_mutex_unlock(&CImageDataWriter_addData_lock);
  //return 0;
   #ifdef CIMAGEDATAWRITER_DEBUG  
@@ -1440,9 +1457,7 @@ int CImageDataWriter::warpImage(CDataSource *dataSource,CDrawImage *drawImage){
   #endif  
  
 
-#ifdef MEASURETIME
-  StopWatch_Stop("Thread[%d]: warp start",dataSource->threadNr);
-#endif
+  CTracer::Span warpSpan("warp");
 
 /*if(renderMethod==nearest){CDBDebug("nearest");}
 if(renderMethod==bilinear){CDBDebug("bilinear");}
@@ -1661,9 +1676,7 @@ if(renderMethod==contour){CDBDebug("contour");}*/
       
     }
   }
-#ifdef MEASURETIME
-  StopWatch_Stop("Thread[%d]: warp finished",dataSource->threadNr);
-#endif
+  warpSpan.stop();
   //imageWarper.closereproj();
   reader.close();
   
@@ -1727,8 +1740,6 @@ int CImageDataWriter::calculateData(std::vector <CDataSource*>&dataSources){
     if(hasFailed==false){
       //Start modifying the data using the specific style
       
-      enum ConditionalOperator{ myand,myor,between,notbetween,lessthan,greaterthan};
-      
       ConditionalOperator combineBooleanMapExpression[dataSources.size()-1];
       ConditionalOperator inputMapExpression[dataSources.size()];
       float inputMapExprValuesLow[dataSources.size()];
@@ -1804,50 +1815,43 @@ int CImageDataWriter::calculateData(std::vector <CDataSource*>&dataSources){
       }
       
       CDBDebug("Start creating the boolean map");
-      double pixel[dataSources.size()];
-      bool conditialMap[dataSources.size()];
-      for(int y=0;y<dataSource->dHeight;y++){
-        for(int x=0;x<dataSource->dWidth;x++){
-          size_t ptr=x+y*dataSource->dWidth;
-          for(size_t j=1;j<dataSources.size();j++){
-            CDataSource *dsj = dataSources[j];
-            int xj=int((float(x)/float(dataSource->dWidth))*float(dsj->dWidth));
-            int yj=int((float(y)/float(dataSource->dHeight))*float(dsj->dHeight));
-            if(dsj->dfBBOX[1]>dsj->dfBBOX[3])yj=dsj->dHeight-yj-1;
-            size_t ptrj=xj+yj*dsj->dWidth;
-            
-            pixel[j] = convertValue(dsj->getDataObject(0)->cdfVariable->getType(),dsj->getDataObject(0)->cdfVariable->data,ptrj);
-            
-            if(inputMapExpression[j]==between){
-              if(pixel[j]>=inputMapExprValuesLow[j]&&pixel[j]<=inputMapExprValuesHigh[j])
-                conditialMap[j]=true;else conditialMap[j]=false;
-            }
-            if(inputMapExpression[j]==notbetween){
-              if(pixel[j]<inputMapExprValuesLow[j]||pixel[j]>inputMapExprValuesHigh[j])
-                conditialMap[j]=true;else conditialMap[j]=false;
-            }
-            if(inputMapExpression[j]==lessthan){
-              if(pixel[j]<inputMapExprValuesLow[j])
-                conditialMap[j]=true;else conditialMap[j]=false;
-            }
-            if(inputMapExpression[j]==greaterthan){
-              if(pixel[j]>inputMapExprValuesLow[j])
-                conditialMap[j]=true;else conditialMap[j]=false;
-            }
+      size_t imageSize = size_t(dataSource->dWidth)*size_t(dataSource->dHeight);
+      std::vector<bool*> conditionalMaps(dataSources.size(),(bool*)NULL);
+      for(size_t j=1;j<dataSources.size()&&hasFailed==false;j++){
+        CDataSource *dsj = dataSources[j];
+        conditionalMaps[j] = new bool[imageSize];
+        BooleanMapConditionKernel conditionKernel;
+        conditionKernel.width = dataSource->dWidth;
+        conditionKernel.height = dataSource->dHeight;
+        conditionKernel.sourceWidth = dsj->dWidth;
+        conditionKernel.sourceHeight = dsj->dHeight;
+        conditionKernel.flipY = dsj->dfBBOX[1]>dsj->dfBBOX[3];
+        conditionKernel.expression = inputMapExpression[j];
+        conditionKernel.low = inputMapExprValuesLow[j];
+        conditionKernel.high = inputMapExprValuesHigh[j];
+        conditionKernel.result = conditionalMaps[j];
+        if(CDF::dispatch(dsj->getDataObject(0)->cdfVariable->getType(),dsj->getDataObject(0)->cdfVariable->data,dsj->getDataObject(0)->cdfVariable->getSize(),conditionKernel)!=0){
+          CDBError("Unknown data type for boolean map");
+          hasFailed=true;
+        }
+      }
+      if(hasFailed==false&&dataSources.size()>1){
+        bool *result = conditionalMaps[1];
+        for(size_t j=2;j<dataSources.size();j++){
+          const bool *conditialMap = conditionalMaps[j];
+          if(combineBooleanMapExpression[j-2]==myand){
+            for(size_t p=0;p<imageSize;p++)result[p]=result[p]&&conditialMap[p];
           }
-          bool result = conditialMap[1];
-          for(size_t j=2;j<dataSources.size();j++){
-            if(combineBooleanMapExpression[j-2]==myand){
-              if(result==true&&conditialMap[j]==true)result=true;else result=false;
-            }
-            if(combineBooleanMapExpression[j-2]==myor){
-              if(result==true||conditialMap[j]==true)result=true;else result=false;
-            }
+          if(combineBooleanMapExpression[j-2]==myor){
+            for(size_t p=0;p<imageSize;p++)result[p]=result[p]||conditialMap[p];
           }
-          if(result==true)pixel[0]=1;else pixel[0]=0;
-          setValue(dataSources[0]->getDataObject(0)->cdfVariable->getType(),dataSources[0]->getDataObject(0)->cdfVariable->data,ptr,pixel[0]);
         }
+        BooleanMapWriteKernel writeKernel;
+        writeKernel.map = result;
+        CDF::Variable *destVariable = dataSources[0]->getDataObject(0)->cdfVariable;
+        CDF::dispatch(destVariable->getType(),destVariable->data,imageSize,writeKernel);
       }
+      for(size_t j=0;j<conditionalMaps.size();j++)delete[] conditionalMaps[j];
       CDBDebug("Warping with style %s",srvParam->Styles.c_str());
       CImageWarperRenderInterface *imageWarperRenderer;
       imageWarperRenderer = new CImgWarpNearestNeighbour();
@@ -1888,6 +1892,129 @@ int CImageDataWriter::calculateData(std::vector <CDataSource*>&dataSources){
 }
 
 
+CImageDataWriter::LayerImages::LayerImages(size_t numLayers){
+  images.resize(numLayers,NULL);
+  status.resize(numLayers,0);
+  dataSources = NULL;
+  imageDataWriter = NULL;
+  parentSpan = NULL;
+  nextLayer = 0;
+  pthread_mutex_init(&lock,NULL);
+}
+
+CImageDataWriter::LayerImages::~LayerImages(){
+  for(size_t j=0;j<images.size();j++){
+    delete images[j];
+  }
+  pthread_mutex_destroy(&lock);
+}
+
+void *CImageDataWriter::warpLayersThread(void *arg){
+  LayerImages *layerImages = (LayerImages*)arg;
+  /* The warp spans get the same names as when the layers are warped one after another */
+  CTracer::Span *previousSpan = CTracer::getCurrentSpan();
+  CTracer::setCurrentSpan(layerImages->parentSpan);
+  while(true){
+    pthread_mutex_lock(&layerImages->lock);
+    while(layerImages->nextLayer<layerImages->images.size()&&layerImages->images[layerImages->nextLayer]==NULL){
+      layerImages->nextLayer++;
+    }
+    size_t j = layerImages->nextLayer++;
+    pthread_mutex_unlock(&layerImages->lock);
+    if(j>=layerImages->images.size())break;
+    CDrawImage *layerImage = layerImages->images[j];
+    layerImages->status[j] = layerImages->imageDataWriter->warpImage((*layerImages->dataSources)[j],layerImage);
+  }
+  CTracer::setCurrentSpan(previousSpan);
+  return NULL;
+}
+
+void CImageDataWriter::setWarpLayersEnabled(bool enable){
+  warpLayersEnabled = enable;
+}
+
+int CImageDataWriter::warpLayers(std::vector <CDataSource*>&dataSources,LayerImages &layerImages){
+  /* Layer images are only possible in true color, a worker thread of an animation draws its layers itself */
+  if(!warpLayersEnabled||drawImage.getRenderer()!=CDRAWIMAGERENDERER_CAIRO||dataSources[0]->threadNr!=-1){
+    return 0;
+  }
+  /* Contours, labels, vectors, points and lines are drawn by cairo, which blends premultiplied. Compositing their
+     edges like pixel_blend would darken them. Only styles which set pixels are warped in a layer image. */
+  const CStyleConfiguration::RenderMethod pixelRenderMethods = RM_NEAREST|RM_AVG_RGBA|RM_RGBA|RM_BILINEAR|RM_SHADED;
+  /* Layers of the same file share one CDFObject from CDFObjectStore, CDataReader::open frees and reallocates the data
+     of its variables. Only the first layer of a file is warped in a layer image, the others are drawn in drawImage. */
+  std::vector<bool> useLayerImage(dataSources.size(),false);
+  std::set<std::string> layerFiles;
+  size_t numDataLayers = 0;
+  for(size_t j=0;j<dataSources.size();j++){
+    if(dataSources[j]->dLayerType==CConfigReaderLayerTypeCascaded)continue;
+    CStyleConfiguration::RenderMethod renderMethod = dataSources[j]->getStyle()->renderMethod;
+    if(renderMethod==RM_UNDEFINED||(renderMethod&~pixelRenderMethods)!=0)continue;
+    const char *fileName = dataSources[j]->getFileName();
+    if(fileName==NULL||!layerFiles.insert(fileName).second)continue;
+    useLayerImage[j] = true;
+    numDataLayers++;
+  }
+  if(numDataLayers<2){
+    return 0;
+  }
+  
+  /* Each layer image gets the palette which drawImage would have while drawing that layer, the last legend of the layers before it */
+  int legendIndex = -1;
+  for(size_t j=0;j<dataSources.size();j++){
+    CDataSource *dataSource=dataSources[j];
+    if(dataSource->dLayerType==CConfigReaderLayerTypeCascaded)continue;
+    if(j!=0&&dataSource->getStyle()->legendIndex!=-1){
+      legendIndex = dataSource->getStyle()->legendIndex;
+    }
+    if(!useLayerImage[j])continue;
+    CDrawImage *layerImage = new CDrawImage();
+    layerImages.images[j] = layerImage;
+    if(layerImage->createLayerImage(&drawImage)!=0){
+      CDBError("Unable to create layer image for layer %s",dataSource->layerName.c_str());
+      return 1;
+    }
+    if(legendIndex!=-1){
+      if(layerImage->createGDPalette(srvParam->cfg->Legend[legendIndex])!=0){
+        CDBError("Unknown palette type for %s",srvParam->cfg->Legend[legendIndex]->attr.name.c_str());
+        return 1;
+      }
+    }
+    /* A negative palette alpha overwrites the pixels of the layers below, compositing over them can not do that */
+    if(layerImage->hasOverwritingColors()){
+      delete layerImage;
+      layerImages.images[j] = NULL;
+      numDataLayers--;
+    }
+  }
+  if(numDataLayers==0){
+    return 0;
+  }
+
+  layerImages.parentSpan = CTracer::getCurrentSpan();
+  CTracer::Span warpLayersSpan("warplayers");
+  layerImages.dataSources = &dataSources;
+  layerImages.imageDataWriter = this;
+  size_t numThreads = numDataLayers<CIMAGEDATAWRITER_MAXLAYERTHREADS?numDataLayers:CIMAGEDATAWRITER_MAXLAYERTHREADS;
+  std::vector<pthread_t> threads;
+  /* This thread warps layers as well */
+  for(size_t worker=1;worker<numThreads;worker++){
+    pthread_t thread;
+    if(pthread_create(&thread,NULL,warpLayersThread,&layerImages)!=0){
+      CDBWarning("pthread_create failed, warping with %d threads",(int)worker);
+      break;
+    }
+    threads.push_back(thread);
+  }
+  warpLayersThread(&layerImages);
+  for(size_t worker=0;worker<threads.size();worker++){
+    pthread_join(threads[worker],NULL);
+  }
+  #ifdef CIMAGEDATAWRITER_DEBUG
+  CDBDebug("Warped %d layers with %d threads",(int)numDataLayers,(int)threads.size()+1);
+  #endif
+  return 0;
+}
 
 int CImageDataWriter::addData(std::vector <CDataSource*>&dataSources){
   
@@ -1908,6 +2035,36 @@ int CImageDataWriter::addData(std::vector <CDataSource*>&dataSources){
   CDBDebug("Draw data. dataSources.size() =  %d",dataSources.size());
 #endif  
   
+#ifdef ENABLE_CURL
+  /* The images of all cascaded WMS layers are fetched at the same time, before they are drawn in layer order */
+  CCascadedWMSFetcher cascadedWMSFetcher;
+  std::vector<int> cascadedWMSRequests(dataSources.size(),-1);
+  bool hasCascadedWMS = false;
+  for(size_t j=0;j<dataSources.size();j++){
+    CDataSource *dataSource=dataSources[j];
+    if(dataSource->dLayerType==CConfigReaderLayerTypeCascaded&&dataSource->cfgLayer->WMSLayer.size()==1){
+      CServerConfig::XMLE_WMSLayer *wmsLayer = dataSource->cfgLayer->WMSLayer[0];
+      CT::string url = getCascadedWMSURL(wmsLayer->attr.service.c_str(),wmsLayer->attr.layer.c_str(),wmsLayer->attr.style.c_str(),
+                                         wmsLayer->attr.transparent,wmsLayer->attr.bgcolor.c_str());
+      cascadedWMSRequests[j] = cascadedWMSFetcher.add(url.c_str());
+      hasCascadedWMS = true;
+    }
+  }
+  if(hasCascadedWMS){
+    CTracer::Span cascadedWMSSpan("cascadedwms");
+    const char *cacheDirectory = NULL;
+    if(srvParam->cfg->TempDir.size()>0)cacheDirectory = srvParam->cfg->TempDir[0]->attr.value.c_str();
+    cascadedWMSFetcher.run(cacheDirectory);
+  }
+#endif
+
+  /* With more than one data layer, the layers are warped at the same time and composited here in layer order */
+  LayerImages layerImages(dataSources.size());
+  if(warpLayers(dataSources,layerImages)!=0){
+    return 1;
+  }
+  size_t compositedLayers = 0;
+
   for(size_t j=0;j<dataSources.size();j++){
     CDataSource *dataSource=dataSources[j];
 
@@ -1916,12 +2073,12 @@ int CImageDataWriter::addData(std::vector <CDataSource*>&dataSources){
     if(dataSource->dLayerType==CConfigReaderLayerTypeCascaded){
       //CDBDebug("Drawing cascaded WMS (grid/logo/external");
       if(dataSource->cfgLayer->WMSLayer.size()==1){
-        status = drawCascadedWMS(dataSource,dataSource->cfgLayer->WMSLayer[0]->attr.service.c_str(),
-                                 dataSource->cfgLayer->WMSLayer[0]->attr.layer.c_str(),
-                                 dataSource->cfgLayer->WMSLayer[0]->attr.style.c_str(),
-                                 dataSource->cfgLayer->WMSLayer[0]->attr.transparent,
-                                 dataSource->cfgLayer->WMSLayer[0]->attr.bgcolor.c_str()
-                                );
+#ifdef ENABLE_CURL
+        status = drawCascadedWMS(dataSource,cascadedWMSFetcher.getImage(cascadedWMSRequests[j]),dataSource->cfgLayer->WMSLayer[0]->attr.transparent);
+#else
+        CDBError("CURL not enabled");
+        status = 1;
+#endif
         if(status!=0){
           CDBError("drawCascadedWMS for layer %s failed",dataSource->layerName.c_str());
         }
@@ -1959,7 +2116,24 @@ int CImageDataWriter::addData(std::vector <CDataSource*>&dataSources){
       CDBDebug("Start warping");
 #endif
       
-      status = warpImage(dataSource,&drawImage);
+      if(layerImages.images[j]==NULL){
+        status = warpImage(dataSource,&drawImage);
+      }else{
+        status = layerImages.status[j];
+        if(status==0&&j>=compositedLayers){
+          /* Composite in one pass with the next layers, until a layer which draws text or a grid after its data */
+          std::vector<CDrawImage*> compositeImages;
+          size_t k=j;
+          while(true){
+            compositeImages.push_back(layerImages.images[k]);
+            if(dataSources[k]->cfgLayer->ImageText.size()>0||dataSources[k]->cfgLayer->Grid.size()>0)break;
+            if(k+1>=dataSources.size()||layerImages.images[k+1]==NULL||layerImages.status[k+1]!=0)break;
+            k++;
+          }
+          compositedLayers = k+1;
+          status = drawImage.compositeLayers(compositeImages);
+        }
+      }
       
 #ifdef CIMAGEDATAWRITER_DEBUG
       CDBDebug("Finished warping %s for step %d/%d",dataSource->layerName.c_str(),dataSource->getCurrentTimeStep(),dataSource->getNumTimeSteps());
@@ -2290,6 +2464,7 @@ int CImageDataWriter::end(){
       resultFormat=imagepng_eprofile;
 
     
+      CTracer::printServerTimingHeader();
       printf("%s%c%c\n","Content-Type:image/png",13,10);
       drawImage.printImagePng8(true);
     
@@ -2307,9 +2482,11 @@ int CImageDataWriter::end(){
           CT::string resultJSON;
           if (srvParam->JSONP.length()==0) {
             CDBDebug("CREATING JSON");
+            CTracer::printServerTimingHeader();
             printf("%s%c%c\n","Content-Type: application/json",13,10);
           } else {
             CDBDebug("CREATING JSONP %s",srvParam->JSONP.c_str() );
+            CTracer::printServerTimingHeader();
             printf("%s%c%c\n%s(","Content-Type: application/javascript",13,10,srvParam->JSONP.c_str());
           }
           
@@ -2333,9 +2510,9 @@ int CImageDataWriter::end(){
     if(resultFormat==textplain||resultFormat==texthtml){
       CT::string resultHTML;
       if(resultFormat==textplain){
-        resultHTML.print("%s%c%c\n","Content-Type:text/plain",13,10);
+        resultHTML.print("%s%s%c%c\n",CTracer::getServerTimingHeader().c_str(),"Content-Type:text/plain",13,10);
       }else{
-        resultHTML.print("%s%c%c\n","Content-Type:text/html",13,10);
+        resultHTML.print("%s%s%c%c\n",CTracer::getServerTimingHeader().c_str(),"Content-Type:text/html",13,10);
       }
       
       if(resultFormat==texthtml)resultHTML.printconcat("<html>\n");
@@ -2456,7 +2633,7 @@ int CImageDataWriter::end(){
     if(resultFormat==applicationvndogcgml){
       CDBDebug("CREATING GML");
       CT::string resultXML;
-      resultXML.print("%s%c%c\n","Content-Type:text/xml",13,10);
+      resultXML.print("%s%s%c%c\n",CTracer::getServerTimingHeader().c_str(),"Content-Type:text/xml",13,10);
       resultXML.printconcat("<?xml version=\"1.0\" encoding=\"ISO-8859-1\"?>\n");
       resultXML.printconcat("  <FeatureCollection\n");
        resultXML.printconcat("          xmlns:gml=\"http://www.opengis.net/gml\"\n");
@@ -2541,7 +2718,7 @@ int CImageDataWriter::end(){
    if(resultFormat==textxml){
       CDBDebug("CREATING XML");
       CT::string resultXML;
-      resultXML.print("%s%c%c\n","Content-Type:text/xml",13,10);
+      resultXML.print("%s%s%c%c\n",CTracer::getServerTimingHeader().c_str(),"Content-Type:text/xml",13,10);
       resultXML.printconcat("<?xml version=\"1.0\" encoding=\"ISO-8859-1\"?>\n");
       resultXML.printconcat(" <GMLOutput\n");
       resultXML.printconcat("          xmlns:gml=\"http://www.opengis.net/gml\"\n");
@@ -2618,10 +2795,10 @@ int CImageDataWriter::end(){
       CT::string resultJSON;
       if (srvParam->JSONP.length()==0) {
         CDBDebug("CREATING JSON");
-        resultJSON.print("%s%c%c\n","Content-Type: application/json",13,10);
+        resultJSON.print("%s%s%c%c\n",CTracer::getServerTimingHeader().c_str(),"Content-Type: application/json",13,10);
       } else {
         CDBDebug("CREATING JSONP %s",srvParam->JSONP.c_str() );
-        resultJSON.print("%s%c%c\n","Content-Type: application/javascript",13,10);
+        resultJSON.print("%s%s%c%c\n",CTracer::getServerTimingHeader().c_str(),"Content-Type: application/javascript",13,10);
       }
        
       CXMLParser::XMLElement rootElement;
@@ -2771,9 +2948,7 @@ int CImageDataWriter::end(){
     /*************************************************************************************************************************************/
     
     if(resultFormat==imagepng||resultFormat==imagegif){
-      #ifdef MEASURETIME
-      StopWatch_Stop("Start creating image");
-      #endif
+      CTracer::Span plotSpan("plot");
       
     
       if(getFeatureInfoResultList.size()==0){
@@ -3300,6 +3475,9 @@ int CImageDataWriter::end(){
       plotCanvas.drawText(int(plotWidth/2-float(title.length())*2.5),int(height-5),fontLocation,8,0,title.c_str(),CColor(0,0,0,255),CColor(255,255,255,0));
         plotCanvas.draw(int(plotOffsetX), int(plotOffsetY),0,0,&lineCanvas);
 
+      plotSpan.stop();
+      CTracer::Span encodeSpan("encode");
+      CTracer::printServerTimingHeader();
       if(resultFormat==imagepng){
         printf("%s%c%c\n","Content-Type:image/png",13,10);
         plotCanvas.printImagePng8(true);
@@ -3308,9 +3486,7 @@ int CImageDataWriter::end(){
         printf("%s%c%c\n","Content-Type:image/gif",13,10);
         plotCanvas.printImageGif();
       }
-      #ifdef MEASURETIME
-      StopWatch_Stop("/Start creating image");
-      #endif
+      encodeSpan.stop();
     
       for(size_t j=0;j<plotObjects.size();j++)delete plotObjects[j];plotObjects.clear();
       //CDBDebug("Done!");
@@ -3339,9 +3515,11 @@ int CImageDataWriter::end(){
     //return 0;
   }
 
-#ifdef MEASURETIME
-StopWatch_Stop("Drawing finished, start printing image");
-#endif
+  CTracer::Span encodeSpan("encode");
+  //Animated GIF headers are already printed when the animation was started
+  if(!(srvParam->imageFormat==IMAGEFORMAT_IMAGEGIF&&animation==1)){
+    CTracer::printServerTimingHeader();
+  }
 
   //Static image
 //CDBDebug("srvParam->imageFormat = %d",srvParam->imageFormat);
@@ -3378,9 +3556,7 @@ StopWatch_Stop("Drawing finished, start printing image");
     status=drawImage.printImagePng8(true);
   }
   
-  #ifdef MEASURETIME
-  StopWatch_Stop("Image printed");
-  #endif
+  encodeSpan.stop();
   if(status!=0){
     CDBError("Errors occured during image printing");
   }
@@ -28,8 +28,10 @@
 #include <string>
 #include <map>
 #include <vector>
+#include <pthread.h>
 #include "Definitions.h"
 #include "CStopWatch.h"
+#include "CTracer.h"
 #include "CIBaseDataWriterInterface.h"
 #include "CImgWarpNearestNeighbour.h"
 #include "CImgWarpNearestRGBA.h"
@@ -40,6 +42,7 @@
 #include "CImgRenderPolylines.h"
 #include "CStyleConfiguration.h"
 #include "CMyCURL.h"
+#include "CCascadedWMSFetcher.h"
 #include "CXMLParser.h"
 #include "CDebugger.h"
 
@@ -129,6 +132,32 @@ private:
     DEF_ERRORFUNCTION();
 
     int warpImage(CDataSource *sourceImage,CDrawImage *drawImage);
+    
+    /**
+     * The images of the data layers of one addData call, warped at the same time by warpLayers
+     */
+    class LayerImages{
+    public:
+      std::vector<CDrawImage*> images;
+      std::vector<int> status;
+      std::vector<CDataSource*> *dataSources;
+      CImageDataWriter *imageDataWriter;
+      CTracer::Span *parentSpan;
+      size_t nextLayer;
+      pthread_mutex_t lock;
+      LayerImages(size_t numLayers);
+      ~LayerImages();
+    };
+    
+    /**
+     * Warps the data layers each in its own layer image, at the same time. Leaves layerImages empty when the layers
+     * have to be drawn one after another in drawImage. Only layers which draw pixels get a layer image, lines and
+     * text drawn by cairo are blended premultiplied and are drawn in drawImage. Layers reading the same file share
+     * one CDFObject and are drawn in drawImage as well, like layers with palette colors which overwrite the pixels below.
+     */
+    int warpLayers(std::vector <CDataSource*> &dataSources,LayerImages &layerImages);
+    static void *warpLayersThread(void *arg);
+    static bool warpLayersEnabled;
   
     CServerParams *srvParam;
     
@@ -143,12 +172,23 @@ public:
     static int getColorIndexForValue(CDataSource *dataSource,float value);
     static float getValueForColorIndex(CDataSource *dataSource,int index);
     static CColor getPixelColorForValue(CDataSource*dataSource,float val);
+    
+    /**
+     * Enables or disables warping layers at the same time, enabled by default. Can be disabled with environment variable ADAGUC_WARPLAYERS=false.
+     */
+    static void setWarpLayersEnabled(bool enable);
 private:
     void setValue(CDFType type,void *data,size_t ptr,double pixel);
     int _setTransparencyAndBGColor(CServerParams *srvParam,CDrawImage* drawImage);
     
     
-    int drawCascadedWMS(CDataSource *dataSource,const char *service,const char *layers,const char *styles, bool transparent, const char *bgcolor);
+    CT::string getCascadedWMSURL(const char *service,const char *layers,const char *styles, bool transparent, const char *bgcolor);
+
+    /**
+     * Draws the image of a cascaded WMS layer, at the Position of the layer
+     * @param gdImage The image fetched from the cascaded WMS, NULL when it is not available
+     */
+    int drawCascadedWMS(CDataSource *dataSource,gdImagePtr gdImage,bool transparent);
     
     
     bool isProfileData;
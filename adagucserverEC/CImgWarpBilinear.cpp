@@ -27,6 +27,7 @@
 #include "CImageDataWriter.h"
 #include <gd.h>
 #include <set>
+#include "CBufferPool.h"
 #ifndef M_PI
 #define M_PI            3.14159265358979323846  // pi 
 #endif
@@ -173,8 +174,8 @@ void CImgWarpBilinear::render(CImageWarper *warper,CDataSource *sourceImage,CDra
   #ifdef CImgWarpBilinear_DEBUG
   CDBDebug("Allocate, numDestPixels %d x %d",dPixelDestW,dPixelDestH);
   #endif
-  int *dpDestX = new int[numDestPixels];//refactor to numGridPoints
-  int *dpDestY = new int[numDestPixels];
+  int *dpDestX = CBufferPool::allocate<int>(numDestPixels);//refactor to numGridPoints
+  int *dpDestY = CBufferPool::allocate<int>(numDestPixels);
   
   class ValueClass{
   public:
@@ -183,8 +184,8 @@ void CImgWarpBilinear::render(CImageWarper *warper,CDataSource *sourceImage,CDra
       valueData=NULL;
     }
     ~ValueClass(){
-      if(fpValues!=NULL){delete[] fpValues;fpValues=NULL;}
-      if(valueData!=NULL){delete[] valueData;valueData=NULL;}
+      CBufferPool::release(fpValues);fpValues=NULL;
+      CBufferPool::release(valueData);valueData=NULL;
     }
     float *fpValues;
     float *valueData;
@@ -195,8 +196,8 @@ void CImgWarpBilinear::render(CImageWarper *warper,CDataSource *sourceImage,CDra
     CDBDebug("Allocating valObj[%d].fpValues: numDestPixels %d x %d",dNr,dPixelDestW,dPixelDestH);
     CDBDebug("Allocating valObj[%d].valueData: imageSize %d x %d",dNr,dImageWidth,dImageHeight);
     #endif
-    valObj[dNr].fpValues = new float [numDestPixels];
-    valObj[dNr].valueData = new float[dImageWidth*dImageHeight];
+    valObj[dNr].fpValues = CBufferPool::allocate<float>(numDestPixels);
+    valObj[dNr].valueData = CBufferPool::allocate<float>(dImageWidth*dImageHeight);
   }
   
   if(!sourceImage->getDataObject(0)->hasNodataValue){
@@ -981,8 +982,8 @@ if (enableBarb) {
 }                 
 
 //Clean up
-delete[] dpDestX;
-delete[] dpDestY;
+CBufferPool::release(dpDestX);
+CBufferPool::release(dpDestY);
 
 delete[] valObj;
  }
@@ -1472,7 +1473,7 @@ void CImgWarpBilinear::drawContour(float *valueData,float fNodataValue,float int
    #endif
    
    //Create a distance field, this is where the line information will be put in.
-   DISTANCEFIELDTYPE *distance = new DISTANCEFIELDTYPE[imageSize];
+   DISTANCEFIELDTYPE *distance = CBufferPool::allocate<DISTANCEFIELDTYPE>(imageSize);
   
   
 /*   
@@ -1755,7 +1756,7 @@ void CImgWarpBilinear::drawContour(float *valueData,float fNodataValue,float int
   CDBDebug("Deleting distance[]");
   #endif
   
-  delete[] distance;
+  CBufferPool::release(distance);
   
   #ifdef CImgWarpBilinear_DEBUG
   CDBDebug("Finished drawing lines and text");
@@ -29,6 +29,7 @@
 #include <pthread.h>
 #include "CImageWarperRenderInterface.h"
 #include "CGenericDataWarper.h"
+#include "CColorIndexTable.h"
 
 //#define CIMGWARPNEARESTNEIGHBOUR_DEBUG
 
@@ -46,21 +47,23 @@ public:
   double dfTileWidth,dfTileHeight;
   double dfSourceBBOX[4];
   double dfImageBBOX[4];
-  double dfNodataValue;
-  double legendLowerRange;
-  double legendUpperRange;
-  double legendValueRange;
-  double hasNodataValue;
   int width,height;
   int internalWidth,internalHeight;
-  float legendLog,legendScale,legendOffset;
-  float legendLogAsLog;
   CDataSource * dataSource;
   CDrawImage *drawImage;
+  const CColorIndexTable *colorIndexTable;
+  short *colorIndices;
   //size_t prev_imgpointer;
-  void init(CDataSource *dataSource,CDrawImage *drawImage,int tileWidth,int tileHeight){
+  
+  /**
+   * @param colorIndexTable Converts the values to color indices, prepared for the type of the data
+   * @param colorIndices Field of the size of drawImage which receives the color indices of the drawn pixels
+   */
+  void init(CDataSource *dataSource,CDrawImage *drawImage,int tileWidth,int tileHeight,const CColorIndexTable *colorIndexTable,short *colorIndices){
     this->dataSource = dataSource;
     this->drawImage = drawImage;
+    this->colorIndexTable = colorIndexTable;
+    this->colorIndices = colorIndices;
     dfTileWidth=tileWidth;dfTileHeight=tileHeight;
     for(int k=0;k<4;k++){
       dfSourceBBOX[k]=dataSource->dfBBOX[k];
@@ -78,24 +81,8 @@ public:
       dfSourceBBOX[2]=dataSource->dfBBOX[0];
     }
     
-    CStyleConfiguration *styleConfiguration = dataSource->getStyle();
-    
-    
-    dfNodataValue    = dataSource->getDataObject(0)->dfNodataValue ;
-    legendValueRange = styleConfiguration->hasLegendValueRange;
-    legendLowerRange = styleConfiguration->legendLowerRange;
-    legendUpperRange = styleConfiguration->legendUpperRange;
-    hasNodataValue   = dataSource->getDataObject(0)->hasNodataValue;
     width = dataSource->dWidth;
     height = dataSource->dHeight;
-    legendLog = styleConfiguration->legendLog;
-    if(legendLog>0){
-      legendLogAsLog = log10(legendLog);
-    }else{
-      legendLogAsLog = 0;
-    }
-    legendScale = styleConfiguration->legendScale;
-    legendOffset = styleConfiguration->legendOffset;
     
     internalWidth = width;
     internalHeight =height;
@@ -188,9 +175,9 @@ public:
 //      CDBDebug("lines: %f %f %f %f",line_dx1,line_dx2,line_dy1,line_dy2);
    //   CDBDebug("rcs: %f %f %f %f",rcx_1,rcy_1,rcx_2,rcy_2);
       
-      bool isNodata=false;
       T val;
-      T nodataValue=(T)dfNodataValue;
+      int imageWidth = drawImage->Geo->dWidth;
+      int imageHeight = drawImage->Geo->dHeight;
       
       size_t imgpointer;
       for(x=0;x<=dfTileWidth-1;x++){
@@ -234,21 +221,9 @@ public:
 #endif             */       
                                     
                   
-                  isNodata=false;
-                  if(hasNodataValue){if(val==nodataValue)isNodata=true;}if(!(val==val))isNodata=true;
-                  if(!isNodata)if(legendValueRange)if(val<legendLowerRange||val>legendUpperRange)isNodata=true;
-                  if(!isNodata){
-                    if(legendLog!=0){
-                      if(val>0){
-                        val=(T)(log10(val)/legendLogAsLog);
-                      }else val=(T)(-legendOffset);
-                    }
-                    int pcolorind=(int)(val*legendScale+legendOffset);
-                    //val+=legendOffset;
-                    if(pcolorind>=239)pcolorind=239;else if(pcolorind<=0)pcolorind=0;
-                    
-                    //drawImage->setPixelIndexed(dstpixel_x,dstpixel_y,drawImage->colors[(unsigned char)val]);
-                    drawImage->setPixelIndexed(dstpixel_x,dstpixel_y,pcolorind);
+                  short pcolorind=colorIndexTable->get(val);
+                  if(pcolorind!=CCOLORINDEXTABLE_NODRAW&&dstpixel_x>=0&&dstpixel_y>=0&&dstpixel_x<imageWidth&&dstpixel_y<imageHeight){
+                    colorIndices[dstpixel_x+dstpixel_y*imageWidth]=pcolorind;
                   }
                 }
               }
@@ -395,15 +370,6 @@ private:
     double legendUpperRange = styleConfiguration->legendUpperRange;
     bool hasNodataValue   = dataSource->getDataObject(0)->hasNodataValue;
     float nodataValue = (float)dfNodataValue;
-    float legendLog = styleConfiguration->legendLog;
-    float legendLogAsLog;
-    if(legendLog>0){
-    legendLogAsLog = log10(legendLog);
-    }else{
-    legendLogAsLog = 0;
-    }
-    float legendScale = styleConfiguration->legendScale;
-    float legendOffset = styleConfiguration->legendOffset;
         
     T *data=(T*)dataSource->getDataObject(0)->cdfVariable->data;
     
@@ -464,43 +430,28 @@ private:
     }
     
     if(shade == false){
-      for(int y=0;y<drawImage->Geo->dHeight;y++){
-        for(int x=0;x<drawImage->Geo->dWidth;x++){
-          T val= data[x+y*drawImage->Geo->dWidth];
-
-            bool isNodata=false;
-            if(hasNodataValue){if(val==nodataValue)isNodata=true;}if(!(val==val))isNodata=true;
-            if(!isNodata)if(legendValueRange)if(val<legendLowerRange||val>legendUpperRange)isNodata=true;
-            if(!isNodata){
-              if(legendLog!=0){
-                if(val>0){
-                  val=(T)(log10(val)/legendLogAsLog);
-                }else val=(T)(-legendOffset);
-              }
-              int pcolorind=(int)(val*legendScale+legendOffset);
-              //val+=legendOffset;
-              if(pcolorind>=239)pcolorind=239;else if(pcolorind<=0)pcolorind=0;
-
-              drawImage->setPixelIndexed(x,(drawImage->Geo->dHeight-1)-y,pcolorind);
-            }
-          
+      CColorIndexTable colorIndexTable;
+      colorIndexTable.init(dataSource);
+      colorIndexTable.prepare<T>();
+      int width = drawImage->Geo->dWidth;
+      int height = drawImage->Geo->dHeight;
+      short *colorIndices = new short[size_t(width)*size_t(height)];
+      for(int y=0;y<height;y++){
+        const T *dataRow = data+size_t(y)*width;
+        short *indexRow = colorIndices+size_t((height-1)-y)*width;
+        for(int x=0;x<width;x++){
+          indexRow[x]=colorIndexTable.get(dataRow[x]);
         }
       }
+      drawImage->setPixelsIndexed(colorIndices);
+      delete[] colorIndices;
     }
   }
   
   class Settings{
   public:
-    double dfNodataValue;
-    double legendValueRange;
-    double legendLowerRange;
-    double legendUpperRange;
-    bool hasNodataValue;
-    float nodataValue;
-    float legendLog;
-    float legendLogAsLog;
-    float legendScale;
-    float legendOffset;
+    const CColorIndexTable *colorIndexTable;
+    short *colorIndices;
     CDrawImage *drawImage;
 
   };
@@ -511,22 +462,11 @@ private:
     Settings *settings = (Settings*)_settings;
     if(settings->drawImage->trueColorAVG_RGBA == false){
 
-      bool isNodata=false;
-      if(settings->hasNodataValue){if(val==settings->nodataValue)isNodata=true;}if(!(val==val))isNodata=true;
-      if(!isNodata)if(settings->legendValueRange)if(val<settings->legendLowerRange||val>settings->legendUpperRange)isNodata=true;
-      if(!isNodata){
-        if(settings->legendLog!=0){
-          if(val>0){
-            val=(T)(log10(val)/settings->legendLogAsLog);
-          }else val=(T)(-settings->legendOffset);
+      if(x>=0&&y>=0&&x<settings->drawImage->Geo->dWidth&&y<settings->drawImage->Geo->dHeight){
+        short pcolorind=settings->colorIndexTable->get(val);
+        if(pcolorind!=CCOLORINDEXTABLE_NODRAW){
+          settings->colorIndices[x+y*settings->drawImage->Geo->dWidth]=pcolorind;
         }
-        int pcolorind=(int)(val*settings->legendScale+settings->legendOffset);
-        //val+=legendOffset;
-        if(pcolorind>=239)pcolorind=239;else if(pcolorind<=0)pcolorind=0;
-      
-        settings->drawImage->setPixelIndexed(x,y,pcolorind);
-        
-        //settings->drawImage->setPixelTrueColorOverWrite(x,y,0,0,0,0);
       }
     }else{
       if(x>=0&&y>=0&&x<settings->drawImage->Geo->dWidth&&y<settings->drawImage->Geo->dHeight){
@@ -582,22 +522,14 @@ private:
     if(dataSource->dWidth*dataSource->dHeight<720*720||1==2||styleConfiguration->renderMethod&RM_AVG_RGBA){
       //CDBDebug("field is small enough for precise renderer: using _render");
       Settings settings;
-        
-      settings.dfNodataValue    = dataSource->getDataObject(0)->dfNodataValue ;
-      settings.legendValueRange = styleConfiguration->hasLegendValueRange;
-      settings.legendLowerRange = styleConfiguration->legendLowerRange;
-      settings.legendUpperRange = styleConfiguration->legendUpperRange;
-      settings.hasNodataValue   = dataSource->getDataObject(0)->hasNodataValue;
-      settings.nodataValue = (float)settings.dfNodataValue;
-      
-      settings.legendLog = styleConfiguration->legendLog;
-      if(settings.legendLog>0){
-        settings.legendLogAsLog = log10(settings.legendLog);
-      }else{
-        settings.legendLogAsLog = 0;
-      }
-      settings.legendScale = styleConfiguration->legendScale;
-      settings.legendOffset = styleConfiguration->legendOffset;
+      CColorIndexTable colorIndexTable;
+      colorIndexTable.init(dataSource);
+      colorIndexTable.prepare(dataSource->getDataObject(0)->cdfVariable->getType());
+      size_t imageSize = size_t(drawImage->Geo->dWidth)*size_t(drawImage->Geo->dHeight);
+      short *colorIndices = new short[imageSize];
+      for(size_t j=0;j<imageSize;j++)colorIndices[j]=CCOLORINDEXTABLE_NODRAW;
+      settings.colorIndexTable = &colorIndexTable;
+      settings.colorIndices = colorIndices;
       settings.drawImage = drawImage;
       
       if(styleConfiguration->renderMethod&RM_AVG_RGBA){
@@ -607,10 +539,10 @@ private:
         size_t size=settings.drawImage->Geo->dWidth*settings.drawImage->Geo->dHeight;
         if(settings.drawImage->rField == NULL){
           CDBDebug("Allocating fields");
-          settings.drawImage->rField = new float[size];
-          settings.drawImage->gField = new float[size];
-          settings.drawImage->bField = new float[size];
-          settings.drawImage->numField = new int[size];
+          settings.drawImage->rField = CBufferPool::allocate<float>(size);
+          settings.drawImage->gField = CBufferPool::allocate<float>(size);
+          settings.drawImage->bField = CBufferPool::allocate<float>(size);
+          settings.drawImage->numField = CBufferPool::allocate<int>(size);
           for(size_t j=0;j<size;j++){
             settings.drawImage->rField[j] = 0;
             settings.drawImage->gField[j] = 0;
@@ -646,6 +578,10 @@ private:
         case CDF_FLOAT :  GenericDataWarper::render<float> (warper,sourceData,&sourceGeo,drawImage->Geo,&settings,&drawFunction);break;
         case CDF_DOUBLE:  GenericDataWarper::render<double>(warper,sourceData,&sourceGeo,drawImage->Geo,&settings,&drawFunction);break;
       }
+      if(settings.drawImage->trueColorAVG_RGBA == false){
+        drawImage->setPixelsIndexed(colorIndices);
+      }
+      delete[] colorIndices;
       
       
 //       if(styleConfiguration->renderMethod&RM_AVG_RGBA&&settings.drawImage->rField!=NULL){
@@ -758,7 +694,13 @@ private:
         
         
      
-        drawTileClass->init(dataSource,drawImage,tile_width,tile_height);
+        CColorIndexTable colorIndexTable;
+        colorIndexTable.init(dataSource);
+        colorIndexTable.prepare(dataSource->getDataObject(0)->cdfVariable->getType());
+        size_t imageSize = size_t(drawImage->Geo->dWidth)*size_t(drawImage->Geo->dHeight);
+        short *colorIndices = new short[imageSize];
+        for(size_t j=0;j<imageSize;j++)colorIndices[j]=CCOLORINDEXTABLE_NODRAW;
+        drawTileClass->init(dataSource,drawImage,tile_width,tile_height,&colorIndexTable,colorIndices);
         
         #ifdef CIMGWARPNEARESTNEIGHBOUR_DEBUG
         CDBDebug("x_div, y_div:  %d %d",x_div,y_div);
@@ -837,6 +779,9 @@ private:
             if(errcode) { CDBError("pthread_join");return;}
           }
         }
+        //All tiles are drawn, convert the color indices to pixels in one pass
+        drawImage->setPixelsIndexed(colorIndices);
+        delete[] colorIndices;
         delete[] drawTileSettings;
         delete drawTileClass;
   }
@@ -2,6 +2,7 @@
 #include <algorithm>
 #include "CMakeJSONTimeSeries.h"
 #include "CImageDataWriter.h"
+#include "CTimeSeriesStore.h"
 
 const char * CMakeJSONTimeSeries::className = "CMakeJSONTimeSeries";
 
@@ -9,6 +10,9 @@ const char * CMakeJSONTimeSeries::className = "CMakeJSONTimeSeries";
 
 #define CMakeJSONTimeSeries_MAX_DIMS 255
 
+//Maximum number of values in the hyperslab which holds all requests of a file
+#define CMakeJSONTimeSeries_MAX_GROUPED_VALUES 65536
+
 class UniqueRequests{
 private:
      DEF_ERRORFUNCTION();
@@ -263,6 +267,10 @@ public:
   }
 
   
+  /**
+   * Adds the values of one request to the results. start and count describe the hyperslab which was read into variable,
+   * this can be larger than the request when the requests of a file were read at once.
+   */
   void expandData(CDataSource::DataObject *dataObject,CDF::Variable *variable,size_t *start,size_t *count,int d,Request *request,int index){
     if(d<int(variable->dimensionlinks.size())-2){
       CDF::Dimension *dim = variable->dimensionlinks[d];
@@ -276,8 +284,9 @@ public:
       if(requestDimIndex==-1){
         CDBError("Unable to find dimension %s in request",dim->name.c_str());throw(__LINE__);
       }
-      if(count[d]!=request->dimensions[requestDimIndex]->values.size()){
-        CDBError("count[d]!=request->dimensions[requestDimIndex]->values.size()");throw(__LINE__);
+      size_t offset = request->dimensions[requestDimIndex]->start-start[d];
+      if(size_t(request->dimensions[requestDimIndex]->start)<start[d]||offset+request->dimensions[requestDimIndex]->values.size()>count[d]){
+        CDBError("Request for dimension %s is outside the hyperslab which was read",dim->name.c_str());throw(__LINE__);
       }
     
       
@@ -287,10 +296,15 @@ public:
       }
       for(size_t j=0;j<request->dimensions[requestDimIndex]->values.size();j++){
         dimensionKeys[d] = &request->dimensions[requestDimIndex]->values[j];
-        expandData(dataObject,variable,start,count,d+1,request,j*multiplier+index);
+        expandData(dataObject,variable,start,count,d+1,request,(offset+j)*multiplier+index);
       }
     }else{
       double pixel=CImageDataWriter::convertValue(variable->getType(),variable->data,index);
+      addResult(dataObject,pixel,variable->dimensionlinks.size()-2);
+    }
+  }
+  
+  void addResult(CDataSource::DataObject *dataObject,double pixel,int numDims){
       CT::string dataAsString="nodata";
       if((pixel!=dataObject->dfNodataValue&&dataObject->hasNodataValue==true&&pixel==pixel)||dataObject->hasNodataValue==false){
       
@@ -306,13 +320,57 @@ public:
       //CDBDebug("VAL [%s][%d][%f]",p.c_str(),index,data[index]);
       Result *result = new Result(this);
 
-      for(size_t j=0;j<variable->dimensionlinks.size()-2;j++){
+      for(int j=0;j<numDims;j++){
         result->dimensionKeys[j] = dimensionKeys[j];
       }
       result->value = dataAsString.c_str();
-      result->numDims= variable->dimensionlinks.size()-2;
+      result->numDims= numDims;
       results.push_back(result);
+  }
+  
+  /**
+   * Reads the requested time steps from the time series store. Only files of which all requested steps are in the store are used,
+   * these are added to filesFromStore and do not need to be opened.
+   */
+  void readFromStore(CTimeSeriesStore *store,CDataSource::DataObject *dataObject,int imx,int imy,std::set<std::string> &filesFromStore){
+    filesFromStore.clear();
+    std::vector<size_t> slotList;
+    std::vector<CT::string*> slotKeys;
+    for(it_type_file filemapiterator = fileInfoMap.begin(); filemapiterator != fileInfoMap.end(); filemapiterator++) {
+      FileInfo *fileInfo = filemapiterator->second;
+      size_t numSlotsBefore = slotList.size();
+      bool inStore = true;
+      for(size_t j=0;j<fileInfo->requests.size()&&inStore;j++){
+        Request *request = fileInfo->requests[j];
+        if(request->numDims!=1){inStore=false;break;}
+        for(size_t i=0;i<request->dimensions[0]->values.size();i++){
+          int slot = store->getSlot((filemapiterator->first).c_str(),request->dimensions[0]->start+i);
+          if(slot==-1){inStore=false;break;}
+          slotList.push_back(slot);
+          slotKeys.push_back(&request->dimensions[0]->values[i]);
+        }
+      }
+      if(inStore){
+        filesFromStore.insert(filemapiterator->first);
+      }else{
+        slotList.resize(numSlotsBefore);
+        slotKeys.resize(numSlotsBefore);
+      }
+    }
+    if(slotList.size()==0)return;
+    
+    std::vector<float> values;
+    if(store->readPoint(dataObject->variableName.c_str(),imx,imy,slotList,values)!=0){
+      CDBWarning("Unable to read from time series store, reading files instead");
+      filesFromStore.clear();
+      return;
     }
+    
+    for(size_t j=0;j<values.size();j++){
+      dimensionKeys[0] = slotKeys[j];
+      addResult(dataObject,values[j],1);
+    }
+    CDBDebug("Read %d values of %d files from time series store",(int)values.size(),(int)filesFromStore.size());
   }
   
   void recurDataStructure(CXMLParser::XMLElement *dataStructure,Result *result,int depth,int *dimOrdering){
@@ -429,6 +487,47 @@ public:
     }
   }
   
+  /**
+   * Sets the hyperslab of the point of one request
+   */
+  void setRequestHyperslab(CDFObject *cdfObject,CDF::Variable *variable,CDataSource *dataSource,Request *request,int imx,int imy,size_t *start,size_t *count,ptrdiff_t *stride){
+    int numberOfDims = dataSource->requiredDims.size();
+    for(int j=0;j<numberOfDims+2;j++){
+      start[j]=0;
+      count[j]=1;
+      stride[j]=1;
+    }
+    start[dataSource->dimXIndex] = imx;
+    start[dataSource->dimYIndex] = imy;
+      
+    for(int i=0;i<request->numDims;i++){
+      int netcdfDimIndex = -1;
+      CDataReader::DimensionType dtype = CDataReader::getDimensionType(cdfObject,request->dimensions[i]->name.c_str());
+      if(dtype==CDataReader::dtype_none){
+        CDBWarning("dtype_none for %s",dtype,request->dimensions[i]->name.c_str());
+      }
+      try{
+        netcdfDimIndex = variable->getDimensionIndex(request->dimensions[i]->name.c_str());
+      }catch(int e){
+        //CDBError("Unable to find dimension [%s]",request->dimensions[i]->name.c_str());
+        if(dtype == CDataReader::dtype_reference_time){
+          CDBDebug("IS REFERENCE TIME %s",request->dimensions[i]->name.c_str());
+
+        }else{
+          throw(__LINE__);
+        }
+      }
+      
+      
+
+      start[netcdfDimIndex]=request->dimensions[i]->start;
+      count[netcdfDimIndex]=request->dimensions[i]->values.size();
+#ifdef CMakeJSONTimeSeries_DEBUG                
+      CDBDebug("  %d %s %d %d",i,request->dimensions[i]->name.c_str(),request->dimensions[i]->start,request->dimensions[i]->values.size());
+#endif              
+    }
+  }
+  
   void makeRequests(CDrawImage *drawImage,CImageWarper *imageWarper,CDataSource *dataSource,int dX,int dY,CXMLParser::XMLElement *gfiStructure){
     #ifdef CMakeJSONTimeSeries_DEBUG
     CDBDebug("makeRequests");
@@ -443,16 +542,43 @@ public:
     
 
     
+    //All files share the same grid, so the pixel location only needs to be determined once
+    CT::string ckey;ckey.print("%d%d%s",dX,dY,dataSource->nativeProj4.c_str());
+    CImageDataWriter::ProjCacheInfo projCacheInfo = CImageDataWriter::GetProjInfo(ckey,drawImage,dataSource,imageWarper, dataSource->srvParams,dX,dY);
+    
+    //Time steps which are in the time series store of the layer do not need to be read from the files. The store holds the
+    //values before any DataPostProc, layers with DataPostProc are always read from the files.
+    CTimeSeriesStore timeSeriesStore;
+    bool useTimeSeriesStore = false;
+    if(projCacheInfo.isOutsideBBOX == false && numberOfDims == 1 && dataSource->dimXIndex == 2 && dataSource->dimYIndex == 1 && dataSource->cfgLayer->DataPostProc.size() == 0){
+      useTimeSeriesStore = (timeSeriesStore.open(dataSource) == 0);
+    }
+    std::set<std::string> filesFromStore;
+    
+    //Let the next files be read from disk while the current one is processed
+    CFilePrefetcher prefetcher;
+    if(projCacheInfo.isOutsideBBOX == false){
+      for(it_type_file filemapiterator = fileInfoMap.begin(); filemapiterator != fileInfoMap.end(); filemapiterator++) {
+        prefetcher.addFile((filemapiterator->first).c_str());
+      }
+      if(!useTimeSeriesStore){
+        prefetcher.start(CMakeJSONTimeSeries::getReadAhead(dataSource));
+      }
+    }
+    
     for(size_t dataObjectNr=0;dataObjectNr<dataSource->dataObjects.size();dataObjectNr++){
       CDataSource::DataObject *dataObject = dataSource->getDataObject(dataObjectNr);
       CT::string variableName = dataObject->cdfVariable->name;
       //Show all requests
       
+      if(useTimeSeriesStore){
+        readFromStore(&timeSeriesStore,dataObject,projCacheInfo.imx,projCacheInfo.imy,filesFromStore);
+      }
+      
       for(it_type_file filemapiterator = fileInfoMap.begin(); filemapiterator != fileInfoMap.end(); filemapiterator++) {
-        CT::string ckey;ckey.print("%d%d%s",dX,dY,dataSource->nativeProj4.c_str());
-        CImageDataWriter::ProjCacheInfo projCacheInfo = CImageDataWriter::GetProjInfo(ckey,drawImage,dataSource,imageWarper, dataSource->srvParams,dX,dY);
-        
+        if(filesFromStore.find(filemapiterator->first)!=filesFromStore.end())continue;
         if(projCacheInfo.isOutsideBBOX == false){
+          prefetcher.setCurrentFile((filemapiterator->first).c_str());
           CDFObject *cdfObject = CDFObjectStore::getCDFObjectStore()->getCDFObjectHeader(dataSource->srvParams,(filemapiterator->first).c_str());
           
 
@@ -492,9 +618,32 @@ public:
             throw (__LINE__);
           }
             
-          for(size_t j=0;j<(filemapiterator->second)->requests.size();j++){
-              
-            Request *request=(filemapiterator->second)->requests[j];
+          /* The requests of a file are read with one hyperslab, unless it would hold too many values which were not asked for */
+          std::vector<Request*> &requests = (filemapiterator->second)->requests;
+          bool readAtOnce = false;
+          if(requests.size()>1){
+            std::vector<size_t> requestStart(numberOfDims+2),requestCount(numberOfDims+2);
+            for(size_t j=0;j<requests.size();j++){
+              setRequestHyperslab(cdfObject,variable,dataSource,requests[j],projCacheInfo.imx,projCacheInfo.imy,&requestStart[0],&requestCount[0],stride);
+              for(int i=0;i<numberOfDims+2;i++){
+                if(j==0){
+                  start[i]=requestStart[i];
+                  count[i]=requestCount[i];
+                }else{
+                  size_t end = start[i]+count[i];
+                  if(requestStart[i]+requestCount[i]>end)end=requestStart[i]+requestCount[i];
+                  if(requestStart[i]<start[i])start[i]=requestStart[i];
+                  count[i]=end-start[i];
+                }
+              }
+            }
+            size_t numValues = 1;
+            for(int i=0;i<numberOfDims+2;i++)numValues*=count[i];
+            readAtOnce = numValues<=CMakeJSONTimeSeries_MAX_GROUPED_VALUES;
+          }
+          
+          size_t numReads = readAtOnce?1:requests.size();
+          for(size_t r=0;r<numReads;r++){
 #ifdef CMakeJSONTimeSeries_DEBUG                          
             CDBDebug("%s",(filemapiterator->first).c_str());
 #endif            
@@ -502,39 +651,8 @@ public:
 
             variable->freeData();
           
-            for(int j=0;j<numberOfDims+2;j++){
-              start[j]=0;
-              count[j]=1;
-              stride[j]=1;
-            }
-            start[dataSource->dimXIndex] = projCacheInfo.imx;
-            start[dataSource->dimYIndex] = projCacheInfo.imy;
-              
-            for(int i=0;i<request->numDims;i++){
-              int netcdfDimIndex = -1;
-              CDataReader::DimensionType dtype = CDataReader::getDimensionType(cdfObject,request->dimensions[i]->name.c_str());
-              if(dtype==CDataReader::dtype_none){
-                CDBWarning("dtype_none for %s",dtype,request->dimensions[i]->name.c_str());
-              }
-              try{
-                netcdfDimIndex = variable->getDimensionIndex(request->dimensions[i]->name.c_str());
-              }catch(int e){
-                //CDBError("Unable to find dimension [%s]",request->dimensions[i]->name.c_str());
-                if(dtype == CDataReader::dtype_reference_time){
-                  CDBDebug("IS REFERENCE TIME %s",request->dimensions[i]->name.c_str());
-      
-                }else{
-                  throw(__LINE__);
-                }
-              }
-              
-              
-
-              start[netcdfDimIndex]=request->dimensions[i]->start;
-              count[netcdfDimIndex]=request->dimensions[i]->values.size();
-#ifdef CMakeJSONTimeSeries_DEBUG                
-              CDBDebug("  %d %s %d %d",i,request->dimensions[i]->name.c_str(),request->dimensions[i]->start,request->dimensions[i]->values.size());
-#endif              
+            if(!readAtOnce){
+              setRequestHyperslab(cdfObject,variable,dataSource,requests[r],projCacheInfo.imx,projCacheInfo.imy,start,count,stride);
             }
 #ifdef CMakeJSONTimeSeries_DEBUG              
             for(int i=0;i<numberOfDims+2;i++){
@@ -591,7 +709,13 @@ public:
               CDBDebug("Read %d elements",variable->getSize());
               
               try{
-                expandData(dataObject,variable,start,count,0,request,0);
+                if(readAtOnce){
+                  for(size_t j=0;j<requests.size();j++){
+                    expandData(dataObject,variable,start,count,0,requests[j],0);
+                  }
+                }else{
+                  expandData(dataObject,variable,start,count,0,requests[r],0);
+                }
               }catch(int e){
                 CDBError("Error in expandData at line %d",e);
                 throw(__LINE__);
@@ -636,6 +760,17 @@ public:
 };
 const char * UniqueRequests::className = "UniqueRequests";
 
+size_t CMakeJSONTimeSeries::getReadAhead(CDataSource *dataSource){
+  size_t readAhead = CMakeJSONTimeSeries_DEFAULT_READAHEAD;
+  if(dataSource->cfgLayer->FilePath.size()==1 && dataSource->cfgLayer->FilePath[0]->attr.gfi_readahead.empty()==false){
+    int value = dataSource->cfgLayer->FilePath[0]->attr.gfi_readahead.toInt();
+    if(value<0)value=0;
+    readAhead = value;
+  }
+  if(readAhead>CMakeJSONTimeSeries_MAX_READAHEAD)readAhead=CMakeJSONTimeSeries_MAX_READAHEAD;
+  return readAhead;
+}
+
 int CMakeJSONTimeSeries::MakeJSONTimeSeries(CDrawImage *drawImage,CImageWarper *imageWarper,std::vector<CDataSource *>dataSources,int dataSourceIndex,int dX,int dY,CXMLParser::XMLElement *gfiStructure){
   CDataSource *dataSource=dataSources[dataSourceIndex];
 
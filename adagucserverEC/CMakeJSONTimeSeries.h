@@ -12,12 +12,23 @@
 #include "CDrawImage.h"
 #include "CImageDataWriter.h"
 #include "CDebugger.h"
+#include "CFilePrefetcher.h"
+
+/* Default number of files read ahead during GetFeatureInfo time series, configurable with FilePath attribute gfi_readahead */
+#define CMakeJSONTimeSeries_DEFAULT_READAHEAD 4
+#define CMakeJSONTimeSeries_MAX_READAHEAD 16
 
 
 class CMakeJSONTimeSeries{
 public:
    DEF_ERRORFUNCTION();
    
+  /**
+   * Returns the number of files to read ahead for time series requests, as configured with <FilePath gfi_readahead="4">.
+   * Zero disables read ahead.
+   */
+  static size_t getReadAhead(CDataSource *dataSource);
+  
   static int MakeJSONTimeSeries(CDrawImage *drawImage,CImageWarper *imageWarper,std::vector<CDataSource *>dataSources,int dataSourceIndex,int dX,int dY,CXMLParser::XMLElement *gfiStructure);
 };
 
@@ -2,6 +2,9 @@
 #include "CGenericDataWarper.h"
 const char * CNetCDFDataWriter::className = "CNetCDFDataWriter";
 #include "CRequest.h"
+#include "CReadFile.h"
+#include "CBufferPool.h"
+#include <set>
 
 // #define CNetCDFDataWriter_DEBUG
 
@@ -77,6 +80,16 @@ int CNetCDFDataWriter::init(CServerParams *srvParam,CDataSource *dataSource, int
 #endif
   baseDataSource = dataSource;
   this->srvParam = srvParam;
+  
+  if(!outputProfileSet&&srvParam->cfg->WCS.size()>0){
+    for(size_t j=0;j<srvParam->cfg->WCS[0]->WCSFormat.size();j++){
+      CServerConfig::XMLE_WCSFormat *wcsFormat = srvParam->cfg->WCS[0]->WCSFormat[j];
+      if(srvParam->Format.equals(wcsFormat->attr.name.c_str())&&!wcsFormat->attr.outputprofile.empty()){
+        if(getOutputProfile(srvParam->cfg,wcsFormat->attr.outputprofile.c_str(),outputProfile)!=0)return 1;
+        break;
+      }
+    }
+  }
   destCDFObject = new CDFObject();
     
   CT::string randomString = CServerParams::randomString(32);
@@ -92,6 +105,33 @@ int CNetCDFDataWriter::init(CServerParams *srvParam,CDataSource *dataSource, int
 
   // Copy global attributes
   CDFObject * srcObj=dataSource->getDataObject(0)->cdfObject;
+  
+  /* 
+   * Stream slices to the file, unless pixels are averaged (tiles) or feature variables need to be added while reading data.
+   * Chunks of several time steps can not be written one slice at a time, an output profile with time chunking is written at once.
+   */
+  streaming = drawFunctionMode == CNetCDFDataWriter_NEAREST && dataSource->level2CompatMode == false && srcObj->getAttributeNE("featureType") == NULL &&
+              outputProfile.chunking != CDFNETCDFWRITER_CHUNKING_TIME;
+  if(streaming){
+    /* Steps with the same dimension values are drawn into one slice, which only works when they follow each other */
+    std::set<std::string> finishedKeys;
+    std::string previousKey;
+    for(int step=0;step<dataSource->getNumTimeSteps()&&streaming;step++){
+      std::string key;
+      for(size_t d=0;d<dataSource->requiredDims.size();d++){
+        key+=dataSource->getDimensionValueForNameAndStep(dataSource->requiredDims[d]->netCDFDimName.c_str(),step).c_str();
+        key+="\n";
+      }
+      if(step>0&&key!=previousKey){
+        finishedKeys.insert(previousKey);
+        if(finishedKeys.find(key)!=finishedKeys.end())streaming = false;
+      }
+      previousKey = key;
+    }
+  }
+#ifdef CNetCDFDataWriter_DEBUG
+  CDBDebug("Streaming mode = %d",streaming);
+#endif
   for(size_t j=0;j<srcObj->attributes.size();j++){
     destCDFObject->setAttribute(srcObj->attributes[j]->name.c_str(),srcObj->attributes[j]->type,srcObj->attributes[j]->data,srcObj->attributes[j]->length);
   }
@@ -386,22 +426,41 @@ int CNetCDFDataWriter::init(CServerParams *srvParam,CDataSource *dataSource, int
 #endif 
         
     
-    if(CDF::allocateData(destVar->getType(),&destVar->data,varSize)!=0){
-      CDBError("Unable to allocate data for variable %s with %d elements",destVar->name.c_str(),varSize);
-      return 1;
-    }
     double dfNoData = NAN;
     if(dataSource->getDataObject(j)->hasNodataValue==1){
       dfNoData=dataSource->getDataObject(j)->dfNodataValue;
     }
-    
+    if(streaming){
+      /* Data is written per slice, the _FillValue needs to be known when the file is created. Slices which are never
+         written read as nodata as well: NaN without a nodata value, like the filled variable, or the NetCDF default for integers. */
+      double fillValue = dfNoData;
+      if(dataSource->getDataObject(j)->hasNodataValue==0){
+        switch(destVar->getType()){
+          case CDF_CHAR  : fillValue = NC_FILL_CHAR;break;
+          case CDF_BYTE  : fillValue = NC_FILL_BYTE;break;
+          case CDF_UBYTE : fillValue = NC_FILL_UBYTE;break;
+          case CDF_SHORT : fillValue = NC_FILL_SHORT;break;
+          case CDF_USHORT: fillValue = NC_FILL_USHORT;break;
+          case CDF_INT   : fillValue = NC_FILL_INT;break;
+          case CDF_UINT  : fillValue = NC_FILL_UINT;break;
+          default:break;
+        }
+      }
+      destVar->setAttribute("_FillValue",destVar->getType(),fillValue);
+    }else{
+      if(CDF::allocateData(destVar->getType(),&destVar->data,varSize)!=0){
+        CDBError("Unable to allocate data for variable %s with %d elements",destVar->name.c_str(),varSize);
+        return 1;
+      }
+      
 #ifdef CNetCDFDataWriter_DEBUG            
-    CDBDebug("Filling variable data of size %d",varSize);
+      CDBDebug("Filling variable data of size %d",varSize);
 #endif 
-    
-    if(CDF::fill(destVar->data,destVar->getType(),dfNoData,varSize)!=0){
-      CDBError("Unable to initialize data field to nodata value");
-      return 1;
+      
+      if(CDF::fill(destVar->data,destVar->getType(),dfNoData,varSize)!=0){
+        CDBError("Unable to initialize data field to nodata value");
+        return 1;
+      }
     }
     
 #ifdef CNetCDFDataWriter_DEBUG            
@@ -437,6 +496,17 @@ int CNetCDFDataWriter::init(CServerParams *srvParam,CDataSource *dataSource, int
   
   destCDFObject->addVariable(crs);
   
+  if(streaming){
+    streamWriter = new CDFNetCDFWriter(destCDFObject);
+    streamWriter->setNetCDFMode(4);
+    streamWriter->setDeflateShuffle(1,2,0);
+    streamWriter->setOutputProfile(outputProfile);
+    if(streamWriter->create(tempFileName.c_str())!=0){
+      CDBError("Unable to create file in temporary directory");
+      delete streamWriter;streamWriter = NULL;
+      return 1;
+    }
+  }
    
   #ifdef CNetCDFDataWriter_DEBUG
   CDBDebug("<CNetCDFDataWriter::init");
@@ -603,6 +673,12 @@ int CNetCDFDataWriter::addData(std::vector <CDataSource*> &dataSources){
       }
       
       destCDFObject->getVariable("crs")->setAttributeText("proj4_params",warper.getDestProjString().c_str());
+      if(streaming&&crsAttributeWritten==false){
+        if(streamWriter->putAttribute("crs",destCDFObject->getVariable("crs")->getAttribute("proj4_params"))!=0){
+          return 1;
+        }
+        crsAttributeWritten = true;
+      }
       CGeoParams sourceGeo;
       
       sourceGeo.dWidth = dataSource->dWidth;
@@ -630,10 +706,10 @@ int CNetCDFDataWriter::addData(std::vector <CDataSource*> &dataSources){
       if(settings.trueColorRGBA){
         size_t size = settings.width*settings.height;
         
-        settings.rField = new float[size];
-        settings.gField = new float[size];
-        settings.bField = new float[size];
-        settings.numField = new int[size];
+        settings.rField = CBufferPool::allocate<float>(size);
+        settings.gField = CBufferPool::allocate<float>(size);
+        settings.bField = CBufferPool::allocate<float>(size);
+        settings.numField = CBufferPool::allocate<int>(size);
         for(size_t j=0;j<size;j++){
           settings.rField[j] = 0;
           settings.gField[j] = 0;
@@ -644,7 +720,42 @@ int CNetCDFDataWriter::addData(std::vector <CDataSource*> &dataSources){
       
       size_t elementOffset = dataStepIndex*settings.width*settings.height;
       void *warpedData = NULL;
-      switch(variable->getType()){
+      if(streaming){
+        /* Only one slice per variable is kept in memory, steps with the same dataStepIndex are drawn into it */
+        PendingSlice *slice = NULL;
+        for(size_t k=0;k<pendingSlices.size();k++){
+          if(pendingSlices[k].variable==variable){slice=&pendingSlices[k];break;}
+        }
+        if(slice!=NULL&&slice->data!=NULL&&slice->dataStepIndex!=dataStepIndex){
+          if(writePendingSlice(*slice)!=0)return 1;
+        }
+        if(slice==NULL){
+          PendingSlice newSlice;
+          newSlice.variable = variable;
+          newSlice.dataStepIndex = dataStepIndex;
+          newSlice.data = NULL;
+          pendingSlices.push_back(newSlice);
+          slice = &pendingSlices.back();
+        }
+        if(slice->data==NULL){
+          size_t sliceSize = settings.width*settings.height;
+          /* Filled with the _FillValue set in init, the same value as unwritten slices */
+          double dfNoData = NAN;
+          CDF::Attribute *fillValue = variable->getAttributeNE("_FillValue");
+          if(fillValue!=NULL)fillValue->getData(&dfNoData,1);
+          if(CDF::allocateData(variable->getType(),&slice->data,sliceSize)!=0){
+            CDBError("Unable to allocate slice for variable %s with %d elements",variable->name.c_str(),sliceSize);
+            return 1;
+          }
+          if(CDF::fill(slice->data,variable->getType(),dfNoData,sliceSize)!=0){
+            CDBError("Unable to initialize data field to nodata value");
+            CDF::freeData(&slice->data);
+            return 1;
+          }
+          slice->dataStepIndex = dataStepIndex;
+        }
+        warpedData = slice->data;
+      }else switch(variable->getType()){
         case CDF_CHAR  : warpedData = ((char*)variable->data)+elementOffset;break;
         case CDF_BYTE  : warpedData = ((char*)variable->data)+elementOffset;break;
         case CDF_UBYTE : warpedData = ((unsigned char*)variable->data)+elementOffset;break;
@@ -693,13 +804,11 @@ int CNetCDFDataWriter::addData(std::vector <CDataSource*> &dataSources){
       
       reader.close();
       
-            
-      
       if(settings.trueColorRGBA){
-        delete[] settings.rField;
-        delete[] settings.gField;
-        delete[] settings.bField;
-        delete[] settings.numField;
+        CBufferPool::release(settings.rField);
+        CBufferPool::release(settings.gField);
+        CBufferPool::release(settings.bField);
+        CBufferPool::release(settings.numField);
         settings.rField = NULL;
         settings.gField=NULL;
         settings.bField = NULL;
@@ -787,13 +896,73 @@ int CNetCDFDataWriter::addData(std::vector <CDataSource*> &dataSources){
 }
 
 
+int CNetCDFDataWriter::writePendingSlice(PendingSlice &slice){
+  /* The slice position follows from the dataStepIndex, like elementOffset in the in memory variable */
+  CDF::Variable *variable = slice.variable;
+  size_t numVarDims = variable->dimensionlinks.size();
+  std::vector<size_t> start(numVarDims),count(numVarDims);
+  size_t stepIndex = slice.dataStepIndex;
+  for(int d=int(numVarDims)-1;d>=0;d--){
+    if(size_t(d)+2>=numVarDims){
+      start[d]=0;
+      count[d]=variable->dimensionlinks[d]->getSize();
+    }else{
+      size_t dimSize = variable->dimensionlinks[d]->getSize();
+      start[d]=stepIndex%dimSize;
+      count[d]=1;
+      stepIndex/=dimSize;
+    }
+  }
+  int status = streamWriter->writeSlice(variable->name.c_str(),&start[0],&count[0],slice.data);
+  CDF::freeData(&slice.data);
+  if(status!=0){
+    CDBError("Unable to write slice %d of variable %s",slice.dataStepIndex,variable->name.c_str());
+    return 1;
+  }
+  return 0;
+}
+
+int CNetCDFDataWriter::writePendingSlices(){
+  int status = 0;
+  for(size_t j=0;j<pendingSlices.size();j++){
+    if(pendingSlices[j].data!=NULL&&writePendingSlice(pendingSlices[j])!=0)status = 1;
+  }
+  pendingSlices.clear();
+  return status;
+}
+
+int CNetCDFDataWriter::finishStreamingFile(const char *fileName){
+  int status = writePendingSlices();
+  if(streamWriter->close()!=0)status = 1;
+  delete streamWriter;streamWriter = NULL;
+  if(status!=0){
+    CDBError("Unable to write file to temporary directory");
+    return 1;
+  }
+  if(fileName!=NULL){
+    if(CReadFile::move(tempFileName.c_str(),fileName)!=CREADFILE_OK){
+      CDBError("Unable to move %s to %s",tempFileName.c_str(),fileName);
+      remove(tempFileName.c_str());
+      return 1;
+    }
+  }
+  return 0;
+}
+
 int CNetCDFDataWriter::writeFile(const char *fileName,int level){
   if(level!=-1){
     destCDFObject->setAttribute("adaguctilelevel",CDF_INT,&level,1);
   }
+  if(streaming){
+    if(level!=-1&&streamWriter->putAttribute(NULL,destCDFObject->getAttribute("adaguctilelevel"))!=0){
+      return 1;
+    }
+    return finishStreamingFile(fileName);
+  }
   CDFNetCDFWriter *netCDFWriter = new CDFNetCDFWriter(destCDFObject);
   netCDFWriter->setNetCDFMode(4);
   netCDFWriter->setDeflateShuffle(1,2, 0);
+  netCDFWriter->setOutputProfile(outputProfile);
   int  status = netCDFWriter->write(fileName);
   delete netCDFWriter;
   
@@ -811,7 +980,15 @@ int CNetCDFDataWriter::end(){
     #endif
       
   const char * pszADAGUCWriteToFile=getenv("ADAGUC_WRITETOFILE");      
-  if(pszADAGUCWriteToFile != NULL){
+  if(streaming){
+    if(finishStreamingFile(pszADAGUCWriteToFile)!=0){
+      return 1;
+    }
+    if(pszADAGUCWriteToFile != NULL){
+      CDBDebug("Written to ADAGUC_WRITETOFILE %s",pszADAGUCWriteToFile);
+      return 0;
+    }
+  }else if(pszADAGUCWriteToFile != NULL){
     CDFNetCDFWriter *netCDFWriter = new CDFNetCDFWriter(destCDFObject);
     netCDFWriter->setNetCDFMode(4);
     // netCDFWriter->setDeflateShuffle(1,2,0);
@@ -824,18 +1001,22 @@ int CNetCDFDataWriter::end(){
     delete netCDFWriter;
     return 0;
   }
-  CDFNetCDFWriter *netCDFWriter = new CDFNetCDFWriter(destCDFObject);
- 
-  netCDFWriter->setNetCDFMode(4);
-  netCDFWriter->setDeflateShuffle(1,2,0);
-  int  status = netCDFWriter->write(tempFileName.c_str());
- 
-  delete netCDFWriter;
- 
-  
-  if(status!=0){
-    CDBError("Unable to write file to temporary directory");
-    return 1;
+  int status = 0;
+  if(!streaming){
+    CDFNetCDFWriter *netCDFWriter = new CDFNetCDFWriter(destCDFObject);
+   
+    netCDFWriter->setNetCDFMode(4);
+    netCDFWriter->setDeflateShuffle(1,2,0);
+    netCDFWriter->setOutputProfile(outputProfile);
+    status = netCDFWriter->write(tempFileName.c_str());
+   
+    delete netCDFWriter;
+   
+    
+    if(status!=0){
+      CDBError("Unable to write file to temporary directory");
+      return 1;
+    }
   }
   
   CT::string humanReadableString;
@@ -866,9 +1047,13 @@ int CNetCDFDataWriter::end(){
     printf("Content-Description: File Transfer\r\n");
     printf("Content-Transfer-Encoding: binary\r\n");
     printf("Content-Length: %zu\r\n",endPos); 
+    CTracer::printServerTimingHeader();
     printf("%s\r\n\r\n","Content-Type:application/netcdf");
-    for(size_t j=0;j<endPos;j++)putchar(getc(fp));
     fclose(fp);
+    if(CReadFile::sendToStdout(tempFileName.c_str())!=CREADFILE_OK){
+      CDBError("Unable to stream %s",tempFileName.c_str());
+      returnCode = 1;
+    }
     fclose(stdout);
   }
   //Remove temporary file
@@ -891,14 +1076,81 @@ CNetCDFDataWriter::CNetCDFDataWriter(){
   projectionVarX=NULL;
   projectionVarY=NULL;
   drawFunctionMode = CNetCDFDataWriter_NEAREST;
+  streaming = false;
+  outputProfileSet = false;
+  crsAttributeWritten = false;
+  streamWriter = NULL;
 }
 CNetCDFDataWriter::~CNetCDFDataWriter(){
 #ifdef CNetCDFDataWriter_DEBUG
         CDBDebug("CNetCDFDataWriter::~CNetCDFDataWriter()");
 #endif   
+  for(size_t j=0;j<pendingSlices.size();j++){
+    CDF::freeData(&pendingSlices[j].data);
+  }
+  if(streamWriter!=NULL){
+    streamWriter->close();
+    delete streamWriter;streamWriter = NULL;
+    remove(tempFileName.c_str());
+  }
   delete destCDFObject;destCDFObject = NULL;
 }
 
 void CNetCDFDataWriter::setInterpolationMode(int mode){
   drawFunctionMode = mode;
 }
+
+void CNetCDFDataWriter::setOutputProfile(const CDFNetCDFWriter::OutputProfile &profile){
+  outputProfile = profile;
+  outputProfileSet = true;
+}
+
+int CNetCDFDataWriter::getOutputProfile(CServerConfig::XMLE_Configuration *cfg,const char *name,CDFNetCDFWriter::OutputProfile &profile){
+  for(size_t j=0;j<cfg->NetCDFOutputProfile.size();j++){
+    CServerConfig::XMLE_NetCDFOutputProfile *cfgProfile = cfg->NetCDFOutputProfile[j];
+    if(!cfgProfile->attr.name.equals(name))continue;
+    profile = CDFNetCDFWriter::OutputProfile();
+    CT::string chunking = cfgProfile->attr.chunking.c_str();
+    chunking.toLowerCaseSelf();
+    if(chunking.equals("spatial")){
+      profile.chunking = CDFNETCDFWRITER_CHUNKING_SPATIAL;
+    }else if(chunking.equals("time")){
+      profile.chunking = CDFNETCDFWRITER_CHUNKING_TIME;
+    }else if(!chunking.empty()&&!chunking.equals("default")){
+      CDBError("NetCDFOutputProfile %s: unknown chunking %s, use default, spatial or time",name,chunking.c_str());
+      return 1;
+    }
+    if(!cfgProfile->attr.chunksize.empty())profile.chunkSize = cfgProfile->attr.chunksize.toInt();
+    if(!cfgProfile->attr.timechunksize.empty())profile.timeChunkSize = cfgProfile->attr.timechunksize.toInt();
+    if(!cfgProfile->attr.deflate.empty()){
+      profile.deflateLevel = cfgProfile->attr.deflate.toInt();
+      if(profile.deflateLevel<0||profile.deflateLevel>9){
+        CDBError("NetCDFOutputProfile %s: deflate must be between 0 and 9",name);
+        return 1;
+      }
+    }
+    if(!cfgProfile->attr.shuffle.empty())profile.shuffle = cfgProfile->attr.shuffle.equals("true")?1:0;
+    CT::string quantize = cfgProfile->attr.quantize.c_str();
+    quantize.toLowerCaseSelf();
+    if(quantize.equals("bitround")){
+      profile.quantize = CDFNETCDFWRITER_QUANTIZE_BITROUND;
+    }else if(quantize.equals("bitgroom")){
+      profile.quantize = CDFNETCDFWRITER_QUANTIZE_BITGROOM;
+    }else if(quantize.equals("granularbr")){
+      profile.quantize = CDFNETCDFWRITER_QUANTIZE_GRANULARBR;
+    }else if(!quantize.empty()&&!quantize.equals("none")){
+      CDBError("NetCDFOutputProfile %s: unknown quantize %s, use none, bitround, bitgroom or granularbr",name,quantize.c_str());
+      return 1;
+    }
+    if(profile.quantize!=CDFNETCDFWRITER_QUANTIZE_NONE){
+      profile.quantizeDigits = cfgProfile->attr.quantizedigits.toInt();
+      if(profile.quantizeDigits<=0){
+        CDBError("NetCDFOutputProfile %s: quantize requires quantizedigits",name);
+        return 1;
+      }
+    }
+    return 0;
+  }
+  CDBError("NetCDFOutputProfile %s is not configured",name);
+  return 1;
+}
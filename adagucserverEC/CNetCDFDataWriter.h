@@ -78,6 +78,33 @@ private:
   CServerParams *srvParam;
   CDF::Dimension *projectionDimX,*projectionDimY;//Shorthand pointers to cdfdatamodel (do never delete!)
   CDF::Variable *projectionVarX,*projectionVarY;//Shorthand pointers to cdfdatamodel (do never delete!)
+  
+  /*
+   * In streaming mode the file is created in init and each warped slice is written directly by addData,
+   * so memory use does not grow with the number of requested timesteps.
+   */
+  bool streaming;
+  bool crsAttributeWritten;
+  CDFNetCDFWriter *streamWriter;
+  
+  /*
+   * The slice of a variable stays in memory while the added steps have the same dataStepIndex, like the files
+   * of a tiled mosaic, and is written when a step with another index is added or the file is finished.
+   */
+  class PendingSlice{
+  public:
+    CDF::Variable *variable;
+    int dataStepIndex;
+    void *data;
+  };
+  std::vector<PendingSlice> pendingSlices;
+  int writePendingSlice(PendingSlice &slice);
+  int writePendingSlices();
+  
+  /* Chunking, compression and quantization of the written file, from setOutputProfile or the WCSFormat */
+  CDFNetCDFWriter::OutputProfile outputProfile;
+  bool outputProfileSet;
+  int finishStreamingFile(const char *fileName);
   void createProjectionVariables(CDFObject *cdfObject,int width,int height,double *bbox);
 public:
   CNetCDFDataWriter();
@@ -89,6 +116,17 @@ public:
   int end();
   
   void setInterpolationMode(int mode);
+  
+  /**
+   * Sets the output profile, overriding the outputprofile of the WCSFormat. Must be called before init.
+   */
+  void setOutputProfile(const CDFNetCDFWriter::OutputProfile &profile);
+  
+  /**
+   * Reads the NetCDFOutputProfile configuration element with the given name
+   * @return Zero on success, 1 when the profile does not exist or is invalid
+   */
+  static int getOutputProfile(CServerConfig::XMLE_Configuration *cfg,const char *name,CDFNetCDFWriter::OutputProfile &profile);
 };
 
 #endif
@@ -156,35 +156,109 @@ CT::string COpenDAPHandler::createDDSHeader(CT::string layerName, CDFObject *cdf
 
 
 
-int bytesWritten = 0;
+/* Encoded data is collected in this buffer and written to stdout with large writes */
+#define COPENDAPHANDLER_OUTPUTBUFFERSIZE (1024*1024)
+
+/* Hyperslabs larger than this number of elements are read and encoded in chunks along their first dimension */
+#define COPENDAPHANDLER_MAXCHUNKELEMENTS (4*1024*1024)
+
+static unsigned char outputBuffer[COPENDAPHANDLER_OUTPUTBUFFERSIZE];
+static size_t outputBufferUsed = 0;
+size_t bytesWritten = 0;
+
+static void flushOutput(){
+  if(outputBufferUsed>0){
+    fwrite(outputBuffer,1,outputBufferUsed,stdout);
+    outputBufferUsed=0;
+  }
+}
+
+/* Returns room for numBytes in the output buffer, numBytes must be smaller than the buffer */
+static inline unsigned char *reserveOutput(size_t numBytes){
+  if(outputBufferUsed+numBytes>COPENDAPHANDLER_OUTPUTBUFFERSIZE)flushOutput();
+  unsigned char *p = outputBuffer+outputBufferUsed;
+  outputBufferUsed+=numBytes;
+  bytesWritten+=numBytes;
+  return p;
+}
+
+static void writeBytes(const void *data,size_t numBytes){
+  const unsigned char *p = (const unsigned char*)data;
+  while(numBytes>0){
+    size_t n = numBytes<COPENDAPHANDLER_OUTPUTBUFFERSIZE?numBytes:COPENDAPHANDLER_OUTPUTBUFFERSIZE;
+    memcpy(reserveOutput(n),p,n);
+    p+=n;numBytes-=n;
+  }
+}
+
 void writeInt(int v){
-  unsigned char c1=((unsigned char)v);
-  unsigned char c2=((unsigned char)(v>>8));
-  unsigned char c3=((unsigned char)(v>>16));
-  unsigned char c4=((unsigned char)(v>>24));;
-//   c1 = 48;
-//   c2=49 ; 
-//   c3 = 50;
-//   c4 = 51;
-  fwrite(&c4,1,1,stdout);
-  fwrite(&c3,1,1,stdout);
-  fwrite(&c2,1,1,stdout);
-  fwrite(&c1,1,1,stdout);
-  bytesWritten+=4;
+  unsigned int b = __builtin_bswap32((unsigned int)v);
+  memcpy(reserveOutput(4),&b,4);
 }
 
 void writeDouble(double &v){
-  unsigned char const * p = reinterpret_cast<unsigned char const *>(&v);
-  fwrite(&p[7],1,1,stdout);
-  fwrite(&p[6],1,1,stdout);
-  fwrite(&p[5],1,1,stdout);
-  fwrite(&p[4],1,1,stdout);
-  fwrite(&p[3],1,1,stdout);
-  fwrite(&p[2],1,1,stdout);
-  fwrite(&p[1],1,1,stdout);
-  fwrite(&p[0],1,1,stdout);
-
-  bytesWritten+=8;
+  unsigned long long b;
+  memcpy(&b,&v,8);
+  b = __builtin_bswap64(b);
+  memcpy(reserveOutput(8),&b,8);
+}
+
+/**
+ * Encodes numElements values as XDR (big endian) into the output buffer, in blocks which fit the buffer.
+ * Shorts are sent as 32 bit words. Returns the number of bytes written.
+ */
+static size_t putData(const void *data,size_t numElements,CDFType type){
+  size_t typeSize = CDF::getTypeSize(type);
+  size_t outputTypeSize = (type==CDF_SHORT||type==CDF_USHORT)?4:typeSize;
+  size_t elementsPerBlock = COPENDAPHANDLER_OUTPUTBUFFERSIZE/outputTypeSize;
+  size_t written = 0;
+  for(size_t offset=0;offset<numElements;offset+=elementsPerBlock){
+    size_t n = numElements-offset<elementsPerBlock?numElements-offset:elementsPerBlock;
+    unsigned char *out = reserveOutput(n*outputTypeSize);
+    const unsigned char *in = ((const unsigned char*)data)+offset*typeSize;
+    switch(outputTypeSize){
+      case 1:
+        memcpy(out,in,n);
+        break;
+      case 4:
+        if(typeSize==2){
+          for(size_t d=0;d<n;d++){
+            out[d*4]=0;
+            out[d*4+1]=0;
+            out[d*4+2]=in[d*2+1];
+            out[d*4+3]=in[d*2];
+          }
+        }else{
+          for(size_t d=0;d<n;d++){
+            unsigned int v;
+            memcpy(&v,in+d*4,4);
+            v = __builtin_bswap32(v);
+            memcpy(out+d*4,&v,4);
+          }
+        }
+        break;
+      case 8:
+        for(size_t d=0;d<n;d++){
+          unsigned long long v;
+          memcpy(&v,in+d*8,8);
+          v = __builtin_bswap64(v);
+          memcpy(out+d*8,&v,8);
+        }
+        break;
+    }
+    written+=n*outputTypeSize;
+  }
+  return written;
+}
+
+/* Bytes need to be padded to words of four bytes */
+static void putPadding(size_t written,CDFType type){
+  if((type==CDF_BYTE||type==CDF_CHAR||type==CDF_UBYTE)){
+    size_t numPadding = (4-(written%4))%4;
+    if(numPadding>0){
+      memset(reserveOutput(numPadding),48,numPadding);
+    }
+  }
 }
 
 int COpenDAPHandler::putVariableDataSize(CDF::Variable *v){
@@ -204,93 +278,87 @@ int COpenDAPHandler::putVariableDataSize(CDF::Variable *v){
   return 0;
 }
 
-// int tdata = 48;
 int COpenDAPHandler::putVariableData(CDF::Variable *v,CDFType type){
-  int written = 0;
-  size_t typeSize = CDF::getTypeSize(type);
+  size_t varSize = v->getSize();
+  //CDBDebug("name:%s varSize:%d",v->name.c_str(),varSize);
   
-
+  //Strings need to be '0' terminated.
+  if(type==CDF_STRING){
+    const char **data = (const char**)v->data;
+    size_t written = 0;
+    for(size_t d=0;d<varSize;d++){
+      size_t l = strlen(data[d]);
+      writeInt(l);
+      writeBytes(data[d],l);
+      written+=l;
+      //Padding bytes to sequences of four.
+      size_t numPadding = (4-(written%4))%4;
+      if(numPadding>0){
+        memset(reserveOutput(numPadding),0,numPadding);
+        written+=numPadding;
+      }
+    }
+    return 0;
+  }
   
-  size_t varSize = v->getSize();
-  //CDBDebug("name:%s typeSize:%d varSize:%d",v->name.c_str(),typeSize,varSize);
   if(type==CDF_BYTE||
     type==CDF_UBYTE||
     type==CDF_CHAR||
+    type==CDF_SHORT||
+    type==CDF_USHORT||
     type==CDF_INT||
     type==CDF_UINT||
     type==CDF_FLOAT||
     type==CDF_DOUBLE){
-    unsigned char *data = (unsigned char*)v->data;
-    for(size_t d=0;d<varSize;d++){
-      for(size_t e=0;e<typeSize;e++){
-        putc(data[d*typeSize+(typeSize-1)-e],stdout);
-        //putc(tdata,stdout);
-        
-      }
-      bytesWritten+=typeSize;
-      written+=typeSize;
-    }
+    size_t written = putData(v->data,varSize,type);
+    putPadding(written,type);
   }
-  
-  if(type==CDF_SHORT||
-    type==CDF_USHORT){
-    unsigned char *data = (unsigned char*)v->data;
-
-    for(size_t d=0;d<varSize;d++){
-      putc(0,stdout);
-      putc(0,stdout);
-      bytesWritten+=2;
-      written+=2;
-      for(size_t e=0;e<typeSize;e++){
-        
-    
-        putc(data[d*typeSize+(typeSize-1)-e],stdout);
+  return 0;
+}
 
-        //putc(tdata,stdout);
-        
-      }
-      bytesWritten+=typeSize;
-      written+=typeSize;
-    }
+int COpenDAPHandler::putVariableHyperslab(CDF::Variable *v,CDFType type,size_t *start,size_t *count,ptrdiff_t *stride){
+  size_t numDims = v->dimensionlinks.size();
+  size_t varSize = 1;
+  for(size_t j=0;j<numDims;j++)varSize*=count[j];
+  
+  /* Small variables, strings and dimensions are read at once */
+  if(v->isDimension||type==CDF_STRING||numDims<2||varSize<=COPENDAPHANDLER_MAXCHUNKELEMENTS||count[0]==0){
+    int status = v->readData(type,start,count,stride);
+    if(status!=0)return status;
+    putVariableDataSize(v);
+    putVariableData(v,type);
+    return 0;
   }
   
-  //Strings need to be '0' terminated.
-  if(type==CDF_STRING){
-    const char **data = (const char**)v->data;
-    for(size_t d=0;d<varSize;d++){
-      size_t l = strlen(data[d]);
-      writeInt(l);
-      for(size_t e=0;e<l;e++){
-        //CDBDebug("%s",data[d][e]);
-        
-        putc(data[d][e],stdout);
-        written++;
-        bytesWritten++;
-        
-      }
-      
-      //Padding bytes to sequences of four.
-      while(int(written/4)*4 !=written){
-        putc(0,stdout);
-        written++;
-        bytesWritten++;
-      }
-    }
+  /* The size is known from the hyperslab, so it can be sent before the data is read */
+  writeInt(varSize);
+  writeInt(varSize);
+  
+  size_t sliceSize = varSize/count[0];
+  size_t slicesPerChunk = COPENDAPHANDLER_MAXCHUNKELEMENTS/sliceSize;
+  if(slicesPerChunk<1)slicesPerChunk=1;
+  size_t chunkStart[numDims],chunkCount[numDims];
+  for(size_t j=0;j<numDims;j++){
+    chunkStart[j]=start[j];
+    chunkCount[j]=count[j];
   }
-
-
-  //Bytes need to be padded to words of four bytes
-  if((type==CDF_BYTE||type==CDF_CHAR||type==CDF_UBYTE))
-  {
-    //Padding bytes to sequences of four.
-    while(int(written/4)*4 !=written){
-      CDBDebug("Padding");
-      putc(48,stdout);
-      written++;
-      bytesWritten++;
+  #ifdef COPENDAPHANDLER_DEBUG
+  CDBDebug("Reading %s in chunks of %d slices",v->name.c_str(),slicesPerChunk);
+  #endif
+  size_t written = 0;
+  for(size_t slice=0;slice<count[0];slice+=slicesPerChunk){
+    chunkStart[0]=start[0]+slice*stride[0];
+    chunkCount[0]=count[0]-slice<slicesPerChunk?count[0]-slice:slicesPerChunk;
+    v->freeData();
+    int status = v->readData(type,chunkStart,chunkCount,stride);
+    if(status!=0){
+      CDBError("Unable to read chunk at %d for %s",chunkStart[0],v->name.c_str());
+      return status;
     }
+    written+=putData(v->data,v->getSize(),type);
   }
-  //fflush(stdout);
+  v->freeData();
+  putPadding(written,type);
   return 0;
 }
 
@@ -434,8 +502,10 @@ int COpenDAPHandler::HandleOpenDAPRequest(const char *path,const char *query,CSe
   }
       
       if(isDODRequest){
+        CTracer::printServerTimingHeader();
         printf("%s%c%c\n","Content-Type: application/octet-stream",13,10);
       }else{
+        CTracer::printServerTimingHeader();
         printf("%s%c%c\n","Content-Type: text/plain",13,10);
       }
 #ifdef COPENDAPHANDLER_DEBUG      
@@ -816,6 +886,7 @@ CDBDebug("Found layer %s",layerName.c_str());
                           
                           #endif
                           CDF::Variable *variableToRead = cdfObjectToRead->getVariable(v->name.c_str());
+                          variableToRead->freeData();
                           variableToRead->readData(type,start,count,stride);
                           #ifdef COPENDAPHANDLER_DEBUG
                           CDBDebug("Read %d elements with type %s with element size %d",variableToRead->getSize(),CDF::getCDFDataTypeName(type).c_str(), CDF::getTypeSize(type));
@@ -823,6 +894,7 @@ CDBDebug("Found layer %s",layerName.c_str());
 
                       
                           putVariableData(variableToRead,type);
+                          variableToRead->freeData();
                         }
                       }
                     }else{
@@ -850,6 +922,7 @@ CDBDebug("Found layer %s",layerName.c_str());
                   int status = v->readData(type);
                   if(status!=0){
                     CDBError("Unable to read data for %s",v->name.c_str());
+                    flushOutput();
                     return -1;
                   }else{
                     putVariableDataSize(v);
@@ -883,26 +956,23 @@ CDBDebug("Found layer %s",layerName.c_str());
                           }
                   #endif
                     //v->freeData();
-                    status = v->readData(type,start,count,stride);
-//                     if(v->getType()==CDF_STRING){
-//                       for(size_t j=0;j<v->getSize();j++){
-//                         CDBDebug("%s",((char**)v->data)[j]);
-//                       }
-//                     }
+                    status = putVariableHyperslab(v,type,start,count,stride);
                 }else{
                   #ifdef COPENDAPHANDLER_DEBUG
                   CDBDebug("READ ALL");
                   #endif
                
                   v->readData(type);
+                  if(status==0){
+                    putVariableDataSize(v);
+                    putVariableData(v,type);
+                  }
                 }
                 if(status!=0){
                   CDBError("Unable to read data for %s",v->name.c_str());
+                  flushOutput();
                   delete dataSource;
                   return -1;
-                }else{
-                  putVariableDataSize(v);
-                  putVariableData(v,type);
                 }
               }
               
@@ -919,6 +989,7 @@ CDBDebug("Found layer %s",layerName.c_str());
             }
           }
         }
+        flushOutput();
         //fflush(stdout);
       }
      
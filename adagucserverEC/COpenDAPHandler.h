@@ -45,6 +45,7 @@ private:
   static CT::string VarInfoToString(std::vector <VarInfo> selectedVariables);
   static int putVariableDataSize(CDF::Variable *v);
   static int putVariableData(CDF::Variable *v,CDFType type);
+  static int putVariableHyperslab(CDF::Variable *v,CDFType type,size_t *start,size_t *count,ptrdiff_t *stride);
   static CT::string createDDSHeader(CT::string layerName, CDFObject *cdfObject ,std::vector <VarInfo> selectedVariables);
   static int getDimSize(CDataSource *dataSource, const char *name);
 public:
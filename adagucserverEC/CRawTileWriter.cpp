@@ -0,0 +1,266 @@
+/******************************************************************************
+ *
+ * Project:  ADAGUC Server
+ * Purpose:  Writes the warped data values of a GetMap request as a binary raw tile
+ * Date:     2026-10-18
+ *
+ ******************************************************************************
+ *
+ * Copyright 2026, Royal Netherlands Meteorological Institute (KNMI)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <string.h>
+#include <math.h>
+#include <zlib.h>
+#include "CRawTileWriter.h"
+#include "CGenericDataWarper.h"
+#include "CDataReader.h"
+
+// #define CRAWTILEWRITER_DEBUG
+
+const char * CRawTileWriter::className = "CRawTileWriter";
+
+CRawTileWriter::CRawTileWriter(){
+  srvParam = NULL;
+  baseDataSource = NULL;
+  encoding = CRAWTILE_ENCODING_FLOAT32;
+  compression = CRAWTILE_COMPRESSION_DEFLATE;
+}
+
+CRawTileWriter::~CRawTileWriter(){
+  for(size_t j=0;j<bands.size();j++){
+    delete[] bands[j];
+  }
+  bands.clear();
+}
+
+bool CRawTileWriter::isRawTileFormat(CT::string *format){
+  return format->indexOf(CRAWTILE_MIMETYPE)>=0;
+}
+
+int CRawTileWriter::init(CServerParams *srvParam,CDataSource *dataSource, int nrOfBands){
+  this->srvParam = srvParam;
+  baseDataSource = dataSource;
+  encoding = CRAWTILE_ENCODING_FLOAT32;
+  compression = CRAWTILE_COMPRESSION_DEFLATE;
+  if(srvParam->Format.indexOf("encoding=int16")>=0)encoding = CRAWTILE_ENCODING_INT16;
+  if(srvParam->Format.indexOf("compression=none")>=0)compression = CRAWTILE_COMPRESSION_NONE;
+  if(srvParam->Geo->dWidth<=0||srvParam->Geo->dHeight<=0){
+    CDBError("Invalid tile size %dx%d",srvParam->Geo->dWidth,srvParam->Geo->dHeight);
+    return 1;
+  }
+  #ifdef CRAWTILEWRITER_DEBUG
+  CDBDebug("init %dx%d encoding %d compression %d",srvParam->Geo->dWidth,srvParam->Geo->dHeight,encoding,compression);
+  #endif
+  return 0;
+}
+
+int CRawTileWriter::addData(std::vector <CDataSource*> &dataSources){
+  if(dataSources.size()!=1){
+    CDBError("Raw tiles can only be made for one layer, %d layers are requested",(int)dataSources.size());
+    return 1;
+  }
+  CDataSource *dataSource = dataSources[0];
+  if(dataSource->dLayerType!=CConfigReaderLayerTypeDataBase){
+    CDBError("Raw tiles are only available for database layers");
+    return 1;
+  }
+  CDataReader reader;
+  int status = reader.open(dataSource,CNETCDFREADER_MODE_OPEN_ALL);
+  if(status!=0){
+    CDBError("Could not open file: %s",dataSource->getFileName());
+    return 1;
+  }
+
+  size_t gridSize = size_t(srvParam->Geo->dWidth)*size_t(srvParam->Geo->dHeight);
+  float *warpedData = new float[gridSize];
+  for(size_t j=0;j<gridSize;j++)warpedData[j]=NAN;
+  bands.push_back(warpedData);
+
+  CImageWarper warper;
+  status = warper.initreproj(dataSource,srvParam->Geo,&srvParam->cfg->Projection);
+  if(status != 0){
+    CDBError("Unable to initialize projection");
+    reader.close();
+    return 1;
+  }
+
+  void *sourceData = dataSource->getDataObject(0)->cdfVariable->data;
+  CDFType dataType=dataSource->getDataObject(0)->cdfVariable->getType();
+
+  Settings settings;
+  settings.width = srvParam->Geo->dWidth;
+  settings.height = srvParam->Geo->dHeight;
+  settings.data = warpedData;
+  settings.hasNodataValue = dataSource->getDataObject(0)->hasNodataValue;
+  settings.dfNodataValue = dataSource->getDataObject(0)->dfNodataValue;
+
+  CGeoParams sourceGeo;
+  sourceGeo.dWidth = dataSource->dWidth;
+  sourceGeo.dHeight = dataSource->dHeight;
+  sourceGeo.dfBBOX[0] = dataSource->dfBBOX[0];
+  sourceGeo.dfBBOX[1] = dataSource->dfBBOX[1];
+  sourceGeo.dfBBOX[2] = dataSource->dfBBOX[2];
+  sourceGeo.dfBBOX[3] = dataSource->dfBBOX[3];
+  sourceGeo.dfCellSizeX = dataSource->dfCellSizeX;
+  sourceGeo.dfCellSizeY = dataSource->dfCellSizeY;
+  sourceGeo.CRS = dataSource->nativeProj4;
+
+  switch(dataType){
+    case CDF_CHAR  :  GenericDataWarper::render<char>  (&warper,sourceData,&sourceGeo,srvParam->Geo,&settings,&drawFunction);break;
+    case CDF_BYTE  :  GenericDataWarper::render<char>  (&warper,sourceData,&sourceGeo,srvParam->Geo,&settings,&drawFunction);break;
+    case CDF_UBYTE :  GenericDataWarper::render<unsigned char> (&warper,sourceData,&sourceGeo,srvParam->Geo,&settings,&drawFunction);break;
+    case CDF_SHORT :  GenericDataWarper::render<short> (&warper,sourceData,&sourceGeo,srvParam->Geo,&settings,&drawFunction);break;
+    case CDF_USHORT:  GenericDataWarper::render<ushort>(&warper,sourceData,&sourceGeo,srvParam->Geo,&settings,&drawFunction);break;
+    case CDF_INT   :  GenericDataWarper::render<int>   (&warper,sourceData,&sourceGeo,srvParam->Geo,&settings,&drawFunction);break;
+    case CDF_UINT  :  GenericDataWarper::render<uint>  (&warper,sourceData,&sourceGeo,srvParam->Geo,&settings,&drawFunction);break;
+    case CDF_FLOAT :  GenericDataWarper::render<float> (&warper,sourceData,&sourceGeo,srvParam->Geo,&settings,&drawFunction);break;
+    case CDF_DOUBLE:  GenericDataWarper::render<double>(&warper,sourceData,&sourceGeo,srvParam->Geo,&settings,&drawFunction);break;
+  }
+  warper.closereproj();
+  reader.close();
+  #ifdef CRAWTILEWRITER_DEBUG
+  CDBDebug("Band %d warped",bands.size());
+  #endif
+  return 0;
+}
+
+void CRawTileWriter::putUInt16(std::vector<unsigned char> &buffer,unsigned short value){
+  buffer.push_back(value&0xFF);
+  buffer.push_back((value>>8)&0xFF);
+}
+
+void CRawTileWriter::putUInt32(std::vector<unsigned char> &buffer,unsigned int value){
+  for(int j=0;j<4;j++)buffer.push_back((value>>(j*8))&0xFF);
+}
+
+void CRawTileWriter::putDouble(std::vector<unsigned char> &buffer,double value){
+  unsigned long long bits;
+  memcpy(&bits,&value,8);
+  for(int j=0;j<8;j++)buffer.push_back((bits>>(j*8))&0xFF);
+}
+
+void CRawTileWriter::putString(std::vector<unsigned char> &buffer,const char *value){
+  size_t length = strlen(value);
+  if(length>65535)length = 65535;
+  putUInt16(buffer,length);
+  buffer.insert(buffer.end(),value,value+length);
+}
+
+int CRawTileWriter::end(){
+  if(bands.size()==0){
+    CDBError("No data added");
+    return 1;
+  }
+  size_t gridSize = size_t(srvParam->Geo->dWidth)*size_t(srvParam->Geo->dHeight);
+  size_t numValues = gridSize*bands.size();
+  size_t valueSize = encoding == CRAWTILE_ENCODING_INT16?2:4;
+  double scale = 1,offset = 0,nodata = NAN;
+
+  //Values as little endian bytes
+  std::vector<unsigned char> values(numValues*valueSize);
+  if(encoding == CRAWTILE_ENCODING_INT16){
+    float min = 0,max = 0;
+    bool first = true;
+    for(size_t b=0;b<bands.size();b++){
+      for(size_t j=0;j<gridSize;j++){
+        float v = bands[b][j];
+        if(v!=v||v==INFINITY||v==-INFINITY)continue;
+        if(first){min = v;max = v;first = false;}
+        if(v<min)min = v;
+        if(v>max)max = v;
+      }
+    }
+    scale = max>min?(double(max)-double(min))/65534.:1;
+    offset = double(min)+32767.*scale;
+    nodata = CRAWTILE_INT16_NODATA;
+    for(size_t b=0;b<bands.size();b++){
+      for(size_t j=0;j<gridSize;j++){
+        float v = bands[b][j];
+        int code = CRAWTILE_INT16_NODATA;
+        if(v==v&&v!=INFINITY&&v!=-INFINITY){
+          code = int(floor((v-offset)/scale+0.5));
+          if(code<-32767)code = -32767;
+          if(code>32767)code = 32767;
+        }
+        size_t p = (b*gridSize+j)*2;
+        values[p] = code&0xFF;
+        values[p+1] = (code>>8)&0xFF;
+      }
+    }
+  }else{
+    for(size_t b=0;b<bands.size();b++){
+      for(size_t j=0;j<gridSize;j++){
+        unsigned int bits;
+        memcpy(&bits,&bands[b][j],4);
+        size_t p = (b*gridSize+j)*4;
+        for(int i=0;i<4;i++)values[p+i] = (bits>>(i*8))&0xFF;
+      }
+    }
+  }
+
+  std::vector<unsigned char> payload;
+  if(compression == CRAWTILE_COMPRESSION_DEFLATE){
+    //Bytes of equal significance are grouped, which makes the data compress much better
+    std::vector<unsigned char> shuffled(values.size());
+    for(size_t j=0;j<numValues;j++){
+      for(size_t i=0;i<valueSize;i++){
+        shuffled[i*numValues+j] = values[j*valueSize+i];
+      }
+    }
+    uLongf compressedSize = compressBound(shuffled.size());
+    payload.resize(compressedSize);
+    if(compress2(&payload[0],&compressedSize,&shuffled[0],shuffled.size(),CRAWTILE_DEFLATE_LEVEL)!=Z_OK){
+      CDBError("Unable to compress raw tile");
+      return 1;
+    }
+    payload.resize(compressedSize);
+  }else{
+    payload.swap(values);
+  }
+
+  std::vector<unsigned char> header;
+  header.push_back('A');header.push_back('D');header.push_back('R');header.push_back('T');
+  header.push_back(CRAWTILE_VERSION);
+  header.push_back(encoding);
+  header.push_back(compression);
+  header.push_back(0);
+  putUInt32(header,srvParam->Geo->dWidth);
+  putUInt32(header,srvParam->Geo->dHeight);
+  putUInt32(header,bands.size());
+  for(int j=0;j<4;j++)putDouble(header,srvParam->Geo->dfBBOX[j]);
+  putDouble(header,scale);
+  putDouble(header,offset);
+  putDouble(header,nodata);
+  putUInt32(header,numValues*valueSize);
+  putUInt32(header,payload.size());
+  putString(header,srvParam->Geo->CRS.c_str());
+  putString(header,baseDataSource->getDataObject(0)->getUnits().c_str());
+
+  #ifdef CRAWTILEWRITER_DEBUG
+  CDBDebug("Writing raw tile of %d bytes, %d bytes uncompressed",header.size()+payload.size(),numValues*valueSize);
+  #endif
+  printf("Content-Length: %zu\r\n",header.size()+payload.size());
+  CTracer::printServerTimingHeader();
+  printf("%s%s\r\n\r\n","Content-Type:",CRAWTILE_MIMETYPE);
+  if(fwrite(&header[0],1,header.size(),stdout)!=header.size()||
+     (payload.size()>0&&fwrite(&payload[0],1,payload.size(),stdout)!=payload.size())){
+    CDBError("Unable to write raw tile");
+    return 1;
+  }
+  fflush(stdout);
+  return 0;
+}
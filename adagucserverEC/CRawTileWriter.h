@@ -0,0 +1,119 @@
+/******************************************************************************
+ *
+ * Project:  ADAGUC Server
+ * Purpose:  Writes the warped data values of a GetMap request as a binary raw tile
+ * Date:     2026-10-18
+ *
+ ******************************************************************************
+ *
+ * Copyright 2026, Royal Netherlands Meteorological Institute (KNMI)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ******************************************************************************/
+
+#ifndef CRawTileWriter_H
+#define CRawTileWriter_H
+
+#include <vector>
+#include "Definitions.h"
+#include "CDataSource.h"
+#include "CIBaseDataWriterInterface.h"
+#include "CDebugger.h"
+
+#define CRAWTILE_MIMETYPE             "application/x-adaguc-rawtile"
+
+#define CRAWTILE_VERSION              1
+
+#define CRAWTILE_ENCODING_FLOAT32     0
+#define CRAWTILE_ENCODING_INT16       1
+
+#define CRAWTILE_COMPRESSION_NONE     0
+#define CRAWTILE_COMPRESSION_DEFLATE  1
+
+/* Nodata value of the int16 encoding, valid values are quantized into -32767...32767 */
+#define CRAWTILE_INT16_NODATA         -32768
+
+#define CRAWTILE_DEFLATE_LEVEL        4
+
+/**
+ * Output format for GetMap which returns the data values instead of a rendered image, so clients can apply
+ * styles themselves and cache the tiles independent of the style.
+ *
+ * Selected with FORMAT=application/x-adaguc-rawtile. By default values are written as float32, with
+ * FORMAT=application/x-adaguc-rawtile;encoding=int16 they are quantized linearly between the minimum and maximum
+ * of the tile. The payload is shuffled and deflated, unless ;compression=none is added to the format.
+ *
+ * Layout, all numbers little endian:
+ *   char[4]    "ADRT"
+ *   uint8      version
+ *   uint8      encoding (CRAWTILE_ENCODING_*)
+ *   uint8      compression (CRAWTILE_COMPRESSION_*)
+ *   uint8      reserved
+ *   uint32     width, height, number of bands (one band per time step)
+ *   float64[4] bbox (minx, miny, maxx, maxy)
+ *   float64    scale, offset: value = stored * scale + offset
+ *   float64    nodata value as stored, NaN for float32
+ *   uint32     uncompressed payload size, payload size
+ *   uint16+char[] CRS
+ *   uint16+char[] units
+ *   payload: the bands after each other, rows from top to bottom. With deflate the bytes of the values are
+ *   shuffled before compression: first byte of all values, then the second bytes, etc.
+ */
+class CRawTileWriter: public CBaseDataWriterInterface{
+private:
+  DEF_ERRORFUNCTION();
+  class Settings{
+  public:
+    size_t width;
+    size_t height;
+    float *data;
+    bool hasNodataValue;
+    double dfNodataValue;
+  };
+
+  template <class T>
+  static void drawFunction(int x,int y,T val, void *_settings){
+    Settings*settings = (Settings*)_settings;
+    if(x>=0&&y>=0&&x<(int)settings->width&&y<(int)settings->height){
+      if(settings->hasNodataValue&&val==(T)settings->dfNodataValue)return;
+      settings->data[x+y*settings->width]=val;
+    }
+  };
+
+  CServerParams *srvParam;
+  CDataSource *baseDataSource;
+  std::vector<float*> bands;
+  int encoding;
+  int compression;
+
+  static void putUInt16(std::vector<unsigned char> &buffer,unsigned short value);
+  static void putUInt32(std::vector<unsigned char> &buffer,unsigned int value);
+  static void putDouble(std::vector<unsigned char> &buffer,double value);
+  static void putString(std::vector<unsigned char> &buffer,const char *value);
+public:
+  CRawTileWriter();
+  virtual ~CRawTileWriter();
+
+  /**
+   * Returns true when the FORMAT of the request asks for a raw tile
+   */
+  static bool isRawTileFormat(CT::string *format);
+
+  // Virtual functions
+  int init(CServerParams *srvParam,CDataSource *dataSource, int nrOfBands);
+  int addData(std::vector <CDataSource*> &dataSources);
+  int end();
+};
+
+#endif
@@ -25,26 +25,37 @@
  ******************************************************************************/
 
  //#define CREQUEST_DEBUG
-//#define MEASURETIME
 
 #include "CRequest.h"
 #include "COpenDAPHandler.h"
 #include "CDBFactory.h"
+#include "CDBFileWatcher.h"
 #include "CAutoResource.h"
 #include "CNetCDFDataWriter.h"
+#include "CRawTileWriter.h"
+#include "CCreateContours.h"
 #include "CConvertGeoJSON.h"
 #include "CCreateScaleBar.h"
+#include "CBufferPool.h"
 const char *CRequest::className="CRequest";
 int CRequest::CGI=0;
 
 //Entry point for all runs
 int CRequest::runRequest(){
+  CTracer::Span requestSpan("request");
   int status=process_querystring();
+  requestSpan.stop();
+  if(CTracer::isEnabled()){
+    CDBDebug("Timings: %s",CTracer::getSummary().c_str());
+  }
+  CTracer::endRequest();
   CDFObjectStore::getCDFObjectStore()->clear();
   CConvertGeoJSON::clearFeatureStore();
   CDFStore::clear();
   ProjectionStore::getProjectionStore()->clear();
   CDBFactory::clear();
+  /* All data of the request is released now, return the pooled buffers to the system in one go */
+  CBufferPool::endRequest();
   return status;
 }
 
@@ -81,9 +92,7 @@ int CRequest::setConfigFile(const char *pszConfigFile){
     CDBError("No config file set");
     return 1;
   }
-  #ifdef MEASURETIME
-  StopWatch_Stop("Set config file %s",pszConfigFile);
-  #endif
+  CTracer::Span configSpan("config");
   
   CT::string configFile = pszConfigFile;
   CT::StackList<CT::string> configFileList=configFile.splitToStack(",");
@@ -137,9 +146,6 @@ int CRequest::setConfigFile(const char *pszConfigFile){
     return 1;
   }
   
-  #ifdef MEASURETIME
-  StopWatch_Stop("Config file parsed");
-  #endif
   
   //Check for mandatory attributes
   for(size_t j=0;j<srvParam->cfg->Layer.size();j++){
@@ -241,9 +247,6 @@ int CRequest::setConfigFile(const char *pszConfigFile){
       
     }
   }
-  #ifdef MEASURETIME
-  StopWatch_Stop("Config file checked");
-  #endif
   
   return status;
 }
@@ -657,9 +660,11 @@ int CRequest::generateGetReferenceTimes(CDataSource *dataSource){
     int status = generateGetReferenceTimesDoc(&XMLdocument,dataSource);;if(status==CXMLGEN_FATAL_ERROR_OCCURED)return 1;
   }
   if (srvParam->JSONP.length()==0) {
+    CTracer::printServerTimingHeader();
     printf("%s%c%c\n","Content-Type: application/json ",13,10);
     printf("%s",XMLdocument.c_str());
   } else {
+    CTracer::printServerTimingHeader();
     printf("%s%c%c\n","Content-Type: application/javascript ",13,10);
     printf("%s(%s)",srvParam->JSONP.c_str(),XMLdocument.c_str());
   }
@@ -711,6 +716,7 @@ int CRequest::process_wms_getcap_request(){
   if(pszADAGUCWriteToFile != NULL){
     CReadFile::write(pszADAGUCWriteToFile, XMLdocument.c_str(), XMLdocument.length());
   }else{
+    CTracer::printServerTimingHeader();
     printf("%s%c%c\n","Content-Type:text/xml",13,10);
     printf("%s",XMLdocument.c_str());
   }
@@ -766,6 +772,22 @@ int CRequest::process_wms_gethistogram_request(){
 
 
 
+int CRequest::process_wms_getcontours_request(){
+  if(srvParam->WMSLayers!=NULL){
+    CT::string message = "WMS GETCONTOURS ";
+    for(size_t j=0;j<srvParam->WMSLayers->count;j++){
+      if(j>0)message.concat(",");
+      message.printconcat("(%d) %s",j,srvParam->WMSLayers[j].c_str());
+    }
+    CDBDebug(message.c_str());
+  }else{
+    CDBDebug("WMS GETCONTOURS no layers");
+  }
+  return process_all_layers();
+}
+
+
+
 int CRequest::setDimValuesForDataSource(CDataSource *dataSource,CServerParams *srvParam){
 #ifdef CREQUEST_DEBUG  
   CDBDebug("setDimValuesForDataSource");
@@ -1142,6 +1164,7 @@ int findExtent(const char *srcProj4Str,CServerParams *srvParam,double nativeView
 }
 
 int CRequest::queryDimValuesForDataSource(CDataSource *dataSource,CServerParams *srvParam){
+  CTracer::Span dbSpan("db");
 #ifdef CREQUEST_DEBUG
     CDBDebug("queryDimValuesForDataSource");
 #endif    
@@ -1554,6 +1577,7 @@ int CRequest::process_all_layers(){
       if(pszADAGUCWriteToFile != NULL){
         CReadFile::write(pszADAGUCWriteToFile, XMLDocument.c_str(), XMLDocument.length());
       }else{
+        CTracer::printServerTimingHeader();
         printf("%s%c%c\n","Content-Type:text/xml",13,10);
         printf("%s",XMLDocument.c_str());
       }
@@ -1674,7 +1698,23 @@ int CRequest::process_all_layers(){
         for(size_t d=0;d<dataSources.size();d++){
           dataSources[d]->setTimeStep(0);
         }
-        if(srvParam->requestType==REQUEST_WMS_GETMAP){
+        // WMS GetMap with the data values instead of an image
+        if(srvParam->requestType==REQUEST_WMS_GETMAP&&CRawTileWriter::isRawTileFormat(&srvParam->Format)){
+          CRawTileWriter rawTileWriter;
+          status = rawTileWriter.init(srvParam,dataSources[j],dataSources[j]->getNumTimeSteps());if(status != 0)throw(__LINE__);
+          for(int k=0;k<dataSources[j]->getNumTimeSteps();k++){
+            dataSources[j]->setTimeStep(k);
+            try{
+              status = rawTileWriter.addData(dataSources);
+            }catch(int e){
+              CDBError("Exception code %d",e);
+              throw(__LINE__);
+            }
+            if(status != 0)throw(__LINE__);
+          }
+          status = rawTileWriter.end();if(status != 0)throw(__LINE__);
+          fclose(stdout);
+        }else if(srvParam->requestType==REQUEST_WMS_GETMAP){
           
 
           CImageDataWriter imageDataWriter;
@@ -1702,7 +1742,7 @@ int CRequest::process_all_layers(){
             dataSourceToUse=0;
             imageDataWriterIsInitialized=true;
           }
-          bool measurePerformance = false;
+          CTracer::Span renderSpan("render");
           
           
           
@@ -1716,10 +1756,8 @@ int CRequest::process_all_layers(){
               }else{
                 useThreading = true;
               }
-              //measurePerformance = true;
             }
           }
-          if(measurePerformance){StopWatch_Stop("Start imagewarper");}
           if(useThreading){
             
             //When we have multiple timesteps, we will create an animation.
@@ -1736,6 +1774,7 @@ int CRequest::process_all_layers(){
                 args[worker].dataSources.push_back(dataSources[d]->clone());;
               }
               args[worker].imageDataWriter = &imageDataWriter;
+              args[worker].parentSpan = CTracer::getCurrentSpan();
               args[worker].finished = false;
               args[worker].running = false;
               args[worker].used = false;
@@ -1761,7 +1800,6 @@ int CRequest::process_all_layers(){
                       errcode=pthread_create(&threads[worker],NULL,CImageDataWriter_addData,&args[worker]);
                       if(errcode){CDBError("pthread_create");return 1;}
                       
-                      if(measurePerformance){StopWatch_Stop("Started thread %d for timestep %d",worker,k);}
                       OK=true;
                       break;
                     }
@@ -1774,7 +1812,6 @@ int CRequest::process_all_layers(){
                 
               }
             }
-            if(measurePerformance){StopWatch_Stop("All submitted");}
             for (int worker=0; worker<numThreads; worker++) {
               if(args[worker].used){
                 args[worker].used=false;
@@ -1782,14 +1819,12 @@ int CRequest::process_all_layers(){
                 if(errcode) { CDBError("pthread_join");return 1;}
               }
             }
-            if(measurePerformance){StopWatch_Stop("All done");}
             for (int worker=0; worker<numThreads; worker++) {
               for(size_t j=0;j<args[worker].dataSources.size();j++){
                 delete args[worker].dataSources[j];
               }
               args[worker].dataSources.clear();
             }
-            if(measurePerformance){StopWatch_Stop("All deleted");}
           }else{
             /*Standard non threading functionality */
             for(size_t k=0;k<(size_t)dataSources[dataSourceToUse]->getNumTimeSteps();k++){
@@ -1829,8 +1864,7 @@ int CRequest::process_all_layers(){
               }
             }
           }
-          if(measurePerformance){StopWatch_Stop("Finished imagewarper");}
-          
+          renderSpan.stop();
  
           
           int textY=5;
@@ -2038,8 +2072,22 @@ int CRequest::process_all_layers(){
           }
         }
         
+        // WMS GETCONTOURS
+        if(srvParam->requestType==REQUEST_WMS_GETCONTOURS){
+          CCreateContours contourCreator;
+          try{
+            status = contourCreator.init(srvParam,dataSources[j],dataSources[j]->getNumTimeSteps());if(status != 0)throw(__LINE__);
+            status = contourCreator.addData(dataSources);if(status != 0)throw(__LINE__);
+            status = contourCreator.end();if(status != 0)throw(__LINE__);
+          }catch(int e){
+            CDBError("Exception code %d",e);
+            throw(__LINE__);
+          }
+        }
+        
         // WMS GetMetaData
         if(srvParam->requestType==REQUEST_WMS_GETMETADATA){
+          CTracer::printServerTimingHeader();
           printf("%s%c%c\n","Content-Type:text/plain",13,10);
           CDataReader reader;
           status = reader.open(dataSources[j],CNETCDFREADER_MODE_OPEN_HEADER);
@@ -2074,10 +2122,6 @@ return 0;
 
 int CRequest::process_querystring(){
  
-  #ifdef MEASURETIME
-  StopWatch_Stop("Start processing query string");
-  #endif
-//  StopWatch_Time("render()");
   //First try to find all possible dimensions
   //std::vector
  /* for(size_t j=0;j<srvParam->cfg->Layer.size();j++){
@@ -2565,6 +2609,7 @@ int CRequest::process_querystring(){
       // debug Parameters
       if(value0Cap.equals("DEBUG")){
         if(values[1].equals("ON")){
+          CTracer::printServerTimingHeader();
           printf("%s%c%c\n","Content-Type:text/plain",13,10);
           printf("Debug mode:ON\nDebug messages:<br>\r\n\r\n");
           //dFound_Debug=1;
@@ -2662,9 +2707,6 @@ int CRequest::process_querystring(){
   #ifdef CREQUEST_DEBUG
     CDBDebug("Finished parsing query string parameters");
   #endif
-  #ifdef MEASURETIME
-  StopWatch_Stop("query string processed");
-  #endif
 
   if(dFound_Service==0){
     CDBError("ADAGUC Server: Parameter SERVICE missing");
@@ -2692,6 +2734,7 @@ int CRequest::process_querystring(){
       if(REQUEST.equals("GETCAPABILITIES"))srvParam->requestType=REQUEST_WMS_GETCAPABILITIES;
       if(REQUEST.equals("GETMAP"))srvParam->requestType=REQUEST_WMS_GETMAP;
       if(REQUEST.equals("GETHISTOGRAM"))srvParam->requestType=REQUEST_WMS_GETHISTOGRAM;
+      if(REQUEST.equals("GETCONTOURS"))srvParam->requestType=REQUEST_WMS_GETCONTOURS;
       if(REQUEST.equals("GETSCALEBAR"))srvParam->requestType=REQUEST_WMS_GETSCALEBAR;
       if(REQUEST.equals("GETFEATUREINFO"))srvParam->requestType=REQUEST_WMS_GETFEATUREINFO;
       if(REQUEST.equals("GETPOINTVALUE"))srvParam->requestType=REQUEST_WMS_GETPOINTVALUE;
@@ -2876,12 +2919,13 @@ int CRequest::process_querystring(){
         srvParam->requestType==REQUEST_WMS_GETMAP||
         srvParam->requestType==REQUEST_WMS_GETFEATUREINFO||
         srvParam->requestType==REQUEST_WMS_GETPOINTVALUE||
-        srvParam->requestType==REQUEST_WMS_GETHISTOGRAM
-        
+        srvParam->requestType==REQUEST_WMS_GETHISTOGRAM||
+        srvParam->requestType==REQUEST_WMS_GETCONTOURS
         
       )){
       
-      if(srvParam->requestType==REQUEST_WMS_GETFEATUREINFO||srvParam->requestType==REQUEST_WMS_GETPOINTVALUE||srvParam->requestType==REQUEST_WMS_GETHISTOGRAM){
+      if(srvParam->requestType==REQUEST_WMS_GETFEATUREINFO||srvParam->requestType==REQUEST_WMS_GETPOINTVALUE||srvParam->requestType==REQUEST_WMS_GETHISTOGRAM||
+         srvParam->requestType==REQUEST_WMS_GETCONTOURS){
         int status = CServerParams::checkDataRestriction();
         if((status&ALLOW_GFI)==false){
           CDBError("ADAGUC Server: This layer is not queryable.");
@@ -2916,6 +2960,14 @@ int CRequest::process_querystring(){
         srvParam->dY=0;
         srvParam->requestType=REQUEST_WMS_GETFEATUREINFO;
       }
+      
+      if(srvParam->requestType==REQUEST_WMS_GETCONTOURS){
+        //Contours are extracted from the native grid, the size of the map is not used
+        dFound_Width=1;
+        dFound_Height=1;
+        srvParam->Geo->dWidth=1;
+        srvParam->Geo->dHeight=1;
+      }
    
       
     
@@ -3004,6 +3056,15 @@ int CRequest::process_querystring(){
           return 0;
         }
       
+        if(srvParam->requestType==REQUEST_WMS_GETCONTOURS){
+          int status =  process_wms_getcontours_request();
+          if(status != 0) {
+            CDBError("WMS GetContours Request failed");
+            return 1;
+          }
+          return 0;
+        }
+      
         if(srvParam->requestType==REQUEST_WMS_GETFEATUREINFO){
           if(srvParam->OGCVersion == WMS_VERSION_1_0_0 || srvParam->OGCVersion == WMS_VERSION_1_1_1){
             if(dFound_X==0){
@@ -3071,6 +3132,7 @@ int CRequest::process_querystring(){
             return 1;
         }
         drawImage.crop(1);
+        CTracer::printServerTimingHeader();
         printf("%s%c%c\n","Content-Type:image/png",13,10);
         drawImage.printImagePng8(true);
         return 0;
@@ -3221,10 +3283,6 @@ int CRequest::process_querystring(){
   }else{
     CDBError("ADAGUC Server: Unknown service");
   }
-  #ifdef MEASURETIME
-  StopWatch_Stop("End of query string");
-  #endif
-
   return 0;
 }
 
@@ -3294,6 +3352,19 @@ int CRequest::updatedb(CT::string *tailPath,CT::string *layerPathToScan, int sca
   return errorHasOccured;
 }
 
+int CRequest::watchdb(CT::string *layerPathToScan,int scanFlags){
+  CDBDebug("***** Starting DB watcher *****");
+  CDBFileWatcher fileWatcher;
+  int status = fileWatcher.run(srvParam,layerPathToScan,scanFlags);
+  CDFObjectStore::getCDFObjectStore()->clear();
+  CConvertGeoJSON::clearFeatureStore();
+  CDFStore::clear();
+  CDBFactory::clear();
+  /* All data of the request is released now, return the pooled buffers to the system in one go */
+  CBufferPool::endRequest();
+  return status;
+}
+
 
 
 int CRequest::getDocumentCacheName(CT::string *documentName,CServerParams *srvParam){
@@ -3334,6 +3405,8 @@ void *CImageDataWriter_addData(void *arg){
    
 //   pthread_mutex_lock(&CImageDataWriter_addData_lock);
   CImageDataWriter_addData_args *imgdwArg = (CImageDataWriter_addData_args*)arg;
+  /* Time this step as part of the render span, as when rendering without threads */
+  CTracer::setCurrentSpan(imgdwArg->parentSpan);
   imgdwArg->status = imgdwArg->imageDataWriter->addData(imgdwArg->dataSources);
   
   imgdwArg->finished = true;
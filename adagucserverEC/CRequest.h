@@ -31,6 +31,7 @@
 #include "CServerParams.h"
 #include "CDataSource.h"
 #include "CStopWatch.h"
+#include "CTracer.h"
 #include "CXMLGen.h"
 #ifdef ADAGUC_USE_GDAL
 #include "CGDALDataWriter.h"
@@ -218,7 +219,9 @@ private:
     int process_all_layers();
     int process_wms_getreferencetimes_request();
     int process_wms_gethistogram_request();
+    int process_wms_getcontours_request();
     int updatedb(CT::string *tailPath,CT::string *layerPathToScan,int scanFlags);
+    int watchdb(CT::string *layerPathToScan,int scanFlags);
     
     int runRequest();
 
@@ -231,6 +234,7 @@ class CImageDataWriter_addData_args{
 public:
   CImageDataWriter *imageDataWriter;
   std::vector <CDataSource*>dataSources;
+  CTracer::Span *parentSpan;
   int status;
   bool running;
   bool finished;
@@ -612,21 +612,68 @@ class CServerConfig:public CXMLSerializerInterface{
       public:
         class Cattr{
         public:
-          CXMLString useendtime;
+          CXMLString useendtime,chunkcachesize,chunkcacheslots,chunkcachepreemption,accessmode;
         }attr;
         void addAttribute(const char *name,const char *value){
           if(equals("useendtime", 10,name)){attr.useendtime.copy(value);return;}
+          else if(equals("chunkcachesize",14,name)){attr.chunkcachesize.copy(value);return;}
+          else if(equals("chunkcacheslots",15,name)){attr.chunkcacheslots.copy(value);return;}
+          else if(equals("chunkcachepreemption",20,name)){attr.chunkcachepreemption.copy(value);return;}
+          else if(equals("accessmode",10,name)){attr.accessmode.copy(value);return;}
         }
     };
     class XMLE_FilePath: public CXMLObjectInterface{
       public:
         class Cattr{
           public:
-            CXMLString filter,gfi_openall;
+            CXMLString filter,gfi_openall,gfi_readahead;
         }attr;
         void addAttribute(const char *name,const char *value){
           if(equals("filter",6,name)){attr.filter.copy(value);return;}
           else if(equals("gfi_openall",11,name)){attr.gfi_openall.copy(value);return;}
+          else if(equals("gfi_readahead",13,name)){attr.gfi_readahead.copy(value);return;}
+        }
+    };
+    
+    class XMLE_TimeSeriesStore: public CXMLObjectInterface{
+      public:
+        class Cattr{
+          public:
+            CXMLString path,chunksize;
+        }attr;
+        void addAttribute(const char *name,const char *value){
+          if(equals("path",4,name)){attr.path.copy(value);return;}
+          else if(equals("chunksize",9,name)){attr.chunksize.copy(value);return;}
+        }
+    };
+    
+    class XMLE_FieldStatistics: public CXMLObjectInterface{
+      public:
+        class Cattr{
+          public:
+            CXMLString bins;
+        }attr;
+        void addAttribute(const char *name,const char *value){
+          if(equals("bins",4,name)){attr.bins.copy(value);return;}
+        }
+    };
+    
+    /* Set of map tiles which are rendered after new files are added to a layer */
+    class XMLE_WarmUp: public CXMLObjectInterface{
+      public:
+        class Cattr{
+          public:
+            CXMLString styles,crs,bbox,levels,width,height,format,threads;
+        }attr;
+        void addAttribute(const char *name,const char *value){
+          if(equals("styles",6,name)){attr.styles.copy(value);return;}
+          else if(equals("crs",3,name)){attr.crs.copy(value);return;}
+          else if(equals("bbox",4,name)){attr.bbox.copy(value);return;}
+          else if(equals("levels",6,name)){attr.levels.copy(value);return;}
+          else if(equals("width",5,name)){attr.width.copy(value);return;}
+          else if(equals("height",6,name)){attr.height.copy(value);return;}
+          else if(equals("format",6,name)){attr.format.copy(value);return;}
+          else if(equals("threads",7,name)){attr.threads.copy(value);return;}
         }
     };
     
@@ -643,7 +690,8 @@ class CServerConfig:public CXMLSerializerInterface{
             threads,
             debug,
             prefix,
-            readonly;
+            readonly,
+            outputprofile;
         }attr;
 //           <TileSettings  tilewidth="600" 
 //                    tileheight="600" 
@@ -659,6 +707,7 @@ class CServerConfig:public CXMLSerializerInterface{
           else if(equals("debug",5,name)){attr.debug.copy(value);return;}
           else if(equals("prefix",6,name)){attr.prefix.copy(value);return;}
           else if(equals("readonly",8,name)){attr.readonly.copy(value);return;}
+          else if(equals("outputprofile",13,name)){attr.outputprofile.copy(value);return;}
           else if(equals("threads",7,name)){attr.threads.copy(value);return;}
           else if(equals("tilewidthpx",11,name)){attr.tilewidthpx.copy(value);return;}
           else if(equals("tileheightpx",12,name)){attr.tileheightpx.copy(value);return;}
@@ -798,13 +847,46 @@ class CServerConfig:public CXMLSerializerInterface{
       public:
         class Cattr{
           public:
-            CXMLString name,driver,mimetype,options;
+            CXMLString name,driver,mimetype,options,outputprofile;
         }attr;
         void addAttribute(const char *attrname,const char *attrvalue){
           if(equals("name",4,attrname)){attr.name.copy(attrvalue);return;}
           if(equals("driver",6,attrname)){attr.driver.copy(attrvalue);return;}
           if(equals("mimetype",8,attrname)){attr.mimetype.copy(attrvalue);return;}
           if(equals("options",7,attrname)){attr.options.copy(attrvalue);return;}
+          if(equals("outputprofile",13,attrname)){attr.outputprofile.copy(attrvalue);return;}
+        }
+    };
+    
+    /* Cache of decoded fields in shared memory, size in megabytes */
+    class XMLE_SharedFieldCache: public CXMLObjectInterface{
+      public:
+        class Cattr{
+          public:
+            CXMLString name,size;
+        }attr;
+        void addAttribute(const char *attrname,const char *attrvalue){
+          if(equals("name",4,attrname)){attr.name.copy(attrvalue);return;}
+          else if(equals("size",4,attrname)){attr.size.copy(attrvalue);return;}
+        }
+    };
+    
+    /* Layout of the NetCDF-4 files written by the server, referenced by name from WCSFormat and TileSettings */
+    class XMLE_NetCDFOutputProfile: public CXMLObjectInterface{
+      public:
+        class Cattr{
+          public:
+            CXMLString name,chunking,chunksize,timechunksize,deflate,shuffle,quantize,quantizedigits;
+        }attr;
+        void addAttribute(const char *attrname,const char *attrvalue){
+          if(equals("name",4,attrname)){attr.name.copy(attrvalue);return;}
+          else if(equals("chunking",8,attrname)){attr.chunking.copy(attrvalue);return;}
+          else if(equals("chunksize",9,attrname)){attr.chunksize.copy(attrvalue);return;}
+          else if(equals("timechunksize",13,attrname)){attr.timechunksize.copy(attrvalue);return;}
+          else if(equals("deflate",7,attrname)){attr.deflate.copy(attrvalue);return;}
+          else if(equals("shuffle",7,attrname)){attr.shuffle.copy(attrvalue);return;}
+          else if(equals("quantize",8,attrname)){attr.quantize.copy(attrvalue);return;}
+          else if(equals("quantizedigits",14,attrname)){attr.quantizedigits.copy(attrvalue);return;}
         }
     };
     
@@ -1004,10 +1086,11 @@ class CServerConfig:public CXMLSerializerInterface{
       public:
         class Cattr{
           public:
-            CXMLString a,b,c,units,algorithm,mode,name;
+            CXMLString a,b,c,units,algorithm,mode,name,expression;
         }attr;
         void addAttribute(const char *attrname,const char *attrvalue){
           if(equals("a",1,attrname)){attr.a.copy(attrvalue);return;}
+          else if(equals("expression",10,attrname)){attr.expression.copy(attrvalue);return;}
           else if(equals("b",1,attrname)){attr.b.copy(attrvalue);return;}
           else if(equals("c",1,attrname)){attr.c.copy(attrvalue);return;}
           else if(equals("mode",4,attrname)){attr.mode.copy(attrvalue);return;}
@@ -1075,6 +1158,8 @@ class CServerConfig:public CXMLSerializerInterface{
         std::vector <XMLE_Variable*> Variable;
         std::vector <XMLE_FilePath*> FilePath;
         std::vector <XMLE_TileSettings*> TileSettings;
+        std::vector <XMLE_TimeSeriesStore*> TimeSeriesStore;
+        std::vector <XMLE_FieldStatistics*> FieldStatistics;
         std::vector <XMLE_DataReader*> DataReader;
         std::vector <XMLE_Dimension*> Dimension;
         std::vector <XMLE_Legend*> Legend;
@@ -1103,6 +1188,7 @@ class CServerConfig:public CXMLSerializerInterface{
         std::vector <XMLE_Grid*> Grid;
         std::vector <XMLE_AdditionalLayer*> AdditionalLayer;
         std::vector <XMLE_FeatureInterval*> FeatureInterval;
+        std::vector <XMLE_WarmUp*> WarmUp;
         
         
         ~XMLE_Layer(){
@@ -1114,6 +1200,8 @@ class CServerConfig:public CXMLSerializerInterface{
           XMLE_DELOBJ(Variable);
           XMLE_DELOBJ(FilePath);
           XMLE_DELOBJ(TileSettings)
+          XMLE_DELOBJ(TimeSeriesStore);
+          XMLE_DELOBJ(FieldStatistics);
           XMLE_DELOBJ(DataReader);
           XMLE_DELOBJ(Dimension);
           XMLE_DELOBJ(Legend);
@@ -1142,6 +1230,7 @@ class CServerConfig:public CXMLSerializerInterface{
           XMLE_DELOBJ(Grid);
           XMLE_DELOBJ(AdditionalLayer);
           XMLE_DELOBJ(FeatureInterval);
+          XMLE_DELOBJ(WarmUp);
         }
         void addElement(CXMLObjectInterface *baseClass,int rc, const char *name,const char *value){
           CXMLSerializerInterface * base = (CXMLSerializerInterface*)baseClass;
@@ -1158,6 +1247,8 @@ class CServerConfig:public CXMLSerializerInterface{
             else if(equals("Variable",8,name)){XMLE_ADDOBJ(Variable);}
             else if(equals("FilePath",8,name)){XMLE_ADDOBJ(FilePath);}
             else if(equals("TileSettings",12,name)){XMLE_ADDOBJ(TileSettings);}
+            else if(equals("TimeSeriesStore",15,name)){XMLE_ADDOBJ(TimeSeriesStore);}
+            else if(equals("FieldStatistics",15,name)){XMLE_ADDOBJ(FieldStatistics);}
             else if(equals("DataReader",10,name)){XMLE_ADDOBJ(DataReader);}
             else if(equals("Dimension",9,name)){XMLE_ADDOBJ(Dimension);}
             else if(equals("Legend",6,name)){XMLE_ADDOBJ(Legend);}
@@ -1186,6 +1277,7 @@ class CServerConfig:public CXMLSerializerInterface{
             else if(equals("Grid",4,name)){XMLE_ADDOBJ(Grid);}
             else if(equals("AdditionalLayer",15,name)){XMLE_ADDOBJ(AdditionalLayer);}
             else if(equals("FeatureInterval",15,name)){XMLE_ADDOBJ(FeatureInterval);}
+            else if(equals("WarmUp",6,name)){XMLE_ADDOBJ(WarmUp);}
             
             
           }
@@ -1214,6 +1306,8 @@ class CServerConfig:public CXMLSerializerInterface{
         std::vector <XMLE_AutoResource*> AutoResource;
         std::vector <XMLE_Dataset*> Dataset;
         std::vector <XMLE_Include*> Include;
+        std::vector <XMLE_NetCDFOutputProfile*> NetCDFOutputProfile;
+        std::vector <XMLE_SharedFieldCache*> SharedFieldCache;
         
         ~XMLE_Configuration(){
           XMLE_DELOBJ(Legend);
@@ -1231,6 +1325,8 @@ class CServerConfig:public CXMLSerializerInterface{
           XMLE_DELOBJ(AutoResource);
           XMLE_DELOBJ(Dataset);
           XMLE_DELOBJ(Include);
+          XMLE_DELOBJ(NetCDFOutputProfile);
+          XMLE_DELOBJ(SharedFieldCache);
         }
         void addElement(CXMLObjectInterface *baseClass,int rc, const char *name,const char *value){
           CXMLSerializerInterface * base = (CXMLSerializerInterface*)baseClass;
@@ -1253,6 +1349,8 @@ class CServerConfig:public CXMLSerializerInterface{
             else if(equals("AutoResource",12,name)){XMLE_ADDOBJ(AutoResource);}
             else if(equals("Dataset",7,name)){XMLE_ADDOBJ(Dataset);}
             else if(equals("Include",7,name)){XMLE_ADDOBJ(Include);}
+            else if(equals("NetCDFOutputProfile",19,name)){XMLE_ADDOBJ(NetCDFOutputProfile);}
+            else if(equals("SharedFieldCache",16,name)){XMLE_SETOBJ(SharedFieldCache);}
           }
           if(pt2Class!=NULL)pt2Class->addElement(baseClass,rc-pt2Class->level,name,value);
         }
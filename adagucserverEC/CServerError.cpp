@@ -24,6 +24,7 @@
  ******************************************************************************/
 
 #include "CServerError.h"
+#include "CTracer.h"
 //#define ERRORMSGS_SIZE 30000 
 
 
@@ -122,6 +123,7 @@ void readyerror(){
   if(errormsgs.size()==0)return;
 
   if(cerror_mode==EXCEPTIONS_PLAINTEXT||cerror_mode==0){//Plain text
+    CTracer::printServerTimingHeader();
     printf("%s%c%c\n","Content-type: text/plain",13,10);  
     for(size_t j=0;j<errormsgs.size();j++){
       fprintf(stdout,"%s\n",errormsgs[j].c_str());
@@ -129,6 +131,7 @@ void readyerror(){
     resetErrors();return;
   }
   if(cerror_mode==WMS_EXCEPTIONS_XML_1_1_1){//XML exception
+    CTracer::printServerTimingHeader();
     printf("%s%c%c\n","Content-Type:text/xml",13,10);  
     fprintf(stdout,"<?xml version='1.0' encoding=\"ISO-8859-1\" standalone=\"no\" ?>\n");
     fprintf(stdout,"<!DOCTYPE ServiceExceptionReport SYSTEM \"http://schemas.opengis.net/wms/1.1.1/exception_1_1_1.dtd\">\n");
@@ -148,6 +151,7 @@ void readyerror(){
     resetErrors();return;
   }
   if(cerror_mode==WMS_EXCEPTIONS_XML_1_3_0){//XML exception
+    CTracer::printServerTimingHeader();
     printf("%s%c%c\n","Content-Type:text/xml",13,10);  
     fprintf(stdout,"<?xml version='1.0' encoding=\"ISO-8859-1\" standalone=\"no\" ?>\n");
     fprintf(stdout,"<ServiceExceptionReport version=\"1.3.0\"  xmlns=\"http://www.opengis.net/ogc\" xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\" xsi:schemaLocation=\"http://www.opengis.net/ogc http://schemas.opengis.net/wms/1.3.0/exceptions_1_3_0.xsd\">\n");
@@ -184,20 +188,25 @@ void readyerror(){
     }
     
     if(errImageFormat==IMAGEFORMAT_IMAGEPNG8){
+      CTracer::printServerTimingHeader();
       printf("%s%c%c\n","Content-Type:image/png",13,10);
       drawImage.printImagePng8(true);
     }else if(errImageFormat==IMAGEFORMAT_IMAGEPNG24){
       drawImage.setRenderer(CDRAWIMAGERENDERER_CAIRO);
+      CTracer::printServerTimingHeader();
       printf("%s%c%c\n","Content-Type:image/png",13,10);
       drawImage.printImagePng24();
     }else if(errImageFormat==IMAGEFORMAT_IMAGEPNG32){
       drawImage.setRenderer(CDRAWIMAGERENDERER_CAIRO);
+      CTracer::printServerTimingHeader();
       printf("%s%c%c\n","Content-Type:image/png",13,10);
       drawImage.printImagePng32();
     }else if(errImageFormat==IMAGEFORMAT_IMAGEGIF){
+      CTracer::printServerTimingHeader();
       printf("%s%c%c\n","Content-Type:image/gif",13,10);
       drawImage.printImageGif();
     }else {
+      CTracer::printServerTimingHeader();
       printf("%s%c%c\n","Content-Type:image/png",13,10);
       drawImage.printImagePng8(true);
     }
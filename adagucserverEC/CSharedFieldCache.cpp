@@ -0,0 +1,306 @@
+/******************************************************************************
+ *
+ * Project:  ADAGUC Server
+ * Purpose:  Cache of decoded fields in shared memory, shared by all server processes
+ * Date:     2026-10-18
+ *
+ ******************************************************************************
+ *
+ * Copyright 2026, Royal Netherlands Meteorological Institute (KNMI)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ******************************************************************************/
+
+#include "CSharedFieldCache.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+const char *CSharedFieldCache::className="CSharedFieldCache";
+CSharedFieldCache::Header *CSharedFieldCache::header = NULL;
+bool CSharedFieldCache::attachTried = false;
+pthread_mutex_t CSharedFieldCache::attachLock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Written as the last step of the initialization of a new segment */
+static const char CSharedFieldCache_magic[16]={'A','D','A','G','U','C','F','I','E','L','D','S','0','0','0','3'};
+
+uint64_t CSharedFieldCache::hashKey(const char *key,size_t length){
+  uint64_t hash = 14695981039346656037ULL;
+  for(size_t j=0;j<length;j++){
+    hash ^= (unsigned char)key[j];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+int CSharedFieldCache::attach(const char *name,size_t size){
+  pthread_mutex_lock(&attachLock);
+  if(attachTried){
+    pthread_mutex_unlock(&attachLock);
+    return header==NULL?1:0;
+  }
+  attachTried = true;
+
+  bool creator = true;
+  int fd = shm_open(name,O_RDWR|O_CREAT|O_EXCL,0600);
+  if(fd==-1&&errno==EEXIST){
+    creator = false;
+    fd = shm_open(name,O_RDWR,0600);
+  }
+  if(fd==-1){
+    CDBError("Unable to open shared memory segment %s: %s",name,strerror(errno));
+    pthread_mutex_unlock(&attachLock);
+    return 1;
+  }
+
+  size_t segmentSize = size;
+  if(creator){
+    if(ftruncate(fd,segmentSize)!=0){
+      CDBError("Unable to size shared memory segment %s: %s",name,strerror(errno));
+      close(fd);
+      shm_unlink(name);
+      pthread_mutex_unlock(&attachLock);
+      return 1;
+    }
+  }else{
+    /* The creating process sizes the segment right after creating it */
+    struct stat st;
+    st.st_size = 0;
+    for(int j=0;j<100&&st.st_size==0;j++){
+      if(fstat(fd,&st)!=0)break;
+      if(st.st_size==0)usleep(10000);
+    }
+    segmentSize = st.st_size;
+  }
+  if(segmentSize<sizeof(Header)+1024*1024){
+    CDBError("Shared memory segment %s is too small (%lu bytes)",name,(unsigned long)segmentSize);
+    close(fd);
+    pthread_mutex_unlock(&attachLock);
+    return 1;
+  }
+
+  void *p = mmap(NULL,segmentSize,PROT_READ|PROT_WRITE,MAP_SHARED,fd,0);
+  close(fd);
+  if(p==MAP_FAILED){
+    CDBError("Unable to map shared memory segment %s: %s",name,strerror(errno));
+    pthread_mutex_unlock(&attachLock);
+    return 1;
+  }
+
+  Header *h = (Header*)p;
+  if(creator){
+    memset(h,0,sizeof(Header));
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setpshared(&attr,PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attr,PTHREAD_MUTEX_ROBUST);
+    pthread_mutex_init(&h->mutex,&attr);
+    pthread_mutexattr_destroy(&attr);
+    h->segmentSize = segmentSize;
+    h->dataOffset = (sizeof(Header)+63)&~(uint64_t)63;
+    h->dataSize = segmentSize-h->dataOffset;
+    __sync_synchronize();
+    memcpy(h->magic,CSharedFieldCache_magic,16);
+  }else{
+    for(int j=0;j<100&&memcmp((const void*)h->magic,CSharedFieldCache_magic,16)!=0;j++){
+      usleep(10000);
+    }
+    if(memcmp((const void*)h->magic,CSharedFieldCache_magic,16)!=0||h->segmentSize!=segmentSize){
+      CDBError("Shared memory segment %s is not initialized, remove it with rm /dev/shm%s",name,name);
+      munmap(p,segmentSize);
+      pthread_mutex_unlock(&attachLock);
+      return 1;
+    }
+  }
+  header = h;
+  #ifdef CSHAREDFIELDCACHE_DEBUG
+  CDBDebug("Attached to %s of %lu bytes (creator=%d)",name,(unsigned long)segmentSize,creator);
+  #endif
+  pthread_mutex_unlock(&attachLock);
+  return 0;
+}
+
+bool CSharedFieldCache::isAttached(){
+  return header!=NULL;
+}
+
+int CSharedFieldCache::lock(){
+  int status = pthread_mutex_lock(&header->mutex);
+  if(status==EOWNERDEAD){
+    /* The previous owner died, possibly while writing a field: start with an empty cache */
+    CDBWarning("A process died while using the field cache, clearing the cache");
+    for(size_t j=0;j<CSHAREDFIELDCACHE_NUMENTRIES;j++){
+      setState(&header->entries[j],CSHAREDFIELDCACHE_FREE);
+    }
+    header->writePos = 0;
+    header->nextEntry = 0;
+    pthread_mutex_consistent(&header->mutex);
+    return 0;
+  }
+  if(status!=0){
+    CDBError("Unable to lock the field cache: %s",strerror(status));
+    return 1;
+  }
+  return 0;
+}
+
+void CSharedFieldCache::unlock(){
+  pthread_mutex_unlock(&header->mutex);
+}
+
+bool CSharedFieldCache::isBeingWritten(Entry *entry){
+  if(entry->state!=CSHAREDFIELDCACHE_WRITING)return false;
+  /* A process which died while copying leaves its entry in the writing state */
+  return kill(entry->writerPid,0)==0||errno!=ESRCH;
+}
+
+void CSharedFieldCache::setState(Entry *entry,uint32_t state){
+  header->sequence++;
+  entry->sequence = header->sequence;
+  entry->state = state;
+}
+
+int CSharedFieldCache::findEntry(const char *key,size_t keyLength,uint64_t hash){
+  const char *data = ((const char*)header)+header->dataOffset;
+  for(size_t j=0;j<CSHAREDFIELDCACHE_NUMENTRIES;j++){
+    Entry *entry = &header->entries[j];
+    if(entry->state==CSHAREDFIELDCACHE_VALID&&entry->hash==hash&&entry->keyLength==keyLength&&memcmp(data+entry->offset,key,keyLength)==0){
+      return j;
+    }
+  }
+  return -1;
+}
+
+int CSharedFieldCache::get(const char *key,CDF::Variable *var,bool *hasNodataValue,double *nodataValue){
+  if(header==NULL)return 1;
+  size_t keyLength = strlen(key);
+  uint64_t hash = hashKey(key,keyLength);
+  if(lock()!=0)return 1;
+  int index = findEntry(key,keyLength,hash);
+  if(index==-1||header->entries[index].type!=var->currentType){
+    unlock();
+    return 1;
+  }
+  Entry *entry = &header->entries[index];
+  uint64_t sequence = entry->sequence;
+  uint64_t numElements = entry->numElements;
+  double storedNodataValue = entry->nodataValue;
+  bool storedHasNodataValue = entry->hasNodataValue!=0;
+  const char *data = ((const char*)header)+header->dataOffset+entry->offset+entry->keyLength;
+  unlock();
+
+  var->allocateData(numElements);
+  if(var->data==NULL){
+    CDBError("Unable to allocate %lu elements for variable %s",(unsigned long)numElements,var->name.c_str());
+    return 1;
+  }
+  memcpy(var->data,data,numElements*CDF::getTypeSize(var->currentType));
+
+  /* The field is invalidated before it is overwritten, so an unchanged sequence means the copy is intact */
+  if(lock()!=0)return 1;
+  bool intact = entry->state==CSHAREDFIELDCACHE_VALID&&entry->sequence==sequence;
+  unlock();
+  if(!intact){
+    #ifdef CSHAREDFIELDCACHE_DEBUG
+    CDBDebug("Overwritten while reading %s",key);
+    #endif
+    var->freeData();
+    return 1;
+  }
+  *hasNodataValue = storedHasNodataValue;
+  *nodataValue = storedNodataValue;
+  #ifdef CSHAREDFIELDCACHE_DEBUG
+  CDBDebug("Found %s",key);
+  #endif
+  return 0;
+}
+
+int CSharedFieldCache::put(const char *key,CDF::Variable *var,bool hasNodataValue,double nodataValue){
+  if(header==NULL||var->data==NULL||var->currentType==CDF_STRING)return 1;
+  size_t keyLength = strlen(key);
+  uint64_t hash = hashKey(key,keyLength);
+  size_t dataLength = var->getSize()*CDF::getTypeSize(var->currentType);
+  uint64_t length = (keyLength+dataLength+7)&~(uint64_t)7;
+
+  /* A few large fields should not flush the whole cache */
+  if(length>header->dataSize/4)return 1;
+
+  if(lock()!=0)return 1;
+  if(findEntry(key,keyLength,hash)!=-1){
+    /* Stored by another process in the meantime */
+    unlock();
+    return 0;
+  }
+  if(header->writePos+length>header->dataSize){
+    header->writePos = 0;
+  }
+  uint64_t offset = header->writePos;
+
+  /* Another process still copying into this region or entry would overwrite the field, it is not stored */
+  if(isBeingWritten(&header->entries[header->nextEntry])){
+    unlock();
+    return 1;
+  }
+  for(size_t j=0;j<CSHAREDFIELDCACHE_NUMENTRIES;j++){
+    Entry *entry = &header->entries[j];
+    if(entry->offset<offset+length&&offset<entry->offset+entry->length&&isBeingWritten(entry)){
+      unlock();
+      return 1;
+    }
+  }
+
+  /* Remove the fields which are overwritten */
+  for(size_t j=0;j<CSHAREDFIELDCACHE_NUMENTRIES;j++){
+    Entry *entry = &header->entries[j];
+    if(entry->state!=CSHAREDFIELDCACHE_FREE&&entry->offset<offset+length&&offset<entry->offset+entry->length){
+      setState(entry,CSHAREDFIELDCACHE_FREE);
+    }
+  }
+  Entry *entry = &header->entries[header->nextEntry];
+  header->nextEntry = (header->nextEntry+1)%CSHAREDFIELDCACHE_NUMENTRIES;
+  entry->hash = hash;
+  entry->offset = offset;
+  entry->length = length;
+  entry->numElements = var->getSize();
+  entry->keyLength = keyLength;
+  entry->type = var->currentType;
+  entry->nodataValue = nodataValue;
+  entry->hasNodataValue = hasNodataValue?1:0;
+  entry->writerPid = getpid();
+  setState(entry,CSHAREDFIELDCACHE_WRITING);
+  uint64_t sequence = entry->sequence;
+  header->writePos = offset+length;
+  unlock();
+
+  char *data = ((char*)header)+header->dataOffset+offset;
+  memcpy(data,key,keyLength);
+  memcpy(data+keyLength,var->data,dataLength);
+
+  /* Only publish the field when its region or entry was not taken by another process during the copy */
+  if(lock()!=0)return 1;
+  bool intact = entry->state==CSHAREDFIELDCACHE_WRITING&&entry->sequence==sequence;
+  if(intact){
+    setState(entry,CSHAREDFIELDCACHE_VALID);
+  }
+  unlock();
+  if(!intact)return 1;
+  #ifdef CSHAREDFIELDCACHE_DEBUG
+  CDBDebug("Stored %s (%lu bytes)",key,(unsigned long)dataLength);
+  #endif
+  return 0;
+}
@@ -0,0 +1,125 @@
+/******************************************************************************
+ *
+ * Project:  ADAGUC Server
+ * Purpose:  Cache of decoded fields in shared memory, shared by all server processes
+ * Date:     2026-10-18
+ *
+ ******************************************************************************
+ *
+ * Copyright 2026, Royal Netherlands Meteorological Institute (KNMI)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ******************************************************************************/
+
+#ifndef CSharedFieldCache_H
+#define CSharedFieldCache_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include "CTString.h"
+#include "CDebugger.h"
+#include "CCDFDataModel.h"
+
+// #define CSHAREDFIELDCACHE_DEBUG
+
+/* Number of fields which can be in the cache at the same time */
+#define CSHAREDFIELDCACHE_NUMENTRIES 1024
+
+/* Default name and size in megabytes of the shared memory segment */
+#define CSHAREDFIELDCACHE_DEFAULTNAME "/adagucserver_fieldcache"
+#define CSHAREDFIELDCACHE_DEFAULTSIZE 1024
+
+/* States of an entry */
+#define CSHAREDFIELDCACHE_FREE    0
+#define CSHAREDFIELDCACHE_WRITING 1
+#define CSHAREDFIELDCACHE_VALID   2
+
+/**
+ * Cache of decoded fields in a POSIX shared memory segment. When many server processes serve the same file,
+ * for example the latest model run, the field is read, decompressed and unpacked only once.
+ *
+ * A field is stored with the data as it is after reading: longitudes swapped, transposed and with scale and
+ * offset applied. The key is made by CDataReader from the file name, the modification time of the file, the
+ * variable and the start, count and stride of the read, so a field is never used after its file changed.
+ *
+ * The index is guarded by a process shared, robust mutex. When a process dies while holding it, the next
+ * process clears the index. Fields are stored one after another in a ring, the oldest fields are overwritten.
+ * The mutex is only held to look up or reserve an entry, the field itself is copied without it. Every change of
+ * an entry gives it a new sequence number, after copying the sequence is checked to detect overwritten fields.
+ * A region which is still being written by a living process is never reserved again, the field is then not stored.
+ */
+class CSharedFieldCache{
+  private:
+    DEF_ERRORFUNCTION();
+    class Entry{
+      public:
+        uint64_t hash;
+        uint64_t offset;
+        uint64_t length;
+        uint64_t numElements;
+        uint32_t keyLength;
+        int32_t type;
+        double nodataValue;
+        uint64_t sequence;
+        uint32_t state;
+        uint32_t hasNodataValue;
+        int32_t writerPid;
+    };
+    class Header{
+      public:
+        char magic[16];
+        uint64_t segmentSize;
+        uint64_t dataOffset;
+        uint64_t dataSize;
+        uint64_t writePos;
+        uint32_t nextEntry;
+        uint64_t sequence;
+        pthread_mutex_t mutex;
+        Entry entries[CSHAREDFIELDCACHE_NUMENTRIES];
+    };
+    static Header *header;
+    static bool attachTried;
+    static pthread_mutex_t attachLock;
+    static uint64_t hashKey(const char *key,size_t length);
+    static int lock();
+    static void unlock();
+    static int findEntry(const char *key,size_t keyLength,uint64_t hash);
+    static void setState(Entry *entry,uint32_t state);
+    static bool isBeingWritten(Entry *entry);
+  public:
+
+    /**
+     * Attaches to the shared memory segment, it is created when it does not exist yet. Only the first call
+     * of a process has effect.
+     * @param name Name of the segment, starting with a slash
+     * @param size Size of the segment in bytes, used when the segment is created
+     * @return Zero when the cache can be used
+     */
+    static int attach(const char *name,size_t size);
+    static bool isAttached();
+
+    /**
+     * Copies a field from the cache into the data of var, var must have the type the field was stored with
+     * @param hasNodataValue,nodataValue Set to the nodata value of the stored field
+     * @return Zero when found
+     */
+    static int get(const char *key,CDF::Variable *var,bool *hasNodataValue,double *nodataValue);
+
+    /**
+     * Stores the data of var in the cache, replacing the oldest fields when the cache is full
+     * @return Zero on success
+     */
+    static int put(const char *key,CDF::Variable *var,bool hasNodataValue,double nodataValue);
+};
+#endif
@@ -0,0 +1,341 @@
+/******************************************************************************
+ *
+ * Project:  ADAGUC Server
+ * Purpose:  Geolocation index of swath data, for reading and drawing only the visible part
+ * Date:     2026-10-18
+ *
+ ******************************************************************************
+ *
+ * Copyright 2026, Royal Netherlands Meteorological Institute (KNMI)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <unistd.h>
+#include <float.h>
+#include "CSwathIndex.h"
+#include "CDirReader.h"
+
+// #define CSWATHINDEX_DEBUG
+
+/* Identifies the cache file format */
+#define CSWATHINDEX_MAGIC 0x58444957
+
+/* Number of points along each side of the request, used to find its lat/lon area */
+#define CSWATHINDEX_NUMSAMPLES 17
+
+/* Degrees added around the lat/lon area of the request, covers the curvature between the sampled points */
+#define CSWATHINDEX_MARGIN 1.0
+
+const char *CSwathIndex::className="CSwathIndex";
+
+CSwathIndex::CSwathIndex(){
+  numCells = 0;
+  cellsPerBlock = 1;
+  for(int j=0;j<4;j++)requestBBOX[j] = 0;
+}
+
+void CSwathIndex::build(const float *lonData,const float *latData,size_t numCells,size_t valuesPerCell,size_t cellsPerBlock){
+  if(cellsPerBlock == 0)cellsPerBlock = 1;
+  this->numCells = numCells;
+  this->cellsPerBlock = cellsPerBlock;
+  size_t numBlocks = (numCells+cellsPerBlock-1)/cellsPerBlock;
+  blocks.resize(numBlocks);
+  for(size_t b=0;b<numBlocks;b++){
+    Block &block = blocks[b];
+    /* An empty block has min > max and never intersects */
+    block.lonMin = 1000;block.lonMax = -1000;
+    block.latMin = 1000;block.latMax = -1000;
+    bool crossesDateLine = false;
+    size_t cellStop = (b+1)*cellsPerBlock;
+    if(cellStop>numCells)cellStop = numCells;
+    for(size_t cell=b*cellsPerBlock;cell<cellStop;cell++){
+      const float *lons = lonData+cell*valuesPerCell;
+      const float *lats = latData+cell*valuesPerCell;
+      float cellLonMin = 0,cellLonMax = 0;
+      bool cellIsValid = true;
+      for(size_t j=0;j<valuesPerCell;j++){
+        float lon = lons[j],lat = lats[j];
+        /* Fill values and NaN are outside these ranges */
+        if(!(lon>=-360&&lon<=360&&lat>=-90&&lat<=90)){cellIsValid = false;break;}
+        if(j==0){cellLonMin = lon;cellLonMax = lon;}else{
+          if(lon<cellLonMin)cellLonMin = lon;
+          if(lon>cellLonMax)cellLonMax = lon;
+        }
+      }
+      if(!cellIsValid)continue;
+      if(cellLonMax-cellLonMin>=180)crossesDateLine = true;
+      if(cellLonMin<block.lonMin)block.lonMin = cellLonMin;
+      if(cellLonMax>block.lonMax)block.lonMax = cellLonMax;
+      for(size_t j=0;j<valuesPerCell;j++){
+        if(lats[j]<block.latMin)block.latMin = lats[j];
+        if(lats[j]>block.latMax)block.latMax = lats[j];
+      }
+    }
+    /* Cells over the date line are drawn shifted by 360 degrees, so the block can end up anywhere in longitude */
+    if(crossesDateLine&&block.latMin<=block.latMax){
+      block.lonMin = -360;block.lonMax = 360;
+    }
+  }
+  #ifdef CSWATHINDEX_DEBUG
+  CDBDebug("Built index with %d blocks of %d cells",(int)numBlocks,(int)cellsPerBlock);
+  #endif
+}
+
+int CSwathIndex::load(const char *cacheFileName){
+  if(cacheFileName == NULL||strlen(cacheFileName) == 0)return 1;
+  FILE *fp = fopen(cacheFileName,"rb");
+  if(fp == NULL)return 1;
+  unsigned int magic = 0;
+  unsigned long long header[3];
+  int status = 0;
+  if(fread(&magic,sizeof(magic),1,fp)!=1||magic!=CSWATHINDEX_MAGIC)status = 1;
+  if(status == 0&&fread(header,sizeof(header),1,fp)!=1)status = 1;
+  if(status == 0&&header[1] == 0)status = 1;
+  if(status == 0){
+    blocks.resize(header[2]);
+    if(header[2]>0&&fread(&blocks[0],sizeof(Block),header[2],fp)!=header[2])status = 1;
+  }
+  fclose(fp);
+  if(status!=0){
+    CDBWarning("Swath index %s is not valid",cacheFileName);
+    blocks.clear();
+    return 1;
+  }
+  numCells = header[0];
+  cellsPerBlock = header[1];
+  #ifdef CSWATHINDEX_DEBUG
+  CDBDebug("Loaded index %s with %d blocks",cacheFileName,(int)blocks.size());
+  #endif
+  return 0;
+}
+
+int CSwathIndex::save(const char *cacheFileName){
+  if(cacheFileName == NULL||strlen(cacheFileName) == 0)return 1;
+  /* Written to a temporary file first, so concurrent requests never read a partial index */
+  CT::string tempFileName;
+  tempFileName.print("%s.%d",cacheFileName,getpid());
+  FILE *fp = fopen(tempFileName.c_str(),"wb");
+  if(fp == NULL){
+    CDBWarning("Unable to write swath index %s",tempFileName.c_str());
+    return 1;
+  }
+  unsigned int magic = CSWATHINDEX_MAGIC;
+  unsigned long long header[3] = {numCells,cellsPerBlock,blocks.size()};
+  int status = 0;
+  if(fwrite(&magic,sizeof(magic),1,fp)!=1)status = 1;
+  if(status == 0&&fwrite(header,sizeof(header),1,fp)!=1)status = 1;
+  if(status == 0&&blocks.size()>0&&fwrite(&blocks[0],sizeof(Block),blocks.size(),fp)!=blocks.size())status = 1;
+  if(fclose(fp)!=0)status = 1;
+  if(status == 0&&rename(tempFileName.c_str(),cacheFileName)!=0)status = 1;
+  if(status!=0){
+    CDBWarning("Unable to write swath index %s",cacheFileName);
+    unlink(tempFileName.c_str());
+    return 1;
+  }
+  return 0;
+}
+
+int CSwathIndex::loadOrBuild(const char *cacheFileName,const float *lonData,const float *latData,size_t numCells,size_t valuesPerCell,size_t cellsPerBlock){
+  if(load(cacheFileName) == 0&&this->numCells == numCells&&this->cellsPerBlock == cellsPerBlock)return 0;
+  if(lonData == NULL||latData == NULL)return 1;
+  build(lonData,latData,numCells,valuesPerCell,cellsPerBlock);
+  save(cacheFileName);
+  return 0;
+}
+
+CT::string CSwathIndex::getCacheFileName(CServerParams *srvParams,const char *fileName,const char *variant){
+  CT::string cacheFileName;
+  if(srvParams->cfg->TempDir.size() == 0)return cacheFileName;
+  const char *tempDir = srvParams->cfg->TempDir[0]->attr.value.c_str();
+  if(tempDir == NULL||strlen(tempDir) == 0)return cacheFileName;
+
+  /* A changed file gets a different modification date, and therefore a new index */
+  CT::string key;
+  key.print("%s|%s|%s",fileName,CDirReader::getFileDate(fileName).c_str(),variant);
+
+  /* FNV-1a */
+  unsigned long long hash = 14695981039346656037ULL;
+  const char *c = key.c_str();
+  for(size_t j=0;j<key.length();j++){
+    hash ^= (unsigned char)c[j];
+    hash *= 1099511628211ULL;
+  }
+  cacheFileName.print("%s/swathindex_%016llx.bin",tempDir,hash);
+  return cacheFileName;
+}
+
+int CSwathIndex::getExtent(double *latLonBBOX){
+  bool found = false;
+  for(size_t b=0;b<blocks.size();b++){
+    Block &block = blocks[b];
+    if(block.latMin>block.latMax)continue;
+    /* Blocks over the date line have -360..360, they cover the world in the convention of the file */
+    double lonMin = block.lonMin,lonMax = block.lonMax;
+    if(lonMin<=-360&&lonMax>=360){lonMin = -180;lonMax = 180;}
+    if(!found){
+      latLonBBOX[0] = lonMin;latLonBBOX[1] = block.latMin;
+      latLonBBOX[2] = lonMax;latLonBBOX[3] = block.latMax;
+      found = true;
+    }else{
+      if(lonMin<latLonBBOX[0])latLonBBOX[0] = lonMin;
+      if(block.latMin<latLonBBOX[1])latLonBBOX[1] = block.latMin;
+      if(lonMax>latLonBBOX[2])latLonBBOX[2] = lonMax;
+      if(block.latMax>latLonBBOX[3])latLonBBOX[3] = block.latMax;
+    }
+  }
+  if(!found)return 1;
+  return 0;
+}
+
+void CSwathIndex::projectBlocks(CServerParams *srvParams,CImageWarper *warper){
+  double *dfBBOX = srvParams->Geo->dfBBOX;
+  requestBBOX[0] = dfBBOX[0]<dfBBOX[2]?dfBBOX[0]:dfBBOX[2];
+  requestBBOX[1] = dfBBOX[1]<dfBBOX[3]?dfBBOX[1]:dfBBOX[3];
+  requestBBOX[2] = dfBBOX[0]<dfBBOX[2]?dfBBOX[2]:dfBBOX[0];
+  requestBBOX[3] = dfBBOX[1]<dfBBOX[3]?dfBBOX[3]:dfBBOX[1];
+  projectedBlocks.resize(blocks.size());
+  for(size_t b=0;b<blocks.size();b++){
+    Block &block = blocks[b];
+    Extent &extent = projectedBlocks[b];
+    /* Blocks over the date line, or with points which can not be projected, cover the whole request */
+    extent.minX = -DBL_MAX;extent.minY = -DBL_MAX;
+    extent.maxX = DBL_MAX;extent.maxY = DBL_MAX;
+    if(block.latMin>block.latMax||(block.lonMin<=-360&&block.lonMax>=360))continue;
+    bool first = true,projectionIsOk = true;
+    double maxStepX = 0,maxStepY = 0;
+    for(int side=0;side<4&&projectionIsOk;side++){
+      double previousX = 0,previousY = 0;
+      for(int j=0;j<CSWATHINDEX_NUMSAMPLES;j++){
+        double f = double(j)/double(CSWATHINDEX_NUMSAMPLES-1);
+        double x,y;
+        if(side==0){x = block.lonMin+(block.lonMax-block.lonMin)*f;y = block.latMin;}
+        else if(side==1){x = block.lonMax;y = block.latMin+(block.latMax-block.latMin)*f;}
+        else if(side==2){x = block.lonMax-(block.lonMax-block.lonMin)*f;y = block.latMax;}
+        else{x = block.lonMin;y = block.latMax-(block.latMax-block.latMin)*f;}
+        if(warper->reprojfromLatLon(x,y)!=0||!(x==x)||!(y==y)){projectionIsOk = false;break;}
+        if(j>0){
+          if(fabs(x-previousX)>maxStepX)maxStepX = fabs(x-previousX);
+          if(fabs(y-previousY)>maxStepY)maxStepY = fabs(y-previousY);
+        }
+        previousX = x;previousY = y;
+        if(first){
+          extent.minX = x;extent.minY = y;extent.maxX = x;extent.maxY = y;
+          first = false;
+        }else{
+          if(x<extent.minX)extent.minX = x;
+          if(y<extent.minY)extent.minY = y;
+          if(x>extent.maxX)extent.maxX = x;
+          if(y>extent.maxY)extent.maxY = y;
+        }
+      }
+    }
+    if(!projectionIsOk){
+      extent.minX = -DBL_MAX;extent.minY = -DBL_MAX;
+      extent.maxX = DBL_MAX;extent.maxY = DBL_MAX;
+      continue;
+    }
+    /* The edges curve between the sampled points, by less than the distance between them */
+    extent.minX -= maxStepX;extent.minY -= maxStepY;
+    extent.maxX += maxStepX;extent.maxY += maxStepY;
+  }
+}
+
+bool CSwathIndex::blockIntersects(size_t block,const double *latLonBBOX){
+  if(block>=blocks.size())return false;
+  Block &b = blocks[block];
+  if(b.latMin>b.latMax)return false;
+  if(b.latMax<latLonBBOX[1]||b.latMin>latLonBBOX[3])return false;
+  if(block<projectedBlocks.size()){
+    Extent &extent = projectedBlocks[block];
+    if(extent.maxX<requestBBOX[0]||extent.minX>requestBBOX[2]||extent.maxY<requestBBOX[1]||extent.minY>requestBBOX[3])return false;
+  }
+  /* Blocks keep the longitude convention of the file, which can be 0..360: also test the request shifted by 360 degrees */
+  for(int shift=-360;shift<=360;shift+=360){
+    if(b.lonMax>=latLonBBOX[0]+shift&&b.lonMin<=latLonBBOX[2]+shift)return true;
+  }
+  return false;
+}
+
+int CSwathIndex::getCellRange(const double *latLonBBOX,size_t &firstCell,size_t &numCellsInRange){
+  size_t firstBlock = blocks.size(),lastBlock = 0;
+  for(size_t b=0;b<blocks.size();b++){
+    if(blockIntersects(b,latLonBBOX)){
+      if(firstBlock == blocks.size())firstBlock = b;
+      lastBlock = b;
+    }
+  }
+  if(firstBlock == blocks.size())return 1;
+  firstCell = firstBlock*cellsPerBlock;
+  size_t cellStop = (lastBlock+1)*cellsPerBlock;
+  if(cellStop>numCells)cellStop = numCells;
+  numCellsInRange = cellStop-firstCell;
+  return 0;
+}
+
+int CSwathIndex::getRequestLatLonBBOX(CServerParams *srvParams,CImageWarper *warper,bool projectionRequired,double *latLonBBOX){
+  double *dfBBOX = srvParams->Geo->dfBBOX;
+  double minX = dfBBOX[0]<dfBBOX[2]?dfBBOX[0]:dfBBOX[2];
+  double maxX = dfBBOX[0]<dfBBOX[2]?dfBBOX[2]:dfBBOX[0];
+  double minY = dfBBOX[1]<dfBBOX[3]?dfBBOX[1]:dfBBOX[3];
+  double maxY = dfBBOX[1]<dfBBOX[3]?dfBBOX[3]:dfBBOX[1];
+  if(!projectionRequired){
+    latLonBBOX[0] = minX;latLonBBOX[1] = minY;
+    latLonBBOX[2] = maxX;latLonBBOX[3] = maxY;
+  }else{
+    bool first = true;
+    for(int sy=0;sy<CSWATHINDEX_NUMSAMPLES;sy++){
+      for(int sx=0;sx<CSWATHINDEX_NUMSAMPLES;sx++){
+        double x = minX+(maxX-minX)*double(sx)/double(CSWATHINDEX_NUMSAMPLES-1);
+        double y = minY+(maxY-minY)*double(sy)/double(CSWATHINDEX_NUMSAMPLES-1);
+        if(warper->reprojToLatLon(x,y)!=0||!(x==x)||!(y==y)){
+          /* The request extends outside the valid area of its projection */
+          return 1;
+        }
+        if(first){
+          latLonBBOX[0] = x;latLonBBOX[1] = y;latLonBBOX[2] = x;latLonBBOX[3] = y;
+          first = false;
+        }else{
+          if(x<latLonBBOX[0])latLonBBOX[0] = x;
+          if(y<latLonBBOX[1])latLonBBOX[1] = y;
+          if(x>latLonBBOX[2])latLonBBOX[2] = x;
+          if(y>latLonBBOX[3])latLonBBOX[3] = y;
+        }
+      }
+    }
+    /* A pole inside the request covers all longitudes */
+    for(int pole=-1;pole<=1;pole+=2){
+      double x = 0,y = 90*pole;
+      if(warper->reprojfromLatLon(x,y) == 0&&x>=minX&&x<=maxX&&y>=minY&&y<=maxY){
+        latLonBBOX[0] = -180;latLonBBOX[2] = 180;
+        if(pole<0)latLonBBOX[1] = -90;else latLonBBOX[3] = 90;
+      }
+    }
+    /* Points on both sides of the date line */
+    if(latLonBBOX[2]-latLonBBOX[0]>180){
+      latLonBBOX[0] = -180;latLonBBOX[2] = 180;
+    }
+  }
+  /* Requests beyond the date line can show cells from the other side */
+  if(latLonBBOX[0]<-180||latLonBBOX[2]>180){
+    latLonBBOX[0] = -360;latLonBBOX[2] = 360;
+  }
+  latLonBBOX[0] -= CSWATHINDEX_MARGIN;latLonBBOX[1] -= CSWATHINDEX_MARGIN;
+  latLonBBOX[2] += CSWATHINDEX_MARGIN;latLonBBOX[3] += CSWATHINDEX_MARGIN;
+  #ifdef CSWATHINDEX_DEBUG
+  CDBDebug("Request lat/lon area %f %f %f %f",latLonBBOX[0],latLonBBOX[1],latLonBBOX[2],latLonBBOX[3]);
+  #endif
+  return 0;
+}
@@ -0,0 +1,126 @@
+/******************************************************************************
+ *
+ * Project:  ADAGUC Server
+ * Purpose:  Geolocation index of swath data, for reading and drawing only the visible part
+ * Date:     2026-10-18
+ *
+ ******************************************************************************
+ *
+ * Copyright 2026, Royal Netherlands Meteorological Institute (KNMI)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ******************************************************************************/
+
+#ifndef CSWATHINDEX_H
+#define CSWATHINDEX_H
+#include <vector>
+#include "CServerParams.h"
+#include "CImageWarper.h"
+#include "CDebugger.h"
+
+/* Number of scanlines grouped in one block of the index */
+#define CSWATHINDEX_SCANLINESPERBLOCK 64
+
+/**
+ * Lat/lon bounding boxes of consecutive blocks of swath cells.
+ *
+ * The cells of a swath are stored scanline by scanline, so a block of consecutive cells is a band of scanlines.
+ * For a GetMap request the blocks outside the requested area can be skipped, both for reading and for drawing.
+ * The index is saved in the TempDir, keyed on file name, file modification date and a variant string.
+ * For a projected request the boxes are also calculated in the CRS of the request, with projectBlocks.
+ */
+class CSwathIndex{
+  private:
+    DEF_ERRORFUNCTION();
+    class Block{
+      public:
+        float lonMin,lonMax,latMin,latMax;
+    };
+    std::vector<Block> blocks;
+    class Extent{
+      public:
+        double minX,minY,maxX,maxY;
+    };
+    std::vector<Extent> projectedBlocks;
+    double requestBBOX[4];
+    size_t numCells,cellsPerBlock;
+  public:
+    CSwathIndex();
+
+    /**
+     * Builds the index from the coordinates of the cells
+     * @param lonData,latData The coordinates, valuesPerCell (center or corner) coordinates per cell
+     * @param numCells Number of cells
+     * @param valuesPerCell Number of coordinates per cell, 1 for centers or 4 for bounds
+     * @param cellsPerBlock Number of cells in a block
+     */
+    void build(const float *lonData,const float *latData,size_t numCells,size_t valuesPerCell,size_t cellsPerBlock);
+
+    /**
+     * Loads the index from the cache, returns zero on success
+     */
+    int load(const char *cacheFileName);
+
+    /**
+     * Saves the index to the cache, returns zero on success
+     */
+    int save(const char *cacheFileName);
+
+    /**
+     * Returns the name of the cache file for a data file, or an empty string when no TempDir is configured
+     * @param variant Distinguishes between different indices of the same file
+     */
+    static CT::string getCacheFileName(CServerParams *srvParams,const char *fileName,const char *variant);
+
+    size_t getNumBlocks(){return blocks.size();}
+    size_t getCellsPerBlock(){return cellsPerBlock;}
+
+    /**
+     * Gets the lat/lon extent of all valid cells, returns 1 when there are none
+     */
+    int getExtent(double *latLonBBOX);
+
+    /**
+     * Calculates the extent of each block in the CRS of the request, from points along the edges of its lat/lon box.
+     * blockIntersects and getCellRange then also test the blocks against the requested bounding box itself. These
+     * extents are not cached, they are cheap compared to the projected lat/lon box of a polar or rotated request.
+     * @param warper Initialized with the request as destination
+     */
+    void projectBlocks(CServerParams *srvParams,CImageWarper *warper);
+
+    /**
+     * Returns true when the block intersects the lat/lon bounding box, and the request when projectBlocks was called
+     */
+    bool blockIntersects(size_t block,const double *latLonBBOX);
+
+    /**
+     * Gives the range of cells which covers all blocks intersecting the lat/lon bounding box
+     * @return Zero on success, 1 when no block intersects
+     */
+    int getCellRange(const double *latLonBBOX,size_t &firstCell,size_t &numCellsInRange);
+
+    /**
+     * Loads the index from the cache, or builds it and saves it when it is not cached or does not match the number of cells
+     * @return Zero on success
+     */
+    int loadOrBuild(const char *cacheFileName,const float *lonData,const float *latData,size_t numCells,size_t valuesPerCell,size_t cellsPerBlock);
+
+    /**
+     * Calculates the lat/lon area of the request, by transforming a grid of points in the requested bounding box
+     * @param warper Initialized with the request as destination, only used when projectionRequired is set
+     * @return Zero on success, 1 when the area cannot be determined and everything needs to be used
+     */
+    static int getRequestLatLonBBOX(CServerParams *srvParams,CImageWarper *warper,bool projectionRequired,double *latLonBBOX);
+};
+#endif
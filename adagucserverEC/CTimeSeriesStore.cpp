@@ -0,0 +1,557 @@
+/******************************************************************************
+ *
+ * Project:  ADAGUC Server
+ * Purpose:  Time major copy of layer data for fast point time series
+ * Date:     2026-10-18
+ *
+ ******************************************************************************
+ *
+ * Copyright 2026, Royal Netherlands Meteorological Institute (KNMI)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include "CTimeSeriesStore.h"
+#include "CDFObjectStore.h"
+
+const char *CTimeSeriesStore::className="CTimeSeriesStore";
+
+//#define CTimeSeriesStore_DEBUG
+
+//Maximum amount of memory used for reading time steps from a file while building the store
+#define CTimeSeriesStore_MAXBATCHBYTES (64*1024*1024)
+
+//Maximum number of bytes read at once while reading a point time series
+#define CTimeSeriesStore_MAXREADBYTES (4*1024*1024)
+
+//The index is rewritten with only its current lines when it has this many lines more than time steps
+#define CTimeSeriesStore_MAXSTALEINDEXLINES 4096
+
+CTimeSeriesStore::CTimeSeriesStore(){
+  width = 0;
+  height = 0;
+  chunkSize = CTimeSeriesStore_DEFAULT_CHUNKSIZE;
+  slotsPerFile = CTimeSeriesStore_SLOTSPERFILE;
+  numSlots = 0;
+  numIndexLines = 0;
+}
+
+CT::string CTimeSeriesStore::getChunkFileName(const char *variableName,int cx,int cy,size_t ct){
+  CT::string fileName;
+  fileName.print("%s/%s_%d_%d_%d.bin",path.c_str(),variableName,cx,cy,(int)ct);
+  return fileName;
+}
+
+void CTimeSeriesStore::eraseFile(const char *fileName){
+  std::string suffix = " ";
+  suffix+=fileName;
+  for(std::map<std::string,size_t>::iterator it=slots.begin();it!=slots.end();){
+    const std::string &slotKey = (*it).first;
+    if(slotKey.length()>suffix.length()&&slotKey.compare(slotKey.length()-suffix.length(),suffix.length(),suffix)==0&&
+       slotKey.find(' ')==slotKey.length()-suffix.length()){
+      slots.erase(it++);
+    }else{
+      ++it;
+    }
+  }
+  fileDates.erase(fileName);
+}
+
+int CTimeSeriesStore::loadIndex(){
+  slots.clear();
+  fileDates.clear();
+  numSlots = 0;
+  numIndexLines = 0;
+  CT::string indexFileName;
+  indexFileName.print("%s/index.txt",path.c_str());
+  FILE *fp = fopen(indexFileName.c_str(),"r");
+  if(fp == NULL)return 1;
+  char *line = NULL;
+  size_t lineSize = 0;
+  ssize_t length;
+  bool headerRead = false;
+  while((length = getline(&line,&lineSize,fp))!=-1){
+    //A line without newline is still being written
+    if(length==0||line[length-1]!='\n')break;
+    line[length-1]=0;
+    if(!headerRead){
+      int version = 0,fileSlots = 0;
+      if(sscanf(line,"ADAGUCTSS %d %d %d %d %d",&version,&width,&height,&chunkSize,&fileSlots)!=5||version!=2||chunkSize<1||fileSlots<1){
+        CDBError("Invalid time series store index %s, remove the store to rebuild it",indexFileName.c_str());
+        free(line);
+        fclose(fp);
+        return 1;
+      }
+      slotsPerFile = fileSlots;
+      headerRead = true;
+      continue;
+    }
+    char *dimIndexStart = strchr(line,' ');
+    if(dimIndexStart == NULL)break;
+    char *dateStart = strchr(dimIndexStart+1,' ');
+    if(dateStart == NULL)break;
+    char *fileNameStart = strchr(dateStart+1,' ');
+    if(fileNameStart == NULL)break;
+    *dimIndexStart = 0;
+    *dateStart = 0;
+    *fileNameStart = 0;
+    numIndexLines++;
+    //A removed file: its time steps are no longer served
+    if(strcmp(line,"removed")==0){
+      eraseFile(fileNameStart+1);
+      continue;
+    }
+    size_t slot = strtoul(line,NULL,10);
+    std::string key = dimIndexStart+1;
+    key+=" ";
+    key+=fileNameStart+1;
+    //A file which was added again after it changed replaces the old slot
+    slots[key] = slot;
+    fileDates[fileNameStart+1] = dateStart+1;
+  }
+  free(line);
+  fclose(fp);
+  //Slots after the last one in use are free again
+  for(std::map<std::string,size_t>::iterator it=slots.begin();it!=slots.end();++it){
+    if((*it).second+1>numSlots)numSlots = (*it).second+1;
+  }
+  return headerRead?0:1;
+}
+
+size_t CTimeSeriesStore::findFreeSlots(size_t numSteps){
+  std::vector<bool> used(numSlots,false);
+  for(std::map<std::string,size_t>::iterator it=slots.begin();it!=slots.end();++it){
+    used[(*it).second] = true;
+  }
+  size_t runStart = 0;
+  for(size_t slot=0;slot<numSlots;slot++){
+    if(used[slot]){
+      runStart = slot+1;
+    }else if(slot+1-runStart==numSteps){
+      return runStart;
+    }
+  }
+  //Otherwise the time steps are appended
+  return runStart;
+}
+
+int CTimeSeriesStore::writeIndex(){
+  CT::string indexFileName,newIndexFileName;
+  indexFileName.print("%s/index.txt",path.c_str());
+  newIndexFileName.print("%s/index.txt.new",path.c_str());
+  FILE *indexFile = fopen(newIndexFileName.c_str(),"w");
+  if(indexFile == NULL){
+    CDBError("Unable to write %s",newIndexFileName.c_str());
+    return 1;
+  }
+  fprintf(indexFile,"ADAGUCTSS 2 %d %d %d %d\n",width,height,chunkSize,(int)slotsPerFile);
+  for(std::map<std::string,size_t>::iterator it=slots.begin();it!=slots.end();++it){
+    const std::string &slotKey = (*it).first;
+    size_t separator = slotKey.find(' ');
+    std::string fileName = slotKey.substr(separator+1);
+    fprintf(indexFile,"%d %s %s %s\n",int((*it).second),slotKey.substr(0,separator).c_str(),fileDates[fileName].c_str(),fileName.c_str());
+  }
+  if(fclose(indexFile)!=0){
+    CDBError("Unable to write %s",newIndexFileName.c_str());
+    unlink(newIndexFileName.c_str());
+    return 1;
+  }
+  //Readers which opened the old index keep reading it
+  if(rename(newIndexFileName.c_str(),indexFileName.c_str())!=0){
+    CDBError("Unable to replace %s",indexFileName.c_str());
+    unlink(newIndexFileName.c_str());
+    return 1;
+  }
+  numIndexLines = slots.size();
+  return 0;
+}
+
+int CTimeSeriesStore::lockIndex(){
+  CT::string lockFileName;
+  lockFileName.print("%s/index.lock",path.c_str());
+  int lockFd = ::open(lockFileName.c_str(),O_RDWR|O_CREAT,0644);
+  if(lockFd==-1){
+    CDBError("Unable to open %s",lockFileName.c_str());
+    return -1;
+  }
+  if(flock(lockFd,LOCK_EX)!=0){
+    CDBError("Unable to lock %s",lockFileName.c_str());
+    close(lockFd);
+    return -1;
+  }
+  return lockFd;
+}
+
+void CTimeSeriesStore::unlockIndex(int lockFd){
+  //The index is only rewritten under the lock, when most of its lines are replaced or removed
+  if(numIndexLines>slots.size()+CTimeSeriesStore_MAXSTALEINDEXLINES){
+    writeIndex();
+  }
+  flock(lockFd,LOCK_UN);
+  close(lockFd);
+}
+
+int CTimeSeriesStore::addFile(CDataSource *dataSource,const char *fileName,const char *fileDate){
+  CDFObject *cdfObject = NULL;
+  try{
+    cdfObject = CDFObjectStore::getCDFObjectStore()->getCDFObject(dataSource,fileName);
+  }catch(int e){
+    CDBError("Unable to open file %s",fileName);
+    return 1;
+  }
+  if(cdfObject == NULL){
+    CDBError("Unable to open file %s",fileName);
+    return 1;
+  }
+
+  std::vector<CDF::Variable*> variables;
+  size_t numTimeSteps = 0;
+  for(size_t v=0;v<dataSource->cfgLayer->Variable.size();v++){
+    CDF::Variable *variable = cdfObject->getVariableNE(dataSource->cfgLayer->Variable[v]->value.c_str());
+    if(variable == NULL){
+      CDBError("Variable %s not found in %s",dataSource->cfgLayer->Variable[v]->value.c_str(),fileName);
+      return 1;
+    }
+    if(variable->dimensionlinks.size()!=3){
+      CDBWarning("Variable %s in %s does not have three dimensions, skipping file",variable->name.c_str(),fileName);
+      return 1;
+    }
+    int fileWidth = variable->dimensionlinks[2]->getSize();
+    int fileHeight = variable->dimensionlinks[1]->getSize();
+    if(width == 0){
+      width = fileWidth;
+      height = fileHeight;
+    }
+    if(fileWidth!=width||fileHeight!=height){
+      CDBWarning("Grid of %s (%dx%d) differs from time series store (%dx%d), skipping file",fileName,fileWidth,fileHeight,width,height);
+      return 1;
+    }
+    if(v==0){
+      numTimeSteps = variable->dimensionlinks[0]->getSize();
+    }else if(numTimeSteps != variable->dimensionlinks[0]->getSize()){
+      CDBWarning("Variables in %s have different time dimensions, skipping file",fileName);
+      return 1;
+    }
+    variables.push_back(variable);
+  }
+
+  //A changed file is written again into its own slots, when they still fit its time steps
+  size_t firstSlot = 0;
+  bool reuseSlots = numTimeSteps>0;
+  for(size_t t=0;t<numTimeSteps&&reuseSlots;t++){
+    CT::string key;
+    key.print("%d %s",int(t),fileName);
+    std::map<std::string,size_t>::iterator it = slots.find(key.c_str());
+    if(it==slots.end()){
+      reuseSlots = false;
+    }else if(t==0){
+      firstSlot = (*it).second;
+    }else if((*it).second!=firstSlot+t){
+      reuseSlots = false;
+    }
+  }
+  //Otherwise it gets the first free slots, the slots of removed files are reused
+  if(!reuseSlots)firstSlot = findFreeSlots(numTimeSteps);
+
+  CT::string indexFileName;
+  indexFileName.print("%s/index.txt",path.c_str());
+  struct stat indexStat;
+  bool writeHeader = (stat(indexFileName.c_str(),&indexStat)!=0||indexStat.st_size==0);
+  FILE *indexFile = fopen(indexFileName.c_str(),"a");
+  if(indexFile == NULL){
+    CDBError("Unable to write %s",indexFileName.c_str());
+    return 1;
+  }
+  if(writeHeader){
+    fprintf(indexFile,"ADAGUCTSS 2 %d %d %d %d\n",width,height,chunkSize,(int)slotsPerFile);
+  }
+
+  size_t batchSize = CTimeSeriesStore_MAXBATCHBYTES/(size_t(width)*height*sizeof(float));
+  if(batchSize<1)batchSize=1;
+
+  int status = 0;
+  for(size_t t0=0;t0<numTimeSteps&&status==0;t0+=batchSize){
+    size_t numSteps = std::min(batchSize,numTimeSteps-t0);
+    for(size_t v=0;v<variables.size()&&status==0;v++){
+      CDF::Variable *variable = variables[v];
+      size_t start[3]={t0,0,0};
+      size_t count[3]={numSteps,size_t(height),size_t(width)};
+      ptrdiff_t stride[3]={1,1,1};
+      variable->freeData();
+      if(variable->readData(CDF_FLOAT,start,count,stride)!=0){
+        CDBError("Unable to read variable %s from %s",variable->name.c_str(),fileName);
+        status = 1;
+        break;
+      }
+
+      //Scale and offset are applied here, applyScaleOffset in readData would change the _FillValue of the cached file
+      double scaleFactor=1,addOffset=0,fillValue=0,missingValue=0;
+      bool hasFillValue = false,hasMissingValue = false;
+      CDF::Attribute *attr = variable->getAttributeNE("scale_factor");
+      if(attr!=NULL)attr->getData(&scaleFactor,1);
+      attr = variable->getAttributeNE("add_offset");
+      if(attr!=NULL)attr->getData(&addOffset,1);
+      attr = variable->getAttributeNE("_FillValue");
+      if(attr!=NULL){attr->getData(&fillValue,1);hasFillValue=true;}
+      attr = variable->getAttributeNE("missing_value");
+      if(attr!=NULL){attr->getData(&missingValue,1);hasMissingValue=true;}
+      float *data = (float*)variable->data;
+      float fFillValue = (float)fillValue;
+      float fMissingValue = (float)missingValue;
+      size_t size = numSteps*width*height;
+      for(size_t j=0;j<size;j++){
+        if((hasFillValue&&data[j]==fFillValue)||(hasMissingValue&&data[j]==fMissingValue)){
+          data[j]=NAN;
+        }else{
+          data[j]=data[j]*scaleFactor+addOffset;
+        }
+      }
+      status = writeSlots(variable->name.c_str(),data,firstSlot+t0,numSteps);
+      variable->freeData();
+    }
+  }
+
+  //Make the time steps visible for readers, only when the whole file is written
+  if(status == 0){
+    //The time steps of the previous version of the file are dropped, it may have had more
+    bool isChanged = fileDates.find(fileName)!=fileDates.end();
+    if(isChanged){
+      fprintf(indexFile,"removed - - %s\n",fileName);
+      eraseFile(fileName);
+    }
+    for(size_t t=0;t<numTimeSteps;t++){
+      fprintf(indexFile,"%d %d %s %s\n",int(firstSlot+t),int(t),fileDate,fileName);
+    }
+    fflush(indexFile);
+    numIndexLines+=numTimeSteps+(isChanged?1:0);
+    for(size_t t=0;t<numTimeSteps;t++){
+      CT::string key;
+      key.print("%d %s",int(t),fileName);
+      slots[key.c_str()] = firstSlot+t;
+    }
+    fileDates[fileName] = fileDate;
+    if(firstSlot+numTimeSteps>numSlots)numSlots = firstSlot+numTimeSteps;
+  }
+  fclose(indexFile);
+  CDFObjectStore::getCDFObjectStore()->deleteCDFObject(fileName);
+  return status;
+}
+
+int CTimeSeriesStore::writeSlots(const char *variableName,const float *data,size_t firstSlot,size_t numSteps){
+  int numChunksX = (width+chunkSize-1)/chunkSize;
+  int numChunksY = (height+chunkSize-1)/chunkSize;
+  std::vector<float> block;
+  for(size_t t0=0;t0<numSteps;){
+    //The time steps which go into the same chunk files
+    size_t ct = (firstSlot+t0)/slotsPerFile;
+    size_t slotInFile = (firstSlot+t0)%slotsPerFile;
+    size_t numRunSteps = std::min(numSteps-t0,slotsPerFile-slotInFile);
+    for(int cy=0;cy<numChunksY;cy++){
+      int numRows = std::min(chunkSize,height-cy*chunkSize);
+      for(int cx=0;cx<numChunksX;cx++){
+        int numCols = std::min(chunkSize,width-cx*chunkSize);
+        CT::string chunkFileName = getChunkFileName(variableName,cx,cy,ct);
+        int fd = ::open(chunkFileName.c_str(),O_RDWR|O_CREAT,0644);
+        if(fd==-1){
+          CDBError("Unable to write %s",chunkFileName.c_str());
+          return 1;
+        }
+        //The runs of the cells are apart by slotsPerFile, the block from the first to the last run is read, filled in and written
+        //at once. The other slots in it are written back unchanged.
+        size_t lastCell = size_t(numRows-1)*chunkSize+numCols-1;
+        size_t blockSize = lastCell*slotsPerFile+numRunSteps;
+        off_t blockOffset = off_t(slotInFile*sizeof(float));
+        block.assign(blockSize,NAN);
+        if(numRunSteps<slotsPerFile){
+          if(pread(fd,&block[0],blockSize*sizeof(float),blockOffset)<0){
+            CDBError("Unable to read %s",chunkFileName.c_str());
+            close(fd);
+            return 1;
+          }
+        }
+        for(int y=0;y<numRows;y++){
+          int gy = cy*chunkSize+y;
+          for(int x=0;x<numCols;x++){
+            int gx = cx*chunkSize+x;
+            float *run = &block[(size_t(y)*chunkSize+x)*slotsPerFile];
+            for(size_t t=0;t<numRunSteps;t++){
+              run[t]=data[((t0+t)*height+gy)*width+gx];
+            }
+          }
+        }
+        size_t bytes = blockSize*sizeof(float);
+        if(pwrite(fd,&block[0],bytes,blockOffset)!=(ssize_t)bytes){
+          CDBError("Unable to write %s",chunkFileName.c_str());
+          close(fd);
+          return 1;
+        }
+        close(fd);
+      }
+    }
+    t0+=numRunSteps;
+  }
+  return 0;
+}
+
+int CTimeSeriesStore::update(CDataSource *dataSource,CDirReader *dirReader){
+  if(dataSource->cfgLayer->TimeSeriesStore.size()!=1)return 0;
+  CServerConfig::XMLE_TimeSeriesStore *cfgStore = dataSource->cfgLayer->TimeSeriesStore[0];
+  CTimeSeriesStore store;
+  store.path = cfgStore->attr.path.c_str();
+  if(store.path.empty()){
+    CDBError("TimeSeriesStore has no path configured");
+    return 1;
+  }
+  if(cfgStore->attr.chunksize.empty()==false){
+    store.chunkSize = cfgStore->attr.chunksize.toInt();
+    if(store.chunkSize<1)store.chunkSize=CTimeSeriesStore_DEFAULT_CHUNKSIZE;
+  }
+  int configuredChunkSize = store.chunkSize;
+  CDirReader::makePublicDirectory(store.path.c_str());
+
+  //The scanner and the file watcher can update the same store: the index is loaded and extended under an exclusive lock
+  int lockFd = store.lockIndex();
+  if(lockFd==-1)return 1;
+  if(store.loadIndex()==0&&store.chunkSize!=configuredChunkSize){
+    CDBWarning("TimeSeriesStore %s was built with chunksize %d, remove it to use chunksize %d",store.path.c_str(),store.chunkSize,configuredChunkSize);
+  }
+
+  size_t numAdded = 0;
+  for(size_t j=0;j<dirReader->fileList.size();j++){
+    const char *fileName = dirReader->fileList[j]->fullName.c_str();
+    CT::string fileDate = CDirReader::getFileDate(fileName);
+    std::map<std::string,std::string>::iterator it = store.fileDates.find(fileName);
+    if(it!=store.fileDates.end()&&fileDate.equals((*it).second.c_str()))continue;
+    #ifdef CTimeSeriesStore_DEBUG
+    CDBDebug("Adding %s to time series store",fileName);
+    #endif
+    if(store.addFile(dataSource,fileName,fileDate.c_str())==0)numAdded++;
+  }
+  store.unlockIndex(lockFd);
+  if(numAdded>0){
+    CDBDebug("Added %d files to time series store %s, now %d time steps",(int)numAdded,store.path.c_str(),(int)store.numSlots);
+  }
+  return 0;
+}
+
+int CTimeSeriesStore::removeFiles(CDataSource *dataSource,std::vector<CT::string> &fileNames){
+  if(dataSource->cfgLayer->TimeSeriesStore.size()!=1||fileNames.size()==0)return 0;
+  CTimeSeriesStore store;
+  store.path = dataSource->cfgLayer->TimeSeriesStore[0]->attr.path.c_str();
+  if(store.path.empty())return 0;
+  CT::string indexFileName;
+  indexFileName.print("%s/index.txt",store.path.c_str());
+  struct stat indexStat;
+  if(stat(indexFileName.c_str(),&indexStat)!=0)return 0;
+  int lockFd = store.lockIndex();
+  if(lockFd==-1)return 1;
+  int status = 0;
+  size_t numRemoved = 0;
+  if(store.loadIndex()==0){
+    FILE *indexFile = NULL;
+    for(size_t j=0;j<fileNames.size();j++){
+      if(store.fileDates.find(fileNames[j].c_str())==store.fileDates.end())continue;
+      if(indexFile==NULL){
+        indexFile = fopen(indexFileName.c_str(),"a");
+        if(indexFile==NULL){
+          CDBError("Unable to write %s",indexFileName.c_str());
+          status = 1;
+          break;
+        }
+      }
+      fprintf(indexFile,"removed - - %s\n",fileNames[j].c_str());
+      store.eraseFile(fileNames[j].c_str());
+      store.numIndexLines++;
+      numRemoved++;
+    }
+    if(indexFile!=NULL)fclose(indexFile);
+  }
+  store.unlockIndex(lockFd);
+  if(numRemoved>0){
+    CDBDebug("Removed %d files from time series store %s",(int)numRemoved,store.path.c_str());
+  }
+  return status;
+}
+
+int CTimeSeriesStore::open(CDataSource *dataSource){
+  if(dataSource->cfgLayer->TimeSeriesStore.size()!=1)return 1;
+  path = dataSource->cfgLayer->TimeSeriesStore[0]->attr.path.c_str();
+  if(path.empty())return 1;
+  if(loadIndex()!=0)return 1;
+  if(numSlots==0||width<=0||height<=0)return 1;
+  return 0;
+}
+
+int CTimeSeriesStore::getSlot(const char *fileName,int dimIndex){
+  CT::string key;
+  key.print("%d %s",dimIndex,fileName);
+  std::map<std::string,size_t>::iterator it = slots.find(key.c_str());
+  if(it==slots.end())return -1;
+  return (int)(*it).second;
+}
+
+int CTimeSeriesStore::readPoint(const char *variableName,int x,int y,std::vector<size_t> &slotList,std::vector<float> &values){
+  values.assign(slotList.size(),NAN);
+  if(x<0||y<0||x>=width||y>=height)return 1;
+  size_t cell = size_t(y%chunkSize)*chunkSize+(x%chunkSize);
+  size_t maxSlotsPerRead = CTimeSeriesStore_MAXREADBYTES/sizeof(float);
+
+  //Sort the slots, so that the slots of one chunk file are read together
+  std::vector<std::pair<size_t,size_t> > order;
+  for(size_t j=0;j<slotList.size();j++)order.push_back(std::pair<size_t,size_t>(slotList[j],j));
+  std::sort(order.begin(),order.end());
+
+  std::vector<float> buffer;
+  int status = 0;
+  for(size_t j=0;j<order.size();){
+    size_t ct = order[j].first/slotsPerFile;
+    CT::string chunkFileName = getChunkFileName(variableName,x/chunkSize,y/chunkSize,ct);
+    int fd = ::open(chunkFileName.c_str(),O_RDONLY);
+    if(fd==-1){
+      CDBError("Unable to open %s",chunkFileName.c_str());
+      status = 1;
+    }
+    //The slots of a cell are contiguous in the chunk file
+    while(j<order.size()&&order[j].first/slotsPerFile==ct){
+      size_t firstSlot = order[j].first;
+      size_t last = j;
+      while(last+1<order.size()&&order[last+1].first/slotsPerFile==ct&&order[last+1].first-firstSlot<maxSlotsPerRead)last++;
+      if(fd!=-1){
+        size_t numRead = order[last].first-firstSlot+1;
+        buffer.resize(numRead);
+        ssize_t bytesRead = pread(fd,&buffer[0],numRead*sizeof(float),off_t((cell*slotsPerFile+firstSlot%slotsPerFile)*sizeof(float)));
+        size_t valuesRead = bytesRead>0?size_t(bytesRead)/sizeof(float):0;
+        for(size_t i=j;i<=last;i++){
+          size_t index = order[i].first-firstSlot;
+          if(index<valuesRead){
+            values[order[i].second]=buffer[index];
+          }
+        }
+      }
+      j=last+1;
+    }
+    if(fd!=-1)close(fd);
+  }
+  #ifdef CTimeSeriesStore_DEBUG
+  CDBDebug("Read %d values of %s",(int)slotList.size(),variableName);
+  #endif
+  return status;
+}
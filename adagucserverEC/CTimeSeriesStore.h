@@ -0,0 +1,120 @@
+/******************************************************************************
+ *
+ * Project:  ADAGUC Server
+ * Purpose:  Time major copy of layer data for fast point time series
+ * Date:     2026-10-18
+ *
+ ******************************************************************************
+ *
+ * Copyright 2026, Royal Netherlands Meteorological Institute (KNMI)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ******************************************************************************/
+
+#ifndef CTimeSeriesStore_H
+#define CTimeSeriesStore_H
+
+#include <string>
+#include <map>
+#include <vector>
+#include "CDataSource.h"
+#include "CDirReader.h"
+#include "CDebugger.h"
+
+#define CTimeSeriesStore_DEFAULT_CHUNKSIZE 16
+
+/* Number of time steps in one chunk file */
+#define CTimeSeriesStore_SLOTSPERFILE 1024
+
+/**
+ * A sidecar copy of a layer, rechunked so that a point time series can be read with a few reads.
+ *
+ * Configured with <TimeSeriesStore path="/data/timeseries/layername" chunksize="16"/> in a Layer. The scanner appends
+ * every time step of newly found files, the files must have variables with dimensions (time,y,x).
+ *
+ * The store directory contains:
+ *  - index.txt: a header line "ADAGUCTSS 2 width height chunksize slotsperfile", followed by one line per time step:
+ *    "slot dimindex filedate filename". A later line for the same time step replaces the earlier one. A line
+ *    "removed - - filename" drops all earlier time steps of a file which was deleted or changed. When most lines are
+ *    dropped or replaced, the index is rewritten with only its current lines and renamed over the old one.
+ *  - index.lock: updates hold an flock on it.
+ *  - <variable>_<cx>_<cy>_<ct>.bin: for each spatial chunk of chunksize by chunksize cells and each range of slotsperfile
+ *    slots, the slots of a cell are stored one after another: a point time series is a single read per chunk file.
+ *    New slots are written with one read and one write of the block of the chunk file they fall in.
+ *    Scale and offset are applied, _FillValue and missing_value are stored as NaN. DataPostProc is not applied, layers
+ *    with a DataPostProc read their time series from the files.
+ * Data is written before the index lines are appended, so readers never see slots without data. A changed file is written
+ * again into its own slots. Other files get the first run of free slots, the slots of removed files are reused.
+ */
+class CTimeSeriesStore{
+  private:
+    DEF_ERRORFUNCTION();
+    CT::string path;
+    int width,height,chunkSize;
+    size_t slotsPerFile;
+    size_t numSlots;
+    size_t numIndexLines;
+    std::map<std::string,size_t> slots;        //"dimindex filename" is key
+    std::map<std::string,std::string> fileDates;//filename is key
+    int loadIndex();
+    int writeIndex();
+    int lockIndex();
+    void unlockIndex(int lockFd);
+    void eraseFile(const char *fileName);
+    size_t findFreeSlots(size_t numSteps);
+    CT::string getChunkFileName(const char *variableName,int cx,int cy,size_t ct);
+    int writeSlots(const char *variableName,const float *data,size_t firstSlot,size_t numSteps);
+    int addFile(CDataSource *dataSource,const char *fileName,const char *fileDate);
+  public:
+    CTimeSeriesStore();
+
+    /**
+     * Adds all files which are not yet in the store, or which have changed. Does nothing when the layer has no TimeSeriesStore.
+     * @param dataSource The layer being scanned
+     * @param dirReader The files found by the scanner
+     * @return Zero on success
+     */
+    static int update(CDataSource *dataSource,CDirReader *dirReader);
+
+    /**
+     * Removes deleted files from the index, their slots are no longer served and are reused by files added later.
+     * Does nothing when the layer has no TimeSeriesStore.
+     * @param dataSource The layer being updated
+     * @param fileNames The files which were removed
+     * @return Zero on success
+     */
+    static int removeFiles(CDataSource *dataSource,std::vector<CT::string> &fileNames);
+
+    /**
+     * Opens the store of the layer for reading.
+     * @return Zero when the store is available
+     */
+    int open(CDataSource *dataSource);
+
+    /**
+     * Returns the slot of a time step, or -1 when it is not in the store
+     */
+    int getSlot(const char *fileName,int dimIndex);
+
+    /**
+     * Reads the values of one cell for a list of slots. The slots in one chunk file are read with a single read.
+     * @param variableName The variable
+     * @param x,y The cell in the grid
+     * @param slotList The slots to read
+     * @param values Gets the values in the same order as slotList, NaN when not available
+     * @return Zero on success
+     */
+    int readPoint(const char *variableName,int x,int y,std::vector<size_t> &slotList,std::vector<float> &values);
+};
+#endif
@@ -0,0 +1,285 @@
+/******************************************************************************
+ *
+ * Project:  ADAGUC Server
+ * Purpose:  Renders configured map tiles after new files are added to a layer
+ * Date:     2026-10-18
+ *
+ ******************************************************************************
+ *
+ * Copyright 2026, Royal Netherlands Meteorological Institute (KNMI)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ******************************************************************************/
+
+#include "CWarmUp.h"
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+const char *CWarmUp::className="CWarmUp";
+std::set<std::string> CWarmUp::updatedLayers;
+std::deque<std::pair<std::string,std::string> > CWarmUp::queuedRequests;
+std::set<std::string> CWarmUp::queuedSet;
+std::map<pid_t,std::string> CWarmUp::runningRequests;
+std::map<std::string,size_t> CWarmUp::maxRunning;
+
+void CWarmUp::addFile(CDataSource *dataSource,const char *fileName){
+  if(dataSource->cfgLayer->WarmUp.size()==0)return;
+  updatedLayers.insert(dataSource->getLayerName());
+  /* The requests will read this file first, the kernel can read it in the meantime */
+  int fd = open(fileName,O_RDONLY);
+  if(fd>=0){
+    posix_fadvise(fd,0,0,POSIX_FADV_WILLNEED);
+    close(fd);
+  }
+}
+
+int CWarmUp::makeRequests(CDataSource *dataSource,CServerConfig::XMLE_WarmUp *warmUp,std::vector<CT::string> &queryStrings){
+  CT::string bboxString = warmUp->attr.bbox.c_str();
+  CT::string *bboxValues = bboxString.splitToArray(",");
+  if(bboxValues->count!=4){
+    CDBError("Layer %s: WarmUp needs a bbox with four values",dataSource->getLayerName());
+    delete[] bboxValues;
+    return 1;
+  }
+  double bbox[4];
+  for(int j=0;j<4;j++)bbox[j]=bboxValues[j].toDouble();
+  delete[] bboxValues;
+
+  int minLevel = 0,maxLevel = 0;
+  CT::string levels = warmUp->attr.levels.c_str();
+  if(!levels.empty()){
+    int separator = levels.indexOf("-");
+    if(separator>0){
+      minLevel = levels.substring(0,separator).toInt();
+      maxLevel = levels.substring(separator+1,-1).toInt();
+    }else{
+      minLevel = maxLevel = levels.toInt();
+    }
+  }
+  if(minLevel<0||maxLevel<minLevel||maxLevel>10){
+    CDBError("Layer %s: invalid WarmUp levels %s",dataSource->getLayerName(),levels.c_str());
+    return 1;
+  }
+
+  int width = warmUp->attr.width.empty()?256:warmUp->attr.width.toInt();
+  int height = warmUp->attr.height.empty()?256:warmUp->attr.height.toInt();
+  CT::string crs = warmUp->attr.crs.empty()?"EPSG:4326":warmUp->attr.crs.c_str();
+  CT::string format = warmUp->attr.format.empty()?"image/png":warmUp->attr.format.c_str();
+  CT::string layerName = dataSource->getLayerName();
+  crs.encodeURLSelf();
+  format.encodeURLSelf();
+  layerName.encodeURLSelf();
+
+  CT::string styleList = warmUp->attr.styles.c_str();
+  CT::string *styles = styleList.splitToArray(",");
+  size_t numStyles = styles->count;
+  if(numStyles==0){
+    /* The default style */
+    delete[] styles;
+    styles = new CT::string[1];
+    numStyles = 1;
+  }
+
+  for(int level=minLevel;level<=maxLevel;level++){
+    int numTiles = 1<<level;
+    double tileWidth = (bbox[2]-bbox[0])/numTiles;
+    double tileHeight = (bbox[3]-bbox[1])/numTiles;
+    for(int y=0;y<numTiles;y++){
+      for(int x=0;x<numTiles;x++){
+        for(size_t s=0;s<numStyles;s++){
+          if(queryStrings.size()>=CWARMUP_MAXREQUESTS){
+            CDBWarning("Layer %s: WarmUp is limited to %d tiles",dataSource->getLayerName(),CWARMUP_MAXREQUESTS);
+            delete[] styles;
+            return 0;
+          }
+          CT::string style = styles[s].c_str();
+          style.encodeURLSelf();
+          CT::string queryString;
+          queryString.print("SERVICE=WMS&REQUEST=GetMap&VERSION=1.1.1&LAYERS=%s&STYLES=%s&SRS=%s&BBOX=%.17g,%.17g,%.17g,%.17g&WIDTH=%d&HEIGHT=%d&FORMAT=%s&TRANSPARENT=TRUE",
+                            layerName.c_str(),style.c_str(),crs.c_str(),
+                            bbox[0]+tileWidth*x,bbox[1]+tileHeight*y,bbox[0]+tileWidth*(x+1),bbox[1]+tileHeight*(y+1),
+                            width,height,format.c_str());
+          queryStrings.push_back(queryString);
+        }
+      }
+    }
+  }
+  delete[] styles;
+  return 0;
+}
+
+void CWarmUp::enqueue(CDataSource *dataSource){
+  std::set<std::string>::iterator it = updatedLayers.find(dataSource->getLayerName());
+  if(it==updatedLayers.end())return;
+  updatedLayers.erase(it);
+
+  std::string layerName = dataSource->getLayerName();
+  std::vector<CT::string> queryStrings;
+  size_t layerMaxRunning = 0;
+  for(size_t j=0;j<dataSource->cfgLayer->WarmUp.size();j++){
+    CServerConfig::XMLE_WarmUp *warmUp = dataSource->cfgLayer->WarmUp[j];
+    if(!warmUp->attr.threads.empty()&&warmUp->attr.threads.toInt()>0&&(size_t)warmUp->attr.threads.toInt()>layerMaxRunning){
+      layerMaxRunning = warmUp->attr.threads.toInt();
+    }
+    makeRequests(dataSource,warmUp,queryStrings);
+  }
+  maxRunning[layerName] = layerMaxRunning>0?layerMaxRunning:CWARMUP_DEFAULTTHREADS;
+  size_t numQueued = 0;
+  for(size_t j=0;j<queryStrings.size();j++){
+    /* A tile which is still waiting from a previous update is not rendered twice */
+    if(queuedSet.insert(queryStrings[j].c_str()).second){
+      queuedRequests.push_back(std::make_pair(layerName,std::string(queryStrings[j].c_str())));
+      numQueued++;
+    }
+  }
+  CDBDebug("Queued %d warm up requests for layer %s",(int)numQueued,dataSource->getLayerName());
+  poll();
+}
+
+void CWarmUp::getInheritedFileDescriptors(std::vector<int> &fileDescriptors){
+  DIR *dir = opendir("/proc/self/fd");
+  if(dir==NULL){
+    long maxFd = sysconf(_SC_OPEN_MAX);
+    if(maxFd<0||maxFd>4096)maxFd = 4096;
+    for(int fd=3;fd<maxFd;fd++){
+      if(fcntl(fd,F_GETFD)!=-1)fileDescriptors.push_back(fd);
+    }
+    return;
+  }
+  struct dirent *entry;
+  while((entry = readdir(dir))!=NULL){
+    if(entry->d_name[0]=='.')continue;
+    int fd = atoi(entry->d_name);
+    if(fd>2&&fd!=dirfd(dir))fileDescriptors.push_back(fd);
+  }
+  closedir(dir);
+}
+
+int CWarmUp::startRequest(const std::string &layerName,const char *queryString){
+  if(getenv("ADAGUC_CONFIG")==NULL){
+    CDBWarning("ADAGUC_CONFIG is not set, unable to start warm up request");
+    return 1;
+  }
+  /* The request process must not keep the database connection or file locks of this process open */
+  std::vector<int> fileDescriptors;
+  getInheritedFileDescriptors(fileDescriptors);
+  for(size_t j=0;j<fileDescriptors.size();j++){
+    int flags = fcntl(fileDescriptors[j],F_GETFD);
+    if(flags!=-1&&(flags&FD_CLOEXEC)==0)fcntl(fileDescriptors[j],F_SETFD,flags|FD_CLOEXEC);
+  }
+  pid_t pid = fork();
+  if(pid<0){
+    CDBError("Unable to start warm up request: %s",strerror(errno));
+    return 1;
+  }
+  if(pid==0){
+    /* The request runs as a new server process, like a CGI request, the image is not needed */
+    int devNull = open("/dev/null",O_RDWR);
+    if(devNull>=0){
+      dup2(devNull,0);
+      dup2(devNull,1);
+      close(devNull);
+    }
+    setenv("QUERY_STRING",queryString,1);
+    setenv("REQUEST_METHOD","GET",1);
+    execl("/proc/self/exe","adagucserver",(char*)NULL);
+    _exit(127);
+  }
+  #ifdef CWARMUP_DEBUG
+  CDBDebug("Started %d: %s",pid,queryString);
+  #endif
+  runningRequests[pid] = layerName;
+  return 0;
+}
+
+size_t CWarmUp::poll(){
+  std::map<std::string,size_t> numRunning;
+  for(std::map<pid_t,std::string>::iterator it=runningRequests.begin();it!=runningRequests.end();){
+    int status = 0;
+    pid_t pid = waitpid(it->first,&status,WNOHANG);
+    /* After detach the requests started by the parent are no children, they are running as long as they exist */
+    if(pid==0||(pid<0&&errno==ECHILD&&kill(it->first,0)==0)){
+      numRunning[it->second]++;
+      ++it;
+      continue;
+    }
+    if(pid>0&&(!WIFEXITED(status)||WEXITSTATUS(status)!=0)){
+      CDBWarning("Warm up request %d failed",it->first);
+    }
+    runningRequests.erase(it++);
+  }
+  /* Requests of a layer at its limit wait, the requests of other layers behind them can start */
+  for(std::deque<std::pair<std::string,std::string> >::iterator it=queuedRequests.begin();it!=queuedRequests.end();){
+    size_t &layerRunning = numRunning[it->first];
+    if(layerRunning>=maxRunning[it->first]){
+      ++it;
+      continue;
+    }
+    std::pair<std::string,std::string> request = *it;
+    it = queuedRequests.erase(it);
+    queuedSet.erase(request.second);
+    if(startRequest(request.first,request.second.c_str())!=0){
+      /* Without a configuration no request can start, drop the queue */
+      queuedRequests.clear();
+      queuedSet.clear();
+      break;
+    }
+    layerRunning++;
+  }
+  return queuedRequests.size()+runningRequests.size();
+}
+
+void CWarmUp::finish(){
+  while(poll()>0){
+    usleep(10000);
+  }
+}
+
+void CWarmUp::detach(){
+  size_t numRequests = poll();
+  if(numRequests==0)return;
+  std::vector<int> fileDescriptors;
+  getInheritedFileDescriptors(fileDescriptors);
+  pid_t pid = fork();
+  if(pid<0){
+    CDBWarning("Unable to continue warm up in the background, waiting: %s",strerror(errno));
+    finish();
+    return;
+  }
+  if(pid>0){
+    CDBDebug("Continuing %d warm up requests in background process %d",(int)numRequests,pid);
+    queuedRequests.clear();
+    queuedSet.clear();
+    runningRequests.clear();
+    return;
+  }
+  /* Nobody waits for the output of the background process */
+  setsid();
+  for(size_t j=0;j<fileDescriptors.size();j++)close(fileDescriptors[j]);
+  int devNull = open("/dev/null",O_RDWR);
+  if(devNull>=0){
+    dup2(devNull,0);
+    dup2(devNull,1);
+    dup2(devNull,2);
+    if(devNull>2)close(devNull);
+  }
+  finish();
+  _exit(0);
+}
@@ -0,0 +1,104 @@
+/******************************************************************************
+ *
+ * Project:  ADAGUC Server
+ * Purpose:  Renders configured map tiles after new files are added to a layer
+ * Date:     2026-10-18
+ *
+ ******************************************************************************
+ *
+ * Copyright 2026, Royal Netherlands Meteorological Institute (KNMI)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ******************************************************************************/
+
+#ifndef CWarmUp_H
+#define CWarmUp_H
+
+#include <deque>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+#include "CDebugger.h"
+#include "CDataSource.h"
+
+// #define CWARMUP_DEBUG
+
+/* Number of warm up requests of a layer which run at the same time, when not configured with the threads attribute */
+#define CWARMUP_DEFAULTTHREADS 2
+
+/* Maximum number of tiles of one WarmUp element */
+#define CWARMUP_MAXREQUESTS 1024
+
+/**
+ * Warms the caches of a layer after new files are scanned, so the first users asking for the newest data do
+ * not all wait for the same files to be read.
+ *
+ * The scanner reports each added file with addFile, which asks the kernel to read the file ahead. After the
+ * scan, enqueue makes a GetMap request for every tile of the WarmUp elements of the layer:
+ *   <WarmUp styles="temperature/shadedcontour" crs="EPSG:3857" bbox="-2000000,5000000,3000000,10000000"
+ *           levels="0-2" width="256" height="256" format="image/png" threads="4"/>
+ * Level n divides the bbox in 2^n by 2^n tiles. The requests use the default dimension values, which is the
+ * newest time.
+ *
+ * Every request runs in a new server process, started in the background with the configuration of
+ * ADAGUC_CONFIG. At most threads requests of a layer run at the same time, poll starts the next ones. Each
+ * layer has its own limit, the largest threads attribute of its WarmUp elements. The request processes do not
+ * inherit the file descriptors of the scanner, like its database connection.
+ *
+ * After a scan the caller either waits with finish(), or hands the remaining requests over to a background
+ * process with detach() and returns immediately.
+ */
+class CWarmUp{
+  private:
+    DEF_ERRORFUNCTION();
+    static std::set<std::string> updatedLayers;
+    static std::deque<std::pair<std::string,std::string> > queuedRequests;
+    static std::set<std::string> queuedSet;
+    static std::map<pid_t,std::string> runningRequests;
+    static std::map<std::string,size_t> maxRunning;
+    static int startRequest(const std::string &layerName,const char *queryString);
+    static void getInheritedFileDescriptors(std::vector<int> &fileDescriptors);
+    static int makeRequests(CDataSource *dataSource,CServerConfig::XMLE_WarmUp *warmUp,std::vector<CT::string> &queryStrings);
+  public:
+
+    /**
+     * Reports a new or changed file of a layer, called by the scanner
+     */
+    static void addFile(CDataSource *dataSource,const char *fileName);
+
+    /**
+     * Queues the warm up requests of a layer, when files were added to it since the last call
+     */
+    static void enqueue(CDataSource *dataSource);
+
+    /**
+     * Collects the finished requests and starts queued requests, does not wait
+     * @return The number of requests which are queued or running
+     */
+    static size_t poll();
+
+    /**
+     * Waits until all queued requests are finished
+     */
+    static void finish();
+
+    /**
+     * Continues the queued and running requests in a background process and returns without waiting. The
+     * background process has no file descriptors of this process besides /dev/null as stdin, stdout and stderr.
+     */
+    static void detach();
+};
+#endif
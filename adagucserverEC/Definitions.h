@@ -56,6 +56,7 @@
 #define REQUEST_WMS_GETREFERENCETIMES     11
 #define REQUEST_WMS_GETHISTOGRAM          12
 #define REQUEST_WMS_GETSCALEBAR           13
+#define REQUEST_WMS_GETCONTOURS           14
 #define REQUEST_UPDATEDB                  100
 
 //Legend
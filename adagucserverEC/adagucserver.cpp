@@ -164,6 +164,24 @@ int main(int argc, const char *argv[]){
   // Initialize error functions
   seterrormode(EXCEPTIONS_PLAINTEXT);
 
+  //Timing spans are always recorded and logged per request, set ADAGUC_TRACE=false to disable them
+  const char *pszADAGUCTrace=getenv("ADAGUC_TRACE");
+  if(pszADAGUCTrace!=NULL&&strncmp(pszADAGUCTrace,"false",5)==0){
+    CTracer::setEnabled(false);
+  }
+
+  //Large buffers are pooled and backed by huge pages, set ADAGUC_BUFFERPOOL=false to use malloc instead
+  const char *pszADAGUCBufferPool=getenv("ADAGUC_BUFFERPOOL");
+  if(pszADAGUCBufferPool!=NULL&&strncmp(pszADAGUCBufferPool,"false",5)==0){
+    CBufferPool::setEnabled(false);
+  }
+
+  //Data layers of distinct files are warped at the same time, set ADAGUC_WARPLAYERS=false to warp them one after another
+  const char *pszADAGUCWarpLayers=getenv("ADAGUC_WARPLAYERS");
+  if(pszADAGUCWarpLayers!=NULL&&strncmp(pszADAGUCWarpLayers,"false",5)==0){
+    CImageDataWriter::setWarpLayersEnabled(false);
+  }
+
 
   //Check if a database update was requested
   if(argc>=2){
@@ -180,6 +198,8 @@ int main(int argc, const char *argv[]){
       CRequest request;
       int configSet = 0;
      
+      bool watch = false;
+      bool waitForWarmUp = false;
       CT::string tailPath,layerPathToScan;
       for(int j=0;j<argc;j++){
         if(strncmp(argv[j],"--config",8)==0&&argc>j+1){
@@ -204,11 +224,19 @@ int main(int argc, const char *argv[]){
           CDBDebug("NOCLEANUP: Leave all records in DB, don't check if files have disappeared");
           scanFlags|=CDBFILESCANNER_DONTREMOVEDATAFROMDB;
         }
+        if(strncmp(argv[j],"--watch",7)==0){
+          watch = true;
+        }
+        if(strncmp(argv[j],"--waitforwarmup",15)==0){
+          waitForWarmUp = true;
+        }
         
       }
       if(configSet == 0){
         CDBError("Error: Configuration file is not set: use '--updatedb --config configfile.xml'" );
         CDBError("And --tailpath for scanning specific sub directory, specify --path for a absolute path to update" );
+        CDBError("Add --watch to keep the database up to date while files are added, changed or removed" );
+        CDBError("Add --waitforwarmup to wait for the WarmUp requests instead of running them in the background" );
 
         return 0;
       }
@@ -222,6 +250,16 @@ int main(int argc, const char *argv[]){
       if(status != 0){
         CDBError("Error occured in updating the database");
       }
+      if(watch&&(scanFlags&CDBFILESCANNER_UPDATEDB)){
+        status = request.watchdb(&layerPathToScan,scanFlags);
+        if(status != 0){
+          CDBError("Error occured in watching the database");
+        }
+      }else if(waitForWarmUp){
+        CWarmUp::finish();
+      }else{
+        CWarmUp::detach();
+      }
     
 
                 
@@ -29,6 +29,7 @@
 #include "CServerError.h"
 #include "Definitions.h"
 #include "CGetFileInfo.h"
+#include "CWarmUp.h"
 
 void writeLogFile(const char * msg);
 
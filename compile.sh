@@ -3,7 +3,10 @@
 #For developing, use:
 #export ADAGUCCOMPILERSETTINGS="-Wall -DMEMLEAKCHECK"
 
-#For time measurement of components use
+#Timings of the request stages (db, open, read, warp, encode) are logged per request and
+#sent as Server-Timing header, set ADAGUC_TRACE=false in the environment to disable them.
+
+#For detailed time measurement of the remaining components (StopWatch_Stop) use
 #export ADAGUCCOMPILERSETTINGS="-Wall -DMEMLEAKCHECK -DMEASURETIME"
 
 #For operational, use:
@@ -0,0 +1,143 @@
+/******************************************************************************
+ *
+ * Project:  ADAGUC Server
+ * Purpose:  Pool of large buffers, reused between allocations and requests
+ * Date:     2026-10-18
+ *
+ ******************************************************************************
+ *
+ * Copyright 2026, Royal Netherlands Meteorological Institute (KNMI)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ******************************************************************************/
+
+#include "CBufferPool.h"
+#include <stdlib.h>
+#include <stdint.h>
+#include <sys/mman.h>
+
+const char *CBufferPool::className="CBufferPool";
+std::map<void*,size_t> CBufferPool::usedBlocks;
+std::multimap<size_t,void*> CBufferPool::freeBlocks;
+size_t CBufferPool::freeBytes = 0;
+pthread_mutex_t CBufferPool::lock = PTHREAD_MUTEX_INITIALIZER;
+bool CBufferPool::enabled = true;
+
+void *CBufferPool::mapBlock(size_t size){
+  /* Map one extra block, so the start can be aligned to a huge page boundary */
+  size_t mappedSize = size+CBUFFERPOOL_BLOCKSIZE;
+  void *p = mmap(NULL,mappedSize,PROT_READ|PROT_WRITE,MAP_PRIVATE|MAP_ANONYMOUS,-1,0);
+  if(p==MAP_FAILED){
+    return NULL;
+  }
+  uintptr_t start = (uintptr_t)p;
+  uintptr_t aligned = (start+CBUFFERPOOL_BLOCKSIZE-1)&~(uintptr_t)(CBUFFERPOOL_BLOCKSIZE-1);
+  if(aligned>start){
+    munmap(p,aligned-start);
+  }
+  size_t tail = (start+mappedSize)-(aligned+size);
+  if(tail>0){
+    munmap((void*)(aligned+size),tail);
+  }
+#ifdef MADV_HUGEPAGE
+  madvise((void*)aligned,size,MADV_HUGEPAGE);
+#endif
+  return (void*)aligned;
+}
+
+void CBufferPool::unmapBlock(void *p,size_t size){
+  munmap(p,size);
+}
+
+void *CBufferPool::allocate(size_t size){
+  if(!enabled||size<CBUFFERPOOL_MINSIZE){
+    return malloc(size);
+  }
+  size_t blockSize = ((size+CBUFFERPOOL_BLOCKSIZE-1)/CBUFFERPOOL_BLOCKSIZE)*CBUFFERPOOL_BLOCKSIZE;
+  void *p = NULL;
+  pthread_mutex_lock(&lock);
+  /* Reuse the smallest released block which fits, unless it wastes more than half of it */
+  std::multimap<size_t,void*>::iterator it = freeBlocks.lower_bound(blockSize);
+  if(it!=freeBlocks.end()&&it->first<=blockSize*2){
+    blockSize = it->first;
+    p = it->second;
+    freeBytes -= blockSize;
+    freeBlocks.erase(it);
+  }
+  pthread_mutex_unlock(&lock);
+  if(p==NULL){
+    p = mapBlock(blockSize);
+    if(p==NULL){
+      CDBError("Unable to map %lu bytes",(unsigned long)blockSize);
+      return NULL;
+    }
+#ifdef CBUFFERPOOL_DEBUG
+    CDBDebug("Mapped block of %lu bytes",(unsigned long)blockSize);
+#endif
+  }
+  pthread_mutex_lock(&lock);
+  usedBlocks[p] = blockSize;
+  pthread_mutex_unlock(&lock);
+  return p;
+}
+
+void CBufferPool::release(void *p){
+  if(p==NULL)return;
+  pthread_mutex_lock(&lock);
+  std::map<void*,size_t>::iterator it = usedBlocks.find(p);
+  if(it==usedBlocks.end()){
+    pthread_mutex_unlock(&lock);
+    free(p);
+    return;
+  }
+  size_t blockSize = it->second;
+  usedBlocks.erase(it);
+  bool keep = freeBytes+blockSize<=CBUFFERPOOL_MAXRETAINED;
+  if(keep){
+    freeBlocks.insert(std::pair<size_t,void*>(blockSize,p));
+    freeBytes += blockSize;
+  }
+  pthread_mutex_unlock(&lock);
+  if(!keep){
+    unmapBlock(p,blockSize);
+  }
+}
+
+void CBufferPool::trim(size_t maxRetained){
+  std::multimap<size_t,void*> unmapList;
+  pthread_mutex_lock(&lock);
+  /* Drop the largest blocks first, they are the least likely to fit the next allocations exactly */
+  while(freeBytes>maxRetained&&!freeBlocks.empty()){
+    std::multimap<size_t,void*>::iterator it = freeBlocks.end();
+    it--;
+    freeBytes -= it->first;
+    unmapList.insert(*it);
+    freeBlocks.erase(it);
+  }
+  pthread_mutex_unlock(&lock);
+  for(std::multimap<size_t,void*>::iterator it=unmapList.begin();it!=unmapList.end();it++){
+    unmapBlock(it->second,it->first);
+  }
+#ifdef CBUFFERPOOL_DEBUG
+  CDBDebug("Trimmed %lu blocks, %lu bytes retained",(unsigned long)unmapList.size(),(unsigned long)freeBytes);
+#endif
+}
+
+void CBufferPool::endRequest(){
+  trim(CBUFFERPOOL_KEEPBETWEENREQUESTS);
+}
+
+void CBufferPool::setEnabled(bool enable){
+  enabled = enable;
+}
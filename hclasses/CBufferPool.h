@@ -0,0 +1,106 @@
+/******************************************************************************
+ *
+ * Project:  ADAGUC Server
+ * Purpose:  Pool of large buffers, reused between allocations and requests
+ * Date:     2026-10-18
+ *
+ ******************************************************************************
+ *
+ * Copyright 2026, Royal Netherlands Meteorological Institute (KNMI)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ******************************************************************************/
+
+#ifndef CBUFFERPOOL_H
+#define CBUFFERPOOL_H
+#include <map>
+#include <stddef.h>
+#include <pthread.h>
+#include "CDebugger.h"
+
+// #define CBUFFERPOOL_DEBUG
+
+/* Allocations smaller than this are passed to malloc */
+#define CBUFFERPOOL_MINSIZE      (1024*1024)
+
+/* Pooled blocks are multiples of, and aligned to, the size of a transparent huge page */
+#define CBUFFERPOOL_BLOCKSIZE    (2*1024*1024)
+
+/* Maximum size of the released blocks which are kept mapped for reuse during a request */
+#define CBUFFERPOOL_MAXRETAINED  (512*1024*1024)
+
+/* Maximum size of the released blocks which are kept mapped for the next request */
+#define CBUFFERPOOL_KEEPBETWEENREQUESTS (128*1024*1024)
+
+/**
+ * Pool for the large buffers of a request: data of variables, warp fields, distance fields and image buffers.
+ *
+ * Large buffers are mapped directly, aligned to huge pages and advised to be backed by transparent huge pages.
+ * Released buffers stay mapped and are handed out again for allocations of about the same size, so the
+ * read, warp and encode stages of a request and of the next request do not fault in fresh pages for every
+ * buffer. At the end of a request the pool is trimmed to CBUFFERPOOL_KEEPBETWEENREQUESTS in one go.
+ *
+ * All functions are thread safe. Small allocations use malloc, and release accepts any pointer from malloc,
+ * so existing buffers can be released with it as well:
+ *   float *values = CBufferPool::allocate<float>(width*height);
+ *   ...
+ *   CBufferPool::release(values);
+ */
+class CBufferPool{
+  private:
+    DEF_ERRORFUNCTION();
+    static std::map<void*,size_t> usedBlocks;
+    static std::multimap<size_t,void*> freeBlocks;
+    static size_t freeBytes;
+    static pthread_mutex_t lock;
+    static bool enabled;
+    static void *mapBlock(size_t size);
+    static void unmapBlock(void *p,size_t size);
+  public:
+
+    /**
+     * Allocates a buffer with the semantics of malloc, the contents are undefined
+     * @return The buffer, or NULL when out of memory
+     */
+    static void *allocate(size_t size);
+
+    /**
+     * Allocates an array of count elements of type T, the elements are not constructed
+     */
+    template <class T>
+    static T *allocate(size_t count){
+      return (T*)allocate(count*sizeof(T));
+    }
+
+    /**
+     * Releases a buffer from allocate or malloc. NULL is ignored.
+     */
+    static void release(void *p);
+
+    /**
+     * Unmaps released blocks until at most maxRetained bytes are kept for reuse
+     */
+    static void trim(size_t maxRetained);
+
+    /**
+     * Called at the end of a request, trims the pool to CBUFFERPOOL_KEEPBETWEENREQUESTS
+     */
+    static void endRequest();
+
+    /**
+     * Enables or disables pooling, enabled by default. Can be disabled with environment variable ADAGUC_BUFFERPOOL=false.
+     */
+    static void setEnabled(bool enable);
+};
+#endif
@@ -254,3 +254,7 @@ CT::string CDirReader::getFileDate(const char *fileName){
    lookupTableFileModificationDateMap.insert(std::pair<std::string,std::string>(fileName,fileDate.c_str()));
   return fileDate;
 }
+
+void CDirReader::forgetFileDate(const char *fileName){
+  lookupTableFileModificationDateMap.erase(fileName);
+}
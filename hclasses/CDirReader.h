@@ -62,6 +62,12 @@ class CDirReader{
     int testRegEx(const char *string,const char *pattern);
     
     static CT::string getFileDate(const char *fileName);
+    
+    /**
+     * Forgets the remembered modification date of a file, for files which have changed since the date was read
+     * @param fileName The file
+     */
+    static void forgetFileDate(const char *fileName);
 
     /**
      * Create a public directory writable for everybody 
@@ -0,0 +1,172 @@
+/******************************************************************************
+ *
+ * Project:  Helper classes
+ * Purpose:  Bounded parallel read ahead of files which are going to be opened
+ * Date:     2026-10-18
+ *
+ ******************************************************************************
+ *
+ * Copyright 2026, Royal Netherlands Meteorological Institute (KNMI)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ******************************************************************************/
+
+#include "CFilePrefetcher.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+const char *CFilePrefetcher::className="CFilePrefetcher";
+
+//Number of bytes read from the start of each file, this covers the header of most NetCDF and HDF5 files
+#define CFilePrefetcher_HEADERSIZE 65536
+
+//Larger files added with wholeFile set are not read completely, only their header
+#define CFilePrefetcher_MAXWHOLEFILESIZE (256*1024*1024)
+
+//Size of the blocks in which whole files are read
+#define CFilePrefetcher_BLOCKSIZE (1024*1024)
+
+//Maximum number of worker threads
+#define CFilePrefetcher_MAXTHREADS 16
+
+CFilePrefetcher::CFilePrefetcher(){
+  nextToPrefetch = 0;
+  currentIndex = 0;
+  window = 0;
+  running = false;
+  stopping = false;
+  pthread_mutex_init(&mutex,NULL);
+  pthread_cond_init(&cond,NULL);
+}
+
+CFilePrefetcher::~CFilePrefetcher(){
+  stop();
+  pthread_cond_destroy(&cond);
+  pthread_mutex_destroy(&mutex);
+}
+
+void CFilePrefetcher::addFile(const char *fileName,bool wholeFile){
+  if(running)return;
+  if(fileNames.size()>0&&fileNames.back().equals(fileName))return;
+  fileNames.push_back(fileName);
+  wholeFiles.push_back(wholeFile);
+}
+
+int CFilePrefetcher::start(size_t window){
+  if(running||window==0||fileNames.size()<2)return 0;
+  this->window = window;
+  nextToPrefetch = 1; /* The first file is opened by the reader right away */
+  currentIndex = 0;
+  stopping = false;
+  running = true;
+  size_t numThreads = window;
+  if(numThreads>CFilePrefetcher_MAXTHREADS)numThreads=CFilePrefetcher_MAXTHREADS;
+  if(numThreads>fileNames.size()-1)numThreads=fileNames.size()-1;
+  for(size_t j=0;j<numThreads;j++){
+    pthread_t thread;
+    if(pthread_create(&thread,NULL,worker,this)!=0){
+      CDBWarning("Unable to start prefetch thread %d",(int)j);
+      break;
+    }
+    threads.push_back(thread);
+  }
+  return 0;
+}
+
+void CFilePrefetcher::setCurrentFile(const char *fileName){
+  if(!running)return;
+  pthread_mutex_lock(&mutex);
+  for(size_t j=currentIndex;j<fileNames.size();j++){
+    if(fileNames[j].equals(fileName)){
+      currentIndex = j;
+      pthread_cond_broadcast(&cond);
+      pthread_mutex_unlock(&mutex);
+      return;
+    }
+  }
+  /* The reader started a new pass over the files */
+  for(size_t j=0;j<currentIndex;j++){
+    if(fileNames[j].equals(fileName)){
+      currentIndex = j;
+      nextToPrefetch = j+1;
+      pthread_cond_broadcast(&cond);
+      break;
+    }
+  }
+  pthread_mutex_unlock(&mutex);
+}
+
+void CFilePrefetcher::stop(){
+  if(!running)return;
+  pthread_mutex_lock(&mutex);
+  stopping = true;
+  pthread_cond_broadcast(&cond);
+  pthread_mutex_unlock(&mutex);
+  for(size_t j=0;j<threads.size();j++){
+    pthread_join(threads[j],NULL);
+  }
+  threads.clear();
+  running = false;
+}
+
+void *CFilePrefetcher::worker(void *arg){
+  CFilePrefetcher *prefetcher = (CFilePrefetcher*)arg;
+  while(true){
+    pthread_mutex_lock(&prefetcher->mutex);
+    /* Wait until the reader comes close enough, otherwise we would push its files out of the cache. At the end of
+       the list wait as well, the reader may start a new pass. */
+    while(!prefetcher->stopping&&(prefetcher->nextToPrefetch>=prefetcher->fileNames.size()||
+          prefetcher->nextToPrefetch>prefetcher->currentIndex+prefetcher->window)){
+      pthread_cond_wait(&prefetcher->cond,&prefetcher->mutex);
+    }
+    if(prefetcher->stopping){
+      pthread_mutex_unlock(&prefetcher->mutex);
+      break;
+    }
+    size_t index = prefetcher->nextToPrefetch++;
+    /* Files already passed by the reader are skipped */
+    bool skip = index<=prefetcher->currentIndex;
+    const char *fileName = prefetcher->fileNames[index].c_str();
+    bool wholeFile = prefetcher->wholeFiles[index];
+    pthread_mutex_unlock(&prefetcher->mutex);
+    if(!skip){
+      prefetchFile(fileName,wholeFile);
+    }
+  }
+  return NULL;
+}
+
+void CFilePrefetcher::prefetchFile(const char *fileName,bool wholeFile){
+  int fd = open(fileName,O_RDONLY);
+  if(fd==-1)return;
+  struct stat fileStat;
+  if(wholeFile&&fstat(fd,&fileStat)==0&&fileStat.st_size<=CFilePrefetcher_MAXWHOLEFILESIZE){
+    /* Read synchronously, so a worker only moves on to the next file when this one is in the page cache */
+    char *buffer = new char[CFilePrefetcher_BLOCKSIZE];
+    off_t offset = 0;
+    while(offset<fileStat.st_size){
+      ssize_t numRead = pread(fd,buffer,CFilePrefetcher_BLOCKSIZE,offset);
+      if(numRead<=0)break;
+      offset+=numRead;
+    }
+    delete[] buffer;
+  }else{
+    char buffer[CFilePrefetcher_HEADERSIZE];
+    if(pread(fd,buffer,CFilePrefetcher_HEADERSIZE,0)<0){
+      /* Not fatal, the reader will report the error when it opens the file */
+    }
+  }
+  close(fd);
+}
@@ -0,0 +1,91 @@
+/******************************************************************************
+ *
+ * Project:  Helper classes
+ * Purpose:  Bounded parallel read ahead of files which are going to be opened
+ * Date:     2026-10-18
+ *
+ ******************************************************************************
+ *
+ * Copyright 2026, Royal Netherlands Meteorological Institute (KNMI)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ******************************************************************************/
+
+#ifndef CFilePrefetcher_H
+#define CFilePrefetcher_H
+#include <vector>
+#include <pthread.h>
+#include "CTypes.h"
+#include "CDebugger.h"
+
+/**
+ * Warms the page cache for a list of files which will be opened one after another.
+ *
+ * The NetCDF and HDF5 libraries are not thread safe, so files can not be opened concurrently. Instead a number
+ * of worker threads read the upcoming files, the serial reader then finds them in memory. By default only the
+ * header is read: a time series reads a few values per file, reading whole files would only evict the page
+ * cache. Files which are read completely, like the fields of GetFeatureInfo with all data, can be added with
+ * wholeFile set, these are read up to CFilePrefetcher_MAXWHOLEFILESIZE bytes. Workers stay at most "window"
+ * files ahead of the reader.
+ *
+ * Usage:
+ *   CFilePrefetcher prefetcher;
+ *   for(...)prefetcher.addFile(fileName);
+ *   prefetcher.start(4);
+ *   for(...){prefetcher.setCurrentFile(fileName);open(fileName)...}
+ *   prefetcher.stop();
+ */
+class CFilePrefetcher{
+  private:
+    DEF_ERRORFUNCTION();
+    std::vector<CT::string> fileNames;
+    std::vector<bool> wholeFiles;
+    size_t nextToPrefetch;
+    size_t currentIndex;
+    size_t window;
+    bool running;
+    bool stopping;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    std::vector<pthread_t> threads;
+    static void *worker(void *arg);
+    static void prefetchFile(const char *fileName,bool wholeFile);
+  public:
+    CFilePrefetcher();
+    ~CFilePrefetcher();
+
+    /**
+     * Adds a file to the list of files to prefetch, consecutive duplicates are ignored. Call before start.
+     * @param wholeFile Read the data of the file as well, instead of only the header.
+     */
+    void addFile(const char *fileName,bool wholeFile=false);
+
+    /**
+     * Starts the worker threads.
+     * @param window The number of files to read ahead, this is also the number of concurrent reads. Zero disables prefetching.
+     */
+    int start(size_t window);
+
+    /**
+     * Tells the prefetcher that the reader is now working on this file. When the reader starts again at an
+     * earlier file, for example for the next variable, the files after it are prefetched again.
+     */
+    void setCurrentFile(const char *fileName);
+
+    /**
+     * Stops and joins the worker threads
+     */
+    void stop();
+};
+#endif
@@ -1,11 +1,21 @@
 #ifndef CREADFILE_H
 #define CREADFILE_H
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
 #include "CTypes.h"
 #define CREADFILE_OK           0
 #define CREADFILE_FILENOTFOUND 1
 #define CREADFILE_FILENOTREAD  2
 #define CREADFILE_FILENOTWRITE 3
 
+/* Size of the buffer used for copying when sendfile is not available */
+#define CREADFILE_COPYBUFFERSIZE (1024*1024)
+
 class CReadFile{
   private:
   static size_t getFileSize(const char *pszFileName){
@@ -56,6 +66,75 @@ class CReadFile{
       return dataString;
     }
     
+    /**
+     * Copies a file to an already opened file descriptor, with sendfile when possible, otherwise with large reads and writes
+     * @param fileName The file to copy
+     * @param outputFd The file descriptor to write to, for example STDOUT_FILENO
+     * @return CREADFILE_OK on success
+     */
+    static int copyToFd(const char *fileName,int outputFd){
+      int inputFd = ::open(fileName,O_RDONLY);
+      if(inputFd<0)return CREADFILE_FILENOTFOUND;
+      struct stat fileStat;
+      if(fstat(inputFd,&fileStat)!=0){::close(inputFd);return CREADFILE_FILENOTREAD;}
+      size_t remaining = fileStat.st_size;
+      int status = CREADFILE_OK;
+#ifdef __linux__
+      off_t offset = 0;
+      while(remaining>0){
+        ssize_t sent = sendfile(outputFd,inputFd,&offset,remaining);
+        if(sent<0&&errno==EINTR)continue;
+        if(sent<=0)break;
+        remaining-=sent;
+      }
+      if(remaining>0&&lseek(inputFd,offset,SEEK_SET)<0)status = CREADFILE_FILENOTREAD;
+#endif
+      /* Fallback for systems or descriptors where sendfile is not supported */
+      if(remaining>0&&status == CREADFILE_OK){
+        char *buffer = new char[CREADFILE_COPYBUFFERSIZE];
+        while(remaining>0){
+          ssize_t numRead = ::read(inputFd,buffer,remaining<CREADFILE_COPYBUFFERSIZE?remaining:CREADFILE_COPYBUFFERSIZE);
+          if(numRead<0&&errno==EINTR)continue;
+          if(numRead<=0){status = CREADFILE_FILENOTREAD;break;}
+          ssize_t numWritten = 0;
+          while(numWritten<numRead){
+            ssize_t w = ::write(outputFd,buffer+numWritten,numRead-numWritten);
+            if(w<0&&errno==EINTR)continue;
+            if(w<=0)break;
+            numWritten+=w;
+          }
+          if(numWritten<numRead){status = CREADFILE_FILENOTWRITE;break;}
+          remaining-=numRead;
+        }
+        delete[] buffer;
+      }
+      ::close(inputFd);
+      return status;
+    }
+
+    /**
+     * Sends a file to stdout. Everything already printed to stdout is flushed first.
+     * @return CREADFILE_OK on success
+     */
+    static int sendToStdout(const char *fileName){
+      fflush(stdout);
+      return copyToFd(fileName,STDOUT_FILENO);
+    }
+
+    /**
+     * Moves a file, copies it when it is on another file system
+     * @return CREADFILE_OK on success
+     */
+    static int move(const char *fromFileName,const char *toFileName){
+      if(rename(fromFileName,toFileName)==0)return CREADFILE_OK;
+      int outputFd = ::open(toFileName,O_WRONLY|O_CREAT|O_TRUNC,0644);
+      if(outputFd<0)return CREADFILE_FILENOTWRITE;
+      int status = copyToFd(fromFileName,outputFd);
+      if(::close(outputFd)!=0&&status == CREADFILE_OK)status = CREADFILE_FILENOTWRITE;
+      if(status == CREADFILE_OK)remove(fromFileName);
+      return status;
+    }
+    
     static void write(const char *fileName,const char *buffer,size_t length){
       if(buffer==NULL){throw CREADFILE_FILENOTWRITE;}
       FILE *pFile = fopen ( fileName , "wb" );
@@ -0,0 +1,217 @@
+/******************************************************************************
+ *
+ * Project:  Helper classes
+ * Purpose:  Request scoped timing spans and latency histograms
+ * Date:     2026-10-18
+ *
+ ******************************************************************************
+ *
+ * Copyright 2026, Royal Netherlands Meteorological Institute (KNMI)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ******************************************************************************/
+
+#include "CTracer.h"
+#include <time.h>
+#include <sys/time.h>
+
+const char *CTracer::className="CTracer";
+std::vector<CTracer::Timing> CTracer::requestTimings;
+std::vector<CTracer::Histogram> CTracer::histograms;
+pthread_mutex_t CTracer::lock = PTHREAD_MUTEX_INITIALIZER;
+bool CTracer::enabled = true;
+
+//Upper bounds of the histogram buckets in milliseconds, the last bucket is +Inf
+static const double CTracer_bucketBounds[CTRACER_NUMBUCKETS]={1,2.5,5,10,25,50,100,250,500,1000,2500,5000,10000,30000};
+
+//The innermost running span of the calling thread, used for nesting
+static __thread CTracer::Span *CTracer_currentSpan = NULL;
+
+double CTracer::now(){
+#if _POSIX_TIMERS > 0
+  timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return double(t.tv_sec)*1000+double(t.tv_nsec)/1000000;
+#else
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return double(tv.tv_sec)*1000+double(tv.tv_usec)/1000;
+#endif
+}
+
+void CTracer::setEnabled(bool enable){
+  enabled = enable;
+}
+
+bool CTracer::isEnabled(){
+  return enabled;
+}
+
+CTracer::Span *CTracer::getCurrentSpan(){
+  return CTracer_currentSpan;
+}
+
+void CTracer::setCurrentSpan(Span *span){
+  CTracer_currentSpan = span;
+}
+
+CTracer::Span::Span(const char *name){
+  running = enabled;
+  parent = NULL;
+  startMs = 0;
+  if(!running)return;
+  parent = CTracer_currentSpan;
+  if(parent!=NULL){
+    this->name.copy(&parent->name);
+    this->name.concat(".");
+  }
+  this->name.concat(name);
+  CTracer_currentSpan = this;
+  startMs = CTracer::now();
+}
+
+CTracer::Span::~Span(){
+  stop();
+}
+
+double CTracer::Span::stop(){
+  if(!running)return 0;
+  running = false;
+  double elapsedMs = CTracer::now()-startMs;
+  /* Spans are scoped, but when one is stopped early the inner spans may still be running: continue with the nearest running parent */
+  if(CTracer_currentSpan == this){
+    Span *span = parent;
+    while(span!=NULL&&!span->running){
+      span = span->parent;
+    }
+    CTracer_currentSpan = span;
+  }
+  CTracer::record(name.c_str(),elapsedMs);
+  return elapsedMs;
+}
+
+void CTracer::record(const char *name,double elapsedMs){
+  pthread_mutex_lock(&lock);
+  Timing *timing = NULL;
+  for(size_t j=0;j<requestTimings.size();j++){
+    if(requestTimings[j].name.equals(name)){
+      timing = &requestTimings[j];
+      break;
+    }
+  }
+  if(timing == NULL){
+    Timing newTiming;
+    newTiming.name = name;
+    newTiming.totalMs = 0;
+    newTiming.count = 0;
+    requestTimings.push_back(newTiming);
+    timing = &requestTimings.back();
+  }
+  timing->totalMs+=elapsedMs;
+  timing->count++;
+  pthread_mutex_unlock(&lock);
+}
+
+CT::string CTracer::getServerTiming(){
+  CT::string result;
+  pthread_mutex_lock(&lock);
+  for(size_t j=0;j<requestTimings.size();j++){
+    if(j>0)result.concat(", ");
+    result.printconcat("%s;dur=%.1f",requestTimings[j].name.c_str(),requestTimings[j].totalMs);
+  }
+  pthread_mutex_unlock(&lock);
+  return result;
+}
+
+CT::string CTracer::getServerTimingHeader(){
+  CT::string header;
+  if(!enabled)return header;
+  CT::string serverTiming = getServerTiming();
+  if(serverTiming.length()>0){
+    header.print("Server-Timing: %s\r\n",serverTiming.c_str());
+  }
+  return header;
+}
+
+void CTracer::printServerTimingHeader(){
+  CT::string header = getServerTimingHeader();
+  if(header.length()>0){
+    printf("%s",header.c_str());
+  }
+}
+
+CT::string CTracer::getSummary(){
+  CT::string result;
+  pthread_mutex_lock(&lock);
+  for(size_t j=0;j<requestTimings.size();j++){
+    if(j>0)result.concat(" ");
+    result.printconcat("%s=%.1fms",requestTimings[j].name.c_str(),requestTimings[j].totalMs);
+    if(requestTimings[j].count>1){
+      result.printconcat("(%dx)",(int)requestTimings[j].count);
+    }
+  }
+  pthread_mutex_unlock(&lock);
+  return result;
+}
+
+void CTracer::endRequest(){
+  pthread_mutex_lock(&lock);
+  for(size_t j=0;j<requestTimings.size();j++){
+    Histogram *histogram = NULL;
+    for(size_t i=0;i<histograms.size();i++){
+      if(histograms[i].name.equals(&requestTimings[j].name)){
+        histogram = &histograms[i];
+        break;
+      }
+    }
+    if(histogram == NULL){
+      Histogram newHistogram;
+      newHistogram.name.copy(&requestTimings[j].name);
+      for(size_t b=0;b<CTRACER_NUMBUCKETS+1;b++)newHistogram.buckets[b]=0;
+      newHistogram.count = 0;
+      newHistogram.sumMs = 0;
+      histograms.push_back(newHistogram);
+      histogram = &histograms.back();
+    }
+    double totalMs = requestTimings[j].totalMs;
+    size_t b=0;
+    while(b<CTRACER_NUMBUCKETS&&totalMs>CTracer_bucketBounds[b])b++;
+    histogram->buckets[b]++;
+    histogram->count++;
+    histogram->sumMs+=totalMs;
+  }
+  requestTimings.clear();
+  pthread_mutex_unlock(&lock);
+}
+
+CT::string CTracer::getMetrics(){
+  CT::string result;
+  result.print("# HELP adaguc_stage_duration_ms Time spent per request in a processing stage\n");
+  result.printconcat("# TYPE adaguc_stage_duration_ms histogram\n");
+  pthread_mutex_lock(&lock);
+  for(size_t i=0;i<histograms.size();i++){
+    Histogram *histogram = &histograms[i];
+    size_t cumulative = 0;
+    for(size_t b=0;b<CTRACER_NUMBUCKETS;b++){
+      cumulative+=histogram->buckets[b];
+      result.printconcat("adaguc_stage_duration_ms_bucket{stage=\"%s\",le=\"%g\"} %lu\n",histogram->name.c_str(),CTracer_bucketBounds[b],(unsigned long)cumulative);
+    }
+    cumulative+=histogram->buckets[CTRACER_NUMBUCKETS];
+    result.printconcat("adaguc_stage_duration_ms_bucket{stage=\"%s\",le=\"+Inf\"} %lu\n",histogram->name.c_str(),(unsigned long)cumulative);
+    result.printconcat("adaguc_stage_duration_ms_sum{stage=\"%s\"} %f\n",histogram->name.c_str(),histogram->sumMs);
+    result.printconcat("adaguc_stage_duration_ms_count{stage=\"%s\"} %lu\n",histogram->name.c_str(),(unsigned long)histogram->count);
+  }
+  pthread_mutex_unlock(&lock);
+  return result;
+}
@@ -0,0 +1,144 @@
+/******************************************************************************
+ *
+ * Project:  Helper classes
+ * Purpose:  Request scoped timing spans and latency histograms
+ * Date:     2026-10-18
+ *
+ ******************************************************************************
+ *
+ * Copyright 2026, Royal Netherlands Meteorological Institute (KNMI)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ******************************************************************************/
+
+#ifndef CTRACER_H
+#define CTRACER_H
+#include <vector>
+#include <pthread.h>
+#include "CTypes.h"
+#include "CDebugger.h"
+
+#define CTRACER_NUMBUCKETS 14
+
+/**
+ * Always available timing of request stages.
+ *
+ * Usage:
+ *   CTracer::Span span("read");
+ * The elapsed time is recorded when the span goes out of scope. Spans opened while another span
+ * is active in the same thread are nested, their name becomes "parent.child" (e.g. request.getmap.read).
+ * A worker thread continues the span of the thread which started it with setCurrentSpan.
+ *
+ * Per request the totals are available as Server-Timing header or as a summary log line. When the request
+ * finishes (endRequest) the totals are folded into process wide histograms, which can be exported in
+ * Prometheus text format with getMetrics.
+ */
+class CTracer{
+  private:
+    DEF_ERRORFUNCTION();
+    class Timing{
+      public:
+        CT::string name;
+        double totalMs;
+        size_t count;
+    };
+    class Histogram{
+      public:
+        CT::string name;
+        size_t buckets[CTRACER_NUMBUCKETS+1];
+        size_t count;
+        double sumMs;
+    };
+    static std::vector<Timing> requestTimings;
+    static std::vector<Histogram> histograms;
+    static pthread_mutex_t lock;
+    static bool enabled;
+    static void record(const char *name,double elapsedMs);
+  public:
+
+    class Span{
+      private:
+        CT::string name;
+        double startMs;
+        Span *parent;
+        bool running;
+      public:
+
+        /**
+         * Starts a span, nested in the current active span of this thread
+         * @param name The name of the stage, use short lowercase tokens like db, open, read, warp, encode
+         */
+        Span(const char *name);
+        ~Span();
+
+        /**
+         * Stops the span before it goes out of scope. Calling stop multiple times is harmless.
+         * @return Elapsed time in milliseconds
+         */
+        double stop();
+    };
+
+    /**
+     * Returns the innermost running span of the calling thread, or NULL
+     */
+    static Span *getCurrentSpan();
+
+    /**
+     * Nests the spans of the calling thread in span, which is usually running in another thread. The span must
+     * outlive the spans of this thread.
+     */
+    static void setCurrentSpan(Span *span);
+
+    /**
+     * Returns the monotonic clock in milliseconds
+     */
+    static double now();
+
+    /**
+     * Enables or disables recording of spans, enabled by default. Can be disabled with environment variable ADAGUC_TRACE=false
+     */
+    static void setEnabled(bool enable);
+    static bool isEnabled();
+
+    /**
+     * Returns the value for the Server-Timing header of the current request, e.g. "request;dur=12.1, request.db;dur=2.0"
+     */
+    static CT::string getServerTiming();
+
+    /**
+     * Returns the Server-Timing header line including \r\n, empty when disabled or nothing was recorded
+     */
+    static CT::string getServerTimingHeader();
+
+    /**
+     * Prints the Server-Timing header line, to be called before the Content-Type line is printed.
+     */
+    static void printServerTimingHeader();
+
+    /**
+     * Returns a one line summary of the current request, e.g. "request=12.1ms db=2.0ms(2x)"
+     */
+    static CT::string getSummary();
+
+    /**
+     * Finishes the current request: The request totals are added to the histograms and are reset.
+     */
+    static void endRequest();
+
+    /**
+     * Returns the histograms aggregated over all requests handled by this process in Prometheus text format.
+     */
+    static CT::string getMetrics();
+};
+#endif
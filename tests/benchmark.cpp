@@ -0,0 +1,835 @@
+/******************************************************************************
+ *
+ * Project:  ADAGUC Server
+ * Purpose:  Benchmark of the GetMap and GetFeatureInfo request pipeline on synthetic data
+ * Date:     2026-10-18
+ *
+ ******************************************************************************
+ *
+ * Copyright 2026, Royal Netherlands Meteorological Institute (KNMI)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ******************************************************************************/
+
+/*
+ * Usage: benchmark --workdir <dir> [--adagucpath <path>] [--iterations <n>] [--filter <name>]
+ *                  [--baseline <file>] [--writebaseline <file>] [--tolerance <fraction>]
+ *
+ * Generates synthetic datasets (regular lat/lon grid, projected grid, curvilinear swath, UGRID mesh, point
+ * timeseries and GeoJSON) with a matching configuration in the workdir, scans them into the database and runs
+ * a set of representative requests through CRequest.
+ *
+ * Every request runs in a forked copy of this process, like a CGI request: the server closes stdout after a
+ * GetMap, and global state like the database connection is not shared between requests. The child reports the
+ * elapsed time, the number of allocations, the output size and the stage timings of CTracer.
+ *
+ * With --baseline the medians are compared with a previous run written by --writebaseline. The exit code is 1
+ * when a request is slower or allocates more than tolerance (default 0.2) above the baseline.
+ *
+ * GetMap requests with several data layers are also rendered with the layers warped one after another, the exit
+ * code is 1 when a pixel of the composited layer images differs more than rounding from the serial image.
+ *
+ * Calculations which do not need a request, like the field statistics and the color index table, are checked first. A failed check counts
+ * as a failed case.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <new>
+#include <map>
+#include <vector>
+#include <algorithm>
+#include <netcdf.h>
+#include <png.h>
+#include "CTypes.h"
+#include "CReadFile.h"
+#include "CTracer.h"
+#include "../adagucserverEC/CRequest.h"
+#include "../adagucserverEC/CServerError.h"
+#include "../adagucserverEC/CDBFileScanner.h"
+#include "../adagucserverEC/CFieldStatistics.h"
+#include "../adagucserverEC/CColorIndexTable.h"
+
+DEF_ERRORMAIN();
+
+/*
+ * Allocations are counted by wrapping malloc at link time (-Wl,--wrap=malloc), this includes operator new of
+ * the MEMLEAKCHECK build. Without MEMLEAKCHECK operator new is replaced here, so it also goes through malloc.
+ */
+static size_t numAllocations = 0;
+static size_t numAllocatedBytes = 0;
+
+extern "C" void *__real_malloc(size_t size);
+extern "C" void *__wrap_malloc(size_t size){
+  __sync_fetch_and_add(&numAllocations,1);
+  __sync_fetch_and_add(&numAllocatedBytes,size);
+  return __real_malloc(size);
+}
+
+#ifndef MEMLEAKCHECK
+void *operator new(size_t size){
+  void *p = malloc(size>0?size:1);
+  if(p==NULL)throw std::bad_alloc();
+  return p;
+}
+void *operator new[](size_t size){
+  return operator new(size);
+}
+void operator delete(void *p) throw(){
+  free(p);
+}
+void operator delete[](void *p) throw(){
+  free(p);
+}
+#endif
+
+#define NCCHECK(call) {int ncStatus=(call);if(ncStatus!=NC_NOERR){CDBError("%s: %s",#call,nc_strerror(ncStatus));throw(__LINE__);}}
+
+class Benchmark{
+  public:
+  class Case{
+    public:
+    const char *name;
+    const char *queryString;
+    const char *expectedContent;
+    size_t numPixels;
+  };
+
+  class Result{
+    public:
+    double elapsedMs;
+    double allocations;
+    double allocatedBytes;
+    double outputBytes;
+    long maxRSSKB;
+    bool contentOk;
+    std::map<std::string,double> stages;
+  };
+
+  CT::string workDir;
+  CT::string adagucPath;
+  CT::string configFile;
+  int iterations;
+  bool warpLayers;
+
+  static void quietFunction(const char *){
+  }
+  static void errorFunction(const char *msg){
+    fprintf(stderr,"%s",msg);
+  }
+
+  /* Regular lat/lon grid with two time steps */
+  void writeRegular(const char *fileName){
+    int nc,dimTime,dimLat,dimLon,varTime,varLat,varLon,var;
+    size_t nx=1440,ny=720,nt=2;
+    NCCHECK(nc_create(fileName,NC_CLOBBER|NC_NETCDF4,&nc));
+    NCCHECK(nc_def_dim(nc,"time",nt,&dimTime));
+    NCCHECK(nc_def_dim(nc,"lat",ny,&dimLat));
+    NCCHECK(nc_def_dim(nc,"lon",nx,&dimLon));
+    NCCHECK(nc_def_var(nc,"time",NC_DOUBLE,1,&dimTime,&varTime));
+    NCCHECK(nc_put_att_text(nc,varTime,"units",strlen("hours since 2000-01-01 00:00:00"),"hours since 2000-01-01 00:00:00"));
+    NCCHECK(nc_put_att_text(nc,varTime,"standard_name",4,"time"));
+    NCCHECK(nc_def_var(nc,"lat",NC_DOUBLE,1,&dimLat,&varLat));
+    NCCHECK(nc_put_att_text(nc,varLat,"units",13,"degrees_north"));
+    NCCHECK(nc_def_var(nc,"lon",NC_DOUBLE,1,&dimLon,&varLon));
+    NCCHECK(nc_put_att_text(nc,varLon,"units",12,"degrees_east"));
+    int dims[]={dimTime,dimLat,dimLon};
+    NCCHECK(nc_def_var(nc,"temperature",NC_FLOAT,3,dims,&var));
+    NCCHECK(nc_put_att_text(nc,var,"units",1,"K"));
+    float fillValue=-9999;
+    NCCHECK(nc_put_att_float(nc,var,"_FillValue",NC_FLOAT,1,&fillValue));
+    NCCHECK(nc_enddef(nc));
+    std::vector<double> lat(ny),lon(nx),time(nt);
+    for(size_t j=0;j<ny;j++)lat[j]=90-(j+0.5)*180./ny;
+    for(size_t j=0;j<nx;j++)lon[j]=-180+(j+0.5)*360./nx;
+    for(size_t j=0;j<nt;j++)time[j]=j*6;
+    NCCHECK(nc_put_var_double(nc,varLat,&lat[0]));
+    NCCHECK(nc_put_var_double(nc,varLon,&lon[0]));
+    NCCHECK(nc_put_var_double(nc,varTime,&time[0]));
+    std::vector<float> data(nx*ny*nt);
+    for(size_t t=0;t<nt;t++)for(size_t y=0;y<ny;y++)for(size_t x=0;x<nx;x++){
+      data[x+y*nx+t*nx*ny]=250+40*cos(lat[y]*M_PI/180)+5*sin(lon[x]*M_PI/30+t);
+    }
+    NCCHECK(nc_put_var_float(nc,var,&data[0]));
+    NCCHECK(nc_close(nc));
+  }
+
+  /* Polar stereographic grid in meters, with ADAGUC proj4_params */
+  void writeProjected(const char *fileName){
+    int nc,dimTime,dimY,dimX,varTime,varY,varX,varProj,var;
+    size_t nx=1000,ny=1000,nt=1;
+    NCCHECK(nc_create(fileName,NC_CLOBBER|NC_NETCDF4,&nc));
+    NCCHECK(nc_def_dim(nc,"time",nt,&dimTime));
+    NCCHECK(nc_def_dim(nc,"y",ny,&dimY));
+    NCCHECK(nc_def_dim(nc,"x",nx,&dimX));
+    NCCHECK(nc_def_var(nc,"time",NC_DOUBLE,1,&dimTime,&varTime));
+    NCCHECK(nc_put_att_text(nc,varTime,"units",strlen("hours since 2000-01-01 00:00:00"),"hours since 2000-01-01 00:00:00"));
+    NCCHECK(nc_put_att_text(nc,varTime,"standard_name",4,"time"));
+    NCCHECK(nc_def_var(nc,"y",NC_DOUBLE,1,&dimY,&varY));
+    NCCHECK(nc_put_att_text(nc,varY,"units",1,"m"));
+    NCCHECK(nc_def_var(nc,"x",NC_DOUBLE,1,&dimX,&varX));
+    NCCHECK(nc_put_att_text(nc,varX,"units",1,"m"));
+    NCCHECK(nc_def_var(nc,"projection",NC_INT,0,NULL,&varProj));
+    const char *proj4="+proj=stere +lat_0=90 +lat_ts=60 +lon_0=0 +k=1 +x_0=0 +y_0=0 +ellps=WGS84 +units=m +no_defs";
+    NCCHECK(nc_put_att_text(nc,varProj,"proj4_params",strlen(proj4),proj4));
+    int dims[]={dimTime,dimY,dimX};
+    NCCHECK(nc_def_var(nc,"precipitation",NC_SHORT,3,dims,&var));
+    NCCHECK(nc_put_att_text(nc,var,"grid_mapping",10,"projection"));
+    NCCHECK(nc_put_att_text(nc,var,"units",2,"mm"));
+    float scaleFactor=0.01;
+    short fillValue=-1;
+    NCCHECK(nc_put_att_float(nc,var,"scale_factor",NC_FLOAT,1,&scaleFactor));
+    NCCHECK(nc_put_att_short(nc,var,"_FillValue",NC_SHORT,1,&fillValue));
+    NCCHECK(nc_enddef(nc));
+    std::vector<double> y(ny),x(nx);
+    double time=0;
+    for(size_t j=0;j<ny;j++)y[j]=-2000000-(j+0.5)*4000;
+    for(size_t j=0;j<nx;j++)x[j]=-2000000+(j+0.5)*4000;
+    NCCHECK(nc_put_var_double(nc,varY,&y[0]));
+    NCCHECK(nc_put_var_double(nc,varX,&x[0]));
+    NCCHECK(nc_put_var_double(nc,varTime,&time));
+    std::vector<short> data(nx*ny);
+    for(size_t j=0;j<ny;j++)for(size_t i=0;i<nx;i++){
+      double v=sin(i*0.02)*cos(j*0.03)*2000;
+      data[i+j*nx]=v>0?short(v):fillValue;
+    }
+    NCCHECK(nc_put_var_short(nc,var,&data[0]));
+    NCCHECK(nc_close(nc));
+  }
+
+  /* Curvilinear swath with cell bounds, tilted over Europe */
+  void writeSwath(const char *fileName){
+    int nc,dimTime,dimRow,dimCol,dimBounds,varTime,varLon,varLat,varLonBnds,varLatBnds,var;
+    size_t nrow=400,ncol=300;
+    NCCHECK(nc_create(fileName,NC_CLOBBER|NC_NETCDF4,&nc));
+    NCCHECK(nc_def_dim(nc,"time",1,&dimTime));
+    NCCHECK(nc_def_dim(nc,"row",nrow,&dimRow));
+    NCCHECK(nc_def_dim(nc,"col",ncol,&dimCol));
+    NCCHECK(nc_def_dim(nc,"bounds",4,&dimBounds));
+    NCCHECK(nc_def_var(nc,"time",NC_DOUBLE,1,&dimTime,&varTime));
+    NCCHECK(nc_put_att_text(nc,varTime,"units",strlen("hours since 2000-01-01 00:00:00"),"hours since 2000-01-01 00:00:00"));
+    NCCHECK(nc_put_att_text(nc,varTime,"standard_name",4,"time"));
+    int dims2D[]={dimRow,dimCol};
+    int dimsBounds[]={dimRow,dimCol,dimBounds};
+    int dims3D[]={dimTime,dimRow,dimCol};
+    NCCHECK(nc_def_var(nc,"lon",NC_FLOAT,2,dims2D,&varLon));
+    NCCHECK(nc_def_var(nc,"lat",NC_FLOAT,2,dims2D,&varLat));
+    NCCHECK(nc_def_var(nc,"lon_bnds",NC_FLOAT,3,dimsBounds,&varLonBnds));
+    NCCHECK(nc_def_var(nc,"lat_bnds",NC_FLOAT,3,dimsBounds,&varLatBnds));
+    NCCHECK(nc_def_var(nc,"radiance",NC_FLOAT,3,dims3D,&var));
+    NCCHECK(nc_put_att_text(nc,var,"units",1,"W"));
+    NCCHECK(nc_enddef(nc));
+    std::vector<float> lon(nrow*ncol),lat(nrow*ncol),lonBnds(nrow*ncol*4),latBnds(nrow*ncol*4),data(nrow*ncol);
+    const double cornerX[]={-0.5,0.5,0.5,-0.5},cornerY[]={-0.5,-0.5,0.5,0.5};
+    for(size_t r=0;r<nrow;r++)for(size_t c=0;c<ncol;c++){
+      size_t p=c+r*ncol;
+      lon[p]=-10+c*0.1+r*0.02;
+      lat[p]=35+r*0.07-c*0.01;
+      for(int b=0;b<4;b++){
+        lonBnds[p*4+b]=-10+(c+cornerX[b])*0.1+(r+cornerY[b])*0.02;
+        latBnds[p*4+b]=35+(r+cornerY[b])*0.07-(c+cornerX[b])*0.01;
+      }
+      data[p]=100+50*sin(c*0.05)*cos(r*0.04);
+    }
+    double time=0;
+    NCCHECK(nc_put_var_double(nc,varTime,&time));
+    NCCHECK(nc_put_var_float(nc,varLon,&lon[0]));
+    NCCHECK(nc_put_var_float(nc,varLat,&lat[0]));
+    NCCHECK(nc_put_var_float(nc,varLonBnds,&lonBnds[0]));
+    NCCHECK(nc_put_var_float(nc,varLatBnds,&latBnds[0]));
+    NCCHECK(nc_put_var_float(nc,var,&data[0]));
+    NCCHECK(nc_close(nc));
+  }
+
+  /* UGRID mesh of quads, with a few missing fourth nodes to make triangles */
+  void writeUGRID(const char *fileName){
+    int nc,dimNode,dimFace,dimMaxNodes,varMesh,varNodeLon,varNodeLat,varFaceNodes;
+    size_t n=150,numNodes=n*n,numFaces=(n-1)*(n-1);
+    NCCHECK(nc_create(fileName,NC_CLOBBER|NC_NETCDF4,&nc));
+    NCCHECK(nc_def_dim(nc,"nMesh_node",numNodes,&dimNode));
+    NCCHECK(nc_def_dim(nc,"nMesh_face",numFaces,&dimFace));
+    NCCHECK(nc_def_dim(nc,"nMaxMesh_face_nodes",4,&dimMaxNodes));
+    NCCHECK(nc_def_var(nc,"mesh",NC_INT,0,NULL,&varMesh));
+    NCCHECK(nc_put_att_text(nc,varMesh,"cf_role",14,"mesh_topology"));
+    NCCHECK(nc_def_var(nc,"mesh_node_lon",NC_FLOAT,1,&dimNode,&varNodeLon));
+    NCCHECK(nc_def_var(nc,"mesh_node_lat",NC_FLOAT,1,&dimNode,&varNodeLat));
+    int dims[]={dimFace,dimMaxNodes};
+    NCCHECK(nc_def_var(nc,"mesh_face_nodes",NC_INT,2,dims,&varFaceNodes));
+    int fillValue=-1;
+    NCCHECK(nc_put_att_int(nc,varFaceNodes,"_FillValue",NC_INT,1,&fillValue));
+    NCCHECK(nc_enddef(nc));
+    std::vector<float> lon(numNodes),lat(numNodes);
+    for(size_t j=0;j<n;j++)for(size_t i=0;i<n;i++){
+      lon[i+j*n]=i*0.1+0.02*sin(j*0.3);
+      lat[i+j*n]=45+j*0.07+0.02*cos(i*0.3);
+    }
+    std::vector<int> faceNodes(numFaces*4);
+    for(size_t j=0;j<n-1;j++)for(size_t i=0;i<n-1;i++){
+      size_t f=i+j*(n-1);
+      faceNodes[f*4]=i+j*n;
+      faceNodes[f*4+1]=i+1+j*n;
+      faceNodes[f*4+2]=i+1+(j+1)*n;
+      faceNodes[f*4+3]=(f%7==0)?fillValue:int(i+(j+1)*n);
+    }
+    NCCHECK(nc_put_var_float(nc,varNodeLon,&lon[0]));
+    NCCHECK(nc_put_var_float(nc,varNodeLat,&lat[0]));
+    NCCHECK(nc_put_var_int(nc,varFaceNodes,&faceNodes[0]));
+    NCCHECK(nc_close(nc));
+  }
+
+  /* ADAGUC point timeseries of stations */
+  void writePoints(const char *fileName){
+    int nc,dimStation,dimTime,varLon,varLat,varTime,var;
+    size_t numStations=5000;
+    NCCHECK(nc_create(fileName,NC_CLOBBER|NC_NETCDF4,&nc));
+    NCCHECK(nc_put_att_text(nc,NC_GLOBAL,"featureType",10,"timeSeries"));
+    NCCHECK(nc_def_dim(nc,"station",numStations,&dimStation));
+    NCCHECK(nc_def_dim(nc,"time",1,&dimTime));
+    NCCHECK(nc_def_var(nc,"lon",NC_FLOAT,1,&dimStation,&varLon));
+    NCCHECK(nc_def_var(nc,"lat",NC_FLOAT,1,&dimStation,&varLat));
+    NCCHECK(nc_def_var(nc,"time",NC_DOUBLE,1,&dimTime,&varTime));
+    NCCHECK(nc_put_att_text(nc,varTime,"units",strlen("hours since 2000-01-01 00:00:00"),"hours since 2000-01-01 00:00:00"));
+    NCCHECK(nc_put_att_text(nc,varTime,"standard_name",4,"time"));
+    int dims[]={dimTime,dimStation};
+    NCCHECK(nc_def_var(nc,"temperature",NC_FLOAT,2,dims,&var));
+    NCCHECK(nc_put_att_text(nc,var,"units",1,"K"));
+    float fillValue=-9999;
+    NCCHECK(nc_put_att_float(nc,var,"_FillValue",NC_FLOAT,1,&fillValue));
+    NCCHECK(nc_enddef(nc));
+    std::vector<float> lon(numStations),lat(numStations),data(numStations);
+    unsigned int seed=1;
+    for(size_t j=0;j<numStations;j++){
+      lon[j]=-180+360*(rand_r(&seed)/(RAND_MAX+1.0));
+      lat[j]=-90+180*(rand_r(&seed)/(RAND_MAX+1.0));
+      data[j]=250+40*cos(lat[j]*M_PI/180);
+    }
+    double time=0;
+    NCCHECK(nc_put_var_float(nc,varLon,&lon[0]));
+    NCCHECK(nc_put_var_float(nc,varLat,&lat[0]));
+    NCCHECK(nc_put_var_double(nc,varTime,&time));
+    NCCHECK(nc_put_var_float(nc,var,&data[0]));
+    NCCHECK(nc_close(nc));
+  }
+
+  /* FeatureCollection with a grid of polygons */
+  void writeGeoJSON(const char *fileName){
+    CT::string json = "{\"type\":\"FeatureCollection\",\"features\":[";
+    int id=0;
+    for(int j=0;j<18;j++){
+      for(int i=0;i<36;i++){
+        double x=-180+i*10,y=-90+j*10;
+        if(id>0)json.concat(",");
+        json.printconcat("{\"type\":\"Feature\",\"id\":\"f%d\",\"properties\":{\"name\":\"f%d\"},\"geometry\":{\"type\":\"Polygon\",\"coordinates\":[[",id,id);
+        for(int k=0;k<=36;k++){
+          double angle=(k%36)*M_PI/18;
+          json.printconcat("%s[%f,%f]",k>0?",":"",x+5+4*cos(angle),y+5+4*sin(angle));
+        }
+        json.concat("]]}}");
+        id++;
+      }
+    }
+    json.concat("]}");
+    CReadFile::write(fileName,json.c_str(),json.length());
+  }
+
+  void writeConfig(){
+    CT::string config;
+    config.print(
+      "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>\n"
+      "<Configuration>\n"
+      "  <TempDir value=\"%s/\"/>\n"
+      "  <Path value=\"%s/\"/>\n"
+      "  <DataBase dbtype=\"sqlite\" parameters=\"%s/benchmark.db\"/>\n"
+      "  <WMS>\n"
+      "    <Title>Benchmark</Title>\n"
+      "    <RootLayer><Title>Benchmark</Title></RootLayer>\n"
+      "    <TitleFont location=\"%s/data/fonts/FreeSans.ttf\" size=\"19\"/>\n"
+      "    <SubTitleFont location=\"%s/data/fonts/FreeSans.ttf\" size=\"10\"/>\n"
+      "    <DimensionFont location=\"%s/data/fonts/FreeSans.ttf\" size=\"7\"/>\n"
+      "    <ContourFont location=\"%s/data/fonts/FreeSans.ttf\" size=\"7\"/>\n"
+      "    <GridFont location=\"%s/data/fonts/FreeSans.ttf\" size=\"5\"/>\n"
+      "    <WMSFormat name=\"image/png\" format=\"image/png32\"/>\n"
+      "  </WMS>\n"
+      "  <WCS><Title>Benchmark</Title><Label>wcsLabel</Label></WCS>\n"
+      "  <Projection id=\"EPSG:4326\" proj4=\"+proj=longlat +ellps=WGS84 +datum=WGS84 +no_defs\"/>\n"
+      "  <Projection id=\"EPSG:3857\" proj4=\"+proj=merc +a=6378137 +b=6378137 +lat_ts=0.0 +lon_0=0.0 +x_0=0.0 +y_0=0 +k=1.0 +units=m +nadgrids=@null +no_defs\"/>\n"
+      "  <Legend name=\"rainbow\" type=\"colorRange\">\n"
+      "    <palette index=\"0\" red=\"0\" green=\"0\" blue=\"255\"/>\n"
+      "    <palette index=\"120\" red=\"0\" green=\"255\" blue=\"0\"/>\n"
+      "    <palette index=\"240\" red=\"255\" green=\"0\" blue=\"0\"/>\n"
+      "  </Legend>\n"
+      "  <Legend name=\"rainbow_transparent\" type=\"colorRange\">\n"
+      "    <palette index=\"0\" red=\"0\" green=\"0\" blue=\"255\" alpha=\"16\"/>\n"
+      "    <palette index=\"120\" red=\"0\" green=\"255\" blue=\"0\" alpha=\"80\"/>\n"
+      "    <palette index=\"240\" red=\"255\" green=\"0\" blue=\"0\" alpha=\"160\"/>\n"
+      "  </Legend>\n"
+      "  <Style name=\"temperature\"><Legend>rainbow</Legend><Min>220</Min><Max>300</Max><RenderMethod>nearest</RenderMethod></Style>\n"
+      "  <Style name=\"temperature_bilinear\"><Legend>rainbow</Legend><Min>220</Min><Max>300</Max><RenderMethod>bilinear</RenderMethod></Style>\n"
+      "  <Style name=\"temperature_shaded\"><Legend>rainbow</Legend><Min>220</Min><Max>300</Max><ShadeInterval>10</ShadeInterval><RenderMethod>shaded</RenderMethod></Style>\n"
+      "  <Style name=\"temperature_transparent\"><Legend>rainbow_transparent</Legend><Min>220</Min><Max>300</Max><RenderMethod>nearest</RenderMethod></Style>\n"
+      "  <Style name=\"precipitation\"><Legend>rainbow</Legend><Min>0</Min><Max>20</Max><RenderMethod>nearest</RenderMethod></Style>\n"
+      "  <Style name=\"precipitation_transparent\"><Legend>rainbow_transparent</Legend><Min>0</Min><Max>20</Max><RenderMethod>nearest</RenderMethod></Style>\n"
+      "  <Style name=\"radiance\"><Legend>rainbow</Legend><Min>50</Min><Max>150</Max><RenderMethod>nearest</RenderMethod></Style>\n"
+      "  <Style name=\"mesh\"><Legend>rainbow</Legend><Min>0</Min><Max>1</Max><RenderMethod>nearest</RenderMethod></Style>\n"
+      "  <Style name=\"points\"><Legend>rainbow</Legend><Min>220</Min><Max>300</Max><RenderMethod>point</RenderMethod></Style>\n"
+      "  <Style name=\"features\"><Legend>rainbow</Legend><Min>0</Min><Max>700</Max><RenderMethod>nearest</RenderMethod></Style>\n"
+      "  <Layer type=\"database\"><Name>regular</Name><FilePath filter=\"\">%s/regular.nc</FilePath><Variable>temperature</Variable><Styles>temperature,temperature_bilinear,temperature_shaded,temperature_transparent</Styles></Layer>\n"
+      "  <Layer type=\"database\"><Name>projected</Name><FilePath filter=\"\">%s/projected.nc</FilePath><Variable>precipitation</Variable><Styles>precipitation,precipitation_transparent</Styles></Layer>\n"
+      "  <Layer type=\"database\"><Name>swath</Name><FilePath filter=\"\">%s/swath.nc</FilePath><Variable>radiance</Variable><Styles>radiance</Styles></Layer>\n"
+      "  <Layer type=\"database\"><Name>ugrid</Name><FilePath filter=\"\">%s/ugrid.nc</FilePath><Variable>mesh</Variable><Styles>mesh</Styles></Layer>\n"
+      "  <Layer type=\"database\"><Name>points</Name><FilePath filter=\"\">%s/points.nc</FilePath><Variable>temperature</Variable><Styles>points</Styles></Layer>\n"
+      "  <Layer type=\"database\"><Name>geojson</Name><FilePath filter=\"\">%s/features.geojson</FilePath><Variable>features</Variable><Styles>features</Styles></Layer>\n"
+      "</Configuration>\n",
+      workDir.c_str(),workDir.c_str(),workDir.c_str(),
+      adagucPath.c_str(),adagucPath.c_str(),adagucPath.c_str(),adagucPath.c_str(),adagucPath.c_str(),
+      workDir.c_str(),workDir.c_str(),workDir.c_str(),workDir.c_str(),workDir.c_str(),workDir.c_str());
+    configFile.print("%s/benchmark.xml",workDir.c_str());
+    CReadFile::write(configFile.c_str(),config.c_str(),config.length());
+  }
+
+  /**
+   * Parses the stage sums of CTracer::getMetrics
+   */
+  static void getStageSums(std::map<std::string,double> &stages){
+    CT::string metrics = CTracer::getMetrics();
+    CT::string *lines = metrics.splitToArray("\n");
+    for(size_t j=0;j<lines->count;j++){
+      const char *prefix="adaguc_stage_duration_ms_sum{stage=\"";
+      if(lines[j].indexOf(prefix)!=0)continue;
+      CT::string line = lines[j].c_str()+strlen(prefix);
+      int end = line.indexOf("\"} ");
+      if(end<0)continue;
+      CT::string value = line.c_str()+end+3;
+      line.setSize(end);
+      stages[line.c_str()]=value.toDouble();
+    }
+    delete[] lines;
+  }
+
+  /**
+   * Runs a request (or the database update when queryString is NULL) in a child process
+   * @return 0 on success
+   */
+  int runInChild(const char *queryString,const char *outputFile,Result &result){
+    int resultPipe[2];
+    if(pipe(resultPipe)!=0){
+      CDBError("Unable to create pipe");
+      return 1;
+    }
+    fflush(stdout);
+    fflush(stderr);
+    pid_t pid = fork();
+    if(pid<0){
+      CDBError("Unable to fork");
+      return 1;
+    }
+    if(pid==0){
+      close(resultPipe[0]);
+      int outputFd = open(outputFile,O_WRONLY|O_CREAT|O_TRUNC,0644);
+      if(outputFd<0)_exit(2);
+      dup2(outputFd,1);
+      close(outputFd);
+      setDebugFunction(quietFunction);
+      setWarningFunction(quietFunction);
+      setErrorFunction(errorFunction);
+      seterrormode(EXCEPTIONS_PLAINTEXT);
+      CImageDataWriter::setWarpLayersEnabled(warpLayers);
+      int status = 0;
+      size_t allocationsBefore = numAllocations;
+      size_t allocatedBytesBefore = numAllocatedBytes;
+      double startMs = CTracer::now();
+      {
+        CRequest request;
+        status = request.setConfigFile(configFile.c_str());
+        if(status==0){
+          if(queryString==NULL){
+            CT::string tailPath,layerPathToScan;
+            status = request.updatedb(&tailPath,&layerPathToScan,CDBFILESCANNER_UPDATEDB);
+          }else{
+            setenv("QUERY_STRING",queryString,1);
+            status = request.runRequest();
+          }
+        }
+        readyerror();
+      }
+      double elapsedMs = CTracer::now()-startMs;
+      struct rusage usage;
+      getrusage(RUSAGE_SELF,&usage);
+      std::map<std::string,double> stages;
+      getStageSums(stages);
+      CT::string report;
+      report.print("%d %f %lu %lu %ld\n",status,elapsedMs,(unsigned long)(numAllocations-allocationsBefore),(unsigned long)(numAllocatedBytes-allocatedBytesBefore),usage.ru_maxrss);
+      for(std::map<std::string,double>::iterator it=stages.begin();it!=stages.end();++it){
+        report.printconcat("%s %f\n",it->first.c_str(),it->second);
+      }
+      if(write(resultPipe[1],report.c_str(),report.length())<0){}
+      close(resultPipe[1]);
+      _exit(0);
+    }
+    close(resultPipe[1]);
+    CT::string report;
+    char buffer[4096];
+    ssize_t n;
+    while((n=read(resultPipe[0],buffer,sizeof(buffer)-1))>0){
+      buffer[n]=0;
+      report.concat(buffer);
+    }
+    close(resultPipe[0]);
+    int childStatus = 0;
+    waitpid(pid,&childStatus,0);
+
+    CT::string *lines = report.splitToArray("\n");
+    int status = 1;
+    if(lines->count>0){
+      unsigned long allocations = 0,allocatedBytes = 0;
+      if(sscanf(lines[0].c_str(),"%d %lf %lu %lu %ld",&status,&result.elapsedMs,&allocations,&allocatedBytes,&result.maxRSSKB)!=5)status=1;
+      result.allocations = allocations;
+      result.allocatedBytes = allocatedBytes;
+      for(size_t j=1;j<lines->count;j++){
+        char name[256];
+        double ms;
+        if(sscanf(lines[j].c_str(),"%255s %lf",name,&ms)==2)result.stages[name]=ms;
+      }
+    }
+    delete[] lines;
+    struct stat st;
+    result.outputBytes = stat(outputFile,&st)==0?st.st_size:0;
+    return status;
+  }
+
+  /**
+   * Reads the RGBA pixels of the PNG image in a response, after its HTTP headers
+   * @return 0 on success
+   */
+  static int readPNGPixels(const char *outputFile,std::vector<unsigned char> &pixels){
+    std::vector<unsigned char> data;
+    FILE *f = fopen(outputFile,"rb");
+    if(f==NULL)return 1;
+    unsigned char buffer[65536];
+    size_t n;
+    while((n=fread(buffer,1,sizeof(buffer),f))>0)data.insert(data.end(),buffer,buffer+n);
+    fclose(f);
+    const unsigned char signature[]={0x89,'P','N','G'};
+    std::vector<unsigned char>::iterator start = std::search(data.begin(),data.end(),signature,signature+4);
+    if(start==data.end())return 1;
+    png_image image;
+    memset(&image,0,sizeof(image));
+    image.version = PNG_IMAGE_VERSION;
+    if(png_image_begin_read_from_memory(&image,&*start,data.end()-start)==0)return 1;
+    image.format = PNG_FORMAT_RGBA;
+    pixels.resize(PNG_IMAGE_SIZE(image));
+    if(png_image_finish_read(&image,NULL,&pixels[0],0,NULL)==0){
+      png_image_free(&image);
+      return 1;
+    }
+    return 0;
+  }
+
+  /**
+   * Renders a GetMap with the data layers warped at the same time and one after another, and compares the pixels.
+   * A pixel which a layer draws more than once is blended in the layer image first, pixel_blend truncates, so its
+   * channels may differ by one.
+   * @return 0 when the images are equal
+   */
+  int compareWarpLayers(const Case &comparisonCase,size_t &numDifferent,int &maxDifference){
+    CT::string compositeFile,serialFile;
+    compositeFile.print("%s/%s_composite.out",workDir.c_str(),comparisonCase.name);
+    serialFile.print("%s/%s_serial.out",workDir.c_str(),comparisonCase.name);
+    Result result;
+    warpLayers = true;
+    int status = runInChild(comparisonCase.queryString,compositeFile.c_str(),result);
+    warpLayers = false;
+    if(status==0)status = runInChild(comparisonCase.queryString,serialFile.c_str(),result);
+    warpLayers = true;
+    if(status!=0){
+      CDBError("Request %s failed",comparisonCase.name);
+      return 1;
+    }
+    std::vector<unsigned char> compositePixels,serialPixels;
+    if(readPNGPixels(compositeFile.c_str(),compositePixels)!=0||readPNGPixels(serialFile.c_str(),serialPixels)!=0){
+      CDBError("Unable to read the PNG images of %s",comparisonCase.name);
+      return 1;
+    }
+    if(compositePixels.size()!=serialPixels.size()||compositePixels.size()!=comparisonCase.numPixels*4){
+      CDBError("Image sizes of %s differ",comparisonCase.name);
+      return 1;
+    }
+    numDifferent = 0;
+    maxDifference = 0;
+    for(size_t p=0;p<comparisonCase.numPixels;p++){
+      int pixelDifference = 0;
+      for(size_t c=0;c<4;c++){
+        int difference = abs(compositePixels[p*4+c]-serialPixels[p*4+c]);
+        if(difference>pixelDifference)pixelDifference = difference;
+      }
+      if(pixelDifference>1)numDifferent++;
+      if(pixelDifference>maxDifference)maxDifference = pixelDifference;
+    }
+    return numDifferent==0?0:1;
+  }
+
+  static double median(std::vector<double> values){
+    if(values.size()==0)return 0;
+    std::sort(values.begin(),values.end());
+    return values[values.size()/2];
+  }
+
+  /**
+   * Runs a case iterations times after one warm up run, and returns the median of each measure
+   */
+  int runCase(const Case &benchmarkCase,Result &medianResult){
+    CT::string outputFile;
+    outputFile.print("%s/%s.out",workDir.c_str(),benchmarkCase.name);
+    std::vector<double> elapsed,allocations,allocatedBytes;
+    std::map<std::string,std::vector<double> > stages;
+    medianResult.maxRSSKB = 0;
+    medianResult.contentOk = true;
+    for(int j=-1;j<iterations;j++){
+      Result result;
+      if(runInChild(benchmarkCase.queryString,outputFile.c_str(),result)!=0){
+        CDBError("Request %s failed, see %s",benchmarkCase.name,outputFile.c_str());
+        return 1;
+      }
+      if(j<0){
+        //Warm up run, also checks the content
+        CT::string output = CReadFile::open(outputFile.c_str());
+        if(output.indexOf(benchmarkCase.expectedContent)<0)medianResult.contentOk = false;
+        continue;
+      }
+      elapsed.push_back(result.elapsedMs);
+      allocations.push_back(result.allocations);
+      allocatedBytes.push_back(result.allocatedBytes);
+      for(std::map<std::string,double>::iterator it=result.stages.begin();it!=result.stages.end();++it){
+        stages[it->first].push_back(it->second);
+      }
+      if(result.maxRSSKB>medianResult.maxRSSKB)medianResult.maxRSSKB = result.maxRSSKB;
+      medianResult.outputBytes = result.outputBytes;
+    }
+    medianResult.elapsedMs = median(elapsed);
+    medianResult.allocations = median(allocations);
+    medianResult.allocatedBytes = median(allocatedBytes);
+    for(std::map<std::string,std::vector<double> >::iterator it=stages.begin();it!=stages.end();++it){
+      medianResult.stages[it->first] = median(it->second);
+    }
+    return 0;
+  }
+};
+
+/**
+ * Checks the average and standard deviation of fields where the sum of squares loses all precision
+ * @return The number of failed checks
+ */
+static int checkFieldStatistics(){
+  int numFailed = 0;
+  CFieldStatistics statistics;
+  std::vector<float> constantField(1000003,273.15f);
+  statistics.calculate(&constantField[0],constantField.size(),CFIELDSTATISTICS_DEFAULT_BINS);
+  if(!(statistics.stddev<1e-6)||statistics.min!=constantField[0]||statistics.max!=constantField[0]||fabs(statistics.avg-constantField[0])>1e-6){
+    printf("%-26s avg %.17g stddev %.17g, expected avg %.17g stddev below 1e-6  UNEXPECTED OUTPUT\n","fieldstatistics_constant",statistics.avg,statistics.stddev,double(constantField[0]));
+    numFailed++;
+  }else{
+    printf("%-26s ok\n","fieldstatistics_constant");
+  }
+  std::vector<float> offsetField(1000000);
+  for(size_t j=0;j<offsetField.size();j++)offsetField[j]=j%2==0?999999.f:1000001.f;
+  statistics.calculate(&offsetField[0],offsetField.size(),CFIELDSTATISTICS_DEFAULT_BINS);
+  double expectedStddev = sqrt(double(offsetField.size())/double(offsetField.size()-1));
+  if(!(fabs(statistics.stddev-expectedStddev)<1e-9)||statistics.avg!=1000000){
+    printf("%-26s avg %.17g stddev %.17g, expected avg 1000000 stddev %.17g  UNEXPECTED OUTPUT\n","fieldstatistics_offset",statistics.avg,statistics.stddev,expectedStddev);
+    numFailed++;
+  }else{
+    printf("%-26s ok\n","fieldstatistics_offset");
+  }
+  return numFailed;
+}
+
+/**
+ * Checks that the binned color index of an integer variable with a logarithmic legend equals the calculated index
+ * @return The number of failed checks
+ */
+static int checkColorIndexTable(){
+  CStyleConfiguration styleConfiguration;
+  styleConfiguration.legendLog = 10;
+  styleConfiguration.legendScale = 100;
+  styleConfiguration.legendOffset = 0;
+  CColorIndexTable colorIndexTable;
+  colorIndexTable.init(&styleConfiguration,false,0);
+  colorIndexTable.prepare(CDF_INT);
+  int numMismatches = 0,firstMismatch = 0;
+  for(int value=-1000;value<2000000;value++){
+    if(colorIndexTable.get(value)!=colorIndexTable.calculate(value)){
+      if(numMismatches==0)firstMismatch = value;
+      numMismatches++;
+    }
+  }
+  if(numMismatches>0||colorIndexTable.get(50)!=100){
+    printf("%-26s %d mismatches from value %d, index of 50 is %d, expected 100  UNEXPECTED OUTPUT\n","colorindextable_intlog",numMismatches,firstMismatch,colorIndexTable.get(50));
+    return 1;
+  }
+  printf("%-26s ok\n","colorindextable_intlog");
+  return 0;
+}
+
+static const Benchmark::Case benchmarkCases[]={
+  {"regular_getmap_4326","SERVICE=WMS&VERSION=1.3.0&REQUEST=GetMap&LAYERS=regular&STYLES=temperature&CRS=EPSG:4326&BBOX=-90,-180,90,180&WIDTH=1024&HEIGHT=512&FORMAT=image/png&TRANSPARENT=TRUE","PNG",1024*512},
+  {"regular_getmap_3857","SERVICE=WMS&VERSION=1.3.0&REQUEST=GetMap&LAYERS=regular&STYLES=temperature&CRS=EPSG:3857&BBOX=-20037508,-15000000,20037508,15000000&WIDTH=1024&HEIGHT=768&FORMAT=image/png&TRANSPARENT=TRUE","PNG",1024*768},
+  {"regular_getmap_4k","SERVICE=WMS&VERSION=1.3.0&REQUEST=GetMap&LAYERS=regular&STYLES=temperature&CRS=EPSG:4326&BBOX=-90,-180,90,180&WIDTH=3840&HEIGHT=1920&FORMAT=image/png&TRANSPARENT=TRUE","PNG",3840*1920},
+  {"regular_getmap_bilinear","SERVICE=WMS&VERSION=1.3.0&REQUEST=GetMap&LAYERS=regular&STYLES=temperature_bilinear&CRS=EPSG:3857&BBOX=-20037508,-15000000,20037508,15000000&WIDTH=1024&HEIGHT=768&FORMAT=image/png&TRANSPARENT=TRUE","PNG",1024*768},
+  {"regular_getfeatureinfo","SERVICE=WMS&VERSION=1.3.0&REQUEST=GetFeatureInfo&LAYERS=regular&QUERY_LAYERS=regular&STYLES=&CRS=EPSG:4326&BBOX=-90,-180,90,180&WIDTH=1024&HEIGHT=512&I=600&J=200&INFO_FORMAT=text/html","regular",0},
+  {"projected_getmap","SERVICE=WMS&VERSION=1.3.0&REQUEST=GetMap&LAYERS=projected&STYLES=precipitation&CRS=EPSG:4326&BBOX=30,-60,90,60&WIDTH=1024&HEIGHT=512&FORMAT=image/png&TRANSPARENT=TRUE","PNG",1024*512},
+  {"swath_getmap","SERVICE=WMS&VERSION=1.3.0&REQUEST=GetMap&LAYERS=swath&STYLES=radiance&CRS=EPSG:3857&BBOX=-1500000,4000000,4500000,10000000&WIDTH=1024&HEIGHT=1024&FORMAT=image/png&TRANSPARENT=TRUE","PNG",1024*1024},
+  {"ugrid_getmap","SERVICE=WMS&VERSION=1.3.0&REQUEST=GetMap&LAYERS=ugrid&STYLES=mesh&CRS=EPSG:4326&BBOX=44,-1,57,16&WIDTH=1024&HEIGHT=1024&FORMAT=image/png&TRANSPARENT=TRUE","PNG",1024*1024},
+  {"points_getmap","SERVICE=WMS&VERSION=1.3.0&REQUEST=GetMap&LAYERS=points&STYLES=points&CRS=EPSG:4326&BBOX=-90,-180,90,180&WIDTH=1024&HEIGHT=512&FORMAT=image/png&TRANSPARENT=TRUE","PNG",1024*512},
+  {"geojson_getmap","SERVICE=WMS&VERSION=1.3.0&REQUEST=GetMap&LAYERS=geojson&STYLES=features&CRS=EPSG:4326&BBOX=-90,-180,90,180&WIDTH=1024&HEIGHT=512&FORMAT=image/png&TRANSPARENT=TRUE","PNG",1024*512},
+};
+
+/* GetMap requests with two or more data layers of distinct files, which are warped in layer images */
+static const Benchmark::Case comparisonCases[]={
+  {"composite_nearest","SERVICE=WMS&VERSION=1.3.0&REQUEST=GetMap&LAYERS=regular,projected&STYLES=temperature,precipitation&CRS=EPSG:4326&BBOX=-90,-180,90,180&WIDTH=1024&HEIGHT=512&FORMAT=image/png32&TRANSPARENT=TRUE","PNG",1024*512},
+  {"composite_shaded","SERVICE=WMS&VERSION=1.3.0&REQUEST=GetMap&LAYERS=regular,projected,swath&STYLES=temperature_shaded,precipitation,radiance&CRS=EPSG:3857&BBOX=-1500000,4000000,4500000,10000000&WIDTH=1024&HEIGHT=1024&FORMAT=image/png32&TRANSPARENT=TRUE","PNG",1024*1024},
+  {"composite_transparent","SERVICE=WMS&VERSION=1.3.0&REQUEST=GetMap&LAYERS=regular,projected&STYLES=temperature_transparent,precipitation_transparent&CRS=EPSG:4326&BBOX=-90,-180,90,180&WIDTH=1024&HEIGHT=512&FORMAT=image/png32&TRANSPARENT=TRUE","PNG",1024*512},
+};
+
+int main(int argc,const char *argv[]){
+  Benchmark benchmark;
+  CT::string baselineFile,writeBaselineFile,filter;
+  double tolerance = 0.2;
+  benchmark.adagucPath = "..";
+  benchmark.iterations = 5;
+  benchmark.warpLayers = true;
+  for(int j=1;j<argc;j++){
+    CT::string argument = argv[j];
+    if(j+1<argc&&argument.equals("--workdir"))benchmark.workDir = argv[++j];
+    else if(j+1<argc&&argument.equals("--adagucpath"))benchmark.adagucPath = argv[++j];
+    else if(j+1<argc&&argument.equals("--iterations"))benchmark.iterations = atoi(argv[++j]);
+    else if(j+1<argc&&argument.equals("--filter"))filter = argv[++j];
+    else if(j+1<argc&&argument.equals("--baseline"))baselineFile = argv[++j];
+    else if(j+1<argc&&argument.equals("--writebaseline"))writeBaselineFile = argv[++j];
+    else if(j+1<argc&&argument.equals("--tolerance"))tolerance = atof(argv[++j]);
+    else{
+      fprintf(stderr,"Unknown argument %s\n",argv[j]);
+      return 1;
+    }
+  }
+  if(benchmark.workDir.empty()||benchmark.iterations<1){
+    fprintf(stderr,"Usage: benchmark --workdir <dir> [--adagucpath <path>] [--iterations <n>] [--filter <name>] [--baseline <file>] [--writebaseline <file>] [--tolerance <fraction>]\n");
+    return 1;
+  }
+  setDebugFunction(Benchmark::quietFunction);
+  setWarningFunction(Benchmark::quietFunction);
+  setErrorFunction(Benchmark::errorFunction);
+  mkdir(benchmark.workDir.c_str(),0755);
+
+  //Synthetic data, configuration and database
+  try{
+    double startMs = CTracer::now();
+    CT::string fileName;
+    fileName.print("%s/regular.nc",benchmark.workDir.c_str());benchmark.writeRegular(fileName.c_str());
+    fileName.print("%s/projected.nc",benchmark.workDir.c_str());benchmark.writeProjected(fileName.c_str());
+    fileName.print("%s/swath.nc",benchmark.workDir.c_str());benchmark.writeSwath(fileName.c_str());
+    fileName.print("%s/ugrid.nc",benchmark.workDir.c_str());benchmark.writeUGRID(fileName.c_str());
+    fileName.print("%s/points.nc",benchmark.workDir.c_str());benchmark.writePoints(fileName.c_str());
+    fileName.print("%s/features.geojson",benchmark.workDir.c_str());benchmark.writeGeoJSON(fileName.c_str());
+    benchmark.writeConfig();
+    printf("Generated data in %.1f ms\n",CTracer::now()-startMs);
+  }catch(int e){
+    fprintf(stderr,"Unable to generate data in %s (%d)\n",benchmark.workDir.c_str(),e);
+    return 1;
+  }
+  CT::string updateDBOutput;
+  updateDBOutput.print("%s/updatedb.out",benchmark.workDir.c_str());
+  Benchmark::Result updateDBResult;
+  if(benchmark.runInChild(NULL,updateDBOutput.c_str(),updateDBResult)!=0){
+    fprintf(stderr,"Unable to update the database\n");
+    return 1;
+  }
+  printf("Updated database in %.1f ms\n\n",updateDBResult.elapsedMs);
+
+  std::map<std::string,std::pair<double,double> > baseline;
+  if(!baselineFile.empty()){
+    FILE *f = fopen(baselineFile.c_str(),"r");
+    if(f==NULL){
+      fprintf(stderr,"Unable to read baseline %s\n",baselineFile.c_str());
+      return 1;
+    }
+    char name[256];
+    double ms,allocations;
+    char line[1024];
+    while(fgets(line,sizeof(line),f)!=NULL){
+      if(line[0]=='#')continue;
+      if(sscanf(line,"%255s %lf %lf",name,&ms,&allocations)==3)baseline[name]=std::pair<double,double>(ms,allocations);
+    }
+    fclose(f);
+  }
+
+  CT::string newBaseline = "# name median_ms allocations\n";
+  int numFailed = 0,numRegressions = 0;
+  if(filter.empty()){
+    numFailed+=checkFieldStatistics();
+    numFailed+=checkColorIndexTable();
+    printf("\n");
+  }
+  printf("%-26s %10s %10s %12s %10s %10s %10s\n","case","median ms","req/s","MPixel/s","allocs","MB alloc","maxrss MB");
+  for(size_t c=0;c<sizeof(benchmarkCases)/sizeof(Benchmark::Case);c++){
+    const Benchmark::Case &benchmarkCase = benchmarkCases[c];
+    if(!filter.empty()&&strstr(benchmarkCase.name,filter.c_str())==NULL)continue;
+    Benchmark::Result result;
+    if(benchmark.runCase(benchmarkCase,result)!=0){
+      numFailed++;
+      continue;
+    }
+    double mpixels = benchmarkCase.numPixels>0?benchmarkCase.numPixels/(result.elapsedMs*1000):0;
+    printf("%-26s %10.2f %10.1f %12.2f %10.0f %10.2f %10.1f%s\n",benchmarkCase.name,result.elapsedMs,1000/result.elapsedMs,mpixels,
+           result.allocations,result.allocatedBytes/1048576,result.maxRSSKB/1024.,result.contentOk?"":"  UNEXPECTED OUTPUT");
+    if(!result.contentOk)numFailed++;
+    for(std::map<std::string,double>::iterator it=result.stages.begin();it!=result.stages.end();++it){
+      printf("    %-40s %10.2f ms\n",it->first.c_str(),it->second);
+    }
+    newBaseline.printconcat("%s %f %f\n",benchmarkCase.name,result.elapsedMs,result.allocations);
+    std::map<std::string,std::pair<double,double> >::iterator b = baseline.find(benchmarkCase.name);
+    if(b!=baseline.end()){
+      double timeRatio = result.elapsedMs/b->second.first;
+      double allocationRatio = b->second.second>0?result.allocations/b->second.second:1;
+      bool isRegression = timeRatio>1+tolerance||allocationRatio>1+tolerance;
+      printf("    baseline %.2f ms (%+.1f%%), %.0f allocations (%+.1f%%)%s\n",b->second.first,(timeRatio-1)*100,b->second.second,(allocationRatio-1)*100,isRegression?"  REGRESSION":"");
+      if(isRegression)numRegressions++;
+    }
+  }
+  for(size_t c=0;c<sizeof(comparisonCases)/sizeof(Benchmark::Case);c++){
+    const Benchmark::Case &comparisonCase = comparisonCases[c];
+    if(!filter.empty()&&strstr(comparisonCase.name,filter.c_str())==NULL)continue;
+    size_t numDifferent = 0;
+    int maxDifference = 0;
+    if(benchmark.compareWarpLayers(comparisonCase,numDifferent,maxDifference)!=0){
+      numFailed++;
+      if(numDifferent>0)printf("%-26s %lu pixels differ from the serial image, max difference %d  UNEXPECTED OUTPUT\n",comparisonCase.name,(unsigned long)numDifferent,maxDifference);
+      continue;
+    }
+    printf("%-26s equal to the serial image, max difference %d\n",comparisonCase.name,maxDifference);
+  }
+  if(!writeBaselineFile.empty()){
+    CReadFile::write(writeBaselineFile.c_str(),newBaseline.c_str(),newBaseline.length());
+    printf("\nBaseline written to %s\n",writeBaselineFile.c_str());
+  }
+  if(numFailed>0)printf("\n%d cases failed\n",numFailed);
+  if(numRegressions>0)printf("\n%d regressions above %.0f%%\n",numRegressions,tolerance*100);
+  return numFailed>0||numRegressions>0?1:0;
+}